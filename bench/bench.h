@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 一个基准测试: run() 执行一轮, 一轮包含 ops_per_run 次操作
+struct bench_case {
+	std::string name;
+	size_t ops_per_run;
+	std::function<void()> run;
+	// 每次操作是一条光线时额外报告 Mrays/s
+	bool counts_rays = false;
+	// 被选中时才调用一次, 用于构建大场景
+	std::function<void()> setup = nullptr;
+};
+
+struct bench_result {
+	std::string name;
+	double ns_per_op;
+	double ops_per_second;
+	// counts_rays 为 false 时为 0
+	double mrays_per_second;
+	// 每条光线的最后一级缓存缺失, 没有硬件计数器或 counts_rays 为 false 时为 -1
+	double cache_misses_per_op = -1;
+};
+
+// 所有用例生成数据时使用的种子, 保证每次运行的输入相同
+const uint64_t bench_seed = 42;
+
+// 防止编译器把被测代码当作死代码删掉: 让编译器认为 value 被读取, 且内存可能被改写
+template <typename T>
+inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "g"(&value) : "memory");
+#else
+	// MSVC 没有内联汇编: 把 value 逐字节复制到 volatile 变量里
+	static volatile unsigned char sink;
+	const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+	for (size_t k = 0; k < sizeof(T); ++k)
+		sink = bytes[k];
+#endif
+}
+
+// 先预热, 再重复 repetitions 轮, 取中位数
+bench_result run_bench(const bench_case &c, int repetitions, double warmup_seconds);
+
+// 各个模块的测试用例
+void register_geometry_benches(std::vector<bench_case> &cases);
+void register_material_benches(std::vector<bench_case> &cases);
+void register_perlin_benches(std::vector<bench_case> &cases);
+void register_texture_benches(std::vector<bench_case> &cases);
+void register_arena_benches(std::vector<bench_case> &cases);
+void register_accel_benches(std::vector<bench_case> &cases);
+void register_shading_benches(std::vector<bench_case> &cases);
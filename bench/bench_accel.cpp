@@ -0,0 +1,339 @@
+#include "bench.h"
+
+#include "asset/material.h"
+#include "geometry/bvh.h"
+#include "geometry/lazy_bvh.h"
+#include "geometry/packed_bvh.h"
+#include "geometry/scene_arena.h"
+#include "render/scene.h"
+#include "shape/sphere.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+namespace {
+	const size_t camera_rays = 4096;
+	const size_t million = 1000000;
+
+	// 同一个场景的四种加速结构, 和一组相机光线加上它们命中点处的漫反射光线
+	struct accel_state {
+		scene s;
+		shared_ptr<hittable> packed;
+		shared_ptr<hittable> lbvh;
+		shared_ptr<hittable> qbvh;
+		std::vector<ray> rays;
+		bool ready = false;
+	};
+
+	// 10^6 个随机小球: 几种建树方法的用时、节点占用的内存和建好之后的求交速度
+	struct million_state {
+		hittable_list spheres;
+		shared_ptr<hittable> bvh, packed, lbvh, qbvh;
+		std::vector<ray> rays;
+		bool ready = false;
+	};
+
+	void prepare(accel_state &state, const std::string &name) {
+		if (state.ready)
+			return;
+		make_scene(name, state.s);
+		state.packed = make_shared<packed_bvh>(state.s.world, 0.0, 1.0);
+		state.lbvh = make_shared<packed_bvh>(state.s.world, 0.0, 1.0, packed_bvh::build_method::lbvh);
+		state.qbvh = make_shared<packed_bvh>(state.s.world, 0.0, 1.0, packed_bvh::build_method::sah,
+											 packed_bvh::node_format::quantized);
+
+		// 光线用固定的种子生成, 两个用例的输入相同
+		random_generator() = pcg32(bench_seed, 13);
+		pcg32 rng(bench_seed, 14);
+		std::vector<ray> bounces;
+		for (size_t k = 0; bounces.size() < camera_rays && k < 16 * camera_rays; ++k) {
+			const ray r = state.s.cam.get_ray(rng.next_double(), rng.next_double());
+			if (state.rays.size() < camera_rays)
+				state.rays.push_back(r);
+			hit_record rec;
+			if (state.s.world.hit(r, 0.001, infinity, rec))
+				bounces.emplace_back(rec.p, rec.normal + random_unit_vector(), r.time());
+		}
+		// 几乎看不到几何体的场景用相机光线补足
+		for (size_t k = 0; bounces.size() < camera_rays; ++k)
+			bounces.push_back(state.rays[k]);
+		state.rays.insert(state.rays.end(), bounces.begin(), bounces.end());
+
+		const auto stats = static_cast<const packed_bvh &>(*state.packed).stats();
+		const auto qstats = static_cast<const packed_bvh &>(*state.qbvh).stats();
+		std::fprintf(stderr,
+					 "accel/%s: %zu rays (half camera, half diffuse bounces), packed bvh %zu nodes, %zu leaves, "
+					 "%zu KB of nodes; quantized %zu nodes, %zu KB\n",
+					 name.c_str(), state.rays.size(), stats.nodes, stats.leaves, stats.node_bytes >> 10, qstats.nodes,
+					 qstats.node_bytes >> 10);
+		state.ready = true;
+	}
+
+	void add_accel_cases(std::vector<bench_case> &cases, const std::string &name) {
+		auto state = std::make_shared<accel_state>();
+
+		bench_case bvh_case{"accel/" + name + "_bvh", 2 * camera_rays, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : state->rays)
+				hits += state->s.world.hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		bvh_case.counts_rays = true;
+		bvh_case.setup = [=]() { prepare(*state, name); };
+		cases.push_back(bvh_case);
+
+		bench_case packed_case{"accel/" + name + "_packed", 2 * camera_rays, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : state->rays)
+				hits += state->packed->hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		packed_case.counts_rays = true;
+		packed_case.setup = [=]() { prepare(*state, name); };
+		cases.push_back(packed_case);
+
+		bench_case lbvh_case{"accel/" + name + "_lbvh", 2 * camera_rays, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : state->rays)
+				hits += state->lbvh->hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		lbvh_case.counts_rays = true;
+		lbvh_case.setup = [=]() { prepare(*state, name); };
+		cases.push_back(lbvh_case);
+
+		bench_case qbvh_case{"accel/" + name + "_qbvh", 2 * camera_rays, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : state->rays)
+				hits += state->qbvh->hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		qbvh_case.counts_rays = true;
+		qbvh_case.setup = [=]() { prepare(*state, name); };
+		cases.push_back(qbvh_case);
+	}
+
+	// 10^6 个小球铺在 1000 x 1000 的平板上, 相机在一边只看到前面的一小块: 比较建好整棵树和按需划分的首帧时间
+	struct lazy_state {
+		hittable_list spheres;
+		std::vector<ray> rays;
+		bool ready = false;
+	};
+
+	size_t trace_all(const hittable &accel, const std::vector<ray> &rays) {
+		hit_record rec;
+		size_t hits = 0;
+		for (const auto &r : rays)
+			hits += accel.hit(r, 0.001, infinity, rec);
+		return hits;
+	}
+
+	double seconds_since(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void prepare_million(million_state &state) {
+		if (state.ready)
+			return;
+		pcg32 rng(bench_seed, 15);
+		auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+		for (size_t k = 0; k < million; ++k) {
+			const point3 center(40 * rng.next_double() - 20, 40 * rng.next_double() - 20, 40 * rng.next_double() - 20);
+			state.spheres.add(make_shared<sphere>(center, 0.05 + 0.2 * rng.next_double(), mat));
+		}
+
+		// 先各建一次, 报告单次的用时; bvh_node 的节点分散在堆上, 用建树前后堆的用量计算它的内存
+		const size_t heap_before = heap_bytes_in_use();
+		auto start = std::chrono::steady_clock::now();
+		state.bvh = make_shared<bvh_node>(state.spheres, 0.0, 1.0);
+		const double bvh_seconds = seconds_since(start);
+		const size_t bvh_bytes = heap_bytes_in_use() - heap_before;
+		start = std::chrono::steady_clock::now();
+		state.packed = make_shared<packed_bvh>(state.spheres, 0.0, 1.0);
+		const double packed_seconds = seconds_since(start);
+		start = std::chrono::steady_clock::now();
+		state.lbvh = make_shared<packed_bvh>(state.spheres, 0.0, 1.0, packed_bvh::build_method::lbvh);
+		const double lbvh_seconds = seconds_since(start);
+		start = std::chrono::steady_clock::now();
+		state.qbvh = make_shared<packed_bvh>(state.spheres, 0.0, 1.0, packed_bvh::build_method::sah,
+											 packed_bvh::node_format::quantized);
+		const double qbvh_seconds = seconds_since(start);
+
+		// 从立方体外面射向里面随机的点, 再加上命中点处的漫反射光线
+		random_generator() = pcg32(bench_seed, 16);
+		std::vector<ray> bounces;
+		const point3 eye(0, 0, -60);
+		for (size_t k = 0; k < camera_rays; ++k) {
+			const point3 target(40 * rng.next_double() - 20, 40 * rng.next_double() - 20, 40 * rng.next_double() - 20);
+			const ray r(eye, target - eye, 0.0);
+			state.rays.push_back(r);
+			hit_record rec;
+			if (state.bvh->hit(r, 0.001, infinity, rec))
+				bounces.emplace_back(rec.p, rec.normal + random_unit_vector(), r.time());
+		}
+		for (size_t k = 0; bounces.size() < camera_rays; ++k)
+			bounces.push_back(state.rays[k]);
+		state.rays.insert(state.rays.end(), bounces.begin(), bounces.end());
+
+		std::fprintf(stderr,
+					 "accel/million: %zu spheres, build bvh_node %.3f s, packed (sah) %.3f s, lbvh %.3f s, "
+					 "quantized %.3f s\n",
+					 million, bvh_seconds, packed_seconds, lbvh_seconds, qbvh_seconds);
+		const auto packed_stats = static_cast<const packed_bvh &>(*state.packed).stats();
+		const auto qbvh_stats = static_cast<const packed_bvh &>(*state.qbvh).stats();
+		std::fprintf(stderr,
+					 "accel/million: node bytes per primitive: bvh_node %.1f (heap), packed %.1f (%zu nodes), "
+					 "quantized %.1f (%zu nodes + %zu leaf ranges)\n",
+					 static_cast<double>(bvh_bytes) / million, static_cast<double>(packed_stats.node_bytes) / million,
+					 packed_stats.nodes, static_cast<double>(qbvh_stats.node_bytes) / million, qbvh_stats.nodes,
+					 qbvh_stats.leaves);
+		state.ready = true;
+	}
+
+	void prepare_lazy(lazy_state &state) {
+		if (state.ready)
+			return;
+		pcg32 rng(bench_seed, 17);
+		auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+		for (size_t k = 0; k < million; ++k) {
+			const point3 center(1000 * rng.next_double() - 500, 2 * rng.next_double(), 1000 * rng.next_double() - 500);
+			state.spheres.add(make_shared<sphere>(center, 0.2 + 0.3 * rng.next_double(), mat));
+		}
+
+		// 相机光线在 20 度的锥里, 命中点处再加一条漫反射光线
+		random_generator() = pcg32(bench_seed, 18);
+		const packed_bvh reference(state.spheres, 0.0, 1.0);
+		const point3 eye(0, 5, -520);
+		std::vector<ray> bounces;
+		for (size_t k = 0; k < camera_rays; ++k) {
+			const vec3 dir(0.35 * (rng.next_double() - 0.5), -0.05 - 0.1 * rng.next_double(), 1.0);
+			const ray r(eye, dir, 0.0);
+			state.rays.push_back(r);
+			hit_record rec;
+			if (reference.hit(r, 0.001, infinity, rec))
+				bounces.emplace_back(rec.p, rec.normal + random_unit_vector(), r.time());
+		}
+		for (size_t k = 0; bounces.size() < camera_rays; ++k)
+			bounces.push_back(state.rays[k]);
+		state.rays.insert(state.rays.end(), bounces.begin(), bounces.end());
+
+		auto start = std::chrono::steady_clock::now();
+		const lazy_bvh lazy(state.spheres, 0.0, 1.0);
+		const double ready = seconds_since(start);
+		trace_all(lazy, state.rays);
+		const double first_frame = seconds_since(start);
+		const auto stats = lazy.stats();
+		std::fprintf(stderr,
+					 "accel/lazy: %zu spheres, %zu rays, lazy bvh ready in %.3f s, first rays done at %.3f s, "
+					 "%zu of %zu nodes built\n",
+					 million, state.rays.size(), ready, first_frame, stats.nodes, stats.max_nodes);
+		state.ready = true;
+	}
+
+	void add_lazy_cases(std::vector<bench_case> &cases) {
+		auto state = std::make_shared<lazy_state>();
+		auto setup = [=]() { prepare_lazy(*state); };
+
+		// 每轮建一次树再追踪所有光线, 即从场景就绪到第一批光线追踪完的时间
+		bench_case eager{"accel/lazy_first_rays_packed", 1, [=]() {
+			packed_bvh tree(state->spheres, 0.0, 1.0);
+			do_not_optimize(trace_all(tree, state->rays));
+		}};
+		eager.setup = setup;
+		cases.push_back(eager);
+
+		bench_case lbvh{"accel/lazy_first_rays_lbvh", 1, [=]() {
+			packed_bvh tree(state->spheres, 0.0, 1.0, packed_bvh::build_method::lbvh);
+			do_not_optimize(trace_all(tree, state->rays));
+		}};
+		lbvh.setup = setup;
+		cases.push_back(lbvh);
+
+		bench_case lazy{"accel/lazy_first_rays_lazy", 1, [=]() {
+			lazy_bvh tree(state->spheres, 0.0, 1.0);
+			do_not_optimize(trace_all(tree, state->rays));
+		}};
+		lazy.setup = setup;
+		cases.push_back(lazy);
+
+		// 树已经建好(lazy 已经划分过这些光线用到的节点)之后的求交速度
+		auto packed_tree = std::make_shared<shared_ptr<packed_bvh>>();
+		auto lazy_tree = std::make_shared<shared_ptr<lazy_bvh>>();
+		bench_case packed_trace{"accel/lazy_trace_packed", 2 * camera_rays, [=]() {
+			do_not_optimize(trace_all(**packed_tree, state->rays));
+		}};
+		packed_trace.counts_rays = true;
+		packed_trace.setup = [=]() {
+			prepare_lazy(*state);
+			*packed_tree = make_shared<packed_bvh>(state->spheres, 0.0, 1.0);
+		};
+		cases.push_back(packed_trace);
+
+		bench_case lazy_trace{"accel/lazy_trace_lazy", 2 * camera_rays, [=]() {
+			do_not_optimize(trace_all(**lazy_tree, state->rays));
+		}};
+		lazy_trace.counts_rays = true;
+		lazy_trace.setup = [=]() {
+			prepare_lazy(*state);
+			*lazy_tree = make_shared<lazy_bvh>(state->spheres, 0.0, 1.0);
+		};
+		cases.push_back(lazy_trace);
+	}
+
+	void add_million_cases(std::vector<bench_case> &cases) {
+		auto state = std::make_shared<million_state>();
+		auto setup = [=]() { prepare_million(*state); };
+
+		// 建树: 每轮一次
+		bench_case build_sah{"accel/million_build_packed", 1, [=]() {
+			packed_bvh tree(state->spheres, 0.0, 1.0);
+			do_not_optimize(tree);
+		}};
+		build_sah.setup = setup;
+		cases.push_back(build_sah);
+
+		bench_case build_lbvh{"accel/million_build_lbvh", 1, [=]() {
+			packed_bvh tree(state->spheres, 0.0, 1.0, packed_bvh::build_method::lbvh);
+			do_not_optimize(tree);
+		}};
+		build_lbvh.setup = setup;
+		cases.push_back(build_lbvh);
+
+		bench_case build_qbvh{"accel/million_build_qbvh", 1, [=]() {
+			packed_bvh tree(state->spheres, 0.0, 1.0, packed_bvh::build_method::sah, packed_bvh::node_format::quantized);
+			do_not_optimize(tree);
+		}};
+		build_qbvh.setup = setup;
+		cases.push_back(build_qbvh);
+
+		const std::pair<const char *, shared_ptr<hittable> million_state::*> accels[] = {
+				{"bvh", &million_state::bvh}, {"packed", &million_state::packed}, {"lbvh", &million_state::lbvh},
+				{"qbvh", &million_state::qbvh}};
+		for (const auto &[name, member] : accels) {
+			bench_case trace{std::string("accel/million_") + name, 2 * camera_rays, [=]() {
+				hit_record rec;
+				size_t hits = 0;
+				const auto &accel = *((*state).*member);
+				for (const auto &r : state->rays)
+					hits += accel.hit(r, 0.001, infinity, rec);
+				do_not_optimize(hits);
+			}};
+			trace.counts_rays = true;
+			trace.setup = setup;
+			cases.push_back(trace);
+		}
+	}
+}
+
+void register_accel_benches(std::vector<bench_case> &cases) {
+	add_accel_cases(cases, "final_scene");
+	add_accel_cases(cases, "random_spheres");
+	add_accel_cases(cases, "cornell_box");
+	add_million_cases(cases);
+	add_lazy_cases(cases);
+}
@@ -0,0 +1,121 @@
+#include "bench.h"
+
+#include "asset/material.h"
+#include "geometry/bvh.h"
+#include "geometry/scene_arena.h"
+#include "sample/sampler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+namespace {
+	const size_t ray_count = 4096;
+
+	// 同一个场景的两种布局: 每个对象一次 make_shared, 和 scene_arena::compact 之后的池
+	struct layouts {
+		shared_ptr<hittable> shared_tree;
+		// 持有整个 arena
+		shared_ptr<hittable> pooled_tree;
+		std::vector<ray> rays;
+		bool reported = false;
+	};
+
+	/*
+	 * 按 random_spheres 的方式构建: 每个图元紧跟着它自己的材质分配, 每 8 个图元中有一个是旋转、平移过的盒子。
+	 * 图元在堆上按创建顺序排列, 而 BVH 的叶节点按空间排序, 所以相邻的叶节点一般不在相邻的内存上。
+	 */
+	shared_ptr<hittable> build_scene(size_t n, double side) {
+		// BVH 的划分轴来自 random_double(), 每次从同一个状态开始, 两种布局的树才相同
+		random_generator() = pcg32();
+		pcg32 rng(bench_seed, 11);
+		std::vector<shared_ptr<hittable>> objects;
+		objects.reserve(n);
+		for (size_t k = 0; k < n; ++k) {
+			const point3 p(side * rng.next_double(), side * rng.next_double(), side * rng.next_double());
+			auto mat = make_shared<lambertian>(color(rng.next_double(), rng.next_double(), rng.next_double()));
+			if (k % 8 == 7) {
+				shared_ptr<hittable> b = make_shared<box>(point3(-0.4), point3(0.4), mat);
+				b = make_shared<rotate_y>(b, 360 * rng.next_double());
+				objects.push_back(make_shared<translate>(b, p));
+			} else {
+				objects.push_back(make_shared<sphere>(p, 0.5, mat));
+			}
+		}
+		return make_shared<bvh_node>(objects, 0, n, 0.0, 1.0);
+	}
+
+	std::vector<ray> make_rays(double side) {
+		pcg32 rng(bench_seed, 12);
+		const point3 center(0.5 * side);
+		std::vector<ray> rays(ray_count);
+		for (auto &r : rays) {
+			const double z = 1.0 - 2.0 * rng.next_double();
+			const double phi = 2.0 * PI * rng.next_double();
+			const double s = std::sqrt(std::max(0.0, 1.0 - z * z));
+			const point3 origin = center + 1.5 * side * vec3(s * std::cos(phi), s * std::sin(phi), z);
+			const point3 target(side * rng.next_double(), side * rng.next_double(), side * rng.next_double());
+			r = ray(origin, target - origin);
+		}
+		return rays;
+	}
+
+	// 两个用例共用一次构建; 构建时比较两种布局的内存占用(glibc 的堆统计)
+	void prepare(layouts &l, size_t n, const std::string &label) {
+		if (l.reported)
+			return;
+		const double side = 2.0 * std::cbrt(static_cast<double>(n));
+		l.rays = make_rays(side);
+
+		l.shared_tree = build_scene(n, side);
+		const size_t before_compact = heap_bytes_in_use();
+		shared_ptr<scene_arena> arena;
+		hittable_list world;
+		world.add(l.shared_tree);
+		l.pooled_tree = scene_arena::compact(world, &arena).objects.front();
+		const size_t after_compact = heap_bytes_in_use();
+
+		// 先释放 make_shared 的对象(材质由池中的副本继续持有)测出它们的大小, 再重新构建一份用于比较速度
+		world.clear();
+		l.shared_tree.reset();
+		const size_t without_shared = heap_bytes_in_use();
+		l.shared_tree = build_scene(n, side);
+
+		std::fprintf(stderr, "arena/%s: shared_ptr layout %.2f MB, arena %.2f MB (%.2f MB in pools)\n", label.c_str(),
+					 (after_compact - without_shared) / 1048576.0, (after_compact - before_compact) / 1048576.0,
+					 arena->bytes() / 1048576.0);
+		l.reported = true;
+	}
+
+	void add_arena_cases(std::vector<bench_case> &cases, size_t n, const std::string &label) {
+		auto state = std::make_shared<layouts>();
+
+		bench_case shared_case{"arena/trace_shared_" + label, ray_count, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : state->rays)
+				hits += state->shared_tree->hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		shared_case.counts_rays = true;
+		shared_case.setup = [=]() { prepare(*state, n, label); };
+		cases.push_back(shared_case);
+
+		bench_case pooled_case{"arena/trace_pooled_" + label, ray_count, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : state->rays)
+				hits += state->pooled_tree->hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		pooled_case.counts_rays = true;
+		pooled_case.setup = [=]() { prepare(*state, n, label); };
+		cases.push_back(pooled_case);
+	}
+}
+
+void register_arena_benches(std::vector<bench_case> &cases) {
+	add_arena_cases(cases, 10000, "1e4");
+	add_arena_cases(cases, 100000, "1e5");
+	add_arena_cases(cases, 1000000, "1e6");
+}
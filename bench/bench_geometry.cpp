@@ -0,0 +1,131 @@
+#include "bench.h"
+
+#include "geometry/bvh.h"
+#include "geometry/hittable_list.h"
+#include "sample/sampler.h"
+#include "shape/aarect.h"
+#include "shape/box.h"
+#include "shape/sphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace {
+	const size_t ray_count = 4096;
+
+	point3 random_point(pcg32 &rng, const point3 &lo, const point3 &hi) {
+		return point3(lo.x() + (hi.x() - lo.x()) * rng.next_double(),
+					  lo.y() + (hi.y() - lo.y()) * rng.next_double(),
+					  lo.z() + (hi.z() - lo.z()) * rng.next_double());
+	}
+
+	// 从包围盒外的球面射向盒内的随机点, 目标盒略大于物体, 大约一半的光线能命中单个图元
+	std::vector<ray> make_rays(const point3 &lo, const point3 &hi, uint64_t stream) {
+		pcg32 rng(bench_seed, stream);
+		const point3 center = 0.5 * (lo + hi);
+		const vec3 half = 0.5 * (hi - lo);
+		const double radius = 2.0 * half.length() + 1.0;
+
+		std::vector<ray> rays(ray_count);
+		for (auto &r : rays) {
+			// 球面上均匀分布的起点
+			const double z = 1.0 - 2.0 * rng.next_double();
+			const double phi = 2.0 * PI * rng.next_double();
+			const double s = std::sqrt(std::max(0.0, 1.0 - z * z));
+			const point3 origin = center + radius * vec3(s * std::cos(phi), s * std::sin(phi), z);
+			const point3 target = random_point(rng, center - 1.5 * half, center + 1.5 * half);
+			r = ray(origin, target - origin);
+		}
+		return rays;
+	}
+
+	bench_case hit_case(const std::string &name, shared_ptr<hittable> object, const point3 &lo, const point3 &hi,
+						uint64_t stream) {
+		auto rays = std::make_shared<std::vector<ray>>(make_rays(lo, hi, stream));
+		bench_case c{name, ray_count, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : *rays)
+				hits += object->hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		c.counts_rays = true;
+		return c;
+	}
+
+	// n 个半径 0.5 的球随机分布在边长 2*cbrt(n) 的立方体中, 密度与规模无关
+	std::vector<shared_ptr<hittable>> make_spheres(size_t n) {
+		pcg32 rng(bench_seed, 7);
+		const double side = 2.0 * std::cbrt(static_cast<double>(n));
+		std::vector<shared_ptr<hittable>> spheres;
+		spheres.reserve(n);
+		for (size_t k = 0; k < n; ++k)
+			spheres.push_back(make_shared<sphere>(random_point(rng, point3(0), point3(side)), 0.5, nullptr));
+		return spheres;
+	}
+
+	void add_bvh_cases(std::vector<bench_case> &cases, size_t n, const std::string &label) {
+		auto tree = std::make_shared<shared_ptr<bvh_node>>();
+		auto rays = std::make_shared<std::vector<ray>>();
+
+		bench_case trace{"bvh/trace_" + label, ray_count, [=]() {
+			hit_record rec;
+			size_t hits = 0;
+			for (const auto &r : *rays)
+				hits += (*tree)->hit(r, 0.001, infinity, rec);
+			do_not_optimize(hits);
+		}};
+		trace.counts_rays = true;
+		trace.setup = [=]() {
+			if (*tree)
+				return;
+			const double side = 2.0 * std::cbrt(static_cast<double>(n));
+			*tree = make_shared<bvh_node>(make_spheres(n), 0, n, 0.0, 1.0);
+			*rays = make_rays(point3(0), point3(side), 8);
+		};
+		cases.push_back(trace);
+	}
+
+	void add_bvh_build_case(std::vector<bench_case> &cases, size_t n, const std::string &label) {
+		auto spheres = std::make_shared<std::vector<shared_ptr<hittable>>>();
+		// ns/op 为每个图元的建树时间
+		bench_case build{"bvh/build_" + label, n, [=]() {
+			bvh_node tree(*spheres, 0, spheres->size(), 0.0, 1.0);
+			do_not_optimize(tree.box);
+		}};
+		build.setup = [=]() {
+			if (spheres->empty())
+				*spheres = make_spheres(n);
+		};
+		cases.push_back(build);
+	}
+}
+
+void register_geometry_benches(std::vector<bench_case> &cases) {
+	const point3 lo(-1, -1, -1), hi(1, 1, 1);
+
+	cases.push_back(hit_case("sphere/hit", make_shared<sphere>(point3(0), 1.0, nullptr), lo, hi, 1));
+	cases.push_back(hit_case("rect/xy_hit", make_shared<xy_rect>(-1, 1, -1, 1, 0, nullptr), lo, hi, 2));
+	cases.push_back(hit_case("rect/xz_hit", make_shared<xz_rect>(-1, 1, -1, 1, 0, nullptr), lo, hi, 3));
+	cases.push_back(hit_case("rect/yz_hit", make_shared<yz_rect>(-1, 1, -1, 1, 0, nullptr), lo, hi, 4));
+	cases.push_back(hit_case("box/hit", make_shared<box>(lo, hi, nullptr), lo, hi, 5));
+
+	auto bounds = std::make_shared<aabb>(lo, hi);
+	auto aabb_rays = std::make_shared<std::vector<ray>>(make_rays(lo, hi, 6));
+	bench_case aabb_hit{"aabb/hit", ray_count, [=]() {
+		size_t hits = 0;
+		for (const auto &r : *aabb_rays)
+			hits += bounds->hit(r, 0.001, infinity);
+		do_not_optimize(hits);
+	}};
+	aabb_hit.counts_rays = true;
+	cases.push_back(aabb_hit);
+
+	add_bvh_cases(cases, 1000, "1e3");
+	add_bvh_cases(cases, 10000, "1e4");
+	add_bvh_cases(cases, 100000, "1e5");
+	add_bvh_cases(cases, 1000000, "1e6");
+	add_bvh_build_case(cases, 10000, "1e4");
+	add_bvh_build_case(cases, 100000, "1e5");
+}
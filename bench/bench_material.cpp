@@ -0,0 +1,100 @@
+#include "bench.h"
+
+#include "asset/material.h"
+#include "geometry/pdf.h"
+#include "sample/sampler.h"
+#include "shape/aarect.h"
+#include "shape/sphere.h"
+
+#include <memory>
+
+namespace {
+	const size_t sample_count = 4096;
+
+	vec3 random_unit(pcg32 &rng) {
+		return random_cosine_direction(rng.next_double(), rng.next_double());
+	}
+
+	// 撞点在原点, 法线朝 +y, 入射方向来自上半球
+	struct shading_input {
+		std::vector<ray> incoming;
+		std::vector<vec3> directions;
+		hit_record rec;
+	};
+
+	std::shared_ptr<shading_input> make_input() {
+		auto in = std::make_shared<shading_input>();
+		pcg32 rng(bench_seed, 11);
+		in->incoming.resize(sample_count);
+		in->directions.resize(sample_count);
+		for (size_t k = 0; k < sample_count; ++k) {
+			const vec3 d = random_unit(rng);
+			// 局部 z 轴映射到 +y
+			in->incoming[k] = ray(point3(d.x(), d.z(), d.y()), -vec3(d.x(), d.z(), d.y()));
+			const vec3 o = random_unit(rng);
+			in->directions[k] = vec3(o.x(), o.z(), o.y());
+		}
+		in->rec.p = point3(0);
+		in->rec.normal = vec3(0, 1, 0);
+		in->rec.front_face = true;
+		in->rec.u = 0.25;
+		in->rec.v = 0.75;
+		in->rec.t = 1.0;
+		return in;
+	}
+
+	bench_case scatter_case(const std::string &name, shared_ptr<material> mat, std::shared_ptr<shading_input> in) {
+		return bench_case{name, sample_count, [=]() {
+			scatter_record srec;
+			size_t scattered = 0;
+			for (const auto &r : in->incoming)
+				scattered += mat->scatter(r, in->rec, srec);
+			do_not_optimize(scattered);
+			do_not_optimize(srec);
+		}};
+	}
+
+	bench_case generate_case(const std::string &name, shared_ptr<pdf> p) {
+		auto smp = std::make_shared<independent_sampler>(static_cast<uint32_t>(bench_seed));
+		return bench_case{name, sample_count, [=]() {
+			vec3 sum(0);
+			for (size_t k = 0; k < sample_count; ++k)
+				sum += p->generate(*smp);
+			do_not_optimize(sum);
+		}};
+	}
+
+	bench_case value_case(const std::string &name, shared_ptr<pdf> p, std::shared_ptr<shading_input> in) {
+		return bench_case{name, sample_count, [=]() {
+			double sum = 0;
+			for (const auto &d : in->directions)
+				sum += p->value(d);
+			do_not_optimize(sum);
+		}};
+	}
+}
+
+void register_material_benches(std::vector<bench_case> &cases) {
+	auto in = make_input();
+
+	cases.push_back(scatter_case("material/lambertian_scatter", make_shared<lambertian>(color(0.5)), in));
+	cases.push_back(scatter_case("material/metal_scatter", make_shared<metal>(color(0.8), 0.3), in));
+	cases.push_back(scatter_case("material/dielectric_scatter", make_shared<dielectric>(1.5), in));
+
+	// 光源位置与 Cornell box 相当: 撞点上方的矩形和球
+	auto rect_light = make_shared<xz_rect>(-0.5, 0.5, -0.5, 0.5, 2.0, nullptr);
+	auto sphere_light = make_shared<sphere>(point3(0, 2, 0), 0.5, nullptr);
+	auto cosine = make_shared<cosine_pdf>(in->rec.normal);
+	auto to_rect = make_shared<hittable_pdf>(rect_light, in->rec.p);
+	auto to_sphere = make_shared<hittable_pdf>(sphere_light, in->rec.p);
+	auto mixture = make_shared<mixture_pdf>(to_rect, cosine);
+
+	cases.push_back(generate_case("pdf/cosine_generate", cosine));
+	cases.push_back(value_case("pdf/cosine_value", cosine, in));
+	cases.push_back(generate_case("pdf/rect_generate", to_rect));
+	cases.push_back(value_case("pdf/rect_value", to_rect, in));
+	cases.push_back(generate_case("pdf/sphere_generate", to_sphere));
+	cases.push_back(value_case("pdf/sphere_value", to_sphere, in));
+	cases.push_back(generate_case("pdf/mixture_generate", mixture));
+	cases.push_back(value_case("pdf/mixture_value", mixture, in));
+}
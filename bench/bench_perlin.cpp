@@ -0,0 +1,49 @@
+#include "bench.h"
+
+#include "sample/perlin.h"
+#include "sample/sampler.h"
+
+#include <memory>
+
+namespace {
+	const size_t point_count = 4096;
+
+	// 固定种子, 坐标范围与 noise_texture 的常见用法相当
+	std::vector<point3> make_points() {
+		pcg32 rng(bench_seed);
+		std::vector<point3> points(point_count);
+		for (auto &p : points)
+			p = point3(rng.next_double() * 64, rng.next_double() * 64, rng.next_double() * 64);
+		return points;
+	}
+}
+
+void register_perlin_benches(std::vector<bench_case> &cases) {
+	auto noise = std::make_shared<perlin>();
+	auto points = std::make_shared<std::vector<point3>>(make_points());
+	auto out = std::make_shared<std::vector<double>>(point_count);
+
+	cases.push_back({"perlin/noise", point_count, [=]() {
+		double sum = 0;
+		for (const auto &p : *points)
+			sum += noise->noise(p);
+		do_not_optimize(sum);
+	}});
+
+	cases.push_back({"perlin/turb7", point_count, [=]() {
+		double sum = 0;
+		for (const auto &p : *points)
+			sum += noise->turb(p);
+		do_not_optimize(sum);
+	}});
+
+	cases.push_back({"perlin/noise_batch", point_count, [=]() {
+		noise->noise(points->data(), out->data(), point_count);
+		do_not_optimize(out->front());
+	}});
+
+	cases.push_back({"perlin/turb7_batch", point_count, [=]() {
+		noise->turb(points->data(), out->data(), point_count);
+		do_not_optimize(out->front());
+	}});
+}
@@ -0,0 +1,95 @@
+#include "bench.h"
+
+#include "asset/material_table.h"
+#include "render/scene.h"
+
+#include <cstdio>
+#include <memory>
+
+namespace {
+	const size_t camera_rays = 4096;
+
+	// 场景中相机光线和一次漫反射的撞点, 按光线的顺序(材质交错)排列
+	struct shading_state {
+		scene s;
+		material_table table;
+		std::vector<material_table::shading_hit> hits;
+		std::vector<material_table::shading_result> results;
+		bool ready = false;
+	};
+
+	void prepare(shading_state &state, const std::string &name) {
+		if (state.ready)
+			return;
+		make_scene(name, state.s);
+		state.table.compile(state.s.world);
+
+		random_generator() = pcg32(bench_seed, 15);
+		pcg32 rng(bench_seed, 16);
+		for (size_t k = 0; state.hits.size() < 2 * camera_rays && k < 16 * camera_rays; ++k) {
+			ray r = state.s.cam.get_ray(rng.next_double(), rng.next_double());
+			for (int bounce = 0; bounce < 2 && state.hits.size() < 2 * camera_rays; ++bounce) {
+				hit_record rec;
+				if (!state.s.world.hit(r, 0.001, infinity, rec))
+					break;
+				state.hits.push_back({r, rec});
+				r = ray(rec.p, rec.normal + random_unit_vector(), r.time());
+			}
+		}
+		state.results.resize(state.hits.size());
+
+		std::fprintf(stderr, "shading/%s: %zu hits, %zu materials in the table\n", name.c_str(), state.hits.size(),
+					 state.table.size());
+		state.ready = true;
+	}
+
+	void add_shading_cases(std::vector<bench_case> &cases, const std::string &name) {
+		auto state = std::make_shared<shading_state>();
+
+		// 虚函数: emitted + scatter, 漫反射每次分配一个 cosine_pdf
+		bench_case virtual_case{"shading/" + name + "_virtual", 2 * camera_rays, [=]() {
+			size_t scattered = 0;
+			color sum(0);
+			for (const auto &hit : state->hits) {
+				scatter_record srec;
+				sum += hit.rec.mat_ptr->emitted(hit.r_in, hit.rec, hit.rec.u, hit.rec.v, hit.rec.p);
+				scattered += hit.rec.mat_ptr->scatter(hit.r_in, hit.rec, srec);
+				sum += srec.attenuation;
+			}
+			do_not_optimize(scattered);
+			do_not_optimize(sum);
+		}};
+		virtual_case.setup = [=]() { prepare(*state, name); };
+		cases.push_back(virtual_case);
+
+		// material_table 逐个撞点分派
+		bench_case static_case{"shading/" + name + "_static", 2 * camera_rays, [=]() {
+			size_t scattered = 0;
+			color sum(0);
+			for (const auto &hit : state->hits) {
+				scatter_record srec;
+				sum += state->table.emitted(hit.rec.mat_ptr, hit.r_in, hit.rec);
+				scattered += state->table.scatter(hit.rec.mat_ptr, hit.r_in, hit.rec, srec);
+				sum += srec.attenuation;
+			}
+			do_not_optimize(scattered);
+			do_not_optimize(sum);
+		}};
+		static_case.setup = [=]() { prepare(*state, name); };
+		cases.push_back(static_case);
+
+		// 按材质排序后批量着色, 包括排序的时间
+		bench_case batched_case{"shading/" + name + "_batched", 2 * camera_rays, [=]() {
+			state->table.shade(state->hits, state->results);
+			do_not_optimize(state->results);
+		}};
+		batched_case.setup = [=]() { prepare(*state, name); };
+		cases.push_back(batched_case);
+	}
+}
+
+void register_shading_benches(std::vector<bench_case> &cases) {
+	add_shading_cases(cases, "random_spheres");
+	add_shading_cases(cases, "final_scene");
+	add_shading_cases(cases, "cornell_box");
+}
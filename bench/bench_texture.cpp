@@ -0,0 +1,52 @@
+#include "bench.h"
+
+#include "asset/image_texture.h"
+#include "asset/texture.h"
+#include "sample/sampler.h"
+
+#include <cmath>
+#include <memory>
+
+#ifndef RT_ASSET_DIR
+#define RT_ASSET_DIR "assets"
+#endif
+
+namespace {
+	const size_t lookup_count = 4096;
+
+	struct lookup {
+		double u, v, uv_width;
+	};
+
+	// 纹理坐标随机分布, uv_width 覆盖从 1 个 texel 到整张图的范围
+	std::vector<lookup> make_lookups() {
+		pcg32 rng(bench_seed, 21);
+		std::vector<lookup> lookups(lookup_count);
+		for (auto &l : lookups) {
+			l.u = rng.next_double();
+			l.v = rng.next_double();
+			l.uv_width = std::pow(2.0, -10.0 * rng.next_double());
+		}
+		return lookups;
+	}
+
+	bench_case texture_case(const std::string &name, shared_ptr<texture> tex, bool filtered) {
+		auto lookups = std::make_shared<std::vector<lookup>>(make_lookups());
+		return bench_case{name, lookup_count, [=]() {
+			color sum(0);
+			const point3 p(0);
+			for (const auto &l : *lookups)
+				sum += filtered ? tex->value(l.u, l.v, p, l.uv_width) : tex->value(l.u, l.v, p);
+			do_not_optimize(sum);
+		}};
+	}
+}
+
+void register_texture_benches(std::vector<bench_case> &cases) {
+	auto earth = make_shared<image_texture>(RT_ASSET_DIR "/earthmap.jpg");
+	auto checker = make_shared<checker_texture>(color(0.2, 0.3, 0.1), color(0.9));
+
+	cases.push_back(texture_case("image_texture/bilinear", earth, false));
+	cases.push_back(texture_case("image_texture/trilinear", earth, true));
+	cases.push_back(texture_case("texture/checker", checker, false));
+}
@@ -0,0 +1,117 @@
+#include "bench.h"
+
+#include "utility/perf_counter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+bench_result run_bench(const bench_case &c, int repetitions, double warmup_seconds) {
+	using clock = std::chrono::steady_clock;
+
+	const auto warmup_end = clock::now() + std::chrono::duration<double>(warmup_seconds);
+	do {
+		c.run();
+	} while (clock::now() < warmup_end);
+
+	// 缓存缺失按所有轮次的总数计算, 计数器只统计本线程
+	static perf_counter misses(perf_counter::event::cache_misses);
+	uint64_t miss_count = 0;
+
+	std::vector<double> samples;
+	for (int r = 0; r < repetitions; ++r) {
+		if (c.counts_rays)
+			misses.start();
+		const auto start = clock::now();
+		c.run();
+		const auto stop = clock::now();
+		if (c.counts_rays)
+			miss_count += misses.stop();
+		samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / c.ops_per_run);
+	}
+	std::sort(samples.begin(), samples.end());
+
+	bench_result result;
+	result.name = c.name;
+	result.ns_per_op = samples[samples.size() / 2];
+	result.ops_per_second = 1e9 / result.ns_per_op;
+	result.mrays_per_second = c.counts_rays ? result.ops_per_second * 1e-6 : 0.0;
+	if (c.counts_rays && misses.available())
+		result.cache_misses_per_op = static_cast<double>(miss_count) / (static_cast<double>(c.ops_per_run) * repetitions);
+	return result;
+}
+
+namespace {
+	void print_json(const std::vector<bench_result> &results, int repetitions, double warmup) {
+		std::printf("{\n  \"seed\": %llu,\n  \"repetitions\": %d,\n  \"warmup_seconds\": %g,\n  \"results\": [",
+					static_cast<unsigned long long>(bench_seed), repetitions, warmup);
+		for (size_t k = 0; k < results.size(); ++k) {
+			const auto &r = results[k];
+			// 用例名只包含字母、数字、'/' 和 '_', 不需要转义
+			std::printf("%s\n    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_second\": %.1f",
+						k ? "," : "", r.name.c_str(), r.ns_per_op, r.ops_per_second);
+			if (r.mrays_per_second > 0)
+				std::printf(", \"mrays_per_second\": %.3f", r.mrays_per_second);
+			if (r.cache_misses_per_op >= 0)
+				std::printf(", \"cache_misses_per_op\": %.3f", r.cache_misses_per_op);
+			std::printf("}");
+		}
+		std::printf("\n  ]\n}\n");
+	}
+}
+
+int main(int argc, char **argv) {
+	const char *filter = nullptr;
+	int repetitions = 7;
+	double warmup = 0.2;
+	bool json = false;
+
+	for (int k = 1; k < argc; ++k) {
+		if (!std::strcmp(argv[k], "--filter") && k + 1 < argc) {
+			filter = argv[++k];
+		} else if (!std::strcmp(argv[k], "--reps") && k + 1 < argc) {
+			repetitions = std::max(1, std::atoi(argv[++k]));
+		} else if (!std::strcmp(argv[k], "--warmup") && k + 1 < argc) {
+			warmup = std::atof(argv[++k]);
+		} else if (!std::strcmp(argv[k], "--json")) {
+			json = true;
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--filter <substring>] [--reps <n>] [--warmup <seconds>] [--json]\n";
+			return 1;
+		}
+	}
+
+	std::vector<bench_case> cases;
+	register_geometry_benches(cases);
+	register_material_benches(cases);
+	register_perlin_benches(cases);
+	register_texture_benches(cases);
+	register_arena_benches(cases);
+	register_accel_benches(cases);
+	register_shading_benches(cases);
+
+	std::vector<bench_result> results;
+	for (const auto &c : cases) {
+		if (filter && c.name.find(filter) == std::string::npos)
+			continue;
+		if (c.setup)
+			c.setup();
+		auto r = run_bench(c, repetitions, warmup);
+		results.push_back(r);
+		if (json)
+			continue;
+		std::printf("%-32s %12.2f ns/op %14.0f ops/s", r.name.c_str(), r.ns_per_op, r.ops_per_second);
+		if (r.mrays_per_second > 0)
+			std::printf(" %10.2f Mrays/s", r.mrays_per_second);
+		if (r.cache_misses_per_op >= 0)
+			std::printf(" %8.2f misses/ray", r.cache_misses_per_op);
+		std::printf("\n");
+		std::fflush(stdout);
+	}
+
+	if (json)
+		print_json(results, repetitions, warmup);
+	return 0;
+}
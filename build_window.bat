@@ -1,6 +1,6 @@
-@echo off
-mkdir build
-cd build
-set /P OPT=<cmake_option.txt
-cmake -S %~dp0 %OPT% -B ./
+@echo off
+mkdir build
+cd build
+set /P OPT=<cmake_option.txt
+cmake -S %~dp0 %OPT% -B ./
 pause
\ No newline at end of file
@@ -1,65 +1,127 @@
-#pragma once
-
-#include "rtweekend.h"
-
-class camera {
-public:
-
-    camera() = default;
-
-	// vfov : vertical field-of-view in degrees
-
-    // focus_dist : 焦距
-    // aperture : 光圈直径
-    camera(point3 lookfrom, point3 lookat, vec3 vup,
-           double vfov, double aspect_ratio, double aperture,
-           double focus_dist, double _time0 = 0, double _time1 = 0)
-    {
-        reset(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, focus_dist, _time0, _time1);
-    }
-
-    void reset(point3 lookfrom, point3 lookat, vec3 vup,
-        double vfov, double aspect_ratio, double aperture,
-        double focus_dist, double _time0 = 0, double _time1 = 0)
-    {
-		double theta = degrees_to_radians(vfov);
-		double h = tan(theta / 2);
-		double viewport_height = 2.0 * h;
-		double viewport_width = aspect_ratio * viewport_height;
-		double focal_length = 1.0;
-
-		w = unit_vector(lookfrom - lookat);
-		u = unit_vector(cross(vup, w));
-		v = cross(w, u);
-
-		origin = lookfrom;
-		horizontal = focus_dist * viewport_width * u;   // new version
-		vertical = focus_dist * viewport_height * v;    // new version
-		// lower_left_corner = origin - horizontal/2 - vertical/2 - w;
-		// origin = lookfrom,   origin - w ==>> lookfrom - unit_vector(lookfrom - lookat)
-		lower_left_corner = origin - horizontal / 2 - vertical / 2 - focus_dist * w;    // new version
-		lens_radius = aperture / 2;
-
-		time0 = _time0;
-		time1 = _time1;
-    }
-
-    ray get_ray(double s, double t) const {
-        vec3 rd = lens_radius * random_in_unit_disk();
-        vec3 offset = u * rd.x() + v * rd.y();
-
-        return ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset, 
-            random_double(time0, time1));
-    }
-
-private:
-    point3 origin;
-    point3 lower_left_corner;
-    vec3 horizontal;
-    vec3 vertical;
-
-    vec3 u, v, w;
-    double lens_radius;
-    double time0, time1;    // shutter open/close times
-};
-
+#pragma once
+
+#include "rtweekend.h"
+#include "sample/sampler.h"
+
+class camera {
+public:
+
+    camera() = default;
+
+	// vfov : vertical field-of-view in degrees
+
+    // focus_dist : 焦距
+    // aperture : 光圈直径
+    camera(point3 lookfrom, point3 lookat, vec3 vup,
+           double vfov, double aspect_ratio, double aperture,
+           double focus_dist, double _time0 = 0, double _time1 = 0)
+    {
+        reset(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, focus_dist, _time0, _time1);
+    }
+
+    void reset(point3 lookfrom, point3 lookat, vec3 vup,
+        double vfov, double aspect_ratio, double aperture,
+        double focus_dist, double _time0 = 0, double _time1 = 0)
+    {
+		double theta = degrees_to_radians(vfov);
+		double h = tan(theta / 2);
+		double viewport_height = 2.0 * h;
+		double viewport_width = aspect_ratio * viewport_height;
+		double focal_length = 1.0;
+
+		w = unit_vector(lookfrom - lookat);
+		u = unit_vector(cross(vup, w));
+		v = cross(w, u);
+
+		origin = lookfrom;
+		horizontal = focus_dist * viewport_width * u;   // new version
+		vertical = focus_dist * viewport_height * v;    // new version
+		// lower_left_corner = origin - horizontal/2 - vertical/2 - w;
+		// origin = lookfrom,   origin - w ==>> lookfrom - unit_vector(lookfrom - lookat)
+		lower_left_corner = origin - horizontal / 2 - vertical / 2 - focus_dist * w;    // new version
+		lens_radius = aperture / 2;
+		focal_distance = focus_dist;
+
+		time0 = _time0;
+		time1 = _time1;
+    }
+
+    ray get_ray(double s, double t) const {
+        vec3 rd = lens_radius * random_in_unit_disk();
+        vec3 offset = u * rd.x() + v * rd.y();
+
+        return ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset, 
+            random_double(time0, time1));
+    }
+
+    // 镜头和快门时间的样本由采样器提供
+    ray get_ray(double s, double t, sampler &smp) const {
+        auto [r1, r2] = smp.get_2d();
+        vec3 rd = lens_radius * random_in_unit_disk(r1, r2);
+        vec3 offset = u * rd.x() + v * rd.y();
+
+        return ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset,
+            time0 + (time1 - time0) * smp.get_1d());
+    }
+
+    // 同时给出相邻像素的光线(ds, dt 为一个像素在 s, t 上的跨度), 与主光线使用同一个镜头和时间样本
+    ray get_ray(double s, double t, double ds, double dt, sampler &smp, ray_differential &diff) const {
+        auto [r1, r2] = smp.get_2d();
+        vec3 rd = lens_radius * random_in_unit_disk(r1, r2);
+        vec3 offset = u * rd.x() + v * rd.y();
+        point3 lens_point = origin + offset;
+        point3 target = lower_left_corner + s * horizontal + t * vertical;
+
+        diff.rx_origin = diff.ry_origin = lens_point;
+        diff.rx_direction = target + ds * horizontal - lens_point;
+        diff.ry_direction = target + dt * vertical - lens_point;
+
+        return ray(lens_point, target - lens_point, time0 + (time1 - time0) * smp.get_1d());
+    }
+
+    // 以下供双向路径追踪把光路连接到相机上
+
+    // 用 (r1, r2) 在镜头上均匀地取一点, 针孔相机总是 origin
+    point3 lens_point(double r1, double r2) const {
+        vec3 rd = lens_radius * random_in_unit_disk(r1, r2);
+        return origin + u * rd.x() + v * rd.y();
+    }
+
+    // 镜头的面积, 针孔相机为 0
+    double lens_area() const { return PI * lens_radius * lens_radius; }
+
+    // 从镜头上的点 lens 看 q: q 的方向与焦平面的交点的 (s, t), 与 get_ray 的参数一致; q 在相机背后时返回 false
+    bool project(const point3 &lens, const point3 &q, double &s, double &t) const {
+        vec3 dir = q - lens;
+        double c = dot(dir, -w);
+        if (c <= 0)
+            return false;
+        vec3 offset = lens + dir * (focal_distance / c) - lower_left_corner;
+        s = dot(offset, horizontal) / horizontal.length_squared();
+        t = dot(offset, vertical) / vertical.length_squared();
+        return true;
+    }
+
+    // 方向 dir 与视线的夹角的余弦
+    double cos_theta(const vec3 &dir) const { return dot(unit_vector(dir), -w); }
+
+    double focus_distance() const { return focal_distance; }
+
+    // 焦平面上 (s, t) 为 [0, 1] x [0, 1] 的区域的面积
+    double viewport_area() const { return horizontal.length() * vertical.length(); }
+
+    double shutter_open() const { return time0; }
+    double shutter_close() const { return time1; }
+
+private:
+    point3 origin;
+    point3 lower_left_corner;
+    vec3 horizontal;
+    vec3 vertical;
+
+    vec3 u, v, w;
+    double lens_radius;
+    double focal_distance;
+    double time0, time1;    // shutter open/close times
+};
+
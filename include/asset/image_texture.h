@@ -1,56 +1,63 @@
-#pragma once
-
-#include "texture.h"
-#include "utility/rtw_stb_image.h"
-
-class image_texture : public texture {
-public:
-    // 每像素三位
-    const static int bytes_per_pixel = 3;
-
-    image_texture() : data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
-
-    image_texture(const char *filename) {
-        auto components_per_pixel = bytes_per_pixel;
-
-        data = stbi_load(filename, &width, &height, &components_per_pixel, components_per_pixel);
-
-        if (!data) {
-            std::cerr << "ERROR: Could not load texture image file '" << filename << "'.\n";
-            width = height = 0;
-        }
-
-        bytes_per_scanline = bytes_per_pixel * width;
-    }
-
-    ~image_texture() {
-        delete data;
-    }
-
-    virtual color value(double u, double v, const vec3 &p) const override {
-        // If we have no texture data, then return solid cyan as a debugging aid.
-        if (data == nullptr)
-            return color(0, 1, 1);
-
-        // Clamp input texture coordinates to [0,1] x [1,0]
-        u = clamp(u, 0.0, 1.0);
-        v = 1.0 - clamp(v, 0.0, 1.0);  // Flip V to image coordinates
-
-        auto i = static_cast<int>(u * width);
-        auto j = static_cast<int>(v * height);
-
-        // Clamp integer mapping, since actual coordinates should be less than 1.0
-        if (i >= width) i = width - 1;
-        if (j >= height) j = height - 1;
-
-        const auto color_scale = 1.0 / 255.0;
-        auto pixel = data + j * bytes_per_scanline + i * bytes_per_pixel;
-
-        return color(color_scale * pixel[0], color_scale * pixel[1], color_scale * pixel[2]);
-    }
-
-private:
-    unsigned char *data;
-    int width, height;
-    int bytes_per_scanline;
-};
\ No newline at end of file
+#pragma once
+
+#include "texture.h"
+#include "texture_cache.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * JPEG/PNG 等由 stb_image 解码的图像, 第一次读取块时才解码并生成MIP金字塔。
+ * 金字塔在对象的生命期内常驻, 其大小计入 texture_cache 的上限; 大图应先用 rtx_convert 转成 .rtx。
+ */
+class stb_tile_source : public tile_source {
+public:
+	explicit stb_tile_source(const char *filename);
+
+	~stb_tile_source() override;
+
+	void read_tile(int level, int tx, int ty, texture_tile &tile) const override;
+
+private:
+	void load() const;
+
+	// 每像素三位
+	const static int bytes_per_pixel = 3;
+
+	std::string filename;
+	mutable std::once_flag loaded;
+	// 每一层的 8 位 RGB 数据
+	mutable std::vector<std::vector<unsigned char>> pyramid;
+	// 在 texture_cache 中登记的字节数
+	mutable size_t reserved_bytes = 0;
+};
+
+// 按扩展名选择: .rtx 直接内存映射, 其它格式交给 stb_image
+shared_ptr<tile_source> open_tile_source(const char *filename);
+
+/*
+ * 图像纹理: 数据以块的形式存放在全局 texture_cache 中, 按需加载、可被淘汰。
+ * uv_width 为撞点处纹理坐标的变化范围(由光线微分求得), 据此选择MIP层做三线性过滤。
+ */
+class image_texture : public texture {
+public:
+	image_texture() = default;
+
+	image_texture(const char *filename);
+
+	explicit image_texture(shared_ptr<tile_source> src);
+
+	virtual color value(double u, double v, const vec3 &p) const override;
+
+	virtual color value(double u, double v, const point3 &p, double uv_width) const override;
+
+private:
+	color texel(int level, int x, int y) const;
+
+	color bilinear(int level, double u, double v) const;
+
+private:
+	shared_ptr<tile_source> source;
+	uint32_t source_id = 0;
+};
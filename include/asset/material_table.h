@@ -0,0 +1,118 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "asset/image_texture.h"
+#include "asset/material.h"
+#include "asset/noise_texture.h"
+#include "asset/texture.h"
+#include "geometry/hittable_list.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+/*
+ * 材质和纹理的静态分派。场景仍然用 material / texture 的子类搭建, compile 遍历场景,
+ * 把每个材质编成一个封闭的 std::variant: 纯色纹理直接折叠成材质里的颜色, 其它纹理也编成 variant,
+ * 按具体类型直接调用, 不经过虚函数。类型不完全相同的子类(isotropic 等)保留虚函数调用。
+ *
+ * 着色结果与 material 的虚函数逐位相同(包括随机数的使用顺序), 只是漫反射的 pdf 放在 scatter_record 里,
+ * 不再每次命中分配一次。
+ */
+class material_table {
+public:
+	// 纹理: 纯色、棋盘(两个子纹理在表中的编号)、按具体类型调用的噪声和图像纹理, 以及其它纹理
+	struct solid_texture_data {
+		color value;
+	};
+	struct checker_texture_data {
+		uint32_t even, odd;
+	};
+	using texture_data = std::variant<solid_texture_data, checker_texture_data, const noise_texture *,
+									  const image_texture *, const texture *>;
+
+	struct lambertian_data {
+		color albedo;
+	};
+	struct textured_lambertian_data {
+		uint32_t albedo;
+	};
+	struct metal_data {
+		color albedo;
+		double fuzz;
+	};
+	struct dielectric_data {
+		double ir;
+	};
+	struct light_data {
+		color emit;
+	};
+	struct textured_light_data {
+		uint32_t emit;
+	};
+	using material_data = std::variant<lambertian_data, textured_lambertian_data, metal_data, dielectric_data,
+									   light_data, textured_light_data, const material *>;
+
+	// 遍历场景中的几何体, 给遇到的每个材质编号; 可以多次调用, 已经编过号的材质不会重复加入
+	void compile(const hittable_list &world);
+
+	// 返回材质的编号并写入 m->shading_id
+	uint32_t add(material *m);
+
+	size_t size() const { return entries.size(); }
+
+	const material_data &data(uint32_t id) const { return entries[id].data; }
+
+	// 逐个撞点着色, 与 material 的同名虚函数对应; 不在表中的材质调用虚函数
+	color emitted(const material *m, const ray &r_in, const hit_record &rec) const;
+
+	bool scatter(const material *m, const ray &r_in, const hit_record &rec, scatter_record &srec) const;
+
+	double scattering_pdf(const material *m, const ray &r_in, const hit_record &rec, const ray &scattered) const;
+
+	// 批量着色: 先按材质排序, 每个材质只分派一次, 再对它的所有撞点做同一种计算
+	struct shading_hit {
+		ray r_in;
+		hit_record rec;
+	};
+	struct shading_result {
+		color emitted;
+		bool scattered;
+		scatter_record srec;
+	};
+
+	// results 与 hits 一一对应, 不在表中的材质最后逐个调用虚函数
+	void shade(const std::vector<shading_hit> &hits, std::vector<shading_result> &results) const;
+
+private:
+	struct entry {
+		const material *source;
+		material_data data;
+	};
+
+	uint32_t add_texture(const shared_ptr<texture> &t);
+
+	// 与 texture 的两个 value 对应: 漫反射用带 uv_width 的版本, 光源用不带的版本
+	color texture_value(uint32_t id, double u, double v, const point3 &p) const;
+	color texture_value(uint32_t id, double u, double v, const point3 &p, double uv_width) const;
+
+	// 表中的材质, 不在表中时为 -1
+	int lookup(const material *m) const {
+		return m->shading_id < entries.size() && entries[m->shading_id].source == m ? static_cast<int>(m->shading_id)
+																					  : -1;
+	}
+
+	template <typename T>
+	color emitted_as(const T &m, const ray &r_in, const hit_record &rec) const;
+
+	template <typename T>
+	bool scatter_as(const T &m, const ray &r_in, const hit_record &rec, scatter_record &srec) const;
+
+	template <typename T>
+	double scattering_pdf_as(const T &m, const ray &r_in, const hit_record &rec, const ray &scattered) const;
+
+	std::vector<entry> entries;
+	std::vector<texture_data> textures;
+	std::unordered_map<const texture *, uint32_t> texture_ids;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "texture_cache.h"
+#include "utility/mapped_file.h"
+
+#include <cstdint>
+#include <string>
+
+/*
+ * .rtx: 预处理好的分块MIP纹理, 可以直接内存映射, 启动时不需要解码。
+ *
+ * 布局(小端):
+ *   [0, 4096)     rtx_header, 其余补0, 让块数据从页边界开始
+ *   每一层        tiles_y x tiles_x 个块, 按行排列, 每块 16x16 个 RGBA texel
+ * 块的大小是页大小的因数(float 4KB, half 2KB), 一次缺页正好读入整块。
+ */
+enum class rtx_texel_format : uint32_t {
+	float32 = 0,
+	float16 = 1,
+};
+
+struct rtx_header {
+	static const uint32_t current_version = 1;
+	static const int max_levels = 24;
+	static const uint64_t data_alignment = 4096;
+
+	char magic[4];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint32_t tile_size;
+	rtx_texel_format format;
+	uint32_t reserved;
+	// 每一层第一块在文件中的偏移
+	uint64_t level_offset[max_levels];
+};
+
+class rtx_tile_source : public tile_source {
+public:
+	explicit rtx_tile_source(const char *filename);
+
+	void read_tile(int level, int tx, int ty, texture_tile &tile) const override;
+
+	rtx_texel_format format() const { return texel_format; }
+
+private:
+	// 读取并检查文件头, 出错时返回原因
+	const char *check_header();
+
+	size_t tile_bytes() const;
+
+	mapped_file file;
+	rtx_texel_format texel_format = rtx_texel_format::float32;
+	uint64_t level_offset[rtx_header::max_levels] = {};
+};
+
+// 把 src 的全部层、全部块写成 .rtx, 失败时返回 false
+bool write_rtx_texture(const std::string &path, const tile_source &src, rtx_texel_format format);
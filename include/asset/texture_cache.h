@@ -0,0 +1,119 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// 纹理按 16x16 的小块存放, 每个texel为 RGBA float, 一块正好4KB
+struct texture_tile {
+	static const int size = 16;
+
+	float texels[size * size][4];
+};
+
+/*
+ * 一张带MIP金字塔的图像的数据来源。
+ * 构造时只读取尺寸, 像素在第一次 read_tile 时才加载。
+ */
+class tile_source {
+public:
+	virtual ~tile_source() {}
+
+	int width() const { return base_width; }
+	int height() const { return base_height; }
+	int levels() const { return level_count; }
+
+	int level_width(int level) const { return std::max(1, base_width >> level); }
+	int level_height(int level) const { return std::max(1, base_height >> level); }
+
+	bool valid() const { return base_width > 0 && base_height > 0; }
+
+	// 填充第 level 层的第 (tx, ty) 块, 超出图像的部分复制边缘texel
+	virtual void read_tile(int level, int tx, int ty, texture_tile &tile) const = 0;
+
+	// 金字塔的层数: 一直缩小到 1x1
+	static int mip_levels(int w, int h) {
+		int levels = 1;
+		while ((w >> levels) > 0 || (h >> levels) > 0)
+			++levels;
+		return levels;
+	}
+
+protected:
+	int base_width = 0;
+	int base_height = 0;
+	int level_count = 0;
+};
+
+/*
+ * 全局纹理块缓存: 所有线程共享一个LRU, 总大小不超过 memory_limit。
+ * 缓存之外常驻的纹理数据(stb 解码出的金字塔)通过 reserve 计入同一个上限, 块会被淘汰来给它腾出位置。
+ * 每个线程另有一个小的直接映射缓存, 命中时不需要加锁。
+ * 块被全局LRU淘汰后, 仍被线程缓存引用的块要等线程缓存替换掉它才真正释放,
+ * 所以实际占用最多超出 线程数 x per_thread_entries 块。
+ */
+class texture_cache {
+public:
+	static texture_cache &instance();
+
+	// 每个 tile_source 注册一个唯一的id, 作为缓存键的一部分
+	uint32_t register_source();
+
+	void set_memory_limit(size_t bytes);
+	size_t memory_limit() const { return limit_bytes; }
+	size_t memory_used() const { return used_bytes + reserved_bytes; }
+
+	// 登记/注销缓存之外常驻的字节数
+	void reserve(size_t bytes);
+	void release(size_t bytes);
+
+	// 返回的指针由本线程的缓存持有, 在本线程下一次调用 tile() 之前有效。
+	// 不返回 shared_ptr, 否则热点块的引用计数会在线程之间来回争用。
+	const texture_tile *tile(uint32_t source_id, const tile_source &src, int level, int tx, int ty);
+
+	// 释放全部块, 主要用于基准测试
+	void clear();
+
+	struct statistics {
+		uint64_t global_hits;
+		uint64_t misses;
+		uint64_t evictions;
+	};
+
+	statistics stats() const;
+
+	static const int per_thread_entries = 64;
+
+private:
+	texture_cache() = default;
+
+	// source_id 19 位, level 5 位(int 尺寸的金字塔最多31层), 块坐标各 20 位
+	static uint64_t make_key(uint32_t source_id, int level, int tx, int ty) {
+		return (static_cast<uint64_t>(source_id) << 45) | (static_cast<uint64_t>(level & 0x1f) << 40)
+			   | (static_cast<uint64_t>(ty & 0xfffff) << 20) | static_cast<uint64_t>(tx & 0xfffff);
+	}
+
+	void evict_locked();
+
+	struct entry {
+		uint64_t key;
+		shared_ptr<const texture_tile> tile;
+	};
+
+	mutable std::mutex mutex;
+	std::list<entry> lru;	// 前面是最近使用的
+	std::unordered_map<uint64_t, std::list<entry>::iterator> entries;
+
+	size_t limit_bytes = size_t(256) << 20;
+	size_t used_bytes = 0;
+	size_t reserved_bytes = 0;
+
+	std::atomic<uint32_t> next_source_id{1};
+	std::atomic<uint64_t> global_hits{0}, misses{0}, evictions{0};
+};
@@ -1,23 +1,28 @@
-#pragma once
-
-#include "../rtweekend.h"
-
-class aabb {
-public:
-    aabb() {}
-
-    aabb(const point3 &a, const point3 &b) : minimum(a), maximum(b) {}
-
-    point3 min() const { return minimum; }
-
-    point3 max() const { return maximum; }
-
-    bool hit(const ray &r, double t_min, double t_max) const;
-
-public:
-    point3 minimum;
-    point3 maximum;
-};
-
-// 将两个aabb重组成一个aabb
-aabb surrounding_box(const aabb& box0, const aabb& box1);
+#pragma once
+
+#include "../rtweekend.h"
+
+class aabb {
+public:
+    aabb() {}
+
+    aabb(const point3 &a, const point3 &b) : minimum(a), maximum(b) {}
+
+    point3 min() const { return minimum; }
+
+    point3 max() const { return maximum; }
+
+    bool hit(const ray &r, double t_min, double t_max) const;
+
+    double surface_area() const {
+        const vec3 d = maximum - minimum;
+        return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+
+public:
+    point3 minimum;
+    point3 maximum;
+};
+
+// 将两个aabb重组成一个aabb
+aabb surrounding_box(const aabb& box0, const aabb& box1);
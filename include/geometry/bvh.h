@@ -26,12 +26,71 @@ public:
 
     bool bounding_box(double time0, double time1, aabb &output_box) const override;
 
+    // 图元移动之后自底向上重新计算包围盒, 树的结构不变; 上面几层的子树作为 OpenMP 任务并行
+    void refit(double time0, double time1);
+
+    // 表面积启发式(SAH)的代价, 以根节点的表面积归一化, 用来判断重新拟合后的树是否已经退化
+    double sah_cost() const;
+
+    // 复制整棵树的节点, 图元仍然共享; 新节点由调用线程分配, 用于给每个 NUMA 节点一份本地副本
+    shared_ptr<bvh_node> clone() const;
+
+private:
+    // 对 objects[start, end) 排序并递归建立子树, objects 由根节点持有
+    void build(std::vector<shared_ptr<hittable>> &objects, size_t start, size_t end, double time0, double time1);
+
+    void refit_subtree(double time0, double time1, int depth);
+
+    double sah_cost(double inv_root_area) const;
+
 public:
     // 左节点
     shared_ptr<hittable> left;
     // 右节点
     shared_ptr<hittable> right;
     aabb box;
+
+    // 子节点是 bvh_node 而不是图元, 建树时记下, 重新拟合时不需要 dynamic_cast
+    bool left_is_node = false;
+    bool right_is_node = false;
+};
+
+/*
+ * 可以随动画更新的 BVH: 保留图元列表, 每帧先重新拟合,
+ * 拟合后的 SAH 代价超过刚建好时的 rebuild_ratio 倍才按当前位置完整重建。
+ */
+class dynamic_bvh : public hittable {
+public:
+    dynamic_bvh(const hittable_list &list, double time0, double time1);
+
+    bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override {
+        return root->hit(r, t_min, t_max, rec);
+    }
+
+    bool bounding_box(double time0, double time1, aabb &output_box) const override {
+        return root->bounding_box(time0, time1, output_box);
+    }
+
+    // 图元移动之后调用, 返回 true 表示重建了
+    bool update(double time0, double time1);
+
+    double cost() const { return current_cost; }
+
+    double cost_after_build() const { return build_cost; }
+
+    const std::vector<shared_ptr<hittable>> &primitives() const { return objects; }
+
+public:
+    // 0 表示每次都重建
+    double rebuild_ratio = 1.3;
+
+private:
+    void rebuild(double time0, double time1);
+
+    std::vector<shared_ptr<hittable>> objects;
+    shared_ptr<bvh_node> root;
+    double build_cost = 0;
+    double current_cost = 0;
 };
 
 inline bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis) {
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/aabb.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+
+// packed_bvh 和 lazy_bvh 共用的建树参数
+namespace bvh_build {
+	// SAH 的桶数
+	const int sah_bins = 12;
+	// 超过这个深度改用中位数划分, 保证树高不超过遍历栈的大小
+	const int median_depth = 32;
+	const int stack_size = 64;
+
+	/*
+	 * 把 [first, last) 的图元在质心范围最大的轴上分成两半, 返回分界点, 划分轴写入 axis。
+	 * 深度小于 median_depth 时用分桶 SAH: 在 sah_bins - 1 个桶边界中选代价 SA(L) * N(L) + SA(R) * N(R) 最小的一个;
+	 * 质心重合、SAH 分不开或者树太深时按中位数划分, 所以两边总是非空。
+	 * centroid_of / box_of 从元素取出质心和包围盒, 区间至少要有两个元素。
+	 */
+	template <typename It, typename Centroid, typename Box>
+	It partition(It first, It last, int depth, Centroid centroid_of, Box box_of, int &axis) {
+		point3 cmin = centroid_of(*first), cmax = cmin;
+		for (It it = std::next(first); it != last; ++it) {
+			const point3 c = centroid_of(*it);
+			for (int a = 0; a < 3; ++a) {
+				cmin[a] = std::min(cmin[a], c[a]);
+				cmax[a] = std::max(cmax[a], c[a]);
+			}
+		}
+
+		const vec3 extent = cmax - cmin;
+		axis = 0;
+		if (extent.y() > extent[axis])
+			axis = 1;
+		if (extent.z() > extent[axis])
+			axis = 2;
+		const int a = axis;
+
+		It mid = first;
+		if (extent[a] > 0.0 && depth < median_depth) {
+			const double scale = sah_bins / extent[a];
+			auto bin_of = [&](const typename std::iterator_traits<It>::value_type &v) {
+				return std::min(sah_bins - 1, static_cast<int>((centroid_of(v)[a] - cmin[a]) * scale));
+			};
+			aabb bin_box[sah_bins];
+			size_t bin_count[sah_bins] = {};
+			for (It it = first; it != last; ++it) {
+				const int b = bin_of(*it);
+				bin_box[b] = bin_count[b] ? surrounding_box(bin_box[b], box_of(*it)) : box_of(*it);
+				++bin_count[b];
+			}
+
+			double right_area[sah_bins];
+			size_t right_count[sah_bins];
+			aabb acc;
+			size_t n = 0;
+			for (int b = sah_bins - 1; b > 0; --b) {
+				if (bin_count[b]) {
+					acc = n ? surrounding_box(acc, bin_box[b]) : bin_box[b];
+					n += bin_count[b];
+				}
+				right_area[b] = n ? acc.surface_area() : 0.0;
+				right_count[b] = n;
+			}
+
+			int best = -1;
+			double best_cost = infinity;
+			n = 0;
+			for (int b = 0; b < sah_bins - 1; ++b) {
+				if (bin_count[b]) {
+					acc = n ? surrounding_box(acc, bin_box[b]) : bin_box[b];
+					n += bin_count[b];
+				}
+				if (n == 0 || right_count[b + 1] == 0)
+					continue;
+				const double cost = acc.surface_area() * n + right_area[b + 1] * right_count[b + 1];
+				if (cost < best_cost) {
+					best_cost = cost;
+					best = b;
+				}
+			}
+			if (best >= 0)
+				mid = std::partition(first, last, [&](const typename std::iterator_traits<It>::value_type &v) {
+					return bin_of(v) <= best;
+				});
+		}
+		if (mid == first || mid == last) {
+			mid = first + (last - first) / 2;
+			std::nth_element(first, mid, last,
+							 [&](const typename std::iterator_traits<It>::value_type &x,
+								 const typename std::iterator_traits<It>::value_type &y) {
+								 return centroid_of(x)[a] < centroid_of(y)[a];
+							 });
+		}
+		return mid;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+struct mesh_chunk;
+class chunked_mesh;
+
+/*
+ * 全局几何块缓存: 与 texture_cache 相同的结构, 所有线程共享一个LRU, 驻留的块总大小不超过 memory_limit。
+ * 块由 chunked_mesh::load_chunk 从映射的文件中读出并建立块内的 BVH。
+ * 每个线程另有一个小的直接映射缓存, 命中时不需要加锁; 被全局LRU淘汰的块要等线程缓存替换掉它才真正释放。
+ */
+class geometry_cache {
+public:
+	static geometry_cache &instance();
+
+	// 每个 chunked_mesh 注册一个唯一的id, 作为缓存键的一部分
+	uint32_t register_mesh();
+
+	void set_memory_limit(size_t bytes);
+	size_t memory_limit() const { return limit_bytes; }
+	size_t memory_used() const { return used_bytes; }
+
+	// 返回的指针由本线程的缓存持有, 在本线程下一次调用 chunk() 之前有效; 不驻留时加载
+	const mesh_chunk *chunk(uint32_t mesh_id, const chunked_mesh &mesh, uint32_t index);
+
+	// 块是否驻留(不加载), 用于把打到未驻留块的光线推迟到一批之后
+	bool resident(uint32_t mesh_id, uint32_t index) const;
+
+	// 释放全部块
+	void clear();
+
+	struct statistics {
+		uint64_t global_hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t peak_bytes;
+	};
+
+	statistics stats() const;
+
+	static const int per_thread_entries = 8;
+
+private:
+	geometry_cache() = default;
+
+	static uint64_t make_key(uint32_t mesh_id, uint32_t index) {
+		return (static_cast<uint64_t>(mesh_id) << 32) | index;
+	}
+
+	void evict_locked();
+
+	struct entry {
+		uint64_t key;
+		size_t bytes;
+		shared_ptr<const mesh_chunk> chunk;
+	};
+
+	mutable std::mutex mutex;
+	std::list<entry> lru;	// 前面是最近使用的
+	std::unordered_map<uint64_t, std::list<entry>::iterator> entries;
+
+	size_t limit_bytes = size_t(256) << 20;
+	size_t used_bytes = 0;
+	size_t peak_bytes = 0;
+
+	std::atomic<uint32_t> next_mesh_id{1};
+	std::atomic<uint64_t> global_hits{0}, misses{0}, evictions{0};
+};
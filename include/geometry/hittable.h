@@ -6,16 +6,22 @@
 #include "../rtweekend.h"
 
 class material;
+class sampler;
 
 /*该结构体记录“撞点”处的信息：离光线起点的距离t、撞点的坐标向量p、撞点出的法向量normal.*/
 struct hit_record {
 	point3 p;
 	vec3 normal;
-	shared_ptr<material> mat_ptr;
+	// 材质由场景持有, 命中时只记下指针, 不复制 shared_ptr(避免每次命中都修改引用计数)
+	const material *mat_ptr = nullptr;
 	double t;
 	// 物体命中点的U,V表面坐标
 	double u, v;
 	bool front_face;
+	// 表面坐标对 u, v 的偏导, 没有参数化的形状保持为0
+	vec3 dpdu{0.0}, dpdv{0.0};
+	// 相邻像素在纹理空间中覆盖的宽度, 0 表示没有光线微分
+	double uv_width = 0;
 
 	// 如果射线和法线的方向相同，则该射线在对象内部，如果射线和法线的方向相反，则该射线在对象之外
 
@@ -27,6 +33,41 @@ struct hit_record {
 		front_face = dot(r.direction(), outward_normal) < 0;
 		normal = front_face ? outward_normal : -outward_normal;
 	}
+
+	// 把两条偏移光线与撞点的切平面求交, 再用最小二乘从 dpdu, dpdv 解出 du, dv
+	inline void compute_uv_footprint(const ray &r, const ray_differential &diff) {
+		uv_width = 0;
+		const double d = dot(normal, p);
+		const double tx_den = dot(normal, diff.rx_direction);
+		const double ty_den = dot(normal, diff.ry_direction);
+		if (std::fabs(tx_den) < 1e-12 || std::fabs(ty_den) < 1e-12)
+			return;
+
+		const double tx = (d - dot(normal, diff.rx_origin)) / tx_den;
+		const double ty = (d - dot(normal, diff.ry_origin)) / ty_den;
+		const vec3 dpdx = diff.rx_origin + tx * diff.rx_direction - p;
+		const vec3 dpdy = diff.ry_origin + ty * diff.ry_direction - p;
+
+		// 法方程 [dpdu dpdv]^T [dpdu dpdv] [du dv]^T = [dpdu dpdv]^T dp
+		const double a00 = dot(dpdu, dpdu), a01 = dot(dpdu, dpdv), a11 = dot(dpdv, dpdv);
+		const double det = a00 * a11 - a01 * a01;
+		if (std::fabs(det) < 1e-20)
+			return;
+		const double inv_det = 1.0 / det;
+
+		auto solve = [&](const vec3 &dp, double &du, double &dv) {
+			const double b0 = dot(dpdu, dp), b1 = dot(dpdv, dp);
+			du = (a11 * b0 - a01 * b1) * inv_det;
+			dv = (a00 * b1 - a01 * b0) * inv_det;
+		};
+
+		double dudx, dvdx, dudy, dvdy;
+		solve(dpdx, dudx, dvdx);
+		solve(dpdy, dudy, dvdy);
+		uv_width = std::max(std::max(std::fabs(dudx), std::fabs(dvdx)), std::max(std::fabs(dudy), std::fabs(dvdy)));
+		if (!std::isfinite(uv_width))
+			uv_width = 0;
+	}
 };
 
 //hitable这个类表示能够被光线撞上的任何物体。比如，球体
@@ -46,6 +87,11 @@ public:
 	virtual vec3 random(const vec3 &o) const {
 		return vec3(1, 0, 0);
 	}
+
+	// 使用采样器提供的样本, 默认退回到 random_double()
+	virtual vec3 random(const vec3 &o, sampler &smp) const {
+		return random(o);
+	}
 };
 
 // make normals point in the −y direction
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/aabb.h"
+#include "geometry/hittable.h"
+#include "geometry/hittable_list.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * 按需建立的 BVH: 构造时只算出每个图元的包围盒, 根节点是整个图元区间。
+ * 一个节点在第一次有光线进入时才用分桶 SAH 划分成两个子节点, 相机看不到的部分一直不划分。
+ *
+ * 节点的状态是原子的: 未划分的节点由第一个 CAS 成功的线程划分, 它独占该节点的图元区间,
+ * 子节点写好之后用 release 发布; 其它线程遇到正在划分的节点时让出 CPU 等它完成(划分只扫描这一段区间一遍),
+ * 已经发布的节点只读, 遍历不加锁。节点数组按 2n 预先分配但不构造, 子节点成对地用原子计数分配,
+ * 分配到时才原地构造, 所以只有建立了的节点所在的页面会被写入。
+ *
+ * 嵌套的 hittable_list / bvh_node / box 被打平, 其它对象(变换、体积等)作为一个图元。
+ */
+class lazy_bvh : public hittable {
+public:
+	lazy_bvh(const hittable_list &list, double time0, double time1);
+
+	bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+	bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
+	// 每个叶节点最多的图元数
+	static const int leaf_size = 4;
+
+	struct statistics {
+		size_t primitives;
+		// 已经建立的节点数和全部划分完时的最多节点数
+		size_t nodes;
+		size_t max_nodes;
+		size_t leaves;
+	};
+
+	statistics stats() const;
+
+private:
+	enum node_state : uint32_t { unsplit, splitting, interior, leaf };
+
+	struct node {
+		aabb box;
+		// 图元区间 [begin, end), 按 order 中的顺序
+		uint32_t begin, end;
+		// 内部节点: 子节点为 child 和 child + 1, axis 为划分轴
+		uint32_t child;
+		uint8_t axis;
+		uint8_t depth;
+		std::atomic<uint32_t> state;
+	};
+
+	void flatten(const shared_ptr<hittable> &object, double time0, double time1);
+
+	// 划分节点 n, 只由把状态从 unsplit 改成 splitting 的线程调用
+	void split(node &n) const;
+
+	// 等 n 划分完, 返回它的最终状态
+	uint32_t resolve(node &n) const;
+
+	std::vector<shared_ptr<hittable>> objects;
+	std::vector<aabb> boxes;
+	std::vector<point3> centroids;
+
+	// 划分时在各自的区间内重排
+	mutable std::vector<uint32_t> order;
+	// 2n 个节点的原始内存, 前 node_count 个已经构造
+	std::unique_ptr<unsigned char[]> node_storage;
+	node *nodes = nullptr;
+	mutable std::atomic<uint32_t> node_count{0};
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/aabb.h"
+#include "geometry/hittable.h"
+#include "geometry/hittable_list.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * 渲染用的加速结构: hittable 仍然是搭建场景的接口, 这里把场景展开成按类型分开的 SoA 数组。
+ * 嵌套的 hittable_list / bvh_node 被打平, box 展开成 6 个矩形, flip_face 包着的矩形记为翻转的矩形;
+ * translate / rotate_y 这类变换保留为一个图元, 但它们下面的列表或 BVH 也换成 packed_bvh。
+ *
+ * 叶节点按 (类型, 下标区间) 引用图元, 同一个叶节点里的图元在各自的数组中连续存放(建树后按叶节点的顺序重排),
+ * 每种类型用 switch 分派, 一次对整个区间做 SIMD 求交, 不经过虚函数。
+ * 其它类型(constant_medium、变换、dynamic_bvh 等)仍然调用 hittable::hit。
+ *
+ * 建树有两种方法: sah 为分桶 SAH 的递归划分(单线程); lbvh 并行地计算质心的 63 位 Morton 码并基数排序,
+ * 再按 Karras 的方法并行地建立二叉层次, 自底向上用原子计数合并包围盒, 最后展开成同样的节点布局。
+ * lbvh 建得快很多, 但树的质量不如 SAH, 适合每帧都要重建的场合。
+ *
+ * 节点有两种格式: binary 是上面的二叉节点(80 字节, 包围盒是 6 个 double); quantized 在建好二叉树之后把它合并成
+ * 4 叉节点, 子节点的包围盒相对于父节点量化成 8 位整数, 一个节点正好一条 64 字节的缓存行, 叶节点的图元区间另外存放。
+ * 包围盒无界的场景(含有没有包围盒的图元)不能量化, 仍然用二叉节点。
+ */
+class packed_bvh : public hittable {
+public:
+	enum class build_method { sah, lbvh };
+
+	enum class node_format { binary, quantized };
+
+	packed_bvh(const hittable_list &list, double time0, double time1, build_method method = build_method::sah,
+			   node_format format = node_format::binary);
+
+	bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+	bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
+	// 每个叶节点最多的图元数
+	static const int leaf_size = 4;
+
+	enum prim_type : uint8_t { sphere_prim, moving_sphere_prim, rect_prim, other_prim, prim_type_count };
+
+	struct statistics {
+		size_t nodes;
+		size_t leaves;
+		size_t prims[prim_type_count];
+		// 节点和叶节点区间占用的字节数, 不含图元数组
+		size_t node_bytes;
+		bool quantized;
+	};
+
+	statistics stats() const;
+
+	// 叶节点中的材质和仍然通过 hittable 调用的图元, 用于遍历场景
+	void collect(std::vector<shared_ptr<material>> &materials, std::vector<shared_ptr<hittable>> &objects) const;
+
+private:
+	// 建树时的图元引用
+	struct prim_ref {
+		aabb box;
+		point3 centroid;
+		prim_type type;
+		uint32_t index;
+	};
+
+	struct node {
+		aabb box;
+		// 内部节点: 左子节点紧跟在后面, right 为右子节点; axis 为划分轴
+		uint32_t right;
+		uint8_t axis;
+		uint8_t leaf;
+		// 叶节点: 每种类型在自己数组中的起点和个数
+		uint8_t count[prim_type_count];
+		uint32_t first[prim_type_count];
+	};
+
+	// 压缩格式下叶节点引用的图元区间
+	struct leaf_range {
+		uint32_t first[prim_type_count];
+		uint8_t count[prim_type_count];
+	};
+
+	// 压缩格式的 4 叉节点: 子节点 c 在轴 a 上的范围解码为 origin[a] + lo[a][c] * scale[a] 到 origin[a] + hi[a][c] * scale[a],
+	// scale 是2的幂; 量化时下界向下、上界向上取整, 解码出的包围盒只会比原来的大
+	struct alignas(64) wide_node {
+		float origin[3];
+		float scale[3];
+		uint8_t lo[3][4];
+		uint8_t hi[3][4];
+		// 内部子节点为 wide 中的下标; 带 leaf_child 位时为 leaf_ranges 中的下标
+		uint32_t child[4];
+	};
+
+	static const uint32_t leaf_child = 0x80000000u;
+	static const uint32_t empty_child = 0xffffffffu;
+
+	void flatten(const shared_ptr<hittable> &object, bool flipped, std::vector<prim_ref> &refs, double time0,
+				 double time1);
+
+	// 按暂存的图元数预留 SoA 数组, emit_leaf 追加时不再重新分配
+	void reserve_arrays();
+
+	uint32_t build(std::vector<prim_ref> &refs, size_t begin, size_t end, int depth);
+
+	// Karras 的层次, 在 packed_bvh.cpp 中定义
+	struct lbvh_tree;
+
+	// 按 Morton 码重排 refs 并建立整棵树
+	void build_lbvh(std::vector<prim_ref> &refs);
+
+	// 把 Karras 树中的一个子树(叶子的编码带最高位)展开成 nodes, 图元不超过 leaf_size 时成为叶节点
+	uint32_t emit_lbvh(std::vector<prim_ref> &refs, const lbvh_tree &tree, uint32_t child, int depth);
+
+	void emit_leaf(node &n, const std::vector<prim_ref> &refs, size_t begin, size_t end);
+
+	// 把二叉节点合并成 4 叉的量化节点, 之后释放二叉节点
+	void compress();
+
+	// 以二叉节点 index 为根的子树展开成量化节点, 返回它在 wide 中的下标
+	uint32_t emit_wide(uint32_t index);
+
+	bool hit_quantized(const ray &r, double t_min, double t_max, hit_record &rec) const;
+
+	bool hit_leaf(const uint8_t *count, const uint32_t *first, const ray &r, double t_min, double &closest,
+				  hit_record &rec) const;
+
+	// 建树前按加入的顺序存放, emit_leaf 再按叶节点的顺序复制到下面的数组
+	struct staged_sphere {
+		point3 center;
+		double radius;
+		shared_ptr<material> mat;
+	};
+
+	struct staged_moving_sphere {
+		point3 center0, center1;
+		double time0, time1, radius;
+		shared_ptr<material> mat;
+	};
+
+	// axis: 0 为 xy 平面(z = k), 1 为 xz 平面(y = k), 2 为 yz 平面(x = k); (a, b) 为平面内的两个坐标
+	struct staged_rect {
+		double a0, a1, b0, b1, k;
+		uint8_t axis;
+		bool flipped;
+		shared_ptr<material> mat;
+	};
+
+	std::vector<staged_sphere> staged_spheres;
+	std::vector<staged_moving_sphere> staged_moving_spheres;
+	std::vector<staged_rect> staged_rects;
+	std::vector<shared_ptr<hittable>> staged_others;
+
+	build_method method;
+	node_format format;
+	aabb root_box;
+	std::vector<node> nodes;
+	std::vector<wide_node> wide;
+	std::vector<leaf_range> leaf_ranges;
+
+	// SoA, 按叶节点的顺序
+	struct {
+		std::vector<double> cx, cy, cz, radius;
+		std::vector<shared_ptr<material>> mat;
+	} spheres;
+
+	struct {
+		std::vector<double> cx0, cy0, cz0, cx1, cy1, cz1, time0, time1, radius;
+		std::vector<shared_ptr<material>> mat;
+	} moving_spheres;
+
+	struct {
+		std::vector<double> a0, a1, b0, b1, k;
+		std::vector<uint8_t> axis, flipped;
+		std::vector<shared_ptr<material>> mat;
+	} rects;
+
+	std::vector<shared_ptr<hittable>> others;
+};
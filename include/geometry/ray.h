@@ -29,3 +29,8 @@ public:
     double tm;
 };
 
+// 相邻像素(x+1 与 y+1)的光线, 只有相机射出的光线带有微分, 用于估计纹理的采样范围
+struct ray_differential {
+    point3 rx_origin, ry_origin;
+    vec3 rx_direction, ry_direction;
+};
@@ -1,87 +1,104 @@
-#pragma once
-
-#include "hittable_list.h"
-
-class rotate_y : public hittable_list {
-public:
-    rotate_y(shared_ptr<hittable> p, double angle);
-
-    virtual bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
-        output_box = bbox;
-        return hasbox;
-    }
-
-public:
-    shared_ptr<hittable> ptr;
-    double sin_theta;
-    double cos_theta;
-    bool hasbox;
-    aabb bbox;
-};
-
-rotate_y::rotate_y(shared_ptr<hittable> p, double angle) : ptr(p) {
-    auto radians = degrees_to_radians(angle);
-    sin_theta = sin(radians);
-    cos_theta = cos(radians);
-    hasbox = ptr->bounding_box(0, 1, bbox);
-
-    point3 min(infinity, infinity, infinity);
-    point3 max(-infinity, -infinity, -infinity);
-
-    // traversal eight point
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 2; j++) {
-            for (int k = 0; k < 2; k++) {
-                auto x = i * bbox.max().x() + (1 - i) * bbox.min().x();
-                auto y = j * bbox.max().y() + (1 - j) * bbox.min().y();
-                auto z = k * bbox.max().z() + (1 - k) * bbox.min().z();
-
-                auto newx = cos_theta * x + sin_theta * z;
-                auto newz = -sin_theta * x + cos_theta * z;
-
-                // only rotate y-axis
-                vec3 tester(newx, y, newz);
-
-                for (int c = 0; c < 3; c++) {
-                    min[c] = std::fmin(min[c], tester[c]);
-                    max[c] = std::fmax(max[c], tester[c]);
-                }
-            }
-        }
-    }
-
-    bbox = aabb(min, max);
-}
-
-bool rotate_y::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
-    auto origin = r.origin();
-    auto direction = r.direction();
-
-    origin[0] = cos_theta * r.origin()[0] - sin_theta * r.origin()[2];
-    origin[2] = sin_theta * r.origin()[0] + cos_theta * r.origin()[2];
-
-    direction[0] = cos_theta * r.direction()[0] - sin_theta * r.direction()[2];
-    direction[2] = sin_theta * r.direction()[0] + cos_theta * r.direction()[2];
-
-    ray rotated_r(origin, direction, r.time());
-
-    if (!ptr->hit(rotated_r, t_min, t_max, rec))
-        return false;
-
-    auto p = rec.p;
-    auto normal = rec.normal;
-
-    // 变换回去
-    p[0] = cos_theta * rec.p[0] + sin_theta * rec.p[2];
-    p[2] = -sin_theta * rec.p[0] + cos_theta * rec.p[2];
-
-    normal[0] = cos_theta * rec.normal[0] + sin_theta * rec.normal[2];
-    normal[2] = -sin_theta * rec.normal[0] + cos_theta * rec.normal[2];
-
-    rec.p = p;
-    rec.set_face_normal(rotated_r, normal);
-
-    return true;
+#pragma once
+
+#include "hittable_list.h"
+
+class rotate_y : public hittable_list {
+public:
+    rotate_y(shared_ptr<hittable> p, double angle);
+
+    // 动画中改变角度, 同时更新包围盒
+    void set_angle(double angle);
+
+    virtual bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
+        output_box = bbox;
+        return hasbox;
+    }
+
+public:
+    shared_ptr<hittable> ptr;
+    double sin_theta;
+    double cos_theta;
+    bool hasbox;
+    aabb bbox;
+};
+
+inline rotate_y::rotate_y(shared_ptr<hittable> p, double angle) : ptr(p) {
+    set_angle(angle);
+}
+
+inline void rotate_y::set_angle(double angle) {
+    auto radians = degrees_to_radians(angle);
+    sin_theta = sin(radians);
+    cos_theta = cos(radians);
+    hasbox = ptr->bounding_box(0, 1, bbox);
+
+    point3 min(infinity, infinity, infinity);
+    point3 max(-infinity, -infinity, -infinity);
+
+    // traversal eight point
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            for (int k = 0; k < 2; k++) {
+                auto x = i * bbox.max().x() + (1 - i) * bbox.min().x();
+                auto y = j * bbox.max().y() + (1 - j) * bbox.min().y();
+                auto z = k * bbox.max().z() + (1 - k) * bbox.min().z();
+
+                auto newx = cos_theta * x + sin_theta * z;
+                auto newz = -sin_theta * x + cos_theta * z;
+
+                // only rotate y-axis
+                vec3 tester(newx, y, newz);
+
+                for (int c = 0; c < 3; c++) {
+                    min[c] = std::fmin(min[c], tester[c]);
+                    max[c] = std::fmax(max[c], tester[c]);
+                }
+            }
+        }
+    }
+
+    bbox = aabb(min, max);
+}
+
+inline bool rotate_y::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
+    auto origin = r.origin();
+    auto direction = r.direction();
+
+    origin[0] = cos_theta * r.origin()[0] - sin_theta * r.origin()[2];
+    origin[2] = sin_theta * r.origin()[0] + cos_theta * r.origin()[2];
+
+    direction[0] = cos_theta * r.direction()[0] - sin_theta * r.direction()[2];
+    direction[2] = sin_theta * r.direction()[0] + cos_theta * r.direction()[2];
+
+    ray rotated_r(origin, direction, r.time());
+
+    if (!ptr->hit(rotated_r, t_min, t_max, rec))
+        return false;
+
+    auto p = rec.p;
+    auto normal = rec.normal;
+
+    // 变换回去
+    p[0] = cos_theta * rec.p[0] + sin_theta * rec.p[2];
+    p[2] = -sin_theta * rec.p[0] + cos_theta * rec.p[2];
+
+    normal[0] = cos_theta * rec.normal[0] + sin_theta * rec.normal[2];
+    normal[2] = -sin_theta * rec.normal[0] + cos_theta * rec.normal[2];
+
+    // 切向量与法线一样转回去
+    auto dpdu = rec.dpdu;
+    auto dpdv = rec.dpdv;
+    dpdu[0] = cos_theta * rec.dpdu[0] + sin_theta * rec.dpdu[2];
+    dpdu[2] = -sin_theta * rec.dpdu[0] + cos_theta * rec.dpdu[2];
+    dpdv[0] = cos_theta * rec.dpdv[0] + sin_theta * rec.dpdv[2];
+    dpdv[2] = -sin_theta * rec.dpdv[0] + cos_theta * rec.dpdv[2];
+
+    rec.p = p;
+    rec.dpdu = dpdu;
+    rec.dpdv = dpdv;
+    rec.set_face_normal(rotated_r, normal);
+
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/bvh.h"
+#include "geometry/hittable_list.h"
+#include "geometry/rotate.h"
+#include "geometry/translate.h"
+#include "shape/aarect.h"
+#include "shape/box.h"
+#include "shape/moving_sphere.h"
+#include "shape/sphere.h"
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 同一类型对象的连续存储。按块分配, 块的大小从 16 个对象开始翻倍到 4096 个;
+ * 块不会移动, 所以对象的地址(句柄)一直有效。不能单独释放对象, 析构时整体释放。
+ */
+template <typename T>
+class object_pool {
+public:
+	object_pool() = default;
+
+	object_pool(const object_pool &) = delete;
+	object_pool &operator=(const object_pool &) = delete;
+
+	~object_pool() { clear(); }
+
+	template <typename... Args>
+	T *create(Args &&...args) {
+		if (chunks.empty() || chunks.back().used == chunks.back().capacity) {
+			const size_t capacity = chunks.empty() ? 16 : std::min<size_t>(chunks.back().capacity * 2, 4096);
+			chunks.push_back(chunk{std::unique_ptr<slot[]>(new slot[capacity]), capacity, 0});
+		}
+		auto &c = chunks.back();
+		T *object = new (&c.slots[c.used]) T(std::forward<Args>(args)...);
+		++c.used;
+		++count;
+		return object;
+	}
+
+	size_t size() const { return count; }
+
+	// 已分配的块的总大小
+	size_t bytes() const {
+		size_t total = 0;
+		for (const auto &c : chunks)
+			total += c.capacity * sizeof(slot);
+		return total;
+	}
+
+	void clear() {
+		for (auto &c : chunks)
+			for (size_t k = 0; k < c.used; ++k)
+				reinterpret_cast<T *>(&c.slots[k])->~T();
+		chunks.clear();
+		count = 0;
+	}
+
+private:
+	using slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+	struct chunk {
+		std::unique_ptr<slot[]> slots;
+		size_t capacity;
+		size_t used;
+	};
+
+	std::vector<chunk> chunks;
+	size_t count = 0;
+};
+
+/*
+ * 场景的几何体存储: 构建场景时仍然用 make_shared, 构建完成后 compact 把 BVH 节点(深度优先)、
+ * 球、矩形、盒子和变换(按叶节点的顺序)复制到各自的池中。遍历时相邻的叶节点因此在相邻的缓存行上,
+ * 也不再有每个对象一个的控制块。
+ *
+ * 返回的列表中的指针共享 arena 的控制块; 池内对象之间的 shared_ptr 不持有所有权, 所以没有循环引用,
+ * 最后一个外部引用释放时整个 arena 一次释放。材质保持原来的 shared_ptr: hit_record 每次命中都会复制
+ * 材质指针, 如果所有材质共用 arena 的控制块, 所有线程都会争用同一个引用计数。
+ * 不认识的类型(dynamic_bvh、constant_medium 等)保留原来的对象。
+ */
+class scene_arena {
+public:
+	static hittable_list compact(const hittable_list &world, shared_ptr<scene_arena> *arena_out = nullptr);
+
+	struct pool_usage {
+		const char *name;
+		size_t objects;
+		size_t bytes;
+	};
+
+	std::vector<pool_usage> usage() const;
+
+	size_t bytes() const;
+
+	// 保留原来的 shared_ptr 的对象数
+	size_t kept() const { return kept_objects; }
+
+private:
+	shared_ptr<hittable> relocate(const shared_ptr<hittable> &object);
+
+	// 不持有所有权的 shared_ptr(use_count 为 0), 生命周期由 arena 管理
+	static shared_ptr<hittable> unowned(hittable *object) { return shared_ptr<hittable>(shared_ptr<void>(), object); }
+
+	object_pool<bvh_node> nodes;
+	object_pool<sphere> spheres;
+	object_pool<moving_sphere> moving_spheres;
+	object_pool<xy_rect> xy_rects;
+	object_pool<xz_rect> xz_rects;
+	object_pool<yz_rect> yz_rects;
+	object_pool<box> boxes;
+	object_pool<translate> translates;
+	object_pool<rotate_y> rotations;
+	object_pool<flip_face> flips;
+
+	// 同一个对象被引用多次时只复制一次
+	std::unordered_map<const hittable *, shared_ptr<hittable>> relocated;
+	size_t kept_objects = 0;
+};
+
+// 进程堆上已分配的字节数(glibc), 其它平台返回 0
+size_t heap_bytes_in_use();
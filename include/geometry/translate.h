@@ -1,40 +1,40 @@
-#pragma once
-
-#include "hittable_list.h"
-
-class translate : public hittable_list {
-public:
-    translate(shared_ptr<hittable> p, const vec3 &displacement)
-            : ptr(p), offset(displacement) {}
-
-    virtual bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
-
-public:
-    shared_ptr<hittable> ptr;
-    vec3 offset;
-};
-
-// move ray
-bool translate::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
-    ray moved_r(r.origin() - offset, r.direction(), r.time());
-    if (!ptr->hit(moved_r, t_min, t_max, rec))
-        return false;
-
-    rec.p += offset;
-    rec.set_face_normal(moved_r, rec.normal);
-
-    return true;
-}
-
-bool translate::bounding_box(double time0, double time1, aabb &output_box) const {
-    if (!ptr->bounding_box(time0, time1, output_box))
-        return false;
-
-    output_box = aabb(
-            output_box.min() + offset,
-            output_box.max() + offset);
-
-    return true;
-}
+#pragma once
+
+#include "hittable_list.h"
+
+class translate : public hittable_list {
+public:
+    translate(shared_ptr<hittable> p, const vec3 &displacement)
+            : ptr(p), offset(displacement) {}
+
+    virtual bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
+public:
+    shared_ptr<hittable> ptr;
+    vec3 offset;
+};
+
+// move ray
+inline bool translate::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
+    ray moved_r(r.origin() - offset, r.direction(), r.time());
+    if (!ptr->hit(moved_r, t_min, t_max, rec))
+        return false;
+
+    rec.p += offset;
+    rec.set_face_normal(moved_r, rec.normal);
+
+    return true;
+}
+
+inline bool translate::bounding_box(double time0, double time1, aabb &output_box) const {
+    if (!ptr->bounding_box(time0, time1, output_box))
+        return false;
+
+    output_box = aabb(
+            output_box.min() + offset,
+            output_box.max() + offset);
+
+    return true;
+}
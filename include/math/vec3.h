@@ -118,9 +118,7 @@ static vec3 random_in_unit_sphere_reject() {
 	}
 }
 
-inline vec3 random_to_sphere(double radius, double distance_squared) {
-	auto r1 = random_double();
-	auto r2 = random_double();
+inline vec3 random_to_sphere(double radius, double distance_squared, double r1, double r2) {
 	auto z = 1 + r2 * (sqrt(1 - radius * radius / distance_squared) - 1);
 
 	auto phi = TWO_PI * r1;
@@ -130,6 +128,11 @@ inline vec3 random_to_sphere(double radius, double distance_squared) {
 	return vec3(x, y, z);
 }
 
+inline vec3 random_to_sphere(double radius, double distance_squared) {
+	auto [r1, r2] = random_point2d();
+	return random_to_sphere(radius, distance_squared, r1, r2);
+}
+
 /* 随机后并且归一化 获得随机向量方向的 单位向量*/
 static vec3 random_unit_vector() {
     return unit_vector(random_in_unit_sphere());
@@ -146,8 +149,8 @@ static vec3 random_in_hemisphere(const vec3 &normal) {
         return -in_unit_sphere;
 }
 
-static vec3 random_cosine_direction() {
-	auto[r1, r2] = random_point2d();
+// r1, r2 为[0,1)上的均匀样本
+static vec3 random_cosine_direction(double r1, double r2) {
 	auto z = sqrt(1 - r2);
 
 	auto phi = 2 * PI * r1;
@@ -157,16 +160,24 @@ static vec3 random_cosine_direction() {
 	return vec3(x, y, z);
 }
 
+static vec3 random_cosine_direction() {
+	auto [r1, r2] = random_point2d();
+	return random_cosine_direction(r1, r2);
+}
+
 /* 随机从圆盘选一点作为lookfrom发射光线*/
-static vec3 random_in_unit_disk(){
-    auto& [r1, r2] = random_point2d();
-    
+static vec3 random_in_unit_disk(double r1, double r2) {
     double theta = r1;
     double phi = r2 * TWO_PI;
 
     return vec3(theta * std::cos(phi), theta * std::sin(phi), 0);
 }
 
+static vec3 random_in_unit_disk() {
+    auto [r1, r2] = random_point2d();
+    return random_in_unit_disk(r1, r2);
+}
+
 // reject
 static vec3 random_in_unit_disk_reject() {
 	while (true) {
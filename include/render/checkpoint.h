@@ -0,0 +1,39 @@
+#pragma once
+
+#include "render/film.h"
+#include "render/integrator.h"
+#include "render/renderer.h"
+#include "render/scene.h"
+
+#include <cstdint>
+#include <string>
+
+/*
+ * checkpoint 保存线性的累加缓冲(包括AOV)和每个像素的样本数, 而不是量化后的图像,
+ * 所以继续渲染的结果与一次渲染完全等价。采样器没有跨样本的状态, 记下类型、种子和下一个样本序号就够了。
+ */
+struct checkpoint_info {
+	uint64_t scene_hash = 0;
+	int width = 0;
+	int height = 0;
+	sampler_type sampling = sampler_type::sobol;
+	uint32_t seed = 0;
+	// 所有像素都已完成的样本数, 继续渲染时从这个样本序号开始
+	int samples_done = 0;
+};
+
+// 场景名、分辨率、最大深度、背景、相机和几何体包围盒的哈希, 用于拒绝不属于当前场景的 checkpoint
+uint64_t scene_hash(const scene &s, int width, int height);
+
+// 原子地写入: 中途被杀掉时旧的 checkpoint 保持完整
+bool write_checkpoint(const std::string &path, const film &f, const checkpoint_info &info);
+
+// 失败时 error 给出原因
+bool read_checkpoint(const std::string &path, film &f, checkpoint_info &info, std::string &error);
+
+/*
+ * 分多遍渲染 info.samples_done .. target_spp 的样本, 每隔 interval 秒以及结束时写一次 checkpoint。
+ * 每一遍的样本数按上一遍的用时调整, 让一遍大约占 interval 的四分之一。
+ */
+bool render_with_checkpoints(const path_integrator &integrator, film &f, const render_settings &settings,
+							 checkpoint_info &info, int target_spp, const std::string &path, double interval);
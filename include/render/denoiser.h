@@ -0,0 +1,36 @@
+#pragma once
+
+#include "render/film.h"
+
+#include <vector>
+
+struct denoise_settings {
+	// à-trous 迭代次数, 第 k 次的步长为 2^k
+	int iterations = 5;
+	// 亮度的边缘停止系数, 以像素估计的标准差为单位
+	float sigma_luminance = 4.0f;
+	// 法线的边缘停止系数: 权重乘 exp(-sigma_normal * (1 - dot(n_p, n_q))), 与亮度、深度项一起放在指数里;
+	// 夹角为 10 度时 1 - cos 约为 0.015, 默认值下权重约为 0.38
+	float sigma_normal = 64.0f;
+	// 相对深度差
+	float sigma_depth = 0.05f;
+	int tile_size = 64;
+};
+
+/*
+ * 边缘保持的 à-trous 小波滤波(Dammertz 2010, 方差引导参考 SVGF)。
+ * 先用第一撞点的反照率做解调, 只对光照部分滤波, 最后再乘回反照率, 纹理细节因此不会被抹掉。
+ * 图像按 tile 分给 OpenMP 线程, 每个 tile 内按行做 SIMD。
+ */
+class atrous_denoiser {
+public:
+	atrous_denoiser() = default;
+
+	explicit atrous_denoiser(const denoise_settings &s) : settings(s) {}
+
+	// 输出每个像素的平均辐射度, 下标与 film 相同
+	void denoise(const film &f, std::vector<color> &output) const;
+
+public:
+	denoise_settings settings;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "render/film.h"
+#include "render/renderer.h"
+#include "render/scene.h"
+
+#include <string>
+
+struct distributed_settings {
+	// 见 socket_stream 的地址格式
+	std::string address;
+	// 一个任务是 job_tile_size x job_tile_size 的像素块和一段样本区间, job_samples 为 0 时一次渲染全部样本
+	int job_tile_size = 32;
+	int job_samples = 0;
+	// 每个 worker 同时持有的任务数, 大于1时传输和渲染可以重叠
+	int jobs_in_flight = 2;
+	// 在本机 fork 出的 worker 数, 它们用 threads 个线程渲染
+	int local_workers = 0;
+	int threads = 0;
+};
+
+/*
+ * 协调者: 监听 address, 把任务分给连接上来的 worker(随时可以加入), 结果累加到 f。
+ * worker 断开时它手上的任务重新排队。同一个像素块的各段样本总是按顺序累加, 加上每个像素样本单独播种,
+ * 输出与 worker 的数量和任务的分配方式无关。
+ * 全部完成后通知 worker 退出; 本机 worker 全部退出而任务没有完成时返回 false。
+ */
+bool run_coordinator(const scene &s, const render_settings &settings, const distributed_settings &ds, film &f);
+
+// worker: 连接协调者, 按收到的场景名和分辨率构建一次场景, 然后渲染任务直到收到退出消息。返回进程的退出码。
+int run_worker(const std::string &address, int threads);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/hittable_list.h"
+
+#include <vector>
+
+// 一个面光源: diffuse_light 材质的轴对齐矩形(可以被 flip_face 包着)或球
+struct emitter {
+	// 0 为矩形, 1 为球
+	int kind;
+	// 矩形: 平面内的范围、平面位置和轴(同 packed_bvh: 0 为 xy, 1 为 xz, 2 为 yz), sign 为发光一侧的法线方向
+	double a0, a1, b0, b1, k;
+	int axis;
+	double sign;
+	// 球
+	point3 center;
+	double radius;
+
+	const material *mat;
+	double area;
+	// 按功率选择光源的累积分布
+	double cdf;
+
+	// 用 (r1, r2) 在光源上均匀地取一点, n 为发光一侧的单位法线, (u, v) 为纹理坐标
+	void sample(double r1, double r2, point3 &p, vec3 &n, double &u, double &v) const;
+
+	// p 处朝 n 一侧发出的辐射度
+	color radiance(const point3 &p, const vec3 &n, double u, double v) const;
+};
+
+/*
+ * 场景中可以直接采样的光源, 按中心处辐射度乘面积的比例选择。
+ * 焦散缓存和双向路径追踪都从这里发射光线; 其它类型的发光体找不到, 由路径追踪照常计算。
+ */
+class emitter_list {
+public:
+	emitter_list() = default;
+
+	explicit emitter_list(const hittable_list &world);
+
+	bool empty() const { return items.empty(); }
+
+	size_t size() const { return items.size(); }
+
+	const emitter &operator[](size_t k) const { return items[k]; }
+
+	// 用 [0, 1) 内的 r 选择一个光源, pdf 为选中的概率
+	size_t pick(double r, double &pdf) const;
+
+	double pick_pdf(size_t k) const { return items[k].cdf - (k > 0 ? items[k - 1].cdf : 0.0); }
+
+	// 材质为 m 的撞点 p 所在的光源, 不在任何光源上时返回 -1
+	int find(const material *m, const point3 &p) const;
+
+	// 材质 m 属于某个光源
+	bool covers(const material *m) const;
+
+private:
+	void add(const shared_ptr<hittable> &object, bool flipped);
+
+	std::vector<emitter> items;
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "utility/atomic_float.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * 默认构造时不初始化元素的分配器。allocate() 之后由渲染线程各自清零自己的行,
+ * 页面因此分配在该线程所在的 NUMA 节点上(first touch), 而不是全部在主线程的节点上。
+ */
+template <typename T>
+struct first_touch_allocator : std::allocator<T> {
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+				  "only for plain pixel data");
+
+	template <typename U>
+	struct rebind {
+		using other = first_touch_allocator<U>;
+	};
+
+	first_touch_allocator() = default;
+
+	template <typename U>
+	first_touch_allocator(const first_touch_allocator<U> &) {}
+
+	template <typename U, typename... Args>
+	void construct(U *p, Args &&...args) {
+		::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+	}
+
+	template <typename U>
+	void construct(U *) {}
+};
+
+template <typename T>
+using film_buffer = std::vector<T, first_touch_allocator<T>>;
+
+// 第一个非镜面撞点处的辅助缓冲(AOV), 用于引导降噪
+struct first_hit_aov {
+	color albedo{1.0};
+	vec3 normal{0.0};
+	double depth = 0.0;
+};
+
+/*
+ * 线性辐射度的累加缓冲, 下标 j * width + i, j = 0 为图像最下面一行(与渲染循环一致)。
+ * 每个像素只由一个线程写入, 所以不需要加锁。
+ */
+class film {
+public:
+	film() = default;
+
+	film(int w, int h) { resize(w, h); }
+
+	void resize(int w, int h) {
+		width = w;
+		height = h;
+		const auto n = static_cast<size_t>(w) * h;
+		radiance.assign(n, color(0.0));
+		luminance_sq.assign(n, 0.0);
+		albedo.assign(n, color(0.0));
+		normal.assign(n, vec3(0.0));
+		depth.assign(n, 0.0);
+		samples.assign(n, 0);
+	}
+
+	// 只分配不清零, 之后必须对每一行调用 clear_rows
+	void allocate(int w, int h) {
+		width = w;
+		height = h;
+		const auto n = static_cast<size_t>(w) * h;
+		allocate_uninitialized(radiance, n);
+		allocate_uninitialized(luminance_sq, n);
+		allocate_uninitialized(albedo, n);
+		allocate_uninitialized(normal, n);
+		allocate_uninitialized(depth, n);
+		allocate_uninitialized(samples, n);
+	}
+
+	// 清零第 j0 .. j1 - 1 行
+	void clear_rows(int j0, int j1) {
+		const auto first = index(0, j0), last = index(0, j1);
+		std::fill(radiance.begin() + first, radiance.begin() + last, color(0.0));
+		std::fill(luminance_sq.begin() + first, luminance_sq.begin() + last, 0.0);
+		std::fill(albedo.begin() + first, albedo.begin() + last, color(0.0));
+		std::fill(normal.begin() + first, normal.begin() + last, vec3(0.0));
+		std::fill(depth.begin() + first, depth.begin() + last, 0.0);
+		std::fill(samples.begin() + first, samples.begin() + last, 0);
+	}
+
+	size_t index(int i, int j) const { return static_cast<size_t>(j) * width + i; }
+
+	// 累加一个像素的 sample_count 个样本
+	void add_samples(int i, int j, const color &radiance_sum, double luminance_sq_sum, const first_hit_aov &aov_sum,
+					 int sample_count) {
+		const auto idx = index(i, j);
+		radiance[idx] += radiance_sum;
+		luminance_sq[idx] += luminance_sq_sum;
+		albedo[idx] += aov_sum.albedo;
+		normal[idx] += aov_sum.normal;
+		depth[idx] += aov_sum.depth;
+		samples[idx] += sample_count;
+	}
+
+	color mean_radiance(int i, int j) const {
+		const auto idx = index(i, j);
+		return samples[idx] > 0 ? radiance[idx] / samples[idx] : color(0.0);
+	}
+
+	static double luminance(const color &c) {
+		return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+	}
+
+private:
+	template <typename T>
+	static void allocate_uninitialized(film_buffer<T> &v, size_t n) {
+		// 先释放旧的内存, 否则 resize 会沿用已经被别的线程写过的页面
+		film_buffer<T>().swap(v);
+		v.resize(n);
+	}
+
+public:
+	int width = 0;
+	int height = 0;
+
+	// 以下均为样本之和
+	film_buffer<color> radiance;
+	film_buffer<double> luminance_sq;
+	film_buffer<color> albedo;
+	film_buffer<vec3> normal;
+	film_buffer<double> depth;
+	film_buffer<int> samples;
+};
+
+/*
+ * 双向路径追踪中光路直接连到相机的贡献(splat)可以落在任何像素上, 几个线程会同时写同一个像素,
+ * 所以用 float 的原子加(CAS 循环)累加。一遍渲染结束后 resolve 把它加到 film 的 radiance 上:
+ * 每个像素样本对应一条光路, 所以 splat 之和与像素的样本之和除以同一个样本数。
+ */
+class splat_buffer {
+public:
+	void resize(int w, int h) {
+		width = w;
+		height = h;
+		values.reset(new std::atomic<float>[static_cast<size_t>(w) * h * 3]);
+		clear();
+	}
+
+	bool empty() const { return !values; }
+
+	void add(int i, int j, const color &c) {
+		const auto idx = (static_cast<size_t>(j) * width + i) * 3;
+		for (int k = 0; k < 3; ++k)
+			atomic_add(values[idx + k], static_cast<float>(c[k]));
+	}
+
+	// 加到 f 的 radiance 上并清零, 在没有线程写入时调用
+	void resolve(film &f) {
+		for (int j = 0; j < height; ++j) {
+			for (int i = 0; i < width; ++i) {
+				const auto idx = (static_cast<size_t>(j) * width + i) * 3;
+				f.radiance[f.index(i, j)] += color(values[idx].load(std::memory_order_relaxed),
+												   values[idx + 1].load(std::memory_order_relaxed),
+												   values[idx + 2].load(std::memory_order_relaxed));
+			}
+		}
+		clear();
+	}
+
+private:
+	void clear() {
+		const auto n = static_cast<size_t>(width) * height * 3;
+		for (size_t k = 0; k < n; ++k)
+			values[k].store(0.0f, std::memory_order_relaxed);
+	}
+
+	int width = 0;
+	int height = 0;
+	std::unique_ptr<std::atomic<float>[]> values;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "render/film.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 下标与 film 相同: j * width + i, j = 0 为图像最下面一行
+
+// 每个像素的平均辐射度, NaN 记为 0
+std::vector<color> mean_image(const film &f);
+
+// gamma 2 之后量化到 8 位的 P3
+void write_ppm(std::ostream &out, int width, int height, const std::vector<color> &pixels);
+
+/*
+ * PFM(Portable Float Map), 保存线性的参考图像。
+ * 文件里的行本来就是从下往上存放, 与 film 的行序一致。
+ */
+bool write_pfm(const std::string &path, int width, int height, const std::vector<color> &pixels);
+
+bool read_pfm(const std::string &path, int &width, int &height, std::vector<color> &pixels);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "render/film.h"
+
+#include <vector>
+
+// 图像误差, 两幅图像的尺寸和下标顺序必须相同, 像素为线性辐射度
+
+// 均方根误差, 三个通道一起平均
+double rmse(const std::vector<color> &test, const std::vector<color> &reference);
+
+// 相对均方误差 (t - r)^2 / (r^2 + 0.01), 暗处的噪声不会被亮处淹没
+double rel_mse(const std::vector<color> &test, const std::vector<color> &reference);
+
+/*
+ * 简化的 FLIP(Andersson et al. 2020, LDR 版本)。
+ * 按 write_color 的方式把辐射度转成显示值(gamma 2, 截断到[0, 1]), 模拟人眼在给定观看距离下的
+ * 对比敏感度滤波后比较颜色差, 再用边缘和点特征的差异加权。返回所有像素误差的平均值, 范围 [0, 1]。
+ */
+double flip_error(const std::vector<color> &test, const std::vector<color> &reference, int width, int height,
+				  double pixels_per_degree = 67.0);
+
+/*
+ * 不需要参考图像的噪声估计: 每个像素均值的标准差(由亮度的二阶矩估计)除以 (亮度 + 0.01), 再对所有像素平均。
+ * 样本数翻倍时大约下降到 1/sqrt(2), 用作渐进渲染的停止条件。
+ */
+double relative_noise(const film &f);
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "asset/material_table.h"
+#include "render/film.h"
+#include "render/path_guide.h"
+#include "render/photon_map.h"
+#include "render/radiance_cache.h"
+#include "render/scene.h"
+#include "sample/sampler.h"
+#include "thread/numa.h"
+
+#include <memory>
+#include <vector>
+
+// 积分方法: 从相机出发的路径追踪, 或双向路径追踪
+enum class integrator_kind {
+	path,
+	bdpt,
+};
+
+// 路径上一个顶点之前经过的表面, 用于把 LS+D 路径交给焦散缓存
+enum class path_origin {
+	camera,
+	// 上一个非镜面顶点是漫反射表面
+	diffuse,
+	// 漫反射之后又经过了镜面反射/折射
+	specular_after_diffuse,
+};
+
+// 路径到达当前顶点之前的状态
+struct path_state {
+	path_origin from = path_origin::camera;
+	// 已经经过的漫反射顶点数, 决定是否查辐射度缓存
+	int diffuse_bounces = 0;
+};
+
+// 一个像素若干个样本的和
+struct pixel_samples {
+	color radiance{0.0};
+	double luminance_sq = 0;
+	first_hit_aov aov{color(0.0), vec3(0.0), 0.0};
+	int count = 0;
+};
+
+/*
+ * 路径追踪积分器: BSDF 采样和光源采样按 mixture_pdf 混合。
+ * 只读地引用场景, 可以被多个线程同时使用。材质在构造时编进 material_table, 着色不经过虚函数。
+ *
+ * set_kind(integrator_kind::bdpt) 换成双向路径追踪(src/render/bdpt.cpp): 每个像素样本分别从相机和光源
+ * 走一条子路径, 连接所有顶点对并按 balance heuristic 加权。光路直接连到相机的贡献落在别的像素上,
+ * 先原子地累加到 splat 缓冲, 一遍结束时由 finish_pass 加进 film。
+ */
+class path_integrator {
+public:
+	path_integrator(const scene &s, int width, int height) : world(s), image_width(width), image_height(height) {
+		materials.compile(s.world);
+	}
+
+	// aov 不为空时记录第一个非镜面撞点的反照率、法线和深度, 镜面反射/折射会沿着路径继续找
+	// diff 只有相机光线才有, 用于选择纹理的MIP层, 次级光线使用最精细的一层
+	// state.from 为焦散缓存打开时路径的来历, 缓存负责的 "漫反射 -> 镜面 -> 光源" 不再计入
+	color ray_color(const ray &r, int depth, sampler &smp, first_hit_aov *aov = nullptr,
+					const ray_differential *diff = nullptr, path_state state = {}) const;
+
+	// 像素(i, j)的第 first_sample .. first_sample + count - 1 个样本
+	pixel_samples sample_pixel(int i, int j, int first_sample, int count, sampler &smp) const;
+
+	// 同上, 结果累加到 f
+	void render_pixel(int i, int j, int first_sample, int count, sampler &smp, film &f) const {
+		const auto p = sample_pixel(i, j, first_sample, count, smp);
+		f.add_samples(i, j, p.radiance, p.luminance_sq, p.aov, p.count);
+	}
+
+	const scene &scene_ref() const { return world; }
+
+	// 打开焦散缓存, 为空时关闭
+	void set_caustics(shared_ptr<caustic_cache> cache) { caustics = std::move(cache); }
+
+	// 打开辐射度缓存(只用于路径追踪), 为空时关闭
+	void set_radiance_cache(shared_ptr<radiance_cache> cache) { radiance = std::move(cache); }
+
+	// 打开路径引导(只用于路径追踪), 为空时关闭; 训练由 train_path_guide 完成
+	void set_guide(shared_ptr<path_guide> g) { guide = std::move(g); }
+
+	// 每一遍渲染之前调用: 焦散缓存再发射一批光子; 从第 0 个样本开始(新的一帧)时清空两个缓存
+	void prepare_pass(int first_sample) const {
+		if (caustics)
+			caustics->next_pass(first_sample == 0);
+		if (radiance && first_sample == 0)
+			radiance->clear();
+	}
+
+	// 选择积分方法; 场景中没有可以采样的光源时双向路径追踪退回到路径追踪, 返回 false
+	bool set_kind(integrator_kind k);
+
+	integrator_kind kind() const { return method; }
+
+	// 每一遍渲染之后调用, 把这一遍的 splat 加进 f
+	void finish_pass(film &f) const {
+		if (method == integrator_kind::bdpt)
+			splats.resolve(f);
+	}
+
+	// 给 threads 个线程用到的每个 NUMA 节点复制一份顶层 BVH, 由绑定在该节点上的线程复制。
+	// 只复制 bvh_node, 图元、材质和每帧更新的 dynamic_bvh 仍然共享; 只有一个节点时什么也不做
+	void replicate_geometry(const numa_topology &topo, int threads);
+
+	// 调用线程所在节点的几何体副本, 没有副本时就是场景本身
+	const hittable_list &geometry() const {
+		const int node = current_numa_node();
+		return node >= 0 && node < static_cast<int>(replicas.size()) ? replicas[node] : world.world;
+	}
+
+private:
+	// 双向路径追踪的一个像素样本, r 为相机光线
+	color bdpt_color(const ray &r, first_hit_aov *aov) const;
+
+	const scene &world;
+	material_table materials;
+	shared_ptr<caustic_cache> caustics;
+	shared_ptr<radiance_cache> radiance;
+	shared_ptr<path_guide> guide;
+	integrator_kind method = integrator_kind::path;
+	emitter_list emitters;
+	mutable splat_buffer splats;
+	std::vector<hittable_list> replicas;
+	int image_width;
+	int image_height;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/hittable_list.h"
+#include "geometry/pdf.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * 方向上的四叉树: 把方向按 (cos theta, phi) 等面积地映射到单位正方形, 每个节点存四个象限的能量,
+ * 按能量的比例向下选择象限。采样用的树是只读的。
+ */
+struct direction_tree {
+	struct node {
+		float sum[4];
+		// 0 表示这个象限是叶子
+		uint32_t child[4];
+	};
+
+	// nodes[0] 为根; 只有根且能量为 0 时是均匀分布
+	std::vector<node> nodes;
+
+	direction_tree() : nodes(1, node{{0, 0, 0, 0}, {0, 0, 0, 0}}) {}
+
+	// 立体角上的 pdf
+	double pdf(const vec3 &dir) const;
+
+	// 用 [0, 1)^2 的样本生成一个单位方向
+	vec3 sample(double r1, double r2) const;
+};
+
+// 训练中的四叉树, 拓扑在一轮中固定, 能量由各线程原子地累加
+struct direction_tree_builder {
+	std::vector<std::array<uint32_t, 4>> child;
+	std::unique_ptr<std::atomic<float>[]> sum;
+
+	// 按 tree 的能量分布生成新的拓扑: 占总能量超过 rho 的象限再分成四个, 最多 max_depth 层; 能量清零
+	void refine_from(const direction_tree &tree, double rho, int max_depth);
+
+	void record(double u, double v, float value);
+
+	// 当前的能量冻结成采样用的树
+	direction_tree freeze() const;
+};
+
+/*
+ * 在线的路径引导(Müller 等人的 Practical Path Guiding): 场景的包围盒按 kd 树在空间上细分,
+ * 每个叶子有一棵方向四叉树(SD 树)。训练时漫反射顶点把 亮度(Li) / pdf 记到它所在叶子的训练树上;
+ * 每一轮结束后, 样本多的空间叶子一分为二, 训练树冻结成采样树, 并按能量细化出下一轮的拓扑。
+ * 渲染时采样树的分布作为 mixture_pdf 的一个分量, 与光源和 BSDF 的混合各占一半。
+ */
+class path_guide {
+public:
+	struct settings {
+		// 空间叶子在一轮中超过 spatial_threshold * sqrt(2^轮数) 个样本时一分为二
+		double spatial_threshold = 2000;
+		// 方向四叉树的细分阈值和最大深度
+		double rho = 0.01;
+		int max_direction_depth = 20;
+		int max_spatial_depth = 24;
+	};
+
+	path_guide(const hittable_list &world, const settings &s);
+
+	// 训练时 record 生效
+	void set_training(bool on) { learning = on; }
+
+	bool training() const { return learning; }
+
+	// 至少完成一轮训练, 可以用来采样
+	bool ready() const { return iterations > 0; }
+
+	// 结束一轮训练: 细分空间, 冻结并细化方向树。不能与 record 同时调用
+	void end_iteration();
+
+	// 在 p 处沿 dir 射出的光线带回的亮度除以采样它的 pdf
+	void record(const point3 &p, const vec3 &dir, double value);
+
+	// p 所在叶子的采样分布
+	const direction_tree &distribution(const point3 &p) const;
+
+	size_t spatial_leaves() const { return leaves.size(); }
+
+	size_t direction_nodes() const;
+
+	int iteration() const { return iterations; }
+
+private:
+	struct spatial_node {
+		// 叶子时为 -1
+		int axis;
+		int depth;
+		uint32_t child[2];
+		uint32_t leaf;
+	};
+
+	struct leaf_data {
+		direction_tree sampling;
+		direction_tree_builder building;
+		std::atomic<uint32_t> samples{0};
+	};
+
+	uint32_t find_leaf(const point3 &p) const;
+
+	// 把叶子节点 n 一分为二, 直到估计的样本数不超过 threshold
+	void split(uint32_t n, double samples, double threshold);
+
+	settings options;
+	point3 lo, hi;
+	std::vector<spatial_node> nodes;
+	std::vector<std::unique_ptr<leaf_data>> leaves;
+	int iterations = 0;
+	bool learning = false;
+};
+
+// 按一棵方向树采样的 pdf
+class guide_pdf : public pdf {
+public:
+	explicit guide_pdf(const direction_tree &t) : tree(t) {}
+
+	double value(const vec3 &direction) const override { return tree.pdf(unit_vector(direction)); }
+
+	vec3 generate() const override { return tree.sample(random_double(), random_double()); }
+
+	vec3 generate(sampler &smp) const override {
+		auto [r1, r2] = smp.get_2d();
+		return tree.sample(r1, r2);
+	}
+
+private:
+	const direction_tree &tree;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/hittable.h"
+#include "render/emitters.h"
+#include "render/scene.h"
+
+#include <cstdint>
+#include <vector>
+
+// 存在表面上的一个光子, 用 float 存放, 52 字节
+struct photon {
+	float position[3];
+	// 光子前进的方向(单位向量)
+	float direction[3];
+	// 撞点的法线(朝向光子射来的一侧)
+	float normal[3];
+	float power[3];
+	// kd 树中这个节点的划分轴
+	uint8_t axis;
+};
+
+/*
+ * 平衡的 kd 树, 隐式地存放在数组里: 区间 [begin, end) 的根是中间的元素, 左右子树是两边的区间。
+ * 按包围盒最长的轴取中位数划分, 没有指针, 查询时按区间下标遍历。
+ */
+class photon_map {
+public:
+	void clear() { photons.clear(); }
+
+	void add(const std::vector<photon> &more) { photons.insert(photons.end(), more.begin(), more.end()); }
+
+	// 加入光子之后重新排列成 kd 树
+	void build();
+
+	size_t size() const { return photons.size(); }
+
+	size_t bytes() const { return photons.capacity() * sizeof(photon); }
+
+	// 半径 radius 内、法线与 n 相近的光子的 weight(入射方向) * power 之和; 入射方向指向光子射来的方向
+	template <typename F>
+	color gather(const point3 &p, const vec3 &n, double radius, F &&weight) const;
+
+private:
+	void build(size_t begin, size_t end);
+
+	std::vector<photon> photons;
+};
+
+template <typename F>
+color photon_map::gather(const point3 &p, const vec3 &n, double radius, F &&weight) const {
+	color sum(0);
+	const double r2 = radius * radius;
+	const double q[3] = {p.x(), p.y(), p.z()};
+
+	// 平衡树的深度约为 log2(n), 每层最多压入一个远端区间
+	struct range {
+		size_t begin, end;
+	};
+	range stack[128];
+	int top = 0;
+	stack[top++] = {0, photons.size()};
+	while (top > 0) {
+		const range r = stack[--top];
+		if (r.begin >= r.end)
+			continue;
+		const size_t mid = r.begin + (r.end - r.begin) / 2;
+		const photon &ph = photons[mid];
+
+		const double dx = q[0] - ph.position[0], dy = q[1] - ph.position[1], dz = q[2] - ph.position[2];
+		// 只取同一个朝向的表面上的光子, 避免墙角处漏到相邻的面上
+		if (dx * dx + dy * dy + dz * dz <= r2 &&
+			n.x() * ph.normal[0] + n.y() * ph.normal[1] + n.z() * ph.normal[2] > 0.9) {
+			const double w = weight(vec3(-ph.direction[0], -ph.direction[1], -ph.direction[2]));
+			sum += w * color(ph.power[0], ph.power[1], ph.power[2]);
+		}
+
+		const double d = q[ph.axis] - ph.position[ph.axis];
+		const range left{r.begin, mid}, right{mid + 1, r.end};
+		if (d * d <= r2)
+			stack[top++] = d < 0 ? right : left;
+		stack[top++] = d < 0 ? left : right;
+	}
+	return sum;
+}
+
+/*
+ * 焦散缓存: 从面光源发射光子, 只保存经过至少一次镜面反射/折射后落在漫反射表面上的光子(LS+D 路径),
+ * 渲染时在漫反射撞点上做密度估计。路径追踪中"漫反射 -> 镜面 -> 光源"的路径由缓存负责, 不再计入,
+ * 所以这些原来只能靠随机碰到光源的路径不再需要几百个样本。
+ *
+ * 每一遍渲染前再发射一批光子并入缓存, 半径按 r_{i+1}^2 = r_i^2 (i + alpha) / (i + 1) 缩小
+ * (Knaus & Zwicker 的渐进光子映射), 遍数越多偏差越小。一遍从第 0 个样本开始时清空缓存(新的一帧)。
+ * 只认识 diffuse_light 材质的矩形(可以被 flip_face 包着)和球, 其它光源照常由路径追踪计算。
+ */
+class caustic_cache {
+public:
+	// radius 为 0 时取场景包围盒对角线的 0.2%
+	caustic_cache(const scene &s, size_t photons_per_pass, double radius);
+
+	bool has_emitters() const { return !emitters.empty(); }
+
+	// 每一遍渲染之前调用, 使用当前的 OpenMP 线程数
+	void next_pass(bool restart);
+
+	// 已经发射过光子
+	bool active() const { return passes > 0; }
+
+	// 这个材质的光源由缓存负责
+	bool covers(const material *m) const { return emitters.covers(m); }
+
+	double radius() const { return current_radius; }
+
+	// 光子的功率之和乘以它得到辐射度
+	double density_scale() const { return 1.0 / (PI * current_radius * current_radius * static_cast<double>(emitted)); }
+
+	const photon_map &photons() const { return map; }
+
+private:
+	// 第 index 个光子, 落在漫反射表面上时加入 out
+	void trace_photon(uint64_t index, std::vector<photon> &out) const;
+
+	const scene &world;
+	emitter_list emitters;
+	size_t photons_per_pass;
+	double initial_radius;
+	double current_radius;
+
+	photon_map map;
+	int passes = 0;
+	uint64_t emitted = 0;
+};
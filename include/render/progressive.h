@@ -0,0 +1,45 @@
+#pragma once
+
+#include "render/checkpoint.h"
+#include "render/film.h"
+#include "render/integrator.h"
+#include "render/renderer.h"
+
+#include <chrono>
+#include <string>
+
+struct progressive_settings {
+	int target_spp = 0;
+	// 秒, 0 表示不限
+	double time_limit = 0;
+	// relative_noise 低于这个值时停止, 0 表示不用
+	double noise_threshold = 0;
+
+	// 预览图像, 每次都是原子地整体替换
+	std::string preview_path;
+	// 满足其一就写预览: 距上一次超过 preview_interval 秒, 或者又完成了 preview_passes 遍
+	double preview_interval = 2.0;
+	int preview_passes = 0;
+
+	// 不为空时同时定期写 checkpoint
+	std::string checkpoint_path;
+	double checkpoint_interval = 60.0;
+};
+
+struct progressive_result {
+	int samples = 0;
+	int passes = 0;
+	double noise = 0;
+	// 从 start 到第一张预览写完
+	double first_image_seconds = 0;
+	const char *stop_reason = "";
+};
+
+/*
+ * 渐进渲染: 第一遍每像素1个样本, 之后每一遍把总样本数翻倍, 直到达到 target_spp、用完时间或者噪声足够低。
+ * 第一遍结束就写出预览, 所以很快就能看到构图是否正确。时间从 start 开始计算(通常包括场景构建)。
+ * 从 info.samples_done 继续, 返回时 info.samples_done 为完成的样本数。
+ */
+progressive_result render_progressive(const path_integrator &integrator, film &f, const render_settings &settings,
+									  checkpoint_info &info, const progressive_settings &ps,
+									  std::chrono::steady_clock::time_point start);
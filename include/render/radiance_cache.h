@@ -0,0 +1,70 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/hittable_list.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/*
+ * 世界空间的辐射度缓存: 按位置(边长 cell_size 的立方体)和法线方向(八面体映射上 5x5 格)散列到一张固定大小的表,
+ * 每格累加漫反射顶点上的入射辐射度估计 sum(scattering_pdf * Li / pdf), 乘以反照率就是出射的间接光。
+ * 路径在第 bounce 次漫反射之后的顶点上查表, 样本数够了就直接结束, 不够时照常追踪并把结果加进去。
+ *
+ * 各线程无锁地更新: 空格用 CAS 占用(线性探测), 和用 float 的原子加, 读取时不加锁(和与样本数可能差一个样本)。
+ * 偏差来自格子的大小和冻结的估计, 由 cell_size、min_samples 和 update_rate 控制, 都趋于 0 时与路径追踪相同。
+ */
+class radiance_cache {
+public:
+	struct settings {
+		// 0 时取场景包围盒对角线的 1%
+		double cell_size = 0;
+		// 一格至少有这么多样本才使用
+		int min_samples = 16;
+		// 在经过这么多次漫反射之后的顶点上查表(1 为第二个漫反射顶点)
+		int bounce = 1;
+		// 即使格子可用, 也按这个概率照常追踪并更新, 估计因此不会停在最初的几个样本上
+		double update_rate = 0.1;
+		// 表的大小, 取 2 的幂
+		size_t cells = size_t(1) << 20;
+	};
+
+	radiance_cache(const hittable_list &world, const settings &s);
+
+	// 清空所有格子, 在一帧开始时调用(没有线程在渲染)
+	void clear();
+
+	// 格子的估计, 样本数不够时返回 false
+	bool lookup(const point3 &p, const vec3 &n, color &value) const;
+
+	// 加入一个样本, 表满时丢弃
+	void add(const point3 &p, const vec3 &n, const color &value);
+
+	const settings &config() const { return options; }
+
+	// 离上一个顶点太近的撞点(墙角、接触阴影)不查表: 格子会把它混进远处的光照里
+	bool too_close(double distance) const { return distance < 2.0 * options.cell_size; }
+
+	size_t used() const;
+
+	size_t bytes() const { return (mask + 1) * sizeof(cell); }
+
+private:
+	struct cell {
+		// 0 为空格
+		std::atomic<uint64_t> key;
+		std::atomic<float> sum[3];
+		std::atomic<uint32_t> count;
+	};
+
+	uint64_t key(const point3 &p, const vec3 &n) const;
+
+	// 找到 key 的格子, insert 时占用一个空格; 找不到时返回 nullptr
+	cell *find(uint64_t k, bool insert) const;
+
+	settings options;
+	double inv_cell_size;
+	size_t mask;
+	std::unique_ptr<cell[]> cells;
+};
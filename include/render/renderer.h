@@ -0,0 +1,47 @@
+#pragma once
+
+#include "render/film.h"
+#include "render/integrator.h"
+#include "sample/sampler.h"
+
+struct render_settings {
+	int width = 0;
+	int height = 0;
+	// 0 表示使用 OpenMP 的默认线程数
+	int threads = 0;
+	int tile_size = 16;
+
+	sampler_type sampling = sampler_type::sobol;
+	uint32_t seed = 0;
+
+	// 在 stderr 上显示剩余的 tile 数
+	bool progress = true;
+
+	// 线程按 NUMA 节点绑定到CPU, 图像按 tile 行分成每个节点一条, 节点的线程先渲染自己的条带再帮其它节点;
+	// 配合 allocate_film 和 path_integrator::replicate_geometry 使用
+	bool numa = false;
+
+	int tiles_x() const { return (width + tile_size - 1) / tile_size; }
+	int tiles_y() const { return (height + tile_size - 1) / tile_size; }
+};
+
+/*
+ * 渲染一遍: 每个像素追加第 first_sample .. first_sample + sample_count - 1 个样本到 f。
+ * 按 tile 动态分配给线程, 代价高的区域不会拖慢整行; 样本序号连续, 所以分几遍渲染和一遍渲染的结果相同。
+ * 返回这一遍的用时(秒)。
+ */
+double render_pass(const path_integrator &integrator, film &f, const render_settings &settings, int first_sample,
+				   int sample_count);
+
+// 渲染使用的线程数
+int render_threads(const render_settings &settings);
+
+// 分配并清零 film; NUMA 模式下每个条带由渲染它的节点上的线程清零, 页面因此在该节点上
+void allocate_film(film &f, const render_settings &settings);
+
+/*
+ * 训练路径引导: 在一张丢弃的 film 上渲染 1, 2, 4, ... spp 的若干轮, 每轮结束时细分并冻结 SD 树,
+ * 总共不超过 budget 个样本。integrator 必须已经通过 set_guide 使用 guide。返回用时(秒)。
+ */
+double train_path_guide(const path_integrator &integrator, path_guide &guide, const render_settings &settings,
+						int budget);
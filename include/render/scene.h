@@ -0,0 +1,51 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "asset/camera.h"
+#include "geometry/bvh.h"
+#include "geometry/hittable_list.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// 一个可渲染的场景: 几何体、用于重要性采样的光源、相机和默认的渲染参数
+struct scene {
+	std::string name;
+
+	hittable_list world;
+	// 光源列表, 只用于 pdf, 不参与求交
+	shared_ptr<hittable> lights;
+	camera cam;
+	color background{0.0};
+
+	double aspect_ratio = 1.0;
+	int image_width = 400;
+	int samples_per_pixel = 100;
+	int max_depth = 50;
+
+	int image_height() const { return static_cast<int>(image_width / aspect_ratio); }
+
+	// 动画: 把图元、变换和相机移动到快门区间 [time0, time1], 为空时场景是静止的
+	std::function<void(scene &, double time0, double time1)> animate;
+	// animate 会移动其中图元的 BVH, 每帧重新拟合
+	std::vector<shared_ptr<dynamic_bvh>> dynamic_bvhs;
+	double frame_rate = 24.0;
+	// 快门开启的时间占一帧的比例(180 度快门)
+	double shutter = 0.5;
+};
+
+// 一帧的场景更新
+struct scene_update {
+	int refits = 0;
+	int rebuilds = 0;
+	double seconds = 0;
+};
+
+// 运行 animate 并更新 dynamic_bvhs, 场景、纹理和其余的加速结构保留到下一帧
+scene_update update_scene(scene &s, int frame);
+
+// 按名字构建内置场景, 名字未知时返回 false
+bool make_scene(const std::string &name, scene &out);
+
+std::vector<std::string> scene_names();
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * 渲染统计: 每个线程各有一份计数器, 结束时合并。
+ * 只有定义了 RT_ENABLE_STATS(CMake 选项)时 RT_STATS(...) 里的语句才会编译进去,
+ * 默认构建中不产生任何开销。
+ */
+#ifdef RT_ENABLE_STATS
+#define RT_STATS(...) __VA_ARGS__
+#else
+#define RT_STATS(...)
+#endif
+
+enum class ray_kind {
+	camera,
+	secondary,
+	// 计算光源 pdf 时射向光源的光线, 相当于阴影光线
+	light_probe,
+	count
+};
+
+enum class shape_kind {
+	sphere,
+	moving_sphere,
+	xy_rect,
+	xz_rect,
+	yz_rect,
+	box,
+	constant_medium,
+	count
+};
+
+const char *ray_kind_name(ray_kind kind);
+
+const char *shape_kind_name(shape_kind kind);
+
+// 单个线程的计数器, 按缓存行对齐, 不同线程的计数器不会落在同一缓存行里
+struct alignas(64) thread_stats {
+	static const int max_path_length = 64;
+
+	uint64_t rays[static_cast<int>(ray_kind::count)] = {};
+	uint64_t bvh_nodes_visited = 0;
+	uint64_t primitive_tests[static_cast<int>(shape_kind::count)] = {};
+	uint64_t primitive_hits[static_cast<int>(shape_kind::count)] = {};
+	// 下标为路径的段数, 最后一格包含更长的路径
+	uint64_t path_length[max_path_length + 1] = {};
+
+	void count_ray(ray_kind kind) { ++rays[static_cast<int>(kind)]; }
+
+	void count_test(shape_kind kind) { ++primitive_tests[static_cast<int>(kind)]; }
+
+	void count_hit(shape_kind kind) { ++primitive_hits[static_cast<int>(kind)]; }
+
+	void count_path(int segments) { ++path_length[segments < max_path_length ? segments : max_path_length]; }
+
+	// 用于像素代价热图: 遍历的节点数加上求交次数
+	uint64_t work() const;
+
+	void merge(const thread_stats &other);
+};
+
+class render_stats {
+public:
+	static render_stats &instance();
+
+	// 当前线程的计数器, 第一次调用时注册
+	static thread_stats &local();
+
+	// 图像尺寸和 tile 数, 开始渲染前调用
+	void reset(int width, int height, int tile_count);
+
+	// 分多遍渲染时每一遍的代价和用时累加起来
+	void add_pixel_cost(int i, int j, float cost) { pixel_cost[static_cast<size_t>(j) * width + i] += cost; }
+
+	void add_tile_time(int tile, int x0, int y0, double seconds);
+
+	thread_stats merged() const;
+
+	void print(std::ostream &out, double render_seconds) const;
+
+	// 以第99百分位归一化, 用 黑-蓝-红-黄-白 的色带写成 PPM
+	bool write_heatmap(const std::string &path) const;
+
+private:
+	render_stats() = default;
+
+	struct tile_time {
+		int x0 = 0, y0 = 0;
+		double seconds = 0;
+	};
+
+	int width = 0, height = 0;
+	std::vector<float> pixel_cost;
+	std::vector<tile_time> tile_times;
+};
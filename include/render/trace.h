@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+ * Chrome trace 时间线: 作用域对象 trace_zone 在析构时把一个完整事件写进当前线程的环形缓冲,
+ * 结束时合并成 trace-event JSON, 可以用 chrome://tracing 或 Perfetto 打开。
+ *
+ * CMake 选项 RT_ENABLE_TRACE 关闭时 RT_TRACE_ZONE 展开为空; 打开但运行时没有 --trace 时
+ * 每个区间只多一次分支判断。
+ */
+#ifdef RT_ENABLE_TRACE
+#define RT_TRACE_CONCAT_INNER(a, b) a##b
+#define RT_TRACE_CONCAT(a, b) RT_TRACE_CONCAT_INNER(a, b)
+#define RT_TRACE_ZONE(...) trace_zone RT_TRACE_CONCAT(trace_zone_, __LINE__)(__VA_ARGS__)
+#define RT_TRACE_THREAD_NAME(name) trace_recorder::set_thread_name(name)
+#else
+#define RT_TRACE_ZONE(...)
+#define RT_TRACE_THREAD_NAME(name)
+#endif
+
+class trace_recorder {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// 每个线程的环形缓冲能保存的事件数, 写满后覆盖最旧的事件
+	static const size_t events_per_thread = size_t(1) << 16;
+
+	static trace_recorder &instance();
+
+	void start();
+
+	bool enabled() const { return recording; }
+
+	// 写出所有线程的事件, 返回是否成功
+	bool write(const std::string &path) const;
+
+	// 在时间线上显示的线程名
+	static void set_thread_name(const std::string &name);
+
+	// name 必须是字符串字面量或者生命周期覆盖整个程序的字符串
+	void record(const char *name, int64_t id, clock::time_point begin, clock::time_point end);
+
+private:
+	trace_recorder() = default;
+
+	bool recording = false;
+	clock::time_point epoch;
+};
+
+class trace_zone {
+public:
+	// id >= 0 时作为事件参数输出, 例如 tile 编号
+	explicit trace_zone(const char *zone_name, int64_t zone_id = -1) {
+		if (trace_recorder::instance().enabled()) {
+			name = zone_name;
+			id = zone_id;
+			begin = trace_recorder::clock::now();
+		}
+	}
+
+	~trace_zone() {
+		if (name)
+			trace_recorder::instance().record(name, id, begin, trace_recorder::clock::now());
+	}
+
+	trace_zone(const trace_zone &) = delete;
+
+	trace_zone &operator=(const trace_zone &) = delete;
+
+private:
+	const char *name = nullptr;
+	int64_t id = -1;
+	trace_recorder::clock::time_point begin;
+};
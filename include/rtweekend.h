@@ -1,58 +1,100 @@
-#pragma once
-
-#include <cmath>
-#include <limits>
-#include <memory>
-#include <random>
-#include <cstdlib>
-
-// Usings
-
-using std::shared_ptr;
-using std::make_shared;
-using std::sqrt;
-
-// Constants
-
-const double infinity = std::numeric_limits<double>::infinity();
-
-#define PI        3.14159265358979323846
-#define TWO_PI    6.28318530717958647692
-#define INV_PI    0.31830988618379067154
-#define INV_2PI   0.15915494309189533577
-
-// Utility Functions
-
-inline double degrees_to_radians(double degrees) {
-    return degrees * PI / 180.0;
-}
-
-inline double random_double() {
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
-}
-
-inline std::pair<double, double> random_point2d() {
-    return std::make_pair(random_double(), random_double());
-}
-
-// return a random value in the interval between min value and max value
-inline double random_double(double min, double max) {
-    return min + (max - min) * random_double();
-}
-
-inline double clamp(double x, double min, double max) {
-    if (x < min) return min;
-    if (x > max) return max;
-    return x;
-}
-
-inline int random_int(int min, int max) {
-    return static_cast<int>(random_double(min, max + 1));
-}
-
-// Common Headers
-#include "geometry/ray.h"
-#include "math/vec3.h"
-
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <cstdlib>
+
+// Usings
+
+using std::shared_ptr;
+using std::make_shared;
+using std::sqrt;
+
+// Constants
+
+const double infinity = std::numeric_limits<double>::infinity();
+
+#define PI        3.14159265358979323846
+#define TWO_PI    6.28318530717958647692
+#define INV_PI    0.31830988618379067154
+#define INV_2PI   0.15915494309189533577
+
+// Utility Functions
+
+inline double degrees_to_radians(double degrees) {
+    return degrees * PI / 180.0;
+}
+
+// PCG32: 状态只有两个64位整数, 重新播种的代价很低
+class pcg32 {
+public:
+    pcg32() { seed(0); }
+
+    explicit pcg32(uint64_t init_state, uint64_t init_seq = 1) { seed(init_state, init_seq); }
+
+    void seed(uint64_t init_state, uint64_t init_seq = 1) {
+        state = 0u;
+        inc = (init_seq << 1u) | 1u;
+        next_uint();
+        state += init_state;
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t old_state = state;
+        state = old_state * 6364136223846793005ULL + inc;
+        auto xorshifted = static_cast<uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+        auto rot = static_cast<uint32_t>(old_state >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+    }
+
+    // [0, 1)
+    double next_double() {
+        return next_uint() * 0x1p-32;
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+// 每个线程独立的随机数生成器, 多线程渲染时不会争用同一个状态
+inline pcg32 &random_generator() {
+    thread_local pcg32 generator;
+    return generator;
+}
+
+inline void seed_random(uint64_t state, uint64_t sequence) {
+    random_generator().seed(state, sequence);
+}
+
+inline double random_double() {
+    return random_generator().next_double();
+}
+
+inline std::pair<double, double> random_point2d() {
+    return std::make_pair(random_double(), random_double());
+}
+
+// return a random value in the interval between min value and max value
+inline double random_double(double min, double max) {
+    return min + (max - min) * random_double();
+}
+
+inline double clamp(double x, double min, double max) {
+    if (x < min) return min;
+    if (x > max) return max;
+    return x;
+}
+
+inline int random_int(int min, int max) {
+    return static_cast<int>(random_double(min, max + 1));
+}
+
+// Common Headers
+#include "geometry/ray.h"
+#include "math/vec3.h"
+
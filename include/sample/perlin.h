@@ -1,34 +1,35 @@
-#pragma once
-
-#include "rtweekend.h"
-
-class perlin {
-public:
-    perlin();
-
-    // 获得噪声
-    double noise(const point3 &p) const;
-    // Turbulence(a composite noise that has multiple summed frequencies is used)
-    double turb(const point3& p, int depth = 7) const;
-
-    ~perlin();
-
-private:
-    static const int point_count = 256;
-//    double *ranfloat;
-    vec3* ranvec;
-    int *perm_x;
-    int *perm_y;
-    int *perm_z;
-
-    // get random sequence
-    static int *perlin_generate_perm();
-
-    // Perlin with trilienear interpolation
-    static double trilinear_interp(double c[2][2][2], double u, double v, double w);
-
-    static double perlin_interp(vec3 c[2][2][2], double u, double v, double w);
-
-    // 洗牌算法
-    static void permute(int *p, int n);
-};
+#pragma once
+
+#include "rtweekend.h"
+
+#include <cstddef>
+#include <cstdint>
+
+class perlin {
+public:
+    perlin();
+
+    // 获得噪声
+    double noise(const point3 &p) const;
+    // Turbulence(a composite noise that has multiple summed frequencies is used)
+    double turb(const point3& p, int depth = 7) const;
+
+    // 批量计算 n 个点, 循环按点向量化
+    void noise(const point3 *p, double *out, size_t n) const;
+    void turb(const point3 *p, double *out, size_t n, int depth = 7) const;
+
+private:
+    static const int point_count = 256;
+
+    // 三个排列和梯度打包在一张约4KB的表里, 常驻L1
+    struct alignas(64) lattice {
+        // 梯度补齐到4个float, 一次取一个16字节
+        float gradient[point_count][4];
+        uint8_t perm[3][point_count];
+    };
+
+    lattice table;
+
+    // 洗牌算法
+    static void permute(uint8_t *p, int n);
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <cstdint>
+#include <utility>
+
+// 32位整数哈希, 用于生成像素/维度相关的扰乱种子
+inline uint32_t mix_bits(uint32_t v) {
+	v ^= v >> 16;
+	v *= 0x7feb352du;
+	v ^= v >> 15;
+	v *= 0x846ca68bu;
+	v ^= v >> 16;
+	return v;
+}
+
+inline uint32_t hash_combine(uint32_t seed, uint32_t v) {
+	return mix_bits(seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+enum class sampler_type {
+	independent,
+	halton,
+	sobol
+};
+
+/*
+ * 采样器: 为一个像素样本的每个维度依次提供1D/2D样本。
+ * 一条路径按固定顺序消耗维度(像素抖动 -> 镜头 -> 时间 -> 每次弹射的BSDF/光源样本),
+ * 维度用完之后继续填充(padding), 每一对维度使用独立扰乱的低差异序列, 所以深层弹射不会越界。
+ */
+class sampler {
+public:
+	explicit sampler(uint32_t s = 0) : seed(s) {}
+
+	virtual ~sampler() {}
+
+	// 开始像素(i, j)的第 sample_index 个样本
+	virtual void start_pixel_sample(int i, int j, int sample_index) {
+		pixel_seed = hash_combine(hash_combine(seed, static_cast<uint32_t>(i)), static_cast<uint32_t>(j));
+		index = static_cast<uint32_t>(sample_index);
+		dimension = 0;
+		// random_double() 也按像素样本重新播种(与 independent_sampler 使用不同的序列),
+		// 所以图像与线程数、tile 的分配方式以及由哪个进程渲染都无关
+		seed_random(pixel_seed, (uint64_t(1) << 32) | index);
+	}
+
+	// 每次弹射从固定的维度开始取样, 不同分支消耗的维度数不同也不会让后续弹射错位
+	void start_bounce(int bounce) {
+		dimension = camera_dimensions + static_cast<uint32_t>(bounce) * bounce_dimensions;
+	}
+
+	virtual double get_1d() = 0;
+
+	virtual std::pair<double, double> get_2d() = 0;
+
+	// 像素抖动(2D) + 镜头(2D) + 快门时间(1D)
+	static const uint32_t camera_dimensions = 5;
+	// 混合pdf的选择(1D) + 光源的选择(1D) + 方向(2D)
+	static const uint32_t bounce_dimensions = 4;
+
+	// 每个线程持有自己的副本
+	virtual shared_ptr<sampler> clone() const = 0;
+
+protected:
+	uint32_t seed;
+	uint32_t pixel_seed = 0;
+	uint32_t index = 0;
+	uint32_t dimension = 0;
+};
+
+// 与原来的 random_double() 等价的独立均匀采样
+class independent_sampler : public sampler {
+public:
+	explicit independent_sampler(uint32_t s = 0) : sampler(s) {}
+
+	void start_pixel_sample(int i, int j, int sample_index) override {
+		sampler::start_pixel_sample(i, j, sample_index);
+		rng.seed(pixel_seed, index);
+	}
+
+	double get_1d() override { return rng.next_double(); }
+
+	std::pair<double, double> get_2d() override {
+		double u = rng.next_double();
+		return std::make_pair(u, rng.next_double());
+	}
+
+	shared_ptr<sampler> clone() const override { return make_shared<independent_sampler>(*this); }
+
+private:
+	pcg32 rng;
+};
+
+// Owen扰乱的Halton序列, 每个2D维度使用基数(2, 3)
+class halton_sampler : public sampler {
+public:
+	explicit halton_sampler(uint32_t s = 0) : sampler(s) {}
+
+	double get_1d() override;
+
+	std::pair<double, double> get_2d() override;
+
+	shared_ptr<sampler> clone() const override { return make_shared<halton_sampler>(*this); }
+
+private:
+	// 基数2用位运算: 反演后按 hash 做嵌套均匀扰乱
+	static double radical_inverse_2(uint32_t i, uint32_t hash);
+
+	static double owen_scrambled_radical_inverse(uint32_t base, uint32_t a, uint32_t hash);
+};
+
+/*
+ * Owen扰乱的Sobol序列(Burley 2020, Practical Hash-based Owen Scrambling)。
+ * 每个维度对都用前两维Sobol, 样本下标按维度做一次嵌套均匀打乱, 各维度之间因此去相关。
+ */
+class sobol_sampler : public sampler {
+public:
+	explicit sobol_sampler(uint32_t s = 0) : sampler(s) {}
+
+	double get_1d() override;
+
+	std::pair<double, double> get_2d() override;
+
+	shared_ptr<sampler> clone() const override { return make_shared<sobol_sampler>(*this); }
+
+private:
+	uint32_t shuffled_index(uint32_t dim_seed) const;
+};
+
+shared_ptr<sampler> make_sampler(sampler_type type, uint32_t seed = 0);
+
+const char *sampler_name(sampler_type type);
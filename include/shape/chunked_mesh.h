@@ -0,0 +1,129 @@
+#pragma once
+
+#include "rtweekend.h"
+#include "geometry/aabb.h"
+#include "geometry/hittable.h"
+#include "utility/mapped_file.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * .rtm: 按空间分块的三角网格, 可以直接内存映射, 渲染时只有光线用到的块才读入内存。
+ *
+ * 布局(小端):
+ *   [0, 4096)     rtm_header, 其余补0
+ *   块表          chunk_count 个 rtm_chunk
+ *   块数据        每块从页边界开始, 每个三角形 9 个 float(三个顶点)
+ * 写入时三角形按质心的 Morton 码排序后顺序切块, 同一块的三角形在空间上相邻, 块的包围盒比较紧。
+ */
+struct rtm_header {
+	static const uint32_t current_version = 1;
+	static const uint64_t data_alignment = 4096;
+
+	char magic[4];
+	uint32_t version;
+	uint32_t chunk_count;
+	uint32_t reserved;
+	uint64_t triangle_count;
+	uint64_t table_offset;
+	float bounds[6];
+};
+
+struct rtm_chunk {
+	float bounds[6];
+	uint32_t triangle_count;
+	uint32_t reserved;
+	uint64_t offset;
+};
+
+// 驻留在几何缓存中的一块: 三角形和块内的 BVH
+struct mesh_chunk {
+	struct triangle {
+		// 顶点 v0 和两条边 e1 = v1 - v0, e2 = v2 - v0
+		float v0[3], e1[3], e2[3];
+	};
+
+	struct node {
+		float lo[3], hi[3];
+		// 内部节点: 左子节点紧跟在后面, 右子节点为 index; 叶节点: 三角形区间从 index 开始
+		uint32_t index;
+		uint16_t count;
+		uint16_t axis;
+	};
+
+	std::vector<triangle> triangles;
+	std::vector<node> nodes;
+
+	size_t bytes() const { return sizeof(*this) + triangles.size() * sizeof(triangle) + nodes.size() * sizeof(node); }
+
+	// 求最近的交点, 命中时更新 closest 并记下三角形和重心坐标
+	bool hit(const ray &r, double t_min, double &closest, uint32_t &prim, double &u, double &v) const;
+
+	// 建立块内的 BVH, 会重排 triangles
+	void build();
+};
+
+/*
+ * 外存网格: 打开时只读入块表, 在块的包围盒上建一棵小的顶层 BVH; 三角形数据留在映射的文件里,
+ * 光线进入一块时通过 geometry_cache 取得这一块, 缓存满时按LRU淘汰, 常驻内存不超过缓存上限。
+ *
+ * hit() 是同步的, 遇到不驻留的块马上加载; trace_batch() 把打到不驻留块的光线推迟,
+ * 一批光线都走完顶层 BVH 后按块分组, 每个缺失的块只加载一次, 再让排在它后面的光线依次求交。
+ */
+class chunked_mesh : public hittable {
+public:
+	chunked_mesh(const std::string &path, shared_ptr<material> m);
+
+	bool valid() const { return !chunks.empty(); }
+
+	bool hit(const ray &r, double t_min, double t_max, hit_record &rec) const override;
+
+	bool bounding_box(double time0, double time1, aabb &output_box) const override;
+
+	size_t chunk_count() const { return chunks.size(); }
+
+	uint64_t triangle_count() const { return triangles; }
+
+	// 从文件中读出第 index 块, 由 geometry_cache 在缺失时调用
+	shared_ptr<const mesh_chunk> load_chunk(uint32_t index) const;
+
+	struct batch_statistics {
+		// 被推迟的 (光线, 块) 对, 以及批末按块分组后的组数
+		size_t deferred;
+		size_t deferred_chunks;
+	};
+
+	// 对 rays 中的每条光线求最近交点; found[i] 为 0 时 hits[i] 无意义
+	batch_statistics trace_batch(const std::vector<ray> &rays, double t_min, double t_max,
+								 std::vector<hit_record> &hits, std::vector<char> &found) const;
+
+private:
+	struct top_node {
+		aabb box;
+		// 内部节点: 左子节点紧跟在后面, 右子节点为 index; 叶节点: index 是块号
+		uint32_t index;
+		uint8_t axis;
+		bool leaf;
+	};
+
+	// 读取并检查文件头和块表, 出错时返回原因
+	const char *check_header();
+
+	uint32_t build_top(std::vector<uint32_t> &order, size_t begin, size_t end);
+
+	// 在 c 中求交, 命中时填写 rec
+	bool hit_chunk(const mesh_chunk &c, const ray &r, double t_min, double &closest, hit_record &rec) const;
+
+	mapped_file file;
+	uint32_t cache_id = 0;
+	uint64_t triangles = 0;
+	std::vector<rtm_chunk> chunks;
+	std::vector<aabb> chunk_boxes;
+	std::vector<top_node> top;
+	shared_ptr<material> mat_ptr;
+};
+
+// 把三角形(每个 9 个 float)按空间分块写成 .rtm, 每块最多 chunk_triangles 个, 失败时返回 false
+bool write_chunked_mesh(const std::string &path, const std::vector<float> &positions, size_t chunk_triangles = 2048);
@@ -25,10 +25,24 @@ public:
 		v = theta * INV_PI;
 	}
 
+	// 单位球面上 p 点的 dp/du, dp/dv, 其中 phi = 2PI*u, theta = PI*v
+	static void get_sphere_partials(const point3 &p, double radius, vec3 &dpdu, vec3 &dpdv) {
+		double sin_theta = sqrt(p.x() * p.x() + p.z() * p.z());
+		dpdu = 2 * PI * radius * vec3(p.z(), 0, -p.x());
+		if (sin_theta < 1e-8) {
+			// 两极处 u 退化
+			dpdv = PI * radius * vec3(1, 0, 0);
+			return;
+		}
+		dpdv = PI * radius * vec3(-p.x() * p.y() / sin_theta, sin_theta, -p.y() * p.z() / sin_theta);
+	}
+
 	virtual double pdf_value(const point3 &o, const vec3 &v) const override;
 
 	virtual vec3 random(const point3 &o) const override;
 
+	virtual vec3 random(const point3 &o, sampler &smp) const override;
+
 public:
 	point3 center;
 	double radius;
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+ * NUMA 拓扑: 每个节点上本进程可以使用的逻辑CPU(已经按进程的亲和性掩码过滤)。
+ * 没有 CPU 的节点(只有内存)不计入。
+ */
+struct numa_topology {
+	std::vector<std::vector<int>> node_cpus;
+
+	int nodes() const { return static_cast<int>(node_cpus.size()); }
+
+	// 线程数少于节点数时只用前 threads 个节点
+	int active_nodes(int threads) const;
+
+	// threads 个线程按编号连续地平均分到各节点: 节点 n 的线程是 first_thread(n) .. first_thread(n + 1) - 1
+	int node_of_thread(int thread, int threads) const;
+	int first_thread(int node, int threads) const;
+	int cpu_of_thread(int thread, int threads) const;
+
+	// 从 sysfs 读取, 读不到时返回一个包含全部可用CPU的节点
+	static numa_topology read(const std::string &root = "/sys/devices/system/node");
+
+	// 进程内只读取一次
+	static const numa_topology &system();
+};
+
+// "0-3,8-11" -> {0, 1, 2, 3, 8, 9, 10, 11}
+std::vector<int> parse_cpu_list(const std::string &list);
+
+// 把调用线程绑定到一个逻辑CPU, 并记下它所在的节点; 已经绑定在这个CPU上时什么也不做
+bool pin_thread(int cpu, int node);
+
+// 调用线程绑定的节点, 没有绑定时为 -1
+int current_numa_node();
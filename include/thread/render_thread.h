@@ -1,8 +1,8 @@
-#ifndef RENDER_THREAD_H
-#define RENDER_THREAD_H
-class render_thread{
-public:
-    int thread_num = 8;
-};
-
-#endif //RENDER_THREAD_H
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+class render_thread{
+public:
+    int thread_num = 8;
+};
+
+#endif //RENDER_THREAD_H
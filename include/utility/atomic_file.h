@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+/*
+ * 先写到 path + ".tmp", 成功关闭后再改名覆盖 path。
+ * 读者(或者被中断后重新启动的渲染)只会看到旧文件或者完整的新文件。
+ */
+class atomic_file {
+public:
+	explicit atomic_file(const std::string &path);
+
+	// 没有 commit() 时删除临时文件, 目标文件保持不变
+	~atomic_file();
+
+	atomic_file(const atomic_file &) = delete;
+
+	atomic_file &operator=(const atomic_file &) = delete;
+
+	bool is_open() const { return file != nullptr; }
+
+	bool write(const void *data, size_t size);
+
+	std::FILE *handle() { return file; }
+
+	// 刷新到磁盘并替换目标文件
+	bool commit();
+
+private:
+	std::string target;
+	std::string temp;
+	std::FILE *file = nullptr;
+	bool failed = false;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <atomic>
+
+// 浮点数的原子加法(std::atomic<float> 在 C++20 之前没有 fetch_add), 多个线程向同一个累加器写入时使用
+inline void atomic_add(std::atomic<float> &v, float x) {
+	float old = v.load(std::memory_order_relaxed);
+	while (!v.compare_exchange_weak(old, old + x, std::memory_order_relaxed)) {
+	}
+}
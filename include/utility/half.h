@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// IEEE 754 半精度浮点与单精度之间的转换, 舍入到最近的偶数
+
+inline uint16_t float_to_half(float f) {
+	uint32_t x;
+	std::memcpy(&x, &f, sizeof(x));
+
+	const uint32_t sign = (x >> 16) & 0x8000u;
+	const uint32_t abs = x & 0x7fffffffu;
+
+	// NaN 和 Inf
+	if (abs >= 0x7f800000u)
+		return static_cast<uint16_t>(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));
+	// 超出半精度范围
+	if (abs >= 0x477ff000u)
+		return static_cast<uint16_t>(sign | 0x7c00u);
+	// 非规格化数
+	if (abs < 0x38800000u) {
+		if (abs < 0x33000000u)
+			return static_cast<uint16_t>(sign);
+		const uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+		const int shift = 126 - static_cast<int>(abs >> 23);
+		uint32_t h = mantissa >> shift;
+		const uint32_t rest = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (h & 1u)))
+			++h;
+		return static_cast<uint16_t>(sign | h);
+	}
+
+	uint32_t h = ((abs - 0x38000000u) >> 13);
+	const uint32_t rest = abs & 0x1fffu;
+	if (rest > 0x1000u || (rest == 0x1000u && (h & 1u)))
+		++h;
+	return static_cast<uint16_t>(sign | h);
+}
+
+// 指数直接平移, 非规格化数借助一次浮点减法规格化, 没有循环
+inline float half_to_float(uint16_t h) {
+	const uint32_t shifted_exponent = 0x7c00u << 13;
+	uint32_t x = static_cast<uint32_t>(h & 0x7fffu) << 13;
+	const uint32_t exponent = x & shifted_exponent;
+	x += (127 - 15) << 23;
+
+	float f;
+	if (exponent == shifted_exponent) {
+		// Inf/NaN
+		x += (128 - 16) << 23;
+		std::memcpy(&f, &x, sizeof(f));
+	} else if (exponent == 0) {
+		// 非规格化数
+		const uint32_t magic_bits = 113u << 23;
+		float magic;
+		std::memcpy(&magic, &magic_bits, sizeof(magic));
+		x += 1u << 23;
+		std::memcpy(&f, &x, sizeof(f));
+		f -= magic;
+	} else {
+		std::memcpy(&f, &x, sizeof(f));
+	}
+
+	if (h & 0x8000u)
+		f = -f;
+	return f;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// 只读内存映射文件, 页面在第一次访问时才由操作系统读入
+class mapped_file {
+public:
+	mapped_file() = default;
+
+	// 失败时 is_open() 为 false
+	explicit mapped_file(const std::string &path);
+
+	~mapped_file();
+
+	mapped_file(const mapped_file &) = delete;
+
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	bool is_open() const { return ptr != nullptr; }
+
+	const unsigned char *data() const { return ptr; }
+
+	size_t size() const { return length; }
+
+	// [offset, offset + bytes) 暂时不再访问: 把这些页面从常驻内存中丢掉, 之后访问时重新从文件读入
+	void release(size_t offset, size_t bytes) const;
+
+private:
+	void close();
+
+	const unsigned char *ptr = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#endif
+};
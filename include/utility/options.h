@@ -0,0 +1,99 @@
+#pragma once
+
+#include "sample/sampler.h"
+
+#include <string>
+
+// 命令行参数, 未指定的项使用场景的默认值
+struct render_options {
+	// 内置场景的名字
+	std::string scene = "cornell_box";
+	// 为空时图像写到 stdout
+	std::string output;
+	// 0 表示使用场景的默认值
+	int samples_per_pixel = 0;
+	int image_width = 0;
+	int threads = 32;
+
+	sampler_type sampling = sampler_type::sobol;
+	uint32_t seed = 0;
+
+	// 降噪图像写在 -o 指定的输出旁边, 默认关闭
+	bool denoise = false;
+
+	// 构建场景后把几何体搬到按类型连续存放的池中
+	bool arena = false;
+
+	// 渲染用的加速结构: bvh(场景里的 bvh_node)、packed(按类型分开存放图元的 packed_bvh, SAH 建树)
+	// lbvh(同样的 packed_bvh, 按 Morton 码并行建树) 或 lazy(光线第一次进入节点时才划分的 lazy_bvh)
+	std::string accel = "bvh";
+
+	// 积分方法: path(路径追踪) 或 bdpt(双向路径追踪)
+	std::string integrator = "path";
+
+	// 辐射度缓存: 打开后在第 radiance_cache_bounce 次漫反射之后查表; 格子边长为 0 时按场景大小选择
+	bool radiance_cache = false;
+	int radiance_cache_bounce = 1;
+	double radiance_cache_cell = 0;
+	int radiance_cache_samples = 16;
+	double radiance_cache_update = 0.1;
+
+	// 路径引导: 渲染之前用 guide_spp 个样本训练 SD 树, 为 0 时取 spp 的四分之一
+	bool guide = false;
+	int guide_spp = 0;
+
+	// 焦散缓存每一遍发射的光子数, 0 时关闭; 半径为 0 时按场景大小自动选择
+	int caustic_photons = 0;
+	double caustic_radius = 0;
+
+	// 按 NUMA 节点绑定线程, 每个节点一份 BVH, framebuffer 按条带在各节点上分配
+	bool numa = false;
+
+	// 纹理块缓存的上限
+	int texture_cache_mb = 256;
+
+	// 每像素代价热图的输出路径, 需要 RT_ENABLE_STATS
+	std::string heatmap;
+
+	// Chrome trace-event JSON 的输出路径, 需要 RT_ENABLE_TRACE
+	std::string trace;
+
+	// 不为空时分多遍渲染, 定期把累加缓冲写到这个文件
+	std::string checkpoint;
+	double checkpoint_interval = 60.0;
+	// 从 checkpoint 继续渲染到 --spp(可以比原来的更多)
+	bool resume = false;
+
+	// 渐进渲染: 样本数逐遍翻倍, 定期写预览, 到 --spp、时间限制或噪声阈值时停止
+	bool progressive = false;
+	// 为空时写在输出图像旁边(*_preview.ppm)
+	std::string preview;
+	double preview_interval = 2.0;
+	int preview_passes = 0;
+	double time_limit = 0;
+	double noise_threshold = 0;
+
+	// 分布式渲染: 作为协调者监听这个地址, 或者作为 worker 连接到这个地址
+	std::string coordinator;
+	std::string worker;
+	// 协调者在本机 fork 的 worker 数
+	int local_workers = 0;
+	// 任务的像素块边长和样本数(0 表示全部样本)
+	int job_tile = 32;
+	int job_spp = 0;
+
+	// 序列渲染: 场景和加速结构在帧之间保留, 每帧只运行场景的动画并重新拟合 BVH
+	int frames = 0;
+	// 0 表示使用场景的默认值
+	double fps = 0;
+	// 重新拟合后的 SAH 代价超过建树时的这个倍数就重建, 0 表示每帧重建, 负数表示使用默认值
+	double bvh_rebuild_ratio = -1;
+};
+
+// 解析失败或者 --help 时返回 false
+bool parse_options(int argc, char **argv, render_options &opt);
+
+void print_usage(const char *program);
+
+// "out/image.ppm" + "_denoised" -> "out/image_denoised.ppm"
+std::string path_with_suffix(const std::string &path, const std::string &suffix);
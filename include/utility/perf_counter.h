@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * 硬件性能计数器, Linux 上使用 perf_event_open, 只统计调用线程在用户态的事件。
+ * 内核不允许(perf_event_paranoid)、虚拟机没有 PMU 或者其它平台上 available() 为 false。
+ */
+class perf_counter {
+public:
+	enum class event {
+		// 最后一级缓存的缺失
+		cache_misses,
+		// L1 数据缓存的读缺失
+		l1d_read_misses,
+	};
+
+	explicit perf_counter(event e);
+
+	~perf_counter();
+
+	perf_counter(const perf_counter &) = delete;
+
+	perf_counter &operator=(const perf_counter &) = delete;
+
+	bool available() const { return fd >= 0; }
+
+	void start();
+
+	// 返回 start 以来的事件数
+	uint64_t stop();
+
+private:
+	int fd = -1;
+};
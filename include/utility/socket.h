@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+/*
+ * 阻塞式的流套接字(Unix 域或 TCP), 只用于分布式渲染的简单协议。
+ * 地址格式: "unix:/tmp/rt.sock", "tcp:host:port"; 不带前缀时视为 Unix 域套接字的路径。
+ */
+class socket_stream {
+public:
+	socket_stream() = default;
+
+	explicit socket_stream(int handle) : fd(handle) {}
+
+	~socket_stream() { close(); }
+
+	socket_stream(const socket_stream &) = delete;
+
+	socket_stream &operator=(const socket_stream &) = delete;
+
+	socket_stream(socket_stream &&other) noexcept : fd(other.fd), unix_path(std::move(other.unix_path)) {
+		other.fd = -1;
+		other.unix_path.clear();
+	}
+
+	socket_stream &operator=(socket_stream &&other) noexcept;
+
+	bool is_open() const { return fd >= 0; }
+
+	int handle() const { return fd; }
+
+	// 发送/接收全部字节, 连接断开或出错时返回 false
+	bool send_all(const void *data, size_t size);
+
+	bool recv_all(void *data, size_t size);
+
+	void close();
+
+	// 监听 address, 失败时返回的套接字 is_open() 为 false。Unix 域套接字的文件在 close() 时删除
+	static socket_stream listen(const std::string &address);
+
+	socket_stream accept();
+
+	static socket_stream connect(const std::string &address);
+
+private:
+	int fd = -1;
+	// 只有监听的 Unix 域套接字才有
+	std::string unix_path;
+};
@@ -0,0 +1,168 @@
+#include "asset/image_texture.h"
+#include "asset/rtx_texture.h"
+#include "render/trace.h"
+#include "utility/rtw_stb_image.h"
+
+#include <cmath>
+#include <iostream>
+
+namespace {
+	inline int clamp_index(int i, int n) {
+		return i < 0 ? 0 : (i >= n ? n - 1 : i);
+	}
+}
+
+stb_tile_source::stb_tile_source(const char *file) : filename(file) {
+	int components = 0;
+	// 只读文件头
+	if (!stbi_info(filename.c_str(), &base_width, &base_height, &components)) {
+		std::cerr << "ERROR: Could not load texture image file '" << filename << "'.\n";
+		base_width = base_height = 0;
+		return;
+	}
+	level_count = mip_levels(base_width, base_height);
+}
+
+stb_tile_source::~stb_tile_source() {
+	if (reserved_bytes > 0)
+		texture_cache::instance().release(reserved_bytes);
+}
+
+void stb_tile_source::load() const {
+	RT_TRACE_ZONE("texture decode");
+	int w = 0, h = 0, components = bytes_per_pixel;
+	unsigned char *data = stbi_load(filename.c_str(), &w, &h, &components, bytes_per_pixel);
+
+	pyramid.resize(level_count);
+	if (!data || w != base_width || h != base_height) {
+		std::cerr << "ERROR: Could not decode texture image file '" << filename << "'.\n";
+		// 解码失败时整张图都是青色, 与没有数据时一致
+		for (int level = 0; level < level_count; ++level) {
+			auto &pixels = pyramid[level];
+			pixels.resize(static_cast<size_t>(level_width(level)) * level_height(level) * bytes_per_pixel);
+			for (size_t k = 0; k < pixels.size(); k += bytes_per_pixel) {
+				pixels[k] = 0;
+				pixels[k + 1] = pixels[k + 2] = 255;
+			}
+		}
+		stbi_image_free(data);
+		return;
+	}
+
+	pyramid[0].assign(data, data + static_cast<size_t>(w) * h * bytes_per_pixel);
+	stbi_image_free(data);
+
+	// 2x2 盒式滤波逐层缩小, 奇数尺寸时钳位到边缘
+	for (int level = 1; level < level_count; ++level) {
+		const int pw = level_width(level - 1), ph = level_height(level - 1);
+		const int lw = level_width(level), lh = level_height(level);
+		const auto &src = pyramid[level - 1];
+		auto &dst = pyramid[level];
+		dst.resize(static_cast<size_t>(lw) * lh * bytes_per_pixel);
+
+		for (int y = 0; y < lh; ++y) {
+			const int y0 = std::min(2 * y, ph - 1), y1 = std::min(2 * y + 1, ph - 1);
+			for (int x = 0; x < lw; ++x) {
+				const int x0 = std::min(2 * x, pw - 1), x1 = std::min(2 * x + 1, pw - 1);
+				for (int c = 0; c < bytes_per_pixel; ++c) {
+					const int sum = src[(static_cast<size_t>(y0) * pw + x0) * bytes_per_pixel + c]
+									+ src[(static_cast<size_t>(y0) * pw + x1) * bytes_per_pixel + c]
+									+ src[(static_cast<size_t>(y1) * pw + x0) * bytes_per_pixel + c]
+									+ src[(static_cast<size_t>(y1) * pw + x1) * bytes_per_pixel + c];
+					dst[(static_cast<size_t>(y) * lw + x) * bytes_per_pixel + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+void stb_tile_source::read_tile(int level, int tx, int ty, texture_tile &tile) const {
+	std::call_once(loaded, [this]() {
+		load();
+		for (const auto &pixels : pyramid)
+			reserved_bytes += pixels.size();
+		auto &cache = texture_cache::instance();
+		if (reserved_bytes > cache.memory_limit())
+			std::cerr << "WARNING: '" << filename << "' decodes to " << (reserved_bytes >> 10)
+					  << " KB, more than the texture cache limit; convert it with rtx_convert.\n";
+		cache.reserve(reserved_bytes);
+	});
+
+	const int lw = level_width(level), lh = level_height(level);
+	const auto &pixels = pyramid[level];
+	const float color_scale = 1.0f / 255.0f;
+
+	for (int y = 0; y < texture_tile::size; ++y) {
+		const int sy = std::min(ty * texture_tile::size + y, lh - 1);
+		for (int x = 0; x < texture_tile::size; ++x) {
+			const int sx = std::min(tx * texture_tile::size + x, lw - 1);
+			const unsigned char *pixel = &pixels[(static_cast<size_t>(sy) * lw + sx) * bytes_per_pixel];
+			float *t = tile.texels[y * texture_tile::size + x];
+			t[0] = color_scale * pixel[0];
+			t[1] = color_scale * pixel[1];
+			t[2] = color_scale * pixel[2];
+			t[3] = 1.0f;
+		}
+	}
+}
+
+shared_ptr<tile_source> open_tile_source(const char *filename) {
+	const std::string name(filename);
+	const std::string extension = ".rtx";
+	if (name.size() >= extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+		return make_shared<rtx_tile_source>(filename);
+	return make_shared<stb_tile_source>(filename);
+}
+
+image_texture::image_texture(const char *filename) : image_texture(open_tile_source(filename)) {}
+
+image_texture::image_texture(shared_ptr<tile_source> src) : source(std::move(src)) {
+	if (source && source->valid())
+		source_id = texture_cache::instance().register_source();
+}
+
+color image_texture::texel(int level, int x, int y) const {
+	const auto *tile = texture_cache::instance().tile(source_id, *source, level,
+													  x / texture_tile::size, y / texture_tile::size);
+	const float *t = tile->texels[(y % texture_tile::size) * texture_tile::size + x % texture_tile::size];
+	return color(t[0], t[1], t[2]);
+}
+
+color image_texture::bilinear(int level, double u, double v) const {
+	const int lw = source->level_width(level), lh = source->level_height(level);
+
+	// texel中心在半整数处
+	const double x = u * lw - 0.5, y = v * lh - 0.5;
+	const double fx = std::floor(x), fy = std::floor(y);
+	const double ax = x - fx, ay = y - fy;
+
+	const int ix0 = clamp_index(static_cast<int>(fx), lw), ix1 = clamp_index(static_cast<int>(fx) + 1, lw);
+	const int iy0 = clamp_index(static_cast<int>(fy), lh), iy1 = clamp_index(static_cast<int>(fy) + 1, lh);
+
+	return (1 - ax) * (1 - ay) * texel(level, ix0, iy0) + ax * (1 - ay) * texel(level, ix1, iy0)
+		   + (1 - ax) * ay * texel(level, ix0, iy1) + ax * ay * texel(level, ix1, iy1);
+}
+
+color image_texture::value(double u, double v, const vec3 &p) const {
+	return value(u, v, p, 0.0);
+}
+
+color image_texture::value(double u, double v, const point3 &p, double uv_width) const {
+	// If we have no texture data, then return solid cyan as a debugging aid.
+	if (source_id == 0)
+		return color(0, 1, 1);
+
+	// Clamp input texture coordinates to [0,1] x [1,0]
+	u = clamp(u, 0.0, 1.0);
+	v = 1.0 - clamp(v, 0.0, 1.0);  // Flip V to image coordinates
+
+	// 覆盖的texel数取以2为底的对数作为MIP层
+	const double footprint = uv_width * std::max(source->width(), source->height());
+	const double level = clamp(footprint > 1.0 ? std::log2(footprint) : 0.0, 0.0, source->levels() - 1.0);
+	const int l0 = static_cast<int>(level);
+	const double t = level - l0;
+
+	if (t == 0.0 || l0 + 1 >= source->levels())
+		return bilinear(l0, u, v);
+	return (1 - t) * bilinear(l0, u, v) + t * bilinear(l0 + 1, u, v);
+}
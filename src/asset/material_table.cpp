@@ -0,0 +1,319 @@
+#include "asset/material_table.h"
+#include "asset/light.h"
+#include "geometry/bvh.h"
+#include "geometry/packed_bvh.h"
+#include "geometry/rotate.h"
+#include "geometry/translate.h"
+#include "shape/aarect.h"
+#include "shape/box.h"
+#include "shape/constant_medium.h"
+#include "shape/moving_sphere.h"
+#include "shape/sphere.h"
+
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_set>
+
+void material_table::compile(const hittable_list &world) {
+	// 与 scene_arena 一样只认类型完全相同的对象, 其它对象里的材质不编号, 着色时调用虚函数
+	std::vector<shared_ptr<hittable>> pending(world.objects.rbegin(), world.objects.rend());
+	std::unordered_set<const hittable *> visited;
+	std::vector<shared_ptr<material>> materials;
+	while (!pending.empty()) {
+		const auto object = pending.back();
+		pending.pop_back();
+		if (!object || !visited.insert(object.get()).second)
+			continue;
+
+		const auto &type = typeid(*object);
+		if (type == typeid(hittable_list)) {
+			const auto &objects = static_cast<const hittable_list &>(*object).objects;
+			pending.insert(pending.end(), objects.rbegin(), objects.rend());
+		} else if (type == typeid(bvh_node)) {
+			const auto &n = static_cast<const bvh_node &>(*object);
+			pending.push_back(n.right);
+			pending.push_back(n.left);
+		} else if (type == typeid(dynamic_bvh)) {
+			const auto &objects = static_cast<const dynamic_bvh &>(*object).primitives();
+			pending.insert(pending.end(), objects.rbegin(), objects.rend());
+		} else if (type == typeid(packed_bvh)) {
+			std::vector<shared_ptr<hittable>> others;
+			static_cast<const packed_bvh &>(*object).collect(materials, others);
+			pending.insert(pending.end(), others.rbegin(), others.rend());
+		} else if (type == typeid(sphere)) {
+			materials.push_back(static_cast<const sphere &>(*object).mat_ptr);
+		} else if (type == typeid(moving_sphere)) {
+			materials.push_back(static_cast<const moving_sphere &>(*object).mat_ptr);
+		} else if (type == typeid(xy_rect)) {
+			materials.push_back(static_cast<const xy_rect &>(*object).mp);
+		} else if (type == typeid(xz_rect)) {
+			materials.push_back(static_cast<const xz_rect &>(*object).mp);
+		} else if (type == typeid(yz_rect)) {
+			materials.push_back(static_cast<const yz_rect &>(*object).mp);
+		} else if (type == typeid(box)) {
+			const auto &sides = static_cast<const box &>(*object).sides.objects;
+			pending.insert(pending.end(), sides.rbegin(), sides.rend());
+		} else if (type == typeid(translate)) {
+			pending.push_back(static_cast<const translate &>(*object).ptr);
+		} else if (type == typeid(rotate_y)) {
+			pending.push_back(static_cast<const rotate_y &>(*object).ptr);
+		} else if (type == typeid(flip_face)) {
+			pending.push_back(static_cast<const flip_face &>(*object).ptr);
+		} else if (type == typeid(constant_medium)) {
+			const auto &medium = static_cast<const constant_medium &>(*object);
+			materials.push_back(medium.phase_function);
+			pending.push_back(medium.boundary);
+		}
+
+		for (const auto &m : materials)
+			add(m.get());
+		materials.clear();
+	}
+}
+
+uint32_t material_table::add(material *m) {
+	if (!m)
+		return ~0u;
+	const int found = lookup(m);
+	if (found >= 0)
+		return static_cast<uint32_t>(found);
+
+	const auto &type = typeid(*m);
+	material_data data = static_cast<const material *>(m);
+	if (type == typeid(lambertian)) {
+		const auto &albedo = static_cast<const lambertian &>(*m).albedo;
+		if (albedo && typeid(*albedo) == typeid(solid_color))
+			data = lambertian_data{albedo->value(0, 0, point3(0))};
+		else if (albedo)
+			data = textured_lambertian_data{add_texture(albedo)};
+	} else if (type == typeid(metal)) {
+		const auto &mt = static_cast<const metal &>(*m);
+		data = metal_data{mt.albedo, mt.fuzz};
+	} else if (type == typeid(dielectric)) {
+		data = dielectric_data{static_cast<const dielectric &>(*m).ir};
+	} else if (type == typeid(diffuse_light)) {
+		const auto &emit = static_cast<const diffuse_light &>(*m).emit;
+		if (emit && typeid(*emit) == typeid(solid_color))
+			data = light_data{emit->value(0, 0, point3(0))};
+		else if (emit)
+			data = textured_light_data{add_texture(emit)};
+	}
+
+	const auto id = static_cast<uint32_t>(entries.size());
+	entries.push_back({m, data});
+	m->shading_id = id;
+	return id;
+}
+
+uint32_t material_table::add_texture(const shared_ptr<texture> &t) {
+	auto found = texture_ids.find(t.get());
+	if (found != texture_ids.end())
+		return found->second;
+
+	// 先占住位置, 棋盘的子纹理排在它后面
+	const auto id = static_cast<uint32_t>(textures.size());
+	textures.emplace_back(static_cast<const texture *>(t.get()));
+	texture_ids.emplace(t.get(), id);
+
+	const auto &type = typeid(*t);
+	if (type == typeid(solid_color)) {
+		textures[id] = solid_texture_data{t->value(0, 0, point3(0))};
+	} else if (type == typeid(checker_texture)) {
+		const auto &checker = static_cast<const checker_texture &>(*t);
+		if (checker.even && checker.odd) {
+			const uint32_t even = add_texture(checker.even);
+			const uint32_t odd = add_texture(checker.odd);
+			textures[id] = checker_texture_data{even, odd};
+		}
+	} else if (type == typeid(noise_texture)) {
+		textures[id] = static_cast<const noise_texture *>(t.get());
+	} else if (type == typeid(image_texture)) {
+		textures[id] = static_cast<const image_texture *>(t.get());
+	}
+	return id;
+}
+
+color material_table::texture_value(uint32_t id, double u, double v, const point3 &p) const {
+	return std::visit(
+			[&](const auto &t) -> color {
+				using T = std::decay_t<decltype(t)>;
+				if constexpr (std::is_same_v<T, solid_texture_data>) {
+					return t.value;
+				} else if constexpr (std::is_same_v<T, checker_texture_data>) {
+					auto sines = sin(10 * p.x()) * sin(10 * p.y()) * sin(10 * p.z());
+					return texture_value(sines < 0 ? t.odd : t.even, u, v, p);
+				} else if constexpr (std::is_same_v<T, const noise_texture *>) {
+					return t->noise_texture::value(u, v, p);
+				} else if constexpr (std::is_same_v<T, const image_texture *>) {
+					return t->image_texture::value(u, v, p);
+				} else {
+					return t->value(u, v, p);
+				}
+			},
+			textures[id]);
+}
+
+color material_table::texture_value(uint32_t id, double u, double v, const point3 &p, double uv_width) const {
+	return std::visit(
+			[&](const auto &t) -> color {
+				using T = std::decay_t<decltype(t)>;
+				if constexpr (std::is_same_v<T, solid_texture_data>) {
+					return t.value;
+				} else if constexpr (std::is_same_v<T, checker_texture_data>) {
+					auto sines = sin(10 * p.x()) * sin(10 * p.y()) * sin(10 * p.z());
+					return texture_value(sines < 0 ? t.odd : t.even, u, v, p, uv_width);
+				} else if constexpr (std::is_same_v<T, const noise_texture *>) {
+					return t->noise_texture::value(u, v, p);
+				} else if constexpr (std::is_same_v<T, const image_texture *>) {
+					return t->image_texture::value(u, v, p, uv_width);
+				} else {
+					return t->value(u, v, p, uv_width);
+				}
+			},
+			textures[id]);
+}
+
+template <typename T>
+color material_table::emitted_as(const T &m, const ray &r_in, const hit_record &rec) const {
+	if constexpr (std::is_same_v<T, light_data>) {
+		return rec.front_face ? m.emit : color(0, 0, 0);
+	} else if constexpr (std::is_same_v<T, textured_light_data>) {
+		return rec.front_face ? texture_value(m.emit, rec.u, rec.v, rec.p) : color(0, 0, 0);
+	} else if constexpr (std::is_same_v<T, const material *>) {
+		return m->emitted(r_in, rec, rec.u, rec.v, rec.p);
+	} else {
+		return color(0, 0, 0);
+	}
+}
+
+template <typename T>
+bool material_table::scatter_as(const T &m, const ray &r_in, const hit_record &rec, scatter_record &srec) const {
+	if constexpr (std::is_same_v<T, lambertian_data> || std::is_same_v<T, textured_lambertian_data>) {
+		srec.is_specular = false;
+		if constexpr (std::is_same_v<T, lambertian_data>)
+			srec.attenuation = m.albedo;
+		else
+			srec.attenuation = texture_value(m.albedo, rec.u, rec.v, rec.p, rec.uv_width);
+		srec.diffuse_pdf = cosine_pdf(rec.normal);
+		srec.pdf_ptr = nullptr;
+		srec.uses_diffuse_pdf = true;
+		return true;
+	} else if constexpr (std::is_same_v<T, metal_data>) {
+		vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
+		srec.specular_ray = ray(rec.p, reflected + m.fuzz * random_in_unit_sphere(), r_in.time());
+		srec.attenuation = m.albedo;
+		srec.is_specular = true;
+		srec.pdf_ptr = nullptr;
+		srec.uses_diffuse_pdf = false;
+		return true;
+	} else if constexpr (std::is_same_v<T, dielectric_data>) {
+		srec.is_specular = true;
+		srec.pdf_ptr = nullptr;
+		srec.uses_diffuse_pdf = false;
+		srec.attenuation = color(1.0, 1.0, 1.0);
+		double refraction_ratio = rec.front_face ? (1.0 / m.ir) : m.ir;
+
+		vec3 unit_direction = unit_vector(r_in.direction());
+		double cos_theta = std::fmin(dot(-unit_direction, rec.normal), 1.0);
+		double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+
+		vec3 direction;
+		if (refraction_ratio * sin_theta > 1.0 ||
+			dielectric::reflectance(cos_theta, refraction_ratio) > random_double())
+			direction = reflect(unit_direction, rec.normal);
+		else
+			direction = refract(unit_direction, rec.normal, refraction_ratio);
+
+		srec.specular_ray = ray(rec.p, direction, r_in.time());
+		return true;
+	} else if constexpr (std::is_same_v<T, const material *>) {
+		srec.uses_diffuse_pdf = false;
+		return m->scatter(r_in, rec, srec);
+	} else {
+		// 光源不散射
+		return false;
+	}
+}
+
+template <typename T>
+double material_table::scattering_pdf_as(const T &m, const ray &r_in, const hit_record &rec,
+										 const ray &scattered) const {
+	if constexpr (std::is_same_v<T, lambertian_data> || std::is_same_v<T, textured_lambertian_data>) {
+		auto cosine = dot(rec.normal, unit_vector(scattered.direction()));
+		return cosine < 0 ? 0 : cosine * INV_PI;
+	} else if constexpr (std::is_same_v<T, const material *>) {
+		return m->scattering_pdf(r_in, rec, scattered);
+	} else {
+		return 0;
+	}
+}
+
+color material_table::emitted(const material *m, const ray &r_in, const hit_record &rec) const {
+	const int id = lookup(m);
+	if (id < 0)
+		return m->emitted(r_in, rec, rec.u, rec.v, rec.p);
+	return std::visit([&](const auto &data) { return emitted_as(data, r_in, rec); }, entries[id].data);
+}
+
+bool material_table::scatter(const material *m, const ray &r_in, const hit_record &rec, scatter_record &srec) const {
+	const int id = lookup(m);
+	if (id < 0) {
+		srec.uses_diffuse_pdf = false;
+		return m->scatter(r_in, rec, srec);
+	}
+	return std::visit([&](const auto &data) { return scatter_as(data, r_in, rec, srec); }, entries[id].data);
+}
+
+double material_table::scattering_pdf(const material *m, const ray &r_in, const hit_record &rec,
+									  const ray &scattered) const {
+	const int id = lookup(m);
+	if (id < 0)
+		return m->scattering_pdf(r_in, rec, scattered);
+	return std::visit([&](const auto &data) { return scattering_pdf_as(data, r_in, rec, scattered); },
+					  entries[id].data);
+}
+
+void material_table::shade(const std::vector<shading_hit> &hits, std::vector<shading_result> &results) const {
+	results.resize(hits.size());
+
+	// 按材质编号对下标做计数排序, 不在表中的材质排在最后一组
+	const size_t unknown = entries.size();
+	std::vector<uint32_t> keys(hits.size());
+	std::vector<size_t> start(unknown + 2, 0);
+	for (size_t k = 0; k < hits.size(); ++k) {
+		const int id = lookup(hits[k].rec.mat_ptr);
+		keys[k] = static_cast<uint32_t>(id < 0 ? unknown : id);
+		++start[keys[k] + 1];
+	}
+	for (size_t g = 1; g < start.size(); ++g)
+		start[g] += start[g - 1];
+	std::vector<uint32_t> order(hits.size());
+	{
+		std::vector<size_t> next(start.begin(), start.end() - 1);
+		for (size_t k = 0; k < hits.size(); ++k)
+			order[next[keys[k]]++] = static_cast<uint32_t>(k);
+	}
+
+	for (size_t g = 0; g < unknown; ++g) {
+		if (start[g] == start[g + 1])
+			continue;
+		// 每组只分派一次
+		std::visit(
+				[&](const auto &data) {
+					for (size_t k = start[g]; k < start[g + 1]; ++k) {
+						const auto &hit = hits[order[k]];
+						auto &out = results[order[k]];
+						out.emitted = emitted_as(data, hit.r_in, hit.rec);
+						out.scattered = scatter_as(data, hit.r_in, hit.rec, out.srec);
+					}
+				},
+				entries[g].data);
+	}
+	for (size_t k = start[unknown]; k < start[unknown + 1]; ++k) {
+		const auto &hit = hits[order[k]];
+		auto &out = results[order[k]];
+		out.emitted = hit.rec.mat_ptr->emitted(hit.r_in, hit.rec, hit.rec.u, hit.rec.v, hit.rec.p);
+		out.srec.uses_diffuse_pdf = false;
+		out.scattered = hit.rec.mat_ptr->scatter(hit.r_in, hit.rec, out.srec);
+	}
+}
@@ -0,0 +1,139 @@
+#include "asset/rtx_texture.h"
+#include "render/trace.h"
+#include "utility/half.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+	const char rtx_magic[4] = {'R', 'T', 'X', 'T'};
+
+	size_t texel_bytes(rtx_texel_format format) {
+		return format == rtx_texel_format::float16 ? 4 * sizeof(uint16_t) : 4 * sizeof(float);
+	}
+
+	int tiles_along(int extent) {
+		return (extent + texture_tile::size - 1) / texture_tile::size;
+	}
+}
+
+rtx_tile_source::rtx_tile_source(const char *filename) : file(filename) {
+	RT_TRACE_ZONE("texture map");
+	if (const char *reason = check_header()) {
+		std::cerr << "ERROR: Could not load texture file '" << filename << "': " << reason << ".\n";
+		base_width = base_height = level_count = 0;
+	}
+}
+
+const char *rtx_tile_source::check_header() {
+	if (!file.is_open())
+		return "cannot map file";
+	if (file.size() < sizeof(rtx_header))
+		return "file too small";
+
+	rtx_header header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, rtx_magic, sizeof(rtx_magic)) != 0)
+		return "not an .rtx file";
+	if (header.version != rtx_header::current_version)
+		return "unsupported version";
+	if (header.tile_size != static_cast<uint32_t>(texture_tile::size))
+		return "unsupported tile size";
+	if (header.format != rtx_texel_format::float32 && header.format != rtx_texel_format::float16)
+		return "unknown texel format";
+	if (header.width == 0 || header.height == 0 || header.width > (1u << 20) || header.height > (1u << 20))
+		return "bad image size";
+
+	base_width = static_cast<int>(header.width);
+	base_height = static_cast<int>(header.height);
+	level_count = mip_levels(base_width, base_height);
+	if (header.levels != static_cast<uint32_t>(level_count) || level_count > rtx_header::max_levels)
+		return "bad level count";
+	texel_format = header.format;
+
+	// 检查每一层都在文件范围内, 之后 read_tile 不再做边界检查
+	for (int level = 0; level < level_count; ++level) {
+		const uint64_t tiles = static_cast<uint64_t>(tiles_along(level_width(level))) * tiles_along(level_height(level));
+		const uint64_t offset = header.level_offset[level];
+		if (offset < sizeof(rtx_header) || offset > file.size() || tiles * tile_bytes() > file.size() - offset)
+			return "truncated file";
+		level_offset[level] = offset;
+	}
+	return nullptr;
+}
+
+size_t rtx_tile_source::tile_bytes() const {
+	return texel_bytes(texel_format) * texture_tile::size * texture_tile::size;
+}
+
+void rtx_tile_source::read_tile(int level, int tx, int ty, texture_tile &tile) const {
+	const size_t index = static_cast<size_t>(ty) * tiles_along(level_width(level)) + tx;
+	const unsigned char *src = file.data() + level_offset[level] + index * tile_bytes();
+
+	if (texel_format == rtx_texel_format::float32) {
+		std::memcpy(tile.texels, src, sizeof(tile.texels));
+		return;
+	}
+
+	uint16_t halfs[texture_tile::size * texture_tile::size * 4];
+	std::memcpy(halfs, src, sizeof(halfs));
+	float *dst = &tile.texels[0][0];
+	for (size_t k = 0; k < texture_tile::size * texture_tile::size * 4; ++k)
+		dst[k] = half_to_float(halfs[k]);
+}
+
+bool write_rtx_texture(const std::string &path, const tile_source &src, rtx_texel_format format) {
+	if (!src.valid() || src.levels() > rtx_header::max_levels)
+		return false;
+
+	rtx_header header{};
+	std::memcpy(header.magic, rtx_magic, sizeof(rtx_magic));
+	header.version = rtx_header::current_version;
+	header.width = static_cast<uint32_t>(src.width());
+	header.height = static_cast<uint32_t>(src.height());
+	header.levels = static_cast<uint32_t>(src.levels());
+	header.tile_size = texture_tile::size;
+	header.format = format;
+
+	const uint64_t tile_size_bytes = texel_bytes(format) * texture_tile::size * texture_tile::size;
+	uint64_t offset = rtx_header::data_alignment;
+	for (int level = 0; level < src.levels(); ++level) {
+		header.level_offset[level] = offset;
+		offset += tile_size_bytes * tiles_along(src.level_width(level)) * tiles_along(src.level_height(level));
+	}
+
+	FILE *out = std::fopen(path.c_str(), "wb");
+	if (!out)
+		return false;
+
+	std::vector<unsigned char> page(rtx_header::data_alignment, 0);
+	std::memcpy(page.data(), &header, sizeof(header));
+	bool ok = std::fwrite(page.data(), 1, page.size(), out) == page.size();
+
+	texture_tile tile;
+	std::vector<uint16_t> halfs(texture_tile::size * texture_tile::size * 4);
+	for (int level = 0; ok && level < src.levels(); ++level) {
+		const int tiles_x = tiles_along(src.level_width(level));
+		const int tiles_y = tiles_along(src.level_height(level));
+		for (int ty = 0; ok && ty < tiles_y; ++ty) {
+			for (int tx = 0; ok && tx < tiles_x; ++tx) {
+				src.read_tile(level, tx, ty, tile);
+				if (format == rtx_texel_format::float32) {
+					ok = std::fwrite(tile.texels, sizeof(tile.texels), 1, out) == 1;
+				} else {
+					const float *texels = &tile.texels[0][0];
+					for (size_t k = 0; k < halfs.size(); ++k)
+						halfs[k] = float_to_half(texels[k]);
+					ok = std::fwrite(halfs.data(), sizeof(uint16_t), halfs.size(), out) == halfs.size();
+				}
+			}
+		}
+	}
+
+	ok = (std::fclose(out) == 0) && ok;
+	if (!ok)
+		std::remove(path.c_str());
+	return ok;
+}
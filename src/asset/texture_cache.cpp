@@ -0,0 +1,122 @@
+#include "asset/texture_cache.h"
+
+namespace {
+	// 每个线程的直接映射缓存
+	struct thread_tile_cache {
+		uint64_t generation = 0;
+		uint64_t keys[texture_cache::per_thread_entries] = {};
+		shared_ptr<const texture_tile> tiles[texture_cache::per_thread_entries];
+	};
+
+	std::atomic<uint64_t> cache_generation{1};
+
+	inline size_t slot_of(uint64_t key) {
+		key ^= key >> 29;
+		key *= 0xbf58476d1ce4e5b9ULL;
+		key ^= key >> 32;
+		return static_cast<size_t>(key % texture_cache::per_thread_entries);
+	}
+}
+
+texture_cache &texture_cache::instance() {
+	static texture_cache cache;
+	return cache;
+}
+
+uint32_t texture_cache::register_source() {
+	return next_source_id++;
+}
+
+void texture_cache::set_memory_limit(size_t bytes) {
+	std::lock_guard<std::mutex> guard(mutex);
+	limit_bytes = bytes;
+	evict_locked();
+}
+
+void texture_cache::reserve(size_t bytes) {
+	std::lock_guard<std::mutex> guard(mutex);
+	reserved_bytes += bytes;
+	evict_locked();
+}
+
+void texture_cache::release(size_t bytes) {
+	std::lock_guard<std::mutex> guard(mutex);
+	reserved_bytes -= std::min(bytes, reserved_bytes);
+}
+
+const texture_tile *texture_cache::tile(uint32_t source_id, const tile_source &src, int level, int tx, int ty) {
+	thread_local thread_tile_cache local;
+
+	const uint64_t generation = cache_generation.load(std::memory_order_relaxed);
+	if (local.generation != generation) {
+		for (auto &t : local.tiles)
+			t.reset();
+		for (auto &k : local.keys)
+			k = 0;
+		local.generation = generation;
+	}
+
+	// 键的高位是非0的 source_id, 所以0可以表示空槽
+	const uint64_t key = make_key(source_id, level, tx, ty);
+	const size_t slot = slot_of(key);
+	// 线程缓存命中不计数, 避免所有线程争用同一个计数器
+	if (local.keys[slot] == key)
+		return local.tiles[slot].get();
+
+	shared_ptr<const texture_tile> result;
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			lru.splice(lru.begin(), lru, it->second);
+			result = it->second->tile;
+			global_hits.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (!result) {
+		// 在锁外加载, 两个线程同时缺失同一块时各自加载一次, 先插入的生效
+		auto loaded = make_shared<texture_tile>();
+		src.read_tile(level, tx, ty, *loaded);
+		misses.fetch_add(1, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> guard(mutex);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			lru.splice(lru.begin(), lru, it->second);
+			result = it->second->tile;
+		} else {
+			lru.push_front(entry{key, loaded});
+			entries.emplace(key, lru.begin());
+			used_bytes += sizeof(texture_tile);
+			result = loaded;
+			evict_locked();
+		}
+	}
+
+	local.keys[slot] = key;
+	local.tiles[slot] = std::move(result);
+	return local.tiles[slot].get();
+}
+
+void texture_cache::evict_locked() {
+	// 最近插入的一块总是保留
+	while (used_bytes + reserved_bytes > limit_bytes && lru.size() > 1) {
+		entries.erase(lru.back().key);
+		lru.pop_back();
+		used_bytes -= sizeof(texture_tile);
+		evictions.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void texture_cache::clear() {
+	std::lock_guard<std::mutex> guard(mutex);
+	lru.clear();
+	entries.clear();
+	used_bytes = 0;
+	cache_generation.fetch_add(1);
+}
+
+texture_cache::statistics texture_cache::stats() const {
+	return statistics{global_hits.load(), misses.load(), evictions.load()};
+}
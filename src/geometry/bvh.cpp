@@ -1,69 +1,175 @@
-#include "geometry/bvh.h"
-
-bool bvh_node::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
-    if (!box.hit(r, t_min, t_max))
-        return false;
-
-    bool hit_left = left->hit(r, t_min, t_max, rec);
-    bool hit_right = right->hit(r, t_min, hit_left ? rec.t : t_max, rec);
-
-    // 左右节点是否有交集结果并起来
-    return hit_left || hit_right;
-}
-
-bool bvh_node::bounding_box(double time0, double time1, aabb &output_box) const {
-    output_box = box;
-    return true;
-}
-
-bvh_node::bvh_node(const std::vector<shared_ptr<hittable>> &src_objects, size_t start, size_t end, double time0,
-                   double time1) {
-
-    auto objects = src_objects;
-
-    int axis = random_double(0, 2);
-    auto comparator = (axis == 0) ? box_x_compare
-                                  : (axis == 1) ? box_y_compare
-                                                : box_z_compare;
-
-    size_t object_span = end - start;
-
-    // 随机比较 x y z
-    if (object_span == 1) {
-        left = right = objects[start];
-    } else if (object_span == 2) {
-        if (comparator(objects[start], objects[start + 1])) {
-            left = objects[start];
-            right = objects[start + 1];
-        } else {
-            left = objects[start + 1];
-            right = objects[start];
-        }
-    } else {
-        std::sort(objects.begin() + start, objects.begin() + end, comparator);
-
-        auto mid = start + object_span / 2;
-        left = make_shared<bvh_node>(objects, start, mid, time0, time1);
-        right = make_shared<bvh_node>(objects, mid, end, time0, time1);
-    }
-
-    aabb box_left, box_right;
-    if (!left->bounding_box(time0, time1, box_left) || !right->bounding_box(time0, time1, box_right)) {
-        std::cerr << "No bounding box in bvh_node constructor.\n";
-    }
-
-    box = surrounding_box(box_left, box_right);
-}
-
-
-bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-    return box_compare(a, b, 0);
-}
-
-bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-    return box_compare(a, b, 1);
-}
-
-bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-    return box_compare(a, b, 2);
+#include "geometry/bvh.h"
+#include "render/stats.h"
+#include "render/trace.h"
+
+bool bvh_node::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
+    RT_STATS(++render_stats::local().bvh_nodes_visited);
+    if (!box.hit(r, t_min, t_max))
+        return false;
+
+    bool hit_left = left->hit(r, t_min, t_max, rec);
+    bool hit_right = right->hit(r, t_min, hit_left ? rec.t : t_max, rec);
+
+    // 左右节点是否有交集结果并起来
+    return hit_left || hit_right;
+}
+
+bool bvh_node::bounding_box(double time0, double time1, aabb &output_box) const {
+    output_box = box;
+    return true;
+}
+
+bvh_node::bvh_node(const std::vector<shared_ptr<hittable>> &src_objects, size_t start, size_t end, double time0,
+                   double time1) {
+    RT_TRACE_ZONE("bvh build");
+    // 只在根节点复制一次, 子树原地排序各自的区间
+    auto objects = src_objects;
+    build(objects, start, end, time0, time1);
+}
+
+void bvh_node::build(std::vector<shared_ptr<hittable>> &objects, size_t start, size_t end, double time0,
+                     double time1) {
+    int axis = random_double(0, 2);
+    auto comparator = (axis == 0) ? box_x_compare
+                                  : (axis == 1) ? box_y_compare
+                                                : box_z_compare;
+
+    size_t object_span = end - start;
+
+    // 随机比较 x y z
+    if (object_span == 1) {
+        left = right = objects[start];
+    } else if (object_span == 2) {
+        if (comparator(objects[start], objects[start + 1])) {
+            left = objects[start];
+            right = objects[start + 1];
+        } else {
+            left = objects[start + 1];
+            right = objects[start];
+        }
+    } else {
+        std::sort(objects.begin() + start, objects.begin() + end, comparator);
+
+        auto mid = start + object_span / 2;
+        auto left_node = make_shared<bvh_node>();
+        auto right_node = make_shared<bvh_node>();
+        left_node->build(objects, start, mid, time0, time1);
+        right_node->build(objects, mid, end, time0, time1);
+        left = left_node;
+        right = right_node;
+        left_is_node = right_is_node = true;
+    }
+
+    aabb box_left, box_right;
+    if (!left->bounding_box(time0, time1, box_left) || !right->bounding_box(time0, time1, box_right)) {
+        std::cerr << "No bounding box in bvh_node constructor.\n";
+    }
+
+    box = surrounding_box(box_left, box_right);
+}
+
+namespace {
+    // 这一层以上的子树作为 OpenMP 任务, 最多 2^6 个
+    const int refit_task_depth = 6;
+
+    // SAH 中一次节点遍历和一次图元求交的相对代价
+    const double traversal_cost = 1.0;
+    const double intersection_cost = 1.0;
+}
+
+void bvh_node::refit(double time0, double time1) {
+    RT_TRACE_ZONE("bvh refit");
+#pragma omp parallel
+#pragma omp single nowait
+    refit_subtree(time0, time1, 0);
+}
+
+void bvh_node::refit_subtree(double time0, double time1, int depth) {
+    auto left_node = left_is_node ? static_cast<bvh_node *>(left.get()) : nullptr;
+    auto right_node = right_is_node ? static_cast<bvh_node *>(right.get()) : nullptr;
+
+    if (depth < refit_task_depth) {
+        if (left_node) {
+#pragma omp task
+            left_node->refit_subtree(time0, time1, depth + 1);
+        }
+        if (right_node)
+            right_node->refit_subtree(time0, time1, depth + 1);
+#pragma omp taskwait
+    } else {
+        if (left_node)
+            left_node->refit_subtree(time0, time1, depth + 1);
+        if (right_node)
+            right_node->refit_subtree(time0, time1, depth + 1);
+    }
+
+    aabb box_left, box_right;
+    left->bounding_box(time0, time1, box_left);
+    right->bounding_box(time0, time1, box_right);
+    box = surrounding_box(box_left, box_right);
+}
+
+double bvh_node::sah_cost() const {
+    return sah_cost(1.0 / std::max(box.surface_area(), 1e-12));
+}
+
+double bvh_node::sah_cost(double inv_root_area) const {
+    // 每个节点: 遍历本身, 加上直接挂在它下面的图元的求交(left == right 时只有一个)
+    int primitives = 0;
+    if (!left_is_node)
+        ++primitives;
+    if (!right_is_node && right != left)
+        ++primitives;
+
+    double cost = box.surface_area() * inv_root_area * (traversal_cost + intersection_cost * primitives);
+    if (left_is_node)
+        cost += static_cast<const bvh_node *>(left.get())->sah_cost(inv_root_area);
+    if (right_is_node)
+        cost += static_cast<const bvh_node *>(right.get())->sah_cost(inv_root_area);
+    return cost;
+}
+
+shared_ptr<bvh_node> bvh_node::clone() const {
+    auto copy = make_shared<bvh_node>(*this);
+    if (left_is_node)
+        copy->left = static_cast<const bvh_node *>(left.get())->clone();
+    if (right_is_node)
+        copy->right = static_cast<const bvh_node *>(right.get())->clone();
+    return copy;
+}
+
+dynamic_bvh::dynamic_bvh(const hittable_list &list, double time0, double time1) : objects(list.objects) {
+    rebuild(time0, time1);
+}
+
+void dynamic_bvh::rebuild(double time0, double time1) {
+    root = make_shared<bvh_node>(objects, 0, objects.size(), time0, time1);
+    build_cost = current_cost = root->sah_cost();
+}
+
+bool dynamic_bvh::update(double time0, double time1) {
+    if (rebuild_ratio <= 0) {
+        rebuild(time0, time1);
+        return true;
+    }
+
+    root->refit(time0, time1);
+    current_cost = root->sah_cost();
+    if (current_cost <= rebuild_ratio * build_cost)
+        return false;
+
+    rebuild(time0, time1);
+    return true;
+}
+
+bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+    return box_compare(a, b, 0);
+}
+
+bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+    return box_compare(a, b, 1);
+}
+
+bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+    return box_compare(a, b, 2);
 }
\ No newline at end of file
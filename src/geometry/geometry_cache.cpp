@@ -0,0 +1,128 @@
+#include "geometry/geometry_cache.h"
+#include "shape/chunked_mesh.h"
+
+#include <algorithm>
+
+namespace {
+	// 每个线程的直接映射缓存
+	struct thread_chunk_cache {
+		uint64_t generation = 0;
+		uint64_t keys[geometry_cache::per_thread_entries] = {};
+		shared_ptr<const mesh_chunk> chunks[geometry_cache::per_thread_entries];
+	};
+
+	std::atomic<uint64_t> cache_generation{1};
+
+	inline size_t slot_of(uint64_t key) {
+		key ^= key >> 29;
+		key *= 0xbf58476d1ce4e5b9ULL;
+		key ^= key >> 32;
+		return static_cast<size_t>(key % geometry_cache::per_thread_entries);
+	}
+
+	thread_chunk_cache &local_cache() {
+		thread_local thread_chunk_cache local;
+		const uint64_t generation = cache_generation.load(std::memory_order_relaxed);
+		if (local.generation != generation) {
+			for (auto &c : local.chunks)
+				c.reset();
+			for (auto &k : local.keys)
+				k = 0;
+			local.generation = generation;
+		}
+		return local;
+	}
+}
+
+geometry_cache &geometry_cache::instance() {
+	static geometry_cache cache;
+	return cache;
+}
+
+uint32_t geometry_cache::register_mesh() {
+	return next_mesh_id++;
+}
+
+void geometry_cache::set_memory_limit(size_t bytes) {
+	std::lock_guard<std::mutex> guard(mutex);
+	limit_bytes = bytes;
+	evict_locked();
+}
+
+const mesh_chunk *geometry_cache::chunk(uint32_t mesh_id, const chunked_mesh &mesh, uint32_t index) {
+	auto &local = local_cache();
+
+	// 键的高位是非0的 mesh_id, 所以0可以表示空槽
+	const uint64_t key = make_key(mesh_id, index);
+	const size_t slot = slot_of(key);
+	if (local.keys[slot] == key)
+		return local.chunks[slot].get();
+
+	shared_ptr<const mesh_chunk> result;
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			lru.splice(lru.begin(), lru, it->second);
+			result = it->second->chunk;
+			global_hits.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (!result) {
+		// 在锁外加载, 两个线程同时缺失同一块时各自加载一次, 先插入的生效
+		shared_ptr<const mesh_chunk> loaded = mesh.load_chunk(index);
+		misses.fetch_add(1, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> guard(mutex);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			lru.splice(lru.begin(), lru, it->second);
+			result = it->second->chunk;
+		} else {
+			const size_t bytes = loaded->bytes();
+			lru.push_front(entry{key, bytes, loaded});
+			entries.emplace(key, lru.begin());
+			used_bytes += bytes;
+			peak_bytes = std::max(peak_bytes, used_bytes);
+			result = std::move(loaded);
+			evict_locked();
+		}
+	}
+
+	local.keys[slot] = key;
+	local.chunks[slot] = std::move(result);
+	return local.chunks[slot].get();
+}
+
+bool geometry_cache::resident(uint32_t mesh_id, uint32_t index) const {
+	const uint64_t key = make_key(mesh_id, index);
+	if (local_cache().keys[slot_of(key)] == key)
+		return true;
+	std::lock_guard<std::mutex> guard(mutex);
+	return entries.count(key) != 0;
+}
+
+void geometry_cache::evict_locked() {
+	// 最近插入的一块总是保留
+	while (used_bytes > limit_bytes && lru.size() > 1) {
+		used_bytes -= lru.back().bytes;
+		entries.erase(lru.back().key);
+		lru.pop_back();
+		evictions.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void geometry_cache::clear() {
+	std::lock_guard<std::mutex> guard(mutex);
+	lru.clear();
+	entries.clear();
+	used_bytes = 0;
+	peak_bytes = 0;
+	cache_generation.fetch_add(1);
+}
+
+geometry_cache::statistics geometry_cache::stats() const {
+	std::lock_guard<std::mutex> guard(mutex);
+	return statistics{global_hits.load(), misses.load(), evictions.load(), peak_bytes};
+}
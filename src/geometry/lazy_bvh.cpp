@@ -0,0 +1,173 @@
+#include "geometry/lazy_bvh.h"
+#include "geometry/bvh.h"
+#include "geometry/bvh_build.h"
+#include "render/stats.h"
+#include "render/trace.h"
+#include "shape/box.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+
+lazy_bvh::lazy_bvh(const hittable_list &list, double time0, double time1) {
+	RT_TRACE_ZONE("lazy bvh build");
+	for (const auto &object : list.objects)
+		flatten(object, time0, time1);
+	if (objects.empty())
+		return;
+
+	const size_t n = objects.size();
+	order.resize(n);
+	centroids.resize(n);
+	aabb root_box = boxes[0];
+	for (size_t k = 0; k < n; ++k) {
+		order[k] = static_cast<uint32_t>(k);
+		centroids[k] = 0.5 * (boxes[k].min() + boxes[k].max());
+		root_box = surrounding_box(root_box, boxes[k]);
+	}
+
+	// 一棵二叉树最多 2n - 1 个节点; 只分配不构造(aabb 的默认构造会清零), 节点在 split 分配到时才构造
+	static_assert(std::is_trivially_destructible<node>::value, "nodes are never destroyed one by one");
+	static_assert(alignof(node) <= alignof(std::max_align_t), "new[] of bytes must be aligned for node");
+	node_storage.reset(new unsigned char[2 * n * sizeof(node)]);
+	nodes = reinterpret_cast<node *>(node_storage.get());
+	node &root = *new (&nodes[0]) node;
+	root.box = root_box;
+	root.begin = 0;
+	root.end = static_cast<uint32_t>(n);
+	root.depth = 0;
+	root.state.store(unsplit, std::memory_order_relaxed);
+	node_count.store(1, std::memory_order_release);
+}
+
+void lazy_bvh::flatten(const shared_ptr<hittable> &object, double time0, double time1) {
+	if (!object)
+		return;
+
+	const auto &type = typeid(*object);
+	if (type == typeid(hittable_list)) {
+		for (const auto &child : static_cast<const hittable_list &>(*object).objects)
+			flatten(child, time0, time1);
+		return;
+	}
+	if (type == typeid(bvh_node)) {
+		const auto &n = static_cast<const bvh_node &>(*object);
+		flatten(n.left, time0, time1);
+		if (n.right != n.left)
+			flatten(n.right, time0, time1);
+		return;
+	}
+	if (type == typeid(box)) {
+		for (const auto &side : static_cast<const box &>(*object).sides.objects)
+			flatten(side, time0, time1);
+		return;
+	}
+
+	aabb b;
+	if (!object->bounding_box(time0, time1, b))
+		b = aabb(point3(-infinity), point3(infinity));
+	objects.push_back(object);
+	boxes.push_back(b);
+}
+
+void lazy_bvh::split(node &n) const {
+	const size_t begin = n.begin, end = n.end;
+	if (end - begin <= static_cast<size_t>(leaf_size)) {
+		n.state.store(leaf, std::memory_order_release);
+		return;
+	}
+
+	int axis;
+	const size_t mid = bvh_build::partition(
+		order.begin() + begin, order.begin() + end, n.depth,
+		[this](uint32_t prim) -> const point3 & { return centroids[prim]; },
+		[this](uint32_t prim) -> const aabb & { return boxes[prim]; }, axis) - order.begin();
+
+	const uint32_t child = node_count.fetch_add(2, std::memory_order_relaxed);
+	const size_t ranges[2][2] = {{begin, mid}, {mid, end}};
+	for (int c = 0; c < 2; ++c) {
+		node &m = *new (&nodes[child + c]) node;
+		m.begin = static_cast<uint32_t>(ranges[c][0]);
+		m.end = static_cast<uint32_t>(ranges[c][1]);
+		m.box = boxes[order[m.begin]];
+		for (size_t k = m.begin + 1; k < m.end; ++k)
+			m.box = surrounding_box(m.box, boxes[order[k]]);
+		m.depth = static_cast<uint8_t>(n.depth + 1);
+		m.state.store(unsplit, std::memory_order_relaxed);
+	}
+	n.child = child;
+	n.axis = static_cast<uint8_t>(axis);
+	// 子节点和 order 的重排在这之前完成, 看到 interior 的线程也能看到它们
+	n.state.store(interior, std::memory_order_release);
+}
+
+uint32_t lazy_bvh::resolve(node &n) const {
+	uint32_t s = n.state.load(std::memory_order_acquire);
+	if (s == unsplit) {
+		if (n.state.compare_exchange_strong(s, splitting, std::memory_order_acquire)) {
+			split(n);
+			return n.state.load(std::memory_order_relaxed);
+		}
+	}
+	while (s == splitting) {
+		std::this_thread::yield();
+		s = n.state.load(std::memory_order_acquire);
+	}
+	return s;
+}
+
+bool lazy_bvh::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
+	if (!nodes)
+		return false;
+
+	uint32_t stack[bvh_build::stack_size];
+	int top = 0;
+	uint32_t current = 0;
+	double closest = t_max;
+	bool hit_anything = false;
+	while (true) {
+		node &n = nodes[current];
+		RT_STATS(++render_stats::local().bvh_nodes_visited);
+		if (n.box.hit(r, t_min, closest)) {
+			const uint32_t s = resolve(n);
+			if (s == leaf) {
+				for (uint32_t k = n.begin; k < n.end; ++k) {
+					if (objects[order[k]]->hit(r, t_min, closest, rec)) {
+						closest = rec.t;
+						hit_anything = true;
+					}
+				}
+			} else {
+				// 先走光线方向上靠前的子节点, 远的子节点入栈
+				uint32_t near_child = n.child, far_child = n.child + 1;
+				if (r.direction()[n.axis] < 0.0)
+					std::swap(near_child, far_child);
+				stack[top++] = far_child;
+				current = near_child;
+				continue;
+			}
+		}
+		if (top == 0)
+			break;
+		current = stack[--top];
+	}
+	return hit_anything;
+}
+
+bool lazy_bvh::bounding_box(double time0, double time1, aabb &output_box) const {
+	if (!nodes)
+		return false;
+	output_box = nodes[0].box;
+	return true;
+}
+
+lazy_bvh::statistics lazy_bvh::stats() const {
+	const size_t count = node_count.load(std::memory_order_acquire);
+	statistics s{objects.size(), count, objects.empty() ? 0 : 2 * objects.size() - 1, 0};
+	for (size_t k = 0; k < count; ++k)
+		s.leaves += nodes[k].state.load(std::memory_order_relaxed) == leaf;
+	return s;
+}
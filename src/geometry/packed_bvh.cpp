@@ -0,0 +1,941 @@
+#include "geometry/packed_bvh.h"
+#include "geometry/bvh.h"
+#include "geometry/bvh_build.h"
+#include "geometry/rotate.h"
+#include "geometry/translate.h"
+#include "render/stats.h"
+#include "render/trace.h"
+#include "shape/aarect.h"
+#include "shape/box.h"
+#include "shape/moving_sphere.h"
+#include "shape/sphere.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <typeinfo>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+	using bvh_build::median_depth;
+	using bvh_build::stack_size;
+	// 4 叉节点每层最多压入三个子节点
+	const int wide_stack_size = 3 * stack_size;
+
+	bool is_flattened(const hittable &object) {
+		const auto &type = typeid(object);
+		return type == typeid(hittable_list) || type == typeid(bvh_node) || type == typeid(box) ||
+			   type == typeid(sphere) || type == typeid(moving_sphere) || type == typeid(xy_rect) ||
+			   type == typeid(xz_rect) || type == typeid(yz_rect) || type == typeid(translate) ||
+			   type == typeid(rotate_y);
+	}
+
+	inline bool hit_box(const aabb &box, const double o[3], const double inv[3], double t_min, double t_max) {
+		for (int a = 0; a < 3; ++a) {
+			double t0 = (box.minimum[a] - o[a]) * inv[a];
+			double t1 = (box.maximum[a] - o[a]) * inv[a];
+			if (inv[a] < 0.0)
+				std::swap(t0, t1);
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+			if (t_max <= t_min)
+				return false;
+		}
+		return true;
+	}
+
+	// 量化节点的解码; 量化时用同一个式子检查, 保证解码出的包围盒是保守的
+	inline double dequantize(float origin, float scale, uint8_t q) {
+		return static_cast<double>(origin) + q * static_cast<double>(scale);
+	}
+
+	bool is_finite(const aabb &box) {
+		for (int a = 0; a < 3; ++a)
+			if (!std::isfinite(box.min()[a]) || !std::isfinite(box.max()[a]))
+				return false;
+		return true;
+	}
+
+	// 最高位之前 0 的个数, x 不能为 0
+	inline int count_leading_zeros(uint64_t x) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, x);
+		return 63 - static_cast<int>(index);
+#else
+		return __builtin_clzll(x);
+#endif
+	}
+
+	inline int count_leading_zeros(uint32_t x) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, x);
+		return 31 - static_cast<int>(index);
+#else
+		return __builtin_clz(x);
+#endif
+	}
+
+	// Morton 码每个轴的位数, 三个轴交错成 63 位
+	const int morton_bits = 21;
+
+	// 把低 21 位分散到每三位的最低一位
+	inline uint64_t expand_bits(uint64_t v) {
+		v &= 0x1fffff;
+		v = (v | v << 32) & 0x1f00000000ffffULL;
+		v = (v | v << 16) & 0x1f0000ff0000ffULL;
+		v = (v | v << 8) & 0x100f00f00f00f00fULL;
+		v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+		v = (v | v << 2) & 0x1249249249249249ULL;
+		return v;
+	}
+
+	// 按 8 位一趟的 LSD 基数排序 (键, 值) 对, 相同的键保持原来的顺序。
+	// 每趟各线程先统计自己那一段的直方图, 前缀和之后按线程的顺序写到各自的位置; 所有键这一位都相同的趟跳过
+	void radix_sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values) {
+		const size_t n = keys.size();
+		std::vector<uint64_t> key_tmp(n);
+		std::vector<uint32_t> value_tmp(n);
+		const int threads = omp_get_max_threads();
+		std::vector<size_t> offsets(static_cast<size_t>(threads) * 256);
+
+		for (int shift = 0; shift < 64; shift += 8) {
+			bool skip = false;
+#pragma omp parallel num_threads(threads)
+			{
+				const int t = omp_get_thread_num(), count = omp_get_num_threads();
+				const size_t begin = n * t / count, end = n * (t + 1) / count;
+				size_t *local = offsets.data() + static_cast<size_t>(t) * 256;
+				std::fill(local, local + 256, 0);
+				for (size_t k = begin; k < end; ++k)
+					++local[(keys[k] >> shift) & 0xff];
+#pragma omp barrier
+#pragma omp single
+				{
+					size_t running = 0;
+					for (int b = 0; b < 256; ++b) {
+						const size_t bucket_start = running;
+						for (int u = 0; u < count; ++u) {
+							size_t &o = offsets[static_cast<size_t>(u) * 256 + b];
+							const size_t c = o;
+							o = running;
+							running += c;
+						}
+						if (running - bucket_start == n)
+							skip = true;
+					}
+				}
+				if (!skip) {
+					for (size_t k = begin; k < end; ++k) {
+						const size_t to = local[(keys[k] >> shift) & 0xff]++;
+						key_tmp[to] = keys[k];
+						value_tmp[to] = values[k];
+					}
+				}
+			}
+			if (!skip) {
+				keys.swap(key_tmp);
+				values.swap(value_tmp);
+			}
+		}
+	}
+
+	// lanes 中最小且小于 closest 的一个, 没有时为 -1
+	inline int nearest_lane(const double *t_lane, int count, double &closest) {
+		int best = -1;
+		for (int k = 0; k < count; ++k) {
+			if (t_lane[k] < closest) {
+				closest = t_lane[k];
+				best = k;
+			}
+		}
+		return best;
+	}
+}
+
+packed_bvh::packed_bvh(const hittable_list &list, double time0, double time1, build_method m, node_format f)
+	: method(m), format(f) {
+	RT_TRACE_ZONE("packed bvh build");
+	std::vector<prim_ref> refs;
+	for (const auto &object : list.objects)
+		flatten(object, false, refs, time0, time1);
+	if (refs.empty())
+		return;
+
+	nodes.reserve(2 * refs.size() / leaf_size + 1);
+	reserve_arrays();
+	if (method == build_method::lbvh && refs.size() > static_cast<size_t>(leaf_size))
+		build_lbvh(refs);
+	else
+		build(refs, 0, refs.size(), 0);
+	root_box = nodes.front().box;
+	if (format == node_format::quantized)
+		compress();
+
+	// 复制完就不再需要
+	std::vector<staged_sphere>().swap(staged_spheres);
+	std::vector<staged_moving_sphere>().swap(staged_moving_spheres);
+	std::vector<staged_rect>().swap(staged_rects);
+	std::vector<shared_ptr<hittable>>().swap(staged_others);
+}
+
+void packed_bvh::reserve_arrays() {
+	const size_t n_spheres = staged_spheres.size();
+	for (auto *v : {&spheres.cx, &spheres.cy, &spheres.cz, &spheres.radius})
+		v->reserve(n_spheres);
+	spheres.mat.reserve(n_spheres);
+
+	const size_t n_moving = staged_moving_spheres.size();
+	auto &m = moving_spheres;
+	for (auto *v : {&m.cx0, &m.cy0, &m.cz0, &m.cx1, &m.cy1, &m.cz1, &m.time0, &m.time1, &m.radius})
+		v->reserve(n_moving);
+	m.mat.reserve(n_moving);
+
+	const size_t n_rects = staged_rects.size();
+	for (auto *v : {&rects.a0, &rects.a1, &rects.b0, &rects.b1, &rects.k})
+		v->reserve(n_rects);
+	rects.axis.reserve(n_rects);
+	rects.flipped.reserve(n_rects);
+	rects.mat.reserve(n_rects);
+
+	others.reserve(staged_others.size());
+}
+
+void packed_bvh::flatten(const shared_ptr<hittable> &object, bool flipped, std::vector<prim_ref> &refs,
+						 double time0, double time1) {
+	if (!object)
+		return;
+
+	const auto &type = typeid(*object);
+	if (type == typeid(hittable_list)) {
+		for (const auto &child : static_cast<const hittable_list &>(*object).objects)
+			flatten(child, flipped, refs, time0, time1);
+		return;
+	}
+	if (type == typeid(bvh_node)) {
+		const auto &n = static_cast<const bvh_node &>(*object);
+		flatten(n.left, flipped, refs, time0, time1);
+		if (n.right != n.left)
+			flatten(n.right, flipped, refs, time0, time1);
+		return;
+	}
+	if (type == typeid(box)) {
+		for (const auto &side : static_cast<const box &>(*object).sides.objects)
+			flatten(side, flipped, refs, time0, time1);
+		return;
+	}
+
+	prim_ref ref;
+	if (!object->bounding_box(time0, time1, ref.box))
+		ref.box = aabb(point3(-infinity), point3(infinity));
+
+	if (type == typeid(sphere)) {
+		const auto &s = static_cast<const sphere &>(*object);
+		ref.type = sphere_prim;
+		ref.index = static_cast<uint32_t>(staged_spheres.size());
+		staged_spheres.push_back({s.center, s.radius, s.mat_ptr});
+	} else if (type == typeid(moving_sphere)) {
+		const auto &s = static_cast<const moving_sphere &>(*object);
+		ref.type = moving_sphere_prim;
+		ref.index = static_cast<uint32_t>(staged_moving_spheres.size());
+		staged_moving_spheres.push_back({s.center0, s.center1, s.time0, s.time1, s.radius, s.mat_ptr});
+	} else if (type == typeid(xy_rect)) {
+		const auto &q = static_cast<const xy_rect &>(*object);
+		ref.type = rect_prim;
+		ref.index = static_cast<uint32_t>(staged_rects.size());
+		staged_rects.push_back({q.x0, q.x1, q.y0, q.y1, q.k, 0, flipped, q.mp});
+	} else if (type == typeid(xz_rect)) {
+		const auto &q = static_cast<const xz_rect &>(*object);
+		ref.type = rect_prim;
+		ref.index = static_cast<uint32_t>(staged_rects.size());
+		staged_rects.push_back({q.x0, q.x1, q.z0, q.z1, q.k, 1, flipped, q.mp});
+	} else if (type == typeid(yz_rect)) {
+		const auto &q = static_cast<const yz_rect &>(*object);
+		ref.type = rect_prim;
+		ref.index = static_cast<uint32_t>(staged_rects.size());
+		staged_rects.push_back({q.y0, q.y1, q.z0, q.z1, q.k, 2, flipped, q.mp});
+	} else if (type == typeid(flip_face) && static_cast<const flip_face &>(*object).ptr &&
+			   (typeid(*static_cast<const flip_face &>(*object).ptr) == typeid(xy_rect) ||
+				typeid(*static_cast<const flip_face &>(*object).ptr) == typeid(xz_rect) ||
+				typeid(*static_cast<const flip_face &>(*object).ptr) == typeid(yz_rect))) {
+		flatten(static_cast<const flip_face &>(*object).ptr, !flipped, refs, time0, time1);
+		return;
+	} else {
+		// 变换保留为一个图元, 只把它下面的几何体换成 packed_bvh
+		shared_ptr<hittable> kept = object;
+		if (type == typeid(translate)) {
+			const auto &t = static_cast<const translate &>(*object);
+			if (t.ptr && is_flattened(*t.ptr)) {
+				auto copy = make_shared<translate>(t);
+				hittable_list child;
+				child.add(t.ptr);
+				copy->ptr = make_shared<packed_bvh>(child, time0, time1, method, format);
+				kept = copy;
+			}
+		} else if (type == typeid(rotate_y)) {
+			const auto &rot = static_cast<const rotate_y &>(*object);
+			if (rot.ptr && is_flattened(*rot.ptr)) {
+				auto copy = make_shared<rotate_y>(rot);
+				hittable_list child;
+				child.add(rot.ptr);
+				copy->ptr = make_shared<packed_bvh>(child, time0, time1, method, format);
+				kept = copy;
+			}
+		}
+		ref.type = other_prim;
+		ref.index = static_cast<uint32_t>(staged_others.size());
+		staged_others.push_back(kept);
+	}
+
+	ref.centroid = 0.5 * (ref.box.min() + ref.box.max());
+	refs.push_back(ref);
+}
+
+uint32_t packed_bvh::build(std::vector<prim_ref> &refs, size_t begin, size_t end, int depth) {
+	const auto index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+
+	aabb bounds = refs[begin].box;
+	for (size_t k = begin + 1; k < end; ++k)
+		bounds = surrounding_box(bounds, refs[k].box);
+	nodes[index].box = bounds;
+
+	if (end - begin <= static_cast<size_t>(leaf_size)) {
+		emit_leaf(nodes[index], refs, begin, end);
+		return index;
+	}
+
+	int axis;
+	const size_t mid = bvh_build::partition(
+		refs.begin() + begin, refs.begin() + end, depth,
+		[](const prim_ref &ref) -> const point3 & { return ref.centroid; },
+		[](const prim_ref &ref) -> const aabb & { return ref.box; }, axis) - refs.begin();
+
+	build(refs, begin, mid, depth + 1);
+	const uint32_t right = build(refs, mid, end, depth + 1);
+	nodes[index].right = right;
+	nodes[index].axis = static_cast<uint8_t>(axis);
+	nodes[index].leaf = 0;
+	return index;
+}
+
+struct packed_bvh::lbvh_tree {
+	// 叶子编码为 leaf_bit | 图元在排序后的下标, 内部节点为下标; 内部节点 0 是根
+	static const uint32_t leaf_bit = 0x80000000u;
+
+	std::vector<uint64_t> codes;
+	std::vector<uint32_t> left, right, first, last;
+	std::vector<aabb> boxes;
+};
+
+void packed_bvh::build_lbvh(std::vector<prim_ref> &refs) {
+	const auto n = static_cast<int64_t>(refs.size());
+
+	// 质心的范围, 每个轴量化成 2^21 格
+	point3 cmin(infinity), cmax(-infinity);
+	{
+		double x0 = infinity, y0 = infinity, z0 = infinity, x1 = -infinity, y1 = -infinity, z1 = -infinity;
+#pragma omp parallel for reduction(min : x0, y0, z0) reduction(max : x1, y1, z1)
+		for (int64_t k = 0; k < n; ++k) {
+			const point3 &c = refs[k].centroid;
+			x0 = std::min(x0, c.x());
+			y0 = std::min(y0, c.y());
+			z0 = std::min(z0, c.z());
+			x1 = std::max(x1, c.x());
+			y1 = std::max(y1, c.y());
+			z1 = std::max(z1, c.z());
+		}
+		cmin = point3(x0, y0, z0);
+		cmax = point3(x1, y1, z1);
+	}
+
+	lbvh_tree tree;
+	tree.codes.resize(n);
+	std::vector<uint32_t> order(n);
+	const double cells = static_cast<double>((1 << morton_bits) - 1);
+	double scale[3];
+	for (int a = 0; a < 3; ++a)
+		scale[a] = cmax[a] > cmin[a] ? cells / (cmax[a] - cmin[a]) : 0.0;
+#pragma omp parallel for
+	for (int64_t k = 0; k < n; ++k) {
+		uint64_t q[3];
+		for (int a = 0; a < 3; ++a) {
+			// 包围盒无限大的图元质心是 NaN, 放在第 0 格
+			const double cell = (refs[k].centroid[a] - cmin[a]) * scale[a];
+			q[a] = cell >= 0 ? static_cast<uint64_t>(std::min(cell, cells)) : 0;
+		}
+		tree.codes[k] = expand_bits(q[0]) << 2 | expand_bits(q[1]) << 1 | expand_bits(q[2]);
+		order[k] = static_cast<uint32_t>(k);
+	}
+	radix_sort(tree.codes, order);
+	{
+		std::vector<prim_ref> sorted(n);
+#pragma omp parallel for
+		for (int64_t k = 0; k < n; ++k)
+			sorted[k] = refs[order[k]];
+		refs.swap(sorted);
+	}
+
+	// Karras: 内部节点 i 的区间以 i 为一端, 方向和另一端由相邻键的公共前缀长度决定。
+	// 键相同时用下标补齐, 所以公共前缀是 (键, 下标) 上的
+	const auto &codes = tree.codes;
+	auto delta = [&](int64_t i, int64_t j) -> int {
+		if (j < 0 || j >= n)
+			return -1;
+		const uint64_t x = codes[i] ^ codes[j];
+		if (x)
+			return count_leading_zeros(x);
+		return 64 + count_leading_zeros(static_cast<uint32_t>(i ^ j));
+	};
+
+	const int64_t internal = n - 1;
+	tree.left.resize(internal);
+	tree.right.resize(internal);
+	tree.first.resize(internal);
+	tree.last.resize(internal);
+	tree.boxes.resize(internal);
+	std::vector<uint32_t> parent(internal + n);
+#pragma omp parallel for
+	for (int64_t i = 0; i < internal; ++i) {
+		const int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+		const int delta_min = delta(i, i - d);
+		int64_t length_max = 2;
+		while (delta(i, i + length_max * d) > delta_min)
+			length_max *= 2;
+		int64_t length = 0;
+		for (int64_t t = length_max / 2; t >= 1; t /= 2)
+			if (delta(i, i + (length + t) * d) > delta_min)
+				length += t;
+		const int64_t j = i + length * d;
+
+		// 二分找到区间内公共前缀变短的位置
+		const int delta_node = delta(i, j);
+		int64_t split = 0;
+		for (int64_t div = 2;; div *= 2) {
+			const int64_t t = (length + div - 1) / div;
+			if (delta(i, i + (split + t) * d) > delta_node)
+				split += t;
+			if (t <= 1)
+				break;
+		}
+		const int64_t gamma = i + split * d + std::min(d, 0);
+
+		const int64_t lo = std::min(i, j), hi = std::max(i, j);
+		tree.first[i] = static_cast<uint32_t>(lo);
+		tree.last[i] = static_cast<uint32_t>(hi);
+		tree.left[i] = lo == gamma ? lbvh_tree::leaf_bit | static_cast<uint32_t>(gamma) : static_cast<uint32_t>(gamma);
+		tree.right[i] =
+				hi == gamma + 1 ? lbvh_tree::leaf_bit | static_cast<uint32_t>(gamma + 1) : static_cast<uint32_t>(gamma + 1);
+		// parent 中叶子排在内部节点后面
+		parent[lo == gamma ? internal + gamma : gamma] = static_cast<uint32_t>(i);
+		parent[hi == gamma + 1 ? internal + gamma + 1 : gamma + 1] = static_cast<uint32_t>(i);
+	}
+
+	// 自底向上合并包围盒: 每个叶子往上走, 第二个到达父节点的线程负责合并, 第一个到达的就此停下
+	std::unique_ptr<std::atomic<int>[]> arrived(new std::atomic<int>[internal]);
+	for (int64_t i = 0; i < internal; ++i)
+		arrived[i].store(0, std::memory_order_relaxed);
+	auto child_box = [&](uint32_t c) -> const aabb & {
+		return c & lbvh_tree::leaf_bit ? refs[c & ~lbvh_tree::leaf_bit].box : tree.boxes[c];
+	};
+#pragma omp parallel for
+	for (int64_t k = 0; k < n; ++k) {
+		uint32_t p = parent[internal + k];
+		while (arrived[p].fetch_add(1, std::memory_order_acq_rel) == 1) {
+			tree.boxes[p] = surrounding_box(child_box(tree.left[p]), child_box(tree.right[p]));
+			if (p == 0)
+				break;
+			p = parent[p];
+		}
+	}
+
+	emit_lbvh(refs, tree, 0, 0);
+}
+
+uint32_t packed_bvh::emit_lbvh(std::vector<prim_ref> &refs, const lbvh_tree &tree, uint32_t child, int depth) {
+	const bool is_leaf = child & lbvh_tree::leaf_bit;
+	const uint32_t i = child & ~lbvh_tree::leaf_bit;
+	const size_t first = is_leaf ? i : tree.first[i];
+	const size_t last = is_leaf ? i : tree.last[i];
+
+	// 键很集中时 Karras 树可能很深, 超过遍历栈之前交给中位数划分
+	if (depth >= median_depth)
+		return build(refs, first, last + 1, depth);
+
+	const auto index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+	nodes[index].box = is_leaf ? refs[i].box : tree.boxes[i];
+	if (last - first + 1 <= static_cast<size_t>(leaf_size)) {
+		emit_leaf(nodes[index], refs, first, last + 1);
+		return index;
+	}
+
+	// 区间两端的键最高的不同位就是划分的位, 它所在的轴是划分轴(z 在最低位)
+	int axis = 0;
+	const uint64_t diff = tree.codes[first] ^ tree.codes[last];
+	if (diff)
+		axis = 2 - (63 - count_leading_zeros(diff)) % 3;
+
+	emit_lbvh(refs, tree, tree.left[i], depth + 1);
+	const uint32_t right = emit_lbvh(refs, tree, tree.right[i], depth + 1);
+	nodes[index].right = right;
+	nodes[index].axis = static_cast<uint8_t>(axis);
+	nodes[index].leaf = 0;
+	return index;
+}
+
+void packed_bvh::emit_leaf(node &n, const std::vector<prim_ref> &refs, size_t begin, size_t end) {
+	n.leaf = 1;
+	n.right = 0;
+	n.axis = 0;
+	n.first[sphere_prim] = static_cast<uint32_t>(spheres.radius.size());
+	n.first[moving_sphere_prim] = static_cast<uint32_t>(moving_spheres.radius.size());
+	n.first[rect_prim] = static_cast<uint32_t>(rects.k.size());
+	n.first[other_prim] = static_cast<uint32_t>(others.size());
+	std::fill(n.count, n.count + prim_type_count, 0);
+
+	for (size_t k = begin; k < end; ++k) {
+		const auto &ref = refs[k];
+		++n.count[ref.type];
+		switch (ref.type) {
+		case sphere_prim: {
+			const auto &s = staged_spheres[ref.index];
+			spheres.cx.push_back(s.center.x());
+			spheres.cy.push_back(s.center.y());
+			spheres.cz.push_back(s.center.z());
+			spheres.radius.push_back(s.radius);
+			spheres.mat.push_back(s.mat);
+			break;
+		}
+		case moving_sphere_prim: {
+			const auto &s = staged_moving_spheres[ref.index];
+			moving_spheres.cx0.push_back(s.center0.x());
+			moving_spheres.cy0.push_back(s.center0.y());
+			moving_spheres.cz0.push_back(s.center0.z());
+			moving_spheres.cx1.push_back(s.center1.x());
+			moving_spheres.cy1.push_back(s.center1.y());
+			moving_spheres.cz1.push_back(s.center1.z());
+			moving_spheres.time0.push_back(s.time0);
+			moving_spheres.time1.push_back(s.time1);
+			moving_spheres.radius.push_back(s.radius);
+			moving_spheres.mat.push_back(s.mat);
+			break;
+		}
+		case rect_prim: {
+			const auto &q = staged_rects[ref.index];
+			rects.a0.push_back(q.a0);
+			rects.a1.push_back(q.a1);
+			rects.b0.push_back(q.b0);
+			rects.b1.push_back(q.b1);
+			rects.k.push_back(q.k);
+			rects.axis.push_back(q.axis);
+			rects.flipped.push_back(q.flipped);
+			rects.mat.push_back(q.mat);
+			break;
+		}
+		default:
+			others.push_back(staged_others[ref.index]);
+			break;
+		}
+	}
+}
+
+bool packed_bvh::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
+	if (!wide.empty())
+		return hit_quantized(r, t_min, t_max, rec);
+	if (nodes.empty())
+		return false;
+
+	const double o[3] = {r.origin().x(), r.origin().y(), r.origin().z()};
+	const double inv[3] = {1.0 / r.direction().x(), 1.0 / r.direction().y(), 1.0 / r.direction().z()};
+
+	uint32_t stack[stack_size];
+	int top = 0;
+	uint32_t current = 0;
+	double closest = t_max;
+	bool hit_anything = false;
+	while (true) {
+		const node &n = nodes[current];
+		RT_STATS(++render_stats::local().bvh_nodes_visited);
+		if (hit_box(n.box, o, inv, t_min, closest)) {
+			if (n.leaf) {
+				if (hit_leaf(n.count, n.first, r, t_min, closest, rec))
+					hit_anything = true;
+			} else {
+				// 先走光线方向上靠前的子节点, 远的子节点入栈
+				uint32_t near_child = current + 1, far_child = n.right;
+				if (inv[n.axis] < 0.0)
+					std::swap(near_child, far_child);
+				stack[top++] = far_child;
+				current = near_child;
+				continue;
+			}
+		}
+		if (top == 0)
+			break;
+		current = stack[--top];
+	}
+	return hit_anything;
+}
+
+bool packed_bvh::hit_leaf(const uint8_t *count_of, const uint32_t *first_of, const ray &r, double t_min,
+						  double &closest, hit_record &rec) const {
+	const double ox = r.origin().x(), oy = r.origin().y(), oz = r.origin().z();
+	const double dx = r.direction().x(), dy = r.direction().y(), dz = r.direction().z();
+	double t_lane[leaf_size];
+	bool hit_anything = false;
+
+	for (int type = 0; type < prim_type_count; ++type) {
+		const int count = count_of[type];
+		if (count == 0)
+			continue;
+		const uint32_t first = first_of[type];
+
+		switch (type) {
+		case sphere_prim: {
+			RT_STATS(for (int k = 0; k < count; ++k) render_stats::local().count_test(shape_kind::sphere));
+			const double *cx = spheres.cx.data() + first, *cy = spheres.cy.data() + first;
+			const double *cz = spheres.cz.data() + first, *radius = spheres.radius.data() + first;
+			const double a = dx * dx + dy * dy + dz * dz;
+			const double t_max = closest;
+#pragma omp simd
+			for (int k = 0; k < count; ++k) {
+				const double ocx = ox - cx[k], ocy = oy - cy[k], ocz = oz - cz[k];
+				const double half_b = ocx * dx + ocy * dy + ocz * dz;
+				const double c = (ocx * ocx + ocy * ocy + ocz * ocz) - radius[k] * radius[k];
+				const double discriminant = half_b * half_b - a * c;
+				const double sqrtd = std::sqrt(discriminant < 0 ? 0.0 : discriminant);
+				double root = (-half_b - sqrtd) / a;
+				if (root < t_min || t_max < root)
+					root = (-half_b + sqrtd) / a;
+				t_lane[k] = (discriminant < 0 || root < t_min || t_max < root) ? infinity : root;
+			}
+			const int k = nearest_lane(t_lane, count, closest);
+			if (k < 0)
+				break;
+
+			const point3 center(cx[k], cy[k], cz[k]);
+			rec.t = t_lane[k];
+			rec.p = r.at(rec.t);
+			rec.normal = (rec.p - center) / radius[k];
+			vec3 outward_normal = (rec.p - center) / radius[k];
+			rec.set_face_normal(r, outward_normal);
+			rec.mat_ptr = spheres.mat[first + k].get();
+			sphere::get_sphere_uv(outward_normal, rec.u, rec.v);
+			sphere::get_sphere_partials(outward_normal, radius[k], rec.dpdu, rec.dpdv);
+			RT_STATS(render_stats::local().count_hit(shape_kind::sphere));
+			hit_anything = true;
+			break;
+		}
+		case moving_sphere_prim: {
+			RT_STATS(for (int k = 0; k < count; ++k) render_stats::local().count_test(shape_kind::moving_sphere));
+			const auto &m = moving_spheres;
+			const double time = r.time();
+			const double a = dx * dx + dy * dy + dz * dz;
+			const double t_max = closest;
+			double center_lane[3][leaf_size];
+#pragma omp simd
+			for (int k = 0; k < count; ++k) {
+				const uint32_t i = first + k;
+				const double f = (time - m.time0[i]) / (m.time1[i] - m.time0[i]);
+				center_lane[0][k] = m.cx0[i] + f * (m.cx1[i] - m.cx0[i]);
+				center_lane[1][k] = m.cy0[i] + f * (m.cy1[i] - m.cy0[i]);
+				center_lane[2][k] = m.cz0[i] + f * (m.cz1[i] - m.cz0[i]);
+				const double ocx = ox - center_lane[0][k], ocy = oy - center_lane[1][k], ocz = oz - center_lane[2][k];
+				const double half_b = ocx * dx + ocy * dy + ocz * dz;
+				const double c = (ocx * ocx + ocy * ocy + ocz * ocz) - m.radius[i] * m.radius[i];
+				const double discriminant = half_b * half_b - a * c;
+				const double sqrtd = std::sqrt(discriminant < 0 ? 0.0 : discriminant);
+				double root = (-half_b - sqrtd) / a;
+				if (root < t_min || t_max < root)
+					root = (-half_b + sqrtd) / a;
+				t_lane[k] = (discriminant < 0 || root < t_min || t_max < root) ? infinity : root;
+			}
+			const int k = nearest_lane(t_lane, count, closest);
+			if (k < 0)
+				break;
+
+			const point3 center(center_lane[0][k], center_lane[1][k], center_lane[2][k]);
+			rec.t = t_lane[k];
+			rec.p = r.at(rec.t);
+			auto outward_normal = (rec.p - center) / m.radius[first + k];
+			rec.set_face_normal(r, outward_normal);
+			rec.mat_ptr = m.mat[first + k].get();
+			RT_STATS(render_stats::local().count_hit(shape_kind::moving_sphere));
+			hit_anything = true;
+			break;
+		}
+		case rect_prim: {
+			const uint8_t *axis = rects.axis.data() + first;
+			RT_STATS(for (int k = 0; k < count; ++k) render_stats::local().count_test(
+					static_cast<shape_kind>(static_cast<int>(shape_kind::xy_rect) + axis[k])));
+			const double *a0 = rects.a0.data() + first, *a1 = rects.a1.data() + first;
+			const double *b0 = rects.b0.data() + first, *b1 = rects.b1.data() + first;
+			const double *plane = rects.k.data() + first;
+			const double t_max = closest;
+			double a_lane[leaf_size], b_lane[leaf_size];
+#pragma omp simd
+			for (int k = 0; k < count; ++k) {
+				// xy: 平面 z = k, 平面内 (x, y); xz: y = k, (x, z); yz: x = k, (y, z)
+				const double oc = axis[k] == 0 ? oz : axis[k] == 1 ? oy : ox;
+				const double dc = axis[k] == 0 ? dz : axis[k] == 1 ? dy : dx;
+				const double oa = axis[k] == 2 ? oy : ox, da = axis[k] == 2 ? dy : dx;
+				const double ob = axis[k] == 0 ? oy : oz, db = axis[k] == 0 ? dy : dz;
+				const double t = (plane[k] - oc) / dc;
+				a_lane[k] = oa + t * da;
+				b_lane[k] = ob + t * db;
+				const bool inside = !(t < t_min || t > t_max) && !(a_lane[k] < a0[k] || a_lane[k] > a1[k] ||
+																	b_lane[k] < b0[k] || b_lane[k] > b1[k]);
+				t_lane[k] = inside ? t : infinity;
+			}
+			const int k = nearest_lane(t_lane, count, closest);
+			if (k < 0)
+				break;
+
+			rec.u = (a_lane[k] - a0[k]) / (a1[k] - a0[k]);
+			rec.v = (b_lane[k] - b0[k]) / (b1[k] - b0[k]);
+			vec3 outward_normal;
+			if (axis[k] == 0) {
+				rec.dpdu = vec3(a1[k] - a0[k], 0, 0);
+				rec.dpdv = vec3(0, b1[k] - b0[k], 0);
+				outward_normal = vec3(0, 0, 1);
+			} else if (axis[k] == 1) {
+				rec.dpdu = vec3(a1[k] - a0[k], 0, 0);
+				rec.dpdv = vec3(0, 0, b1[k] - b0[k]);
+				outward_normal = vec3(0, 1, 0);
+			} else {
+				rec.dpdu = vec3(0, a1[k] - a0[k], 0);
+				rec.dpdv = vec3(0, 0, b1[k] - b0[k]);
+				outward_normal = vec3(1, 0, 0);
+			}
+			rec.t = t_lane[k];
+			rec.set_face_normal(r, outward_normal);
+			rec.mat_ptr = rects.mat[first + k].get();
+			rec.p = r.at(rec.t);
+			if (rects.flipped[first + k])
+				rec.front_face = !rec.front_face;
+			RT_STATS(render_stats::local().count_hit(
+					static_cast<shape_kind>(static_cast<int>(shape_kind::xy_rect) + axis[k])));
+			hit_anything = true;
+			break;
+		}
+		default:
+			for (int k = 0; k < count; ++k) {
+				if (others[first + k]->hit(r, t_min, closest, rec)) {
+					closest = rec.t;
+					hit_anything = true;
+				}
+			}
+			break;
+		}
+	}
+	return hit_anything;
+}
+
+void packed_bvh::compress() {
+	static_assert(sizeof(wide_node) == 64, "量化节点应该正好是一条缓存行");
+	if (nodes.empty() || !is_finite(root_box))
+		return;
+
+	RT_TRACE_ZONE("packed bvh compress");
+	// 二叉树的节点数约为 4 叉树的三倍
+	wide.reserve(nodes.size() / 3 + 1);
+	leaf_ranges.reserve(nodes.size() / 2 + 1);
+	emit_wide(0);
+	std::vector<node>().swap(nodes);
+}
+
+uint32_t packed_bvh::emit_wide(uint32_t index) {
+	// 从两个子节点开始, 每次展开表面积最大的内部子节点, 直到有 4 个子节点或者全是叶节点
+	uint32_t children[4];
+	int count = 0;
+	if (nodes[index].leaf) {
+		children[count++] = index;
+	} else {
+		children[count++] = index + 1;
+		children[count++] = nodes[index].right;
+	}
+	while (count < 4) {
+		int best = -1;
+		double best_area = -1.0;
+		for (int c = 0; c < count; ++c) {
+			const node &n = nodes[children[c]];
+			if (!n.leaf && n.box.surface_area() > best_area) {
+				best_area = n.box.surface_area();
+				best = c;
+			}
+		}
+		if (best < 0)
+			break;
+		const uint32_t expanded = children[best];
+		children[best] = expanded + 1;
+		children[count++] = nodes[expanded].right;
+	}
+
+	const auto w = static_cast<uint32_t>(wide.size());
+	wide.emplace_back();
+	const aabb &parent = nodes[index].box;
+	{
+		wide_node &q = wide[w];
+		for (int a = 0; a < 3; ++a) {
+			// 原点向下取整到 float, 比例取能盖住整个范围的最小的2的幂
+			float origin = static_cast<float>(parent.min()[a]);
+			if (origin > parent.min()[a])
+				origin = std::nextafter(origin, -std::numeric_limits<float>::infinity());
+			const double extent = parent.max()[a] - origin;
+			int e = -126;
+			if (extent > 0.0) {
+				std::frexp(extent / 255.0, &e);
+				e = std::max(e, -126);
+			}
+			float scale = std::ldexp(1.0f, e);
+			while (dequantize(origin, scale, 255) < parent.max()[a])
+				scale *= 2.0f;
+			q.origin[a] = origin;
+			q.scale[a] = scale;
+
+			for (int c = 0; c < 4; ++c) {
+				if (c >= count) {
+					q.lo[a][c] = q.hi[a][c] = 0;
+					continue;
+				}
+				const aabb &box = nodes[children[c]].box;
+				int lo = static_cast<int>(std::floor((box.min()[a] - origin) / scale));
+				lo = std::clamp(lo, 0, 255);
+				while (lo > 0 && dequantize(origin, scale, static_cast<uint8_t>(lo)) > box.min()[a])
+					--lo;
+				int hi = static_cast<int>(std::ceil((box.max()[a] - origin) / scale));
+				hi = std::clamp(hi, 0, 255);
+				while (hi < 255 && dequantize(origin, scale, static_cast<uint8_t>(hi)) < box.max()[a])
+					++hi;
+				q.lo[a][c] = static_cast<uint8_t>(lo);
+				q.hi[a][c] = static_cast<uint8_t>(hi);
+			}
+		}
+	}
+
+	// 递归会往 wide 里追加节点, 不能持有 wide[w] 的引用
+	for (int c = 0; c < 4; ++c) {
+		uint32_t ref = empty_child;
+		if (c < count) {
+			const node &n = nodes[children[c]];
+			if (n.leaf) {
+				leaf_range range;
+				std::copy(n.first, n.first + prim_type_count, range.first);
+				std::copy(n.count, n.count + prim_type_count, range.count);
+				ref = leaf_child | static_cast<uint32_t>(leaf_ranges.size());
+				leaf_ranges.push_back(range);
+			} else {
+				ref = emit_wide(children[c]);
+			}
+		}
+		wide[w].child[c] = ref;
+	}
+	return w;
+}
+
+bool packed_bvh::hit_quantized(const ray &r, double t_min, double t_max, hit_record &rec) const {
+	const double o[3] = {r.origin().x(), r.origin().y(), r.origin().z()};
+	const double inv[3] = {1.0 / r.direction().x(), 1.0 / r.direction().y(), 1.0 / r.direction().z()};
+	if (!hit_box(root_box, o, inv, t_min, t_max))
+		return false;
+
+	struct entry {
+		uint32_t child;
+		double t;
+	};
+	entry stack[wide_stack_size];
+	int top = 0;
+	uint32_t current = 0;
+	double closest = t_max;
+	bool hit_anything = false;
+	while (true) {
+		if (current & leaf_child) {
+			const leaf_range &leaf = leaf_ranges[current & ~leaf_child];
+			if (hit_leaf(leaf.count, leaf.first, r, t_min, closest, rec))
+				hit_anything = true;
+		} else {
+			const wide_node &n = wide[current];
+			RT_STATS(++render_stats::local().bvh_nodes_visited);
+			// 把光线变换到节点的量化坐标里, 每个边界只需要一次乘加: t = q * scale / d + (origin - o) / d;
+			// 按方向的符号选出先进入的一侧, 不用逐个比较两个边界
+			double slope[3], offset[3];
+			const uint8_t *near_q[3], *far_q[3];
+			for (int a = 0; a < 3; ++a) {
+				slope[a] = n.scale[a] * inv[a];
+				offset[a] = (n.origin[a] - o[a]) * inv[a];
+				near_q[a] = inv[a] < 0.0 ? n.hi[a] : n.lo[a];
+				far_q[a] = inv[a] < 0.0 ? n.lo[a] : n.hi[a];
+			}
+			// 四个子节点的包围盒一起求交
+			double t_near[4];
+			const double t_far_limit = closest;
+#pragma omp simd
+			for (int c = 0; c < 4; ++c) {
+				double t0 = t_min, t1 = t_far_limit;
+				for (int a = 0; a < 3; ++a) {
+					const double enter = near_q[a][c] * slope[a] + offset[a];
+					const double leave = far_q[a][c] * slope[a] + offset[a];
+					t0 = enter > t0 ? enter : t0;
+					t1 = leave < t1 ? leave : t1;
+				}
+				t_near[c] = t0 < t1 ? t0 : infinity;
+			}
+
+			// 命中的子节点按进入距离从远到近入栈, 最近的在栈顶
+			const int base = top;
+			for (int c = 0; c < 4; ++c) {
+				if (n.child[c] == empty_child || t_near[c] == infinity)
+					continue;
+				int k = top++;
+				for (; k > base && stack[k - 1].t < t_near[c]; --k)
+					stack[k] = stack[k - 1];
+				stack[k] = {n.child[c], t_near[c]};
+			}
+		}
+
+		// 出栈时跳过进入距离已经比最近交点远的子节点
+		do {
+			if (top == 0)
+				return hit_anything;
+			--top;
+		} while (stack[top].t > closest);
+		current = stack[top].child;
+	}
+}
+
+bool packed_bvh::bounding_box(double time0, double time1, aabb &output_box) const {
+	if (nodes.empty() && wide.empty())
+		return false;
+	output_box = root_box;
+	return true;
+}
+
+packed_bvh::statistics packed_bvh::stats() const {
+	statistics s{nodes.size(), 0, {spheres.radius.size(), moving_spheres.radius.size(), rects.k.size(), others.size()},
+				 nodes.size() * sizeof(node), false};
+	for (const auto &n : nodes)
+		s.leaves += n.leaf;
+	if (!wide.empty()) {
+		s.nodes = wide.size();
+		s.leaves = leaf_ranges.size();
+		s.node_bytes = wide.size() * sizeof(wide_node) + leaf_ranges.size() * sizeof(leaf_range);
+		s.quantized = true;
+	}
+	return s;
+}
+
+void packed_bvh::collect(std::vector<shared_ptr<material>> &materials,
+						 std::vector<shared_ptr<hittable>> &objects) const {
+	materials.insert(materials.end(), spheres.mat.begin(), spheres.mat.end());
+	materials.insert(materials.end(), moving_spheres.mat.begin(), moving_spheres.mat.end());
+	materials.insert(materials.end(), rects.mat.begin(), rects.mat.end());
+	objects.insert(objects.end(), others.begin(), others.end());
+}
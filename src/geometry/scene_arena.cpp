@@ -0,0 +1,106 @@
+#include "geometry/scene_arena.h"
+
+#include <typeinfo>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+hittable_list scene_arena::compact(const hittable_list &world, shared_ptr<scene_arena> *arena_out) {
+	auto arena = make_shared<scene_arena>();
+	hittable_list result;
+	for (const auto &object : world.objects) {
+		auto copy = arena->relocate(object);
+		// 池中的对象换成持有 arena 的指针, 保留下来的对象仍然用原来的 shared_ptr
+		result.add(copy.use_count() == 0 ? shared_ptr<hittable>(arena, copy.get()) : copy);
+	}
+	// clear() 不释放桶数组
+	std::unordered_map<const hittable *, shared_ptr<hittable>>().swap(arena->relocated);
+
+	if (arena_out)
+		*arena_out = arena;
+	return result;
+}
+
+shared_ptr<hittable> scene_arena::relocate(const shared_ptr<hittable> &object) {
+	if (!object)
+		return object;
+	auto found = relocated.find(object.get());
+	if (found != relocated.end())
+		return found->second;
+
+	// 只搬运类型完全相同的对象, 子类按基类复制会丢掉子类的部分
+	const auto &type = typeid(*object);
+	shared_ptr<hittable> copy;
+	if (type == typeid(bvh_node)) {
+		// 先放节点再放子树, 节点按深度优先的顺序, 图元按叶节点的顺序
+		auto node = nodes.create(static_cast<const bvh_node &>(*object));
+		copy = unowned(node);
+		node->left = relocate(node->left);
+		node->right = relocate(node->right);
+	} else if (type == typeid(sphere)) {
+		copy = unowned(spheres.create(static_cast<const sphere &>(*object)));
+	} else if (type == typeid(moving_sphere)) {
+		copy = unowned(moving_spheres.create(static_cast<const moving_sphere &>(*object)));
+	} else if (type == typeid(xy_rect)) {
+		copy = unowned(xy_rects.create(static_cast<const xy_rect &>(*object)));
+	} else if (type == typeid(xz_rect)) {
+		copy = unowned(xz_rects.create(static_cast<const xz_rect &>(*object)));
+	} else if (type == typeid(yz_rect)) {
+		copy = unowned(yz_rects.create(static_cast<const yz_rect &>(*object)));
+	} else if (type == typeid(box)) {
+		auto b = boxes.create(static_cast<const box &>(*object));
+		copy = unowned(b);
+		for (auto &side : b->sides.objects)
+			side = relocate(side);
+	} else if (type == typeid(translate)) {
+		auto t = translates.create(static_cast<const translate &>(*object));
+		copy = unowned(t);
+		t->ptr = relocate(t->ptr);
+	} else if (type == typeid(rotate_y)) {
+		auto r = rotations.create(static_cast<const rotate_y &>(*object));
+		copy = unowned(r);
+		r->ptr = relocate(r->ptr);
+	} else if (type == typeid(flip_face)) {
+		auto f = flips.create(static_cast<const flip_face &>(*object));
+		copy = unowned(f);
+		f->ptr = relocate(f->ptr);
+	} else {
+		++kept_objects;
+		copy = object;
+	}
+
+	relocated.emplace(object.get(), copy);
+	return copy;
+}
+
+std::vector<scene_arena::pool_usage> scene_arena::usage() const {
+	return {
+			{"bvh_node", nodes.size(), nodes.bytes()},
+			{"sphere", spheres.size(), spheres.bytes()},
+			{"moving_sphere", moving_spheres.size(), moving_spheres.bytes()},
+			{"xy_rect", xy_rects.size(), xy_rects.bytes()},
+			{"xz_rect", xz_rects.size(), xz_rects.bytes()},
+			{"yz_rect", yz_rects.size(), yz_rects.bytes()},
+			{"box", boxes.size(), boxes.bytes()},
+			{"translate", translates.size(), translates.bytes()},
+			{"rotate_y", rotations.size(), rotations.bytes()},
+			{"flip_face", flips.size(), flips.bytes()},
+	};
+}
+
+size_t scene_arena::bytes() const {
+	size_t total = 0;
+	for (const auto &pool : usage())
+		total += pool.bytes;
+	return total;
+}
+
+size_t heap_bytes_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	const auto info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+#else
+	return 0;
+#endif
+}
@@ -1,200 +1,420 @@
-#include "geometry/ray.h"
-#include "math/vec3.h"
-#include "rtweekend.h"
-#include "color.h"
-
-#include "geometry/hittable_list.h"
-#include "geometry/translate.h"
-#include "geometry/rotate.h"
-#include "geometry/bvh.h"
-#include "geometry/pdf.h"
-
-#include "shape/sphere.h"
-#include "shape/aarect.h"
-#include "shape/box.h"
-#include "shape/moving_sphere.h"
-#include "shape/constant_medium.h"
-
-#include "asset/material.h"
-#include "asset/camera.h"
-#include "asset/noise_texture.h"
-#include "asset/image_texture.h"
-#include "asset/light.h"
-
-#include <omp.h>
-#include <iostream>
-#include <thread>
-#include <mutex>
-#include <fstream>
-#include <chrono>
-
-// Image
-double aspect_ratio = 16.0 / 9.0;
-int image_width = 400;
-int image_height = static_cast<int>(image_width / aspect_ratio);
-const int max_depth = 50;
-
-// World
-hittable_list world;
-
-camera cam;
-
-// 225 600
-std::vector<std::vector<color>> color_table(image_height + 1, std::vector<color>(image_width + 1));
-
-// ray recursion
-color ray_color(const ray &r, const color &background, const hittable &world, shared_ptr<hittable> &lights, int depth) {
-	hit_record rec;
-
-	// If we've exceeded the ray bounce limit, no more light is gathered.
-	if (depth <= 0)
-		return color(0, 0, 0);
-
-	if (!world.hit(r, 0.001, infinity, rec))
-		return background;
-
-	scatter_record srec;
-	color emitted = rec.mat_ptr->emitted(r, rec, rec.u, rec.v, rec.p);
-	if (!rec.mat_ptr->scatter(r, rec, srec))
-		return emitted;
-
-	if (srec.is_specular) {
-		return srec.attenuation
-			* ray_color(srec.specular_ray, background, world, lights, depth-1);
-	}
-
-	auto light_ptr = make_shared<hittable_pdf>(lights, rec.p);
-	mixture_pdf p(light_ptr, srec.pdf_ptr);
-
-	ray scattered = ray(rec.p, p.generate(), r.time());
-	auto pdf_val = p.value(scattered.direction());
-
-	// Monte-Carlo BRDF
-	return emitted
-		+ srec.attenuation * rec.mat_ptr->scattering_pdf(r, rec, scattered)
-			* ray_color(scattered, background, world, lights, depth - 1) / pdf_val;
-}
-
-void scan_calculate_color(int height,
-						  int width,
-						  color &background,
-						  int samples_per_pixel,
-						  shared_ptr<hittable> lights) {
-	int i = width, j = height;
-	color pixel_color(0, 0, 0);
-	for (int s = 0; s < samples_per_pixel; ++s) {
-		double u = (i + random_double()) / (image_width - 1.0);
-		double v = (j + random_double()) / (image_height - 1.0);
-		ray r = cam.get_ray(u, v);
-		pixel_color += ray_color(r, background, world, lights, max_depth);
-	}
-	//    write_color(std::cout, pixel_color, samples_per_pixel);
-	write_color_table(pixel_color, samples_per_pixel, color_table, j, i);
-}
-
-hittable_list cornell_box() {
-	hittable_list objects;
-
-	auto red = make_shared<lambertian>(color(.65, .05, .05));
-	auto white = make_shared<lambertian>(color(.73, .73, .73));
-	auto green = make_shared<lambertian>(color(.12, .45, .15));
-
-//    auto baseColor = vec3(.34299999, .54779997, .22700010);
-	auto baseColor = vec3(1.0);
-	auto light = make_shared<diffuse_light>(baseColor * color(15, 15, 15));
-
-	// box
-	shared_ptr<material> aluminum = make_shared<metal>(color(0.8, 0.85, 0.88), 0.0);
-	shared_ptr<hittable> box1 = make_shared<box>(point3(0, 0, 0), point3(165, 330, 165), aluminum);
-	box1 = make_shared<rotate_y>(box1, 15);
-	box1 = make_shared<translate>(box1, vec3(265, 0, 295));
-	objects.add(box1);
-
-	auto glass = make_shared<dielectric>(1.5);
-	objects.add(make_shared<sphere>(point3(190,90,190), 90 , glass));
-
-	// wall
-	objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
-	objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
-	objects.add(make_shared<flip_face>(make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
-//    objects.add(make_shared<xz_rect>(213, 343, 227, 332, 554, light));
-	objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
-	objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
-	objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
-
-	return objects;
-}
-
-int main() {
-	// default Camera
-	point3 lookfrom;
-	point3 lookat;
-	vec3 vup(0, 1, 0);
-	double dist_to_focus = 10.0;
-	double vfov = 40.0;
-	double aperture = 0.0;
-
-	int samples_per_pixel = 10;
-
-	color background(0, 0, 0);
-
-	int option = 7;
-
-	auto lights = make_shared<hittable_list>();
-	lights->add(make_shared<xz_rect>(213, 343, 227, 332, 554, shared_ptr<material>()));
-	lights->add(make_shared<sphere>(point3(190, 90, 190), 90, shared_ptr<material>()));
-
-	switch (option) {
-		case 7:world = cornell_box();
-			aspect_ratio = 1.0;
-			image_width = 1024;
-			samples_per_pixel = 600;
-			background = color(0, 0, 0);
-			lookfrom = point3(278, 278, -800);
-			lookat = point3(278, 278, 0);
-			vfov = 40.0;
-			break;
-	}
-
-	cam.reset(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
-	image_height = static_cast<int>(image_width / aspect_ratio);
-	color_table.resize(image_height + 1);
-	for (auto &col : color_table) {
-		col.resize(image_width + 1);
-	}
-
-	// Render
-	std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-
-	omp_set_num_threads(32);
-
-	int finish = image_width - 1;
-	static omp_lock_t lock;
-	omp_init_lock(&lock);
-
-	const auto start = std::chrono::high_resolution_clock::now();
-
-#pragma omp parallel for
-	for (int j = image_height - 1; j >= 0; --j) {
-		for (int i = 0; i < image_width; ++i) {
-			scan_calculate_color(j, i, background, samples_per_pixel, lights);
-		}
-
-		omp_set_lock(&lock);
-		std::cerr << "\routput remaining: " << finish << ' ' << std::flush;
-		finish--;
-		omp_unset_lock(&lock);
-	}
-
-	for (int j = image_height - 1; j >= 0; --j) {
-		std::cerr << "\routput remaining: " << j << ' ' << std::flush;
-		for (int i = 0; i < image_width; ++i) {
-			out_color_table(std::cout, color_table, j, i);
-		}
-	}
-
-	const auto stop = std::chrono::high_resolution_clock::now();
-	const auto elapsed = std::chrono::duration<float, std::chrono::seconds::period>(stop - start).count();
-
-	std::cerr << "\n" << "duration : " << elapsed << "s\tDone.\n";
-}
+#include "rtweekend.h"
+
+#include "asset/texture_cache.h"
+
+#include "render/scene.h"
+#include "render/integrator.h"
+#include "render/photon_map.h"
+#include "render/renderer.h"
+#include "render/image_io.h"
+#include "render/film.h"
+#include "render/progressive.h"
+#include "render/checkpoint.h"
+#include "render/denoiser.h"
+#include "render/distributed.h"
+#include "render/stats.h"
+#include "render/trace.h"
+
+#include "geometry/lazy_bvh.h"
+#include "geometry/packed_bvh.h"
+#include "geometry/scene_arena.h"
+
+#include "thread/numa.h"
+
+#include "utility/options.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+	void write_trace(const render_options &options) {
+#ifdef RT_ENABLE_TRACE
+		if (!options.trace.empty()) {
+			if (trace_recorder::instance().write(options.trace))
+				std::cerr << "trace -> " << options.trace << "\n";
+			else
+				std::cerr << "ERROR: Could not write trace '" << options.trace << "'.\n";
+		}
+#else
+		(void) options;
+#endif
+	}
+
+	/*
+	 * 序列渲染: 场景、纹理缓存和加速结构在帧之间保留。
+	 * 每帧先运行场景的动画并重新拟合(必要时重建) BVH, 再渲染, 两部分的时间分开统计。
+	 */
+	int render_sequence(scene &world, const path_integrator &integrator, film &frame, const render_settings &settings,
+						const render_options &options) {
+		if (options.progressive || !options.checkpoint.empty() || !options.coordinator.empty())
+			std::cerr << "--frames renders every frame locally, --progressive, --checkpoint and --coordinator are ignored\n";
+		if (!world.animate)
+			std::cerr << "scene " << world.name << " is not animated, all frames are the same\n";
+
+		const std::string base = options.output.empty() ? std::string("frame.ppm") : options.output;
+		double setup_total = 0, render_total = 0, output_total = 0;
+		int refits = 0, rebuilds = 0;
+
+		for (int k = 0; k < options.frames; ++k) {
+			const auto update = update_scene(world, k);
+
+			allocate_film(frame, settings);
+			const double render_seconds = render_pass(integrator, frame, settings, 0, world.samples_per_pixel);
+
+			const auto output_start = std::chrono::steady_clock::now();
+			char suffix[16];
+			std::snprintf(suffix, sizeof(suffix), "_%04d", k);
+			const auto path = path_with_suffix(base, suffix);
+			{
+				RT_TRACE_ZONE("output", k);
+				std::ofstream file(path);
+				write_ppm(file, settings.width, settings.height, mean_image(frame));
+				if (options.denoise) {
+					std::vector<color> denoised;
+					atrous_denoiser().denoise(frame, denoised);
+					std::ofstream denoised_file(path_with_suffix(path, "_denoised"));
+					write_ppm(denoised_file, settings.width, settings.height, denoised);
+				}
+				if (!file) {
+					std::cerr << "ERROR: Could not write frame '" << path << "'.\n";
+					return 1;
+				}
+			}
+			const double output_seconds =
+					std::chrono::duration<double>(std::chrono::steady_clock::now() - output_start).count();
+
+			setup_total += update.seconds;
+			render_total += render_seconds;
+			output_total += output_seconds;
+			refits += update.refits;
+			rebuilds += update.rebuilds;
+
+			std::cerr << "frame " << k << ": setup " << update.seconds * 1e3 << "ms"
+					  << (update.rebuilds ? " (rebuild)" : update.refits ? " (refit)" : "") << ", render "
+					  << render_seconds << "s, output " << output_seconds << "s -> " << path << "\n";
+		}
+
+		const int n = options.frames;
+		std::cerr << "sequence : " << n << " frames, setup " << setup_total << "s (" << setup_total / n * 1e3
+				  << "ms/frame, " << refits << " refits, " << rebuilds << " rebuilds), render " << render_total << "s ("
+				  << render_total / n << "s/frame), output " << output_total << "s\n";
+		for (const auto &bvh : world.dynamic_bvhs)
+			std::cerr << "bvh SAH cost : " << bvh->cost() << " (" << bvh->cost_after_build() << " after the last build)\n";
+
+		write_trace(options);
+		return 0;
+	}
+}
+
+int main(int argc, char **argv) {
+	const auto program_start = std::chrono::steady_clock::now();
+	render_options options;
+	if (!parse_options(argc, argv, options)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	texture_cache::instance().set_memory_limit(static_cast<size_t>(options.texture_cache_mb) << 20);
+	// worker 不写图像, 只替协调者渲染
+	if (!options.worker.empty())
+		return run_worker(options.worker, options.threads);
+
+#ifdef RT_ENABLE_TRACE
+	if (!options.trace.empty()) {
+		trace_recorder::instance().start();
+		RT_TRACE_THREAD_NAME("main");
+	}
+#else
+	if (!options.trace.empty())
+		std::cerr << "--trace needs a build with RT_ENABLE_TRACE=ON\n";
+#endif
+
+	scene world;
+	if (!make_scene(options.scene, world)) {
+		std::cerr << "ERROR: Unknown scene '" << options.scene << "'.\n";
+		return 1;
+	}
+
+	if (options.image_width > 0)
+		world.image_width = options.image_width;
+	if (options.samples_per_pixel > 0)
+		world.samples_per_pixel = options.samples_per_pixel;
+	if (options.fps > 0)
+		world.frame_rate = options.fps;
+	if (options.bvh_rebuild_ratio >= 0)
+		for (auto &bvh : world.dynamic_bvhs)
+			bvh->rebuild_ratio = options.bvh_rebuild_ratio;
+
+	// 光源在 --arena / --accel 改写场景之前按原来的类型找出来, 光子在改写后的场景中追踪
+	shared_ptr<caustic_cache> caustics;
+	if (options.caustic_photons > 0) {
+		caustics = make_shared<caustic_cache>(world, static_cast<size_t>(options.caustic_photons),
+											  options.caustic_radius);
+		if (!caustics->has_emitters()) {
+			std::cerr << "--caustics: no rect or sphere diffuse_light emitters in the scene, caustic cache is off\n";
+			caustics.reset();
+		}
+	}
+
+	if (options.arena) {
+		// 动画保存的是原来对象的指针, 搬走之后就不再起作用
+		if (options.frames > 0 && world.animate) {
+			std::cerr << "--arena is ignored for animated sequences\n";
+		} else {
+			const size_t heap_before = heap_bytes_in_use();
+			shared_ptr<scene_arena> arena;
+			world.world = scene_arena::compact(world.world, &arena);
+			const size_t heap_after = heap_bytes_in_use();
+
+			size_t pooled = 0;
+			for (const auto &pool : arena->usage())
+				pooled += pool.objects;
+			std::cerr << "arena: " << pooled << " objects in " << (arena->bytes() >> 10) << " KB of pools, "
+					  << arena->kept() << " kept as they were, heap " << (heap_before >> 10) << " -> "
+					  << (heap_after >> 10) << " KB\n";
+		}
+	}
+
+	if (options.accel == "packed" || options.accel == "lbvh" || options.accel == "qbvh") {
+		if (options.frames > 0 && world.animate) {
+			std::cerr << "--accel " << options.accel << " is ignored for animated sequences\n";
+		} else {
+			const auto method =
+					options.accel == "lbvh" ? packed_bvh::build_method::lbvh : packed_bvh::build_method::sah;
+			const auto format =
+					options.accel == "qbvh" ? packed_bvh::node_format::quantized : packed_bvh::node_format::binary;
+			const auto start = std::chrono::steady_clock::now();
+			auto packed = make_shared<packed_bvh>(world.world, 0.0, 1.0, method, format);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			const auto stats = packed->stats();
+			size_t prims = 0;
+			for (size_t count : stats.prims)
+				prims += count;
+			std::cerr << "packed bvh" << (method == packed_bvh::build_method::lbvh ? " (lbvh)" : "")
+					  << (stats.quantized ? " (quantized)" : "") << ": " << stats.nodes << " nodes, " << stats.leaves
+					  << " leaves, " << stats.prims[packed_bvh::sphere_prim] << " spheres, "
+					  << stats.prims[packed_bvh::moving_sphere_prim] << " moving spheres, "
+					  << stats.prims[packed_bvh::rect_prim] << " rects, " << stats.prims[packed_bvh::other_prim]
+					  << " other, " << (stats.node_bytes >> 10) << " KB of nodes ("
+					  << (prims ? static_cast<double>(stats.node_bytes) / prims : 0.0) << " B/primitive), built in "
+					  << seconds * 1000.0 << " ms\n";
+			if (format == packed_bvh::node_format::quantized && !stats.quantized)
+				std::cerr << "--accel qbvh: the scene has unbounded primitives, kept binary nodes\n";
+			world.world.clear();
+			world.world.add(packed);
+		}
+	}
+
+	shared_ptr<lazy_bvh> lazy;
+	if (options.accel == "lazy") {
+		if (options.frames > 0 && world.animate) {
+			std::cerr << "--accel lazy is ignored for animated sequences\n";
+		} else {
+			const auto start = std::chrono::steady_clock::now();
+			lazy = make_shared<lazy_bvh>(world.world, 0.0, 1.0);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cerr << "lazy bvh: " << lazy->stats().primitives << " primitives, ready in " << seconds * 1000.0
+					  << " ms\n";
+			world.world.clear();
+			world.world.add(lazy);
+		}
+	}
+
+	render_settings settings;
+	settings.width = world.image_width;
+	settings.height = world.image_height();
+	settings.threads = options.threads;
+	settings.sampling = options.sampling;
+	settings.seed = options.seed;
+	settings.numa = options.numa;
+
+	// 线性辐射度和降噪用的AOV
+	film frame;
+	allocate_film(frame, settings);
+	path_integrator integrator(world, settings.width, settings.height);
+	integrator.set_caustics(caustics);
+	if (options.integrator == "bdpt" && !integrator.set_kind(integrator_kind::bdpt))
+		std::cerr << "--integrator bdpt: no rect or sphere diffuse_light emitters in the scene, using path tracing\n";
+	shared_ptr<radiance_cache> radiance;
+	if (options.radiance_cache) {
+		if (integrator.kind() != integrator_kind::path) {
+			std::cerr << "--radiance-cache is only used by the path tracer\n";
+		} else {
+			radiance_cache::settings rc;
+			rc.bounce = options.radiance_cache_bounce;
+			rc.cell_size = options.radiance_cache_cell;
+			rc.min_samples = options.radiance_cache_samples;
+			rc.update_rate = options.radiance_cache_update;
+			radiance = make_shared<radiance_cache>(world.world, rc);
+			integrator.set_radiance_cache(radiance);
+			std::cerr << "radiance cache: cell " << radiance->config().cell_size << ", " << rc.min_samples
+					  << " samples per cell after " << rc.bounce << " diffuse bounce(s), "
+					  << (radiance->bytes() >> 20) << " MB\n";
+		}
+	}
+	shared_ptr<path_guide> guide;
+	if (options.guide) {
+		if (integrator.kind() != integrator_kind::path) {
+			std::cerr << "--guide is only used by the path tracer\n";
+		} else {
+			guide = make_shared<path_guide>(world.world, path_guide::settings());
+			integrator.set_guide(guide);
+		}
+	}
+
+	if (settings.numa) {
+		const auto &topo = numa_topology::system();
+		const int threads = render_threads(settings);
+		integrator.replicate_geometry(topo, threads);
+		std::cerr << "numa: " << topo.nodes() << " node(s), " << threads << " threads on "
+				  << topo.active_nodes(threads) << " node(s), cpus per node:";
+		for (const auto &cpus : topo.node_cpus)
+			std::cerr << ' ' << cpus.size();
+		std::cerr << "\n";
+	}
+
+	if (options.frames > 0) {
+		std::cerr << "scene: " << world.name << ", sampler: " << sampler_name(settings.sampling) << ", "
+				  << world.samples_per_pixel << " spp, " << options.frames << " frames at " << world.frame_rate
+				  << " fps\n";
+		settings.progress = false;
+		return render_sequence(world, integrator, frame, settings, options);
+	}
+
+	checkpoint_info resume_point;
+	resume_point.scene_hash = scene_hash(world, settings.width, settings.height);
+	resume_point.width = settings.width;
+	resume_point.height = settings.height;
+	resume_point.sampling = settings.sampling;
+	resume_point.seed = settings.seed;
+	if (options.resume) {
+		std::string error;
+		if (!read_checkpoint(options.checkpoint, frame, resume_point, error)) {
+			std::cerr << "ERROR: Could not resume from '" << options.checkpoint << "': " << error << ".\n";
+			return 1;
+		}
+		// 继续原来的样本序列, 否则前后两段样本不再是同一个低差异序列
+		settings.sampling = resume_point.sampling;
+		settings.seed = resume_point.seed;
+		std::cerr << "resuming from " << resume_point.samples_done << " spp\n";
+	}
+
+	std::ofstream output_file;
+	if (!options.output.empty()) {
+		output_file.open(options.output);
+		if (!output_file) {
+			std::cerr << "ERROR: Could not open output file '" << options.output << "'.\n";
+			return 1;
+		}
+	}
+	std::ostream &out = options.output.empty() ? std::cout : output_file;
+
+	RT_STATS(render_stats::instance().reset(settings.width, settings.height, settings.tiles_x() * settings.tiles_y()));
+
+	std::cerr << "scene: " << world.name << ", sampler: " << sampler_name(settings.sampling) << ", "
+			  << world.samples_per_pixel << " spp\n";
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	if (guide) {
+		// 训练算在渲染时间里
+		const int budget = options.guide_spp > 0 ? options.guide_spp : std::max(world.samples_per_pixel / 4, 1);
+		const double seconds = train_path_guide(integrator, *guide, settings, budget);
+		std::cerr << "path guide: trained in " << seconds << "s\n";
+	}
+
+	if (options.progressive) {
+		progressive_settings ps;
+		ps.target_spp = world.samples_per_pixel;
+		ps.time_limit = options.time_limit;
+		ps.noise_threshold = options.noise_threshold;
+		ps.preview_path = !options.preview.empty() ? options.preview
+							: options.output.empty() ? std::string("preview.ppm")
+													 : path_with_suffix(options.output, "_preview");
+		ps.preview_interval = options.preview_interval;
+		ps.preview_passes = options.preview_passes;
+		ps.checkpoint_path = options.checkpoint;
+		ps.checkpoint_interval = options.checkpoint_interval;
+		settings.progress = false;
+
+		const auto result = render_progressive(integrator, frame, settings, resume_point, ps, program_start);
+		std::cerr << "progressive: " << result.samples << " spp in " << result.passes << " passes, stopped at "
+				  << result.stop_reason << ", noise " << result.noise << ", time to first image "
+				  << result.first_image_seconds << "s\n";
+	} else if (!options.checkpoint.empty()) {
+		if (!options.coordinator.empty())
+			std::cerr << "--checkpoint renders locally, --coordinator is ignored\n";
+		settings.progress = false;
+		if (!render_with_checkpoints(integrator, frame, settings, resume_point, world.samples_per_pixel,
+									 options.checkpoint, options.checkpoint_interval))
+			return 1;
+	} else if (options.coordinator.empty()) {
+		render_pass(integrator, frame, settings, 0, world.samples_per_pixel);
+	} else {
+		distributed_settings ds;
+		ds.address = options.coordinator;
+		ds.job_tile_size = options.job_tile;
+		ds.job_samples = options.job_spp;
+		ds.local_workers = options.local_workers;
+		ds.threads = options.threads;
+		if (!run_coordinator(world, settings, ds, frame))
+			return 1;
+	}
+	if (lazy) {
+		const auto stats = lazy->stats();
+		std::cerr << "lazy bvh: " << stats.nodes << " of at most " << stats.max_nodes << " nodes built, " << stats.leaves
+				  << " leaves\n";
+	}
+	if (radiance)
+		std::cerr << "radiance cache: " << radiance->used() << " of " << radiance->config().cells << " cells used\n";
+
+	{
+		RT_TRACE_ZONE("output");
+		write_ppm(out, settings.width, settings.height, mean_image(frame));
+	}
+
+	const auto stop = std::chrono::high_resolution_clock::now();
+	const auto elapsed = std::chrono::duration<float, std::chrono::seconds::period>(stop - start).count();
+
+	std::cerr << "\n" << "duration : " << elapsed << "s\tDone.\n";
+
+#ifdef RT_ENABLE_STATS
+	render_stats::instance().print(std::cerr, elapsed);
+	if (!options.heatmap.empty()) {
+		if (render_stats::instance().write_heatmap(options.heatmap))
+			std::cerr << "heatmap -> " << options.heatmap << "\n";
+		else
+			std::cerr << "ERROR: Could not write heatmap '" << options.heatmap << "'.\n";
+	}
+#else
+	if (!options.heatmap.empty())
+		std::cerr << "--heatmap needs a build with RT_ENABLE_STATS=ON\n";
+#endif
+
+	const auto tex_stats = texture_cache::instance().stats();
+	if (tex_stats.misses > 0) {
+		std::cerr << "texture cache : " << tex_stats.misses << " tiles loaded, " << tex_stats.global_hits
+				  << " shared hits, " << tex_stats.evictions << " evicted, "
+				  << (texture_cache::instance().memory_used() >> 10) << " KB resident\n";
+	}
+
+	if (options.denoise) {
+		// 降噪结果写在输出图像旁边(parse_options 保证有 -o)
+		const auto denoised_path = path_with_suffix(options.output, "_denoised");
+
+		const auto denoise_start = std::chrono::high_resolution_clock::now();
+		std::vector<color> denoised;
+		atrous_denoiser().denoise(frame, denoised);
+		const auto denoise_stop = std::chrono::high_resolution_clock::now();
+
+		std::ofstream denoised_file(denoised_path);
+		write_ppm(denoised_file, settings.width, settings.height, denoised);
+
+		const auto denoise_elapsed = std::chrono::duration<float, std::chrono::seconds::period>(
+				denoise_stop - denoise_start).count();
+		std::cerr << "denoise : " << denoise_elapsed << "s\t-> " << denoised_path << "\n";
+	}
+
+	write_trace(options);
+}
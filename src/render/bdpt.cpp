@@ -0,0 +1,412 @@
+#include "render/integrator.h"
+#include "render/stats.h"
+
+#include "asset/material.h"
+#include "geometry/obn.h"
+
+#include <vector>
+
+/*
+ * 双向路径追踪(Veach 1997; 写法参照 pbrt-v3 的 BDPTIntegrator)。
+ * 顶点的 pdf 都换算成面积测度: pdf_fwd 为沿着子路径生成这个顶点的密度, pdf_rev 为从另一端反向生成它的密度,
+ * 多重重要性采样的权重由这两者的比值连乘得到。镜面(metal / dielectric)顶点的 pdf 记为 0, 不能用于连接。
+ *
+ * 与路径追踪的约定一致: 材质通过 material_table 求值, 非镜面材质的 BSDF * cos 为
+ * attenuation * scattering_pdf, 采样方向用 scatter 给出的 pdf; 镜面顶点直接乘 attenuation。
+ */
+
+namespace {
+	struct path_vertex {
+		enum kind_t { camera_vertex, light_vertex, surface_vertex };
+
+		kind_t kind = surface_vertex;
+		point3 p;
+		// 表面顶点为撞点的法线(朝向路径到来的一侧), 光源顶点为发光一侧的法线
+		vec3 n;
+		hit_record rec;
+		ray r_in;
+		// scatter 的结果
+		scatter_record srec;
+		color beta;
+		// 表面自身发出的辐射度(相机子路径撞到光源时)
+		color le;
+		bool delta = false;
+		// 非镜面、有 pdf 的表面, 可以和另一条子路径连接
+		bool connectible = false;
+		double pdf_fwd = 0;
+		double pdf_rev = 0;
+		// 所在的光源(emitter_list 的下标), 不在可采样的光源上时为 -1
+		int light = -1;
+	};
+
+	// 每个线程的两条子路径, 只在开始时分配一次
+	struct subpaths {
+		std::vector<path_vertex> camera, light;
+	};
+
+	subpaths &thread_subpaths(size_t length) {
+		thread_local subpaths paths;
+		if (paths.camera.size() < length) {
+			paths.camera.resize(length);
+			paths.light.resize(length);
+		}
+		return paths;
+	}
+
+	// 0 表示镜面或无法反向生成, 比值中当作 1
+	double remap0(double f) { return f != 0 ? f : 1; }
+
+	bool is_black(const color &c) { return c.x() == 0 && c.y() == 0 && c.z() == 0; }
+}
+
+bool path_integrator::set_kind(integrator_kind k) {
+	method = integrator_kind::path;
+	if (k == integrator_kind::bdpt) {
+		emitters = emitter_list(world.world);
+		if (emitters.empty())
+			return false;
+		splats.resize(image_width, image_height);
+		method = k;
+	}
+	return true;
+}
+
+color path_integrator::bdpt_color(const ray &camera_ray, first_hit_aov *aov) const {
+	const int max_depth = world.max_depth;
+	auto &paths = thread_subpaths(static_cast<size_t>(max_depth) + 2);
+	path_vertex *cam = paths.camera.data();
+	path_vertex *lgt = paths.light.data();
+	const camera &view = world.cam;
+	const double time = camera_ray.time();
+
+	// 整个画面(包括最后一个像素多出的部分)在焦平面上的面积, 相机方向的 pdf 和重要性都按它归一化
+	const double film_area = view.viewport_area() * image_width / (image_width - 1.0) * image_height /
+							 (image_height - 1.0);
+	const double lens_area = view.lens_area();
+	const double lens_pdf = lens_area > 0 ? 1.0 / lens_area : 1.0;
+	const double fd2 = view.focus_distance() * view.focus_distance();
+
+	// 从镜头上的 lens 方向 w 落在画面上时的 pdf(立体角), 并给出像素
+	auto camera_pdf_dir = [&](const point3 &lens, const vec3 &w, int *pi, int *pj) {
+		double s, t;
+		if (!view.project(lens, lens + w, s, t))
+			return 0.0;
+		const int i = static_cast<int>(std::floor(s * (image_width - 1.0)));
+		const int j = static_cast<int>(std::floor(t * (image_height - 1.0)));
+		if (i < 0 || i >= image_width || j < 0 || j >= image_height)
+			return 0.0;
+		if (pi) {
+			*pi = i;
+			*pj = j;
+		}
+		const double c = view.cos_theta(w);
+		return fd2 / (film_area * c * c * c);
+	};
+
+	// 立体角的 pdf 换算成 to 处的面积密度
+	auto convert_density = [](double pdf, const path_vertex &from, const path_vertex &to) {
+		const vec3 w = to.p - from.p;
+		const double dist2 = w.length_squared();
+		if (dist2 == 0)
+			return 0.0;
+		if (to.kind != path_vertex::camera_vertex)
+			pdf *= std::fabs(dot(to.n, w)) / std::sqrt(dist2);
+		return pdf / dist2;
+	};
+
+	// 非镜面表面的 BSDF * cos(n, w)
+	auto f_cos = [&](const path_vertex &v, const vec3 &w) {
+		return v.srec.attenuation * materials.scattering_pdf(v.rec.mat_ptr, v.r_in, v.rec, ray(v.p, w, time));
+	};
+
+	// 光源顶点 v 朝 to 发光的密度(面积测度)
+	auto pdf_light = [&](const path_vertex &v, const path_vertex &to) {
+		const vec3 w = to.p - v.p;
+		const double c = dot(v.n, unit_vector(w));
+		return c > 0 ? convert_density(c * INV_PI, v, to) : 0.0;
+	};
+
+	// 光源上的点 v 被光源采样选中的密度
+	auto pdf_light_origin = [&](const path_vertex &v) {
+		return v.light >= 0 ? emitters.pick_pdf(v.light) / emitters[v.light].area : 0.0;
+	};
+
+	// 从 v 出发生成 next 的密度(面积测度); 表面的 pdf 与来路无关, 所以不需要前一个顶点
+	auto pdf_to = [&](const path_vertex &v, const path_vertex &next) {
+		if (v.kind == path_vertex::light_vertex)
+			return pdf_light(v, next);
+		if (v.kind == path_vertex::camera_vertex)
+			return convert_density(camera_pdf_dir(v.p, next.p - v.p, nullptr, nullptr), v, next);
+		if (!v.connectible)
+			return 0.0;
+		return convert_density(v.srec.scatter_pdf()->value(next.p - v.p), v, next);
+	};
+
+	// 从 path[0] 出发沿 r 随机游走, 最多再加 max_vertices 个顶点, 返回加入的顶点数
+	auto random_walk = [&](ray r, color beta, double pdf_dir, path_vertex *path, int max_vertices,
+						   bool from_camera) {
+		int count = 0;
+		bool first_diffuse = from_camera && aov;
+		while (count < max_vertices) {
+			RT_STATS(render_stats::local().count_ray(count == 0 && from_camera ? ray_kind::camera
+																			  : ray_kind::secondary));
+			hit_record rec;
+			if (!geometry().hit(r, 0.001, infinity, rec)) {
+				if (from_camera) {
+					// 背景只能由相机子路径找到, 权重为 1, 记在一个没有表面的顶点上
+					path_vertex &v = path[count + 1];
+					v.kind = path_vertex::surface_vertex;
+					v.le = world.background;
+					v.beta = beta;
+					v.light = -1;
+					v.connectible = false;
+					v.delta = false;
+					v.p = r.at(1e6);
+					v.n = vec3(0);
+					v.pdf_fwd = v.pdf_rev = 0;
+					++count;
+				}
+				break;
+			}
+
+			path_vertex &prev = path[count];
+			path_vertex &v = path[count + 1];
+			++count;
+			v.kind = path_vertex::surface_vertex;
+			v.rec = rec;
+			v.p = rec.p;
+			v.n = rec.normal;
+			v.r_in = r;
+			v.beta = beta;
+			v.delta = false;
+			v.connectible = false;
+			v.light = -1;
+			v.le = color(0.0);
+			v.pdf_fwd = convert_density(pdf_dir, prev, v);
+			v.pdf_rev = 0;
+
+			const bool scattered = materials.scatter(rec.mat_ptr, r, v.rec, v.srec);
+			if (from_camera) {
+				v.le = materials.emitted(rec.mat_ptr, r, rec);
+				if (!is_black(v.le))
+					v.light = emitters.find(rec.mat_ptr, rec.p);
+			}
+			if (first_diffuse && (!scattered || !v.srec.is_specular)) {
+				if (scattered)
+					aov->albedo = aov->albedo * v.srec.attenuation;
+				aov->normal = rec.normal;
+				aov->depth = rec.t * r.direction().length();
+				first_diffuse = false;
+			}
+			// 最后一个顶点也可以连接, 只是不再继续走
+			v.connectible = scattered && !v.srec.is_specular && v.srec.scatter_pdf();
+			if (!scattered || count >= max_vertices)
+				break;
+
+			if (v.srec.is_specular) {
+				if (first_diffuse)
+					aov->albedo = aov->albedo * v.srec.attenuation;
+				v.delta = true;
+				beta = beta * v.srec.attenuation;
+				r = v.srec.specular_ray;
+				pdf_dir = 0;
+				prev.pdf_rev = 0;
+				continue;
+			}
+			if (!v.connectible)
+				break;
+
+			const vec3 wi = v.srec.scatter_pdf()->generate();
+			pdf_dir = v.srec.scatter_pdf()->value(wi);
+			const color f = f_cos(v, wi);
+			if (pdf_dir <= 0 || is_black(f))
+				break;
+			beta = beta * f / pdf_dir;
+			prev.pdf_rev = convert_density(v.srec.scatter_pdf()->value(-r.direction()), v, prev);
+			r = ray(v.p, wi, time);
+		}
+		return count;
+	};
+
+	// 相机子路径, 最多 max_depth 个表面顶点
+	cam[0].kind = path_vertex::camera_vertex;
+	cam[0].p = camera_ray.origin();
+	cam[0].beta = color(1.0);
+	cam[0].delta = false;
+	cam[0].connectible = false;
+	cam[0].light = -1;
+	cam[0].pdf_fwd = lens_pdf;
+	cam[0].pdf_rev = 0;
+	const int camera_vertices =
+			1 + random_walk(camera_ray, color(1.0), camera_pdf_dir(cam[0].p, camera_ray.direction(), nullptr, nullptr),
+							cam, max_depth, true);
+
+	// 光源子路径: 按功率选一个光源, 面上均匀地取点, 余弦分布的方向
+	int light_vertices = 0;
+	if (max_depth > 1) {
+		double pick_pdf;
+		const size_t which = emitters.pick(random_double(), pick_pdf);
+		const emitter &e = emitters[which];
+		point3 p;
+		vec3 n;
+		double u, v;
+		const double r1 = random_double();
+		const double r2 = random_double();
+		e.sample(r1, r2, p, n, u, v);
+		const color le = e.radiance(p, n, u, v);
+		onb uvw;
+		uvw.build_from_w(n);
+		const vec3 dir = uvw.local(random_cosine_direction());
+		const double pdf_pos = pick_pdf / e.area;
+		const double pdf_dir = dot(n, dir) * INV_PI;
+		if (pick_pdf > 0 && pdf_dir > 0 && !is_black(le)) {
+			lgt[0].kind = path_vertex::light_vertex;
+			lgt[0].p = p;
+			lgt[0].n = n;
+			lgt[0].le = le;
+			lgt[0].beta = le / pdf_pos;
+			lgt[0].delta = false;
+			lgt[0].connectible = false;
+			lgt[0].light = static_cast<int>(which);
+			lgt[0].pdf_fwd = pdf_pos;
+			lgt[0].pdf_rev = 0;
+			light_vertices = 1 + random_walk(ray(p, dir, time), le * (dot(n, dir) / (pdf_pos * pdf_dir)), pdf_dir,
+											 lgt, max_depth - 1, false);
+		}
+	}
+
+	// 连接方式 (s, t) 的权重, sampled 为 s = 1 时新采样的光源顶点或 t = 1 时镜头上的顶点
+	auto mis_weight = [&](int s, int t, const path_vertex &sampled) {
+		if (s + t == 2)
+			return 1.0;
+		const path_vertex &pt = t == 1 ? sampled : cam[t - 1];
+		const path_vertex *qs = s == 0 ? nullptr : s == 1 ? &sampled : &lgt[s - 1];
+		const path_vertex *pt_minus = t > 1 ? &cam[t - 2] : nullptr;
+		const path_vertex *qs_minus = s > 1 ? &lgt[s - 2] : nullptr;
+
+		// 连接处的四个 pdf_rev 按这条路径重新计算
+		const double pt_rev = qs ? pdf_to(*qs, pt) : pdf_light_origin(pt);
+		double pt_minus_rev = 0;
+		if (pt_minus) {
+			if (!qs) {
+				path_vertex as_light;
+				as_light.kind = path_vertex::light_vertex;
+				as_light.p = pt.p;
+				as_light.n = pt.n;
+				pt_minus_rev = pdf_light(as_light, *pt_minus);
+			} else {
+				pt_minus_rev = pdf_to(pt, *pt_minus);
+			}
+		}
+		const double qs_rev = qs ? pdf_to(pt, *qs) : 0;
+		const double qs_minus_rev = qs_minus ? pdf_to(*qs, *qs_minus) : 0;
+
+		auto cam_fwd = [&](int i) { return t == 1 && i == 0 ? sampled.pdf_fwd : cam[i].pdf_fwd; };
+		auto cam_rev = [&](int i) { return i == t - 1 ? pt_rev : i == t - 2 ? pt_minus_rev : cam[i].pdf_rev; };
+		auto cam_delta = [&](int i) { return i == t - 1 ? false : cam[i].delta; };
+		auto light_fwd = [&](int i) { return s == 1 && i == 0 ? sampled.pdf_fwd : lgt[i].pdf_fwd; };
+		auto light_rev = [&](int i) { return i == s - 1 ? qs_rev : i == s - 2 ? qs_minus_rev : lgt[i].pdf_rev; };
+		auto light_delta = [&](int i) { return i == s - 1 ? false : lgt[i].delta; };
+
+		double sum = 0, ri = 1;
+		for (int i = t - 1; i > 0; --i) {
+			ri *= remap0(cam_rev(i)) / remap0(cam_fwd(i));
+			if (!cam_delta(i) && !cam_delta(i - 1))
+				sum += ri;
+		}
+		ri = 1;
+		for (int i = s - 1; i >= 0; --i) {
+			ri *= remap0(light_rev(i)) / remap0(light_fwd(i));
+			if (!light_delta(i) && !(i > 0 && light_delta(i - 1)))
+				sum += ri;
+		}
+		return 1.0 / (1.0 + sum);
+	};
+
+	// p 到 q 之间没有遮挡
+	auto visible = [&](const point3 &p, const point3 &q) {
+		RT_STATS(render_stats::local().count_ray(ray_kind::light_probe));
+		const vec3 w = q - p;
+		const double dist = w.length();
+		hit_record rec;
+		return !geometry().hit(ray(p, w / dist, time), 0.001, dist - 0.001, rec);
+	};
+
+	color radiance(0.0);
+	for (int t = 1; t <= camera_vertices; ++t) {
+		for (int s = 0; s <= light_vertices; ++s) {
+			// 表面顶点数不超过路径追踪的 max_depth
+			if ((t == 1 && s <= 1) || s + t - 1 > max_depth)
+				continue;
+
+			if (s == 0) {
+				// 相机子路径自己撞到光源(或背景)
+				const path_vertex &pt = cam[t - 1];
+				if (is_black(pt.le))
+					continue;
+				const color l = pt.beta * pt.le;
+				radiance += pt.light >= 0 ? l * mis_weight(0, t, pt) : l;
+			} else if (t == 1) {
+				// 光源子路径的顶点连到镜头上, 贡献落在投影到的像素
+				const path_vertex &qs = lgt[s - 1];
+				if (!qs.connectible)
+					continue;
+				path_vertex lens;
+				lens.kind = path_vertex::camera_vertex;
+				const double r1 = random_double();
+				const double r2 = random_double();
+				lens.p = view.lens_point(r1, r2);
+				lens.pdf_fwd = lens_pdf;
+				int i, j;
+				const vec3 w = qs.p - lens.p;
+				if (camera_pdf_dir(lens.p, w, &i, &j) <= 0)
+					continue;
+				const double c = view.cos_theta(w);
+				// We * cos / (pdf_lens * dist^2), We = fd^2 / (film_area * cos^4 * lens_area)
+				const color l = qs.beta * f_cos(qs, -w) * (fd2 / (film_area * c * c * c * w.length_squared()));
+				if (is_black(l) || !visible(qs.p, lens.p))
+					continue;
+				splats.add(i, j, l * mis_weight(s, 1, lens));
+			} else if (s == 1) {
+				// 在光源上采一点, 连到相机子路径的顶点
+				const path_vertex &pt = cam[t - 1];
+				if (!pt.connectible)
+					continue;
+				double pick_pdf;
+				const size_t which = emitters.pick(random_double(), pick_pdf);
+				const emitter &e = emitters[which];
+				path_vertex light;
+				light.kind = path_vertex::light_vertex;
+				double u, v;
+				const double r1 = random_double();
+				const double r2 = random_double();
+				e.sample(r1, r2, light.p, light.n, u, v);
+				light.light = static_cast<int>(which);
+				light.pdf_fwd = pick_pdf / e.area;
+				const vec3 w = light.p - pt.p;
+				const double dist2 = w.length_squared();
+				const double cos_light = -dot(light.n, w) / std::sqrt(dist2);
+				if (pick_pdf <= 0 || cos_light <= 0)
+					continue;
+				const color l = pt.beta * f_cos(pt, w) * e.radiance(light.p, light.n, u, v) *
+								(cos_light / (dist2 * light.pdf_fwd));
+				if (is_black(l) || !visible(pt.p, light.p))
+					continue;
+				radiance += l * mis_weight(1, t, light);
+			} else {
+				// 两条子路径的内部顶点相连
+				const path_vertex &qs = lgt[s - 1];
+				const path_vertex &pt = cam[t - 1];
+				if (!qs.connectible || !pt.connectible)
+					continue;
+				const vec3 w = qs.p - pt.p;
+				const color l = qs.beta * f_cos(qs, -w) * f_cos(pt, w) * pt.beta / w.length_squared();
+				if (is_black(l) || !visible(pt.p, qs.p))
+					continue;
+				radiance += l * mis_weight(s, t, pt);
+			}
+		}
+	}
+	RT_STATS(render_stats::local().count_path(camera_vertices - 1));
+	return radiance;
+}
@@ -0,0 +1,172 @@
+#include "render/checkpoint.h"
+#include "utility/atomic_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+namespace {
+	const char checkpoint_magic[4] = {'R', 'T', 'C', 'K'};
+	const uint32_t checkpoint_version = 1;
+
+	struct checkpoint_header {
+		char magic[4];
+		uint32_t version;
+		uint64_t scene_hash;
+		int32_t width, height;
+		int32_t sampling;
+		uint32_t seed;
+		int32_t samples_done;
+		int32_t reserved;
+	};
+
+	static_assert(sizeof(vec3) == 3 * sizeof(double), "film 的数组按 double 直接读写");
+
+	// FNV-1a
+	struct hasher {
+		uint64_t value = 0xcbf29ce484222325ULL;
+
+		void bytes(const void *data, size_t size) {
+			auto p = static_cast<const unsigned char *>(data);
+			for (size_t k = 0; k < size; ++k) {
+				value ^= p[k];
+				value *= 0x100000001b3ULL;
+			}
+		}
+
+		template <typename T>
+		void add(const T &v) {
+			static_assert(std::is_trivially_copyable<T>::value, "只能哈希平凡类型");
+			bytes(&v, sizeof(T));
+		}
+
+		void add_box(const hittable &h) {
+			aabb box;
+			if (h.bounding_box(0.0, 1.0, box)) {
+				add(box.minimum);
+				add(box.maximum);
+			}
+		}
+	};
+
+	template <typename T, typename A>
+	bool write_array(atomic_file &file, const std::vector<T, A> &v) {
+		return file.write(v.data(), v.size() * sizeof(T));
+	}
+
+	template <typename T, typename A>
+	bool read_array(std::FILE *file, std::vector<T, A> &v) {
+		return std::fread(v.data(), sizeof(T), v.size(), file) == v.size();
+	}
+}
+
+uint64_t scene_hash(const scene &s, int width, int height) {
+	hasher h;
+	h.bytes(s.name.data(), s.name.size());
+	h.add(width);
+	h.add(height);
+	h.add(s.max_depth);
+	h.add(s.background);
+	h.add(s.cam);
+	h.add(s.world.objects.size());
+	h.add_box(s.world);
+	if (s.lights)
+		h.add_box(*s.lights);
+	return h.value;
+}
+
+bool write_checkpoint(const std::string &path, const film &f, const checkpoint_info &info) {
+	atomic_file file(path);
+	if (!file.is_open())
+		return false;
+
+	checkpoint_header header{};
+	std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+	header.version = checkpoint_version;
+	header.scene_hash = info.scene_hash;
+	header.width = info.width;
+	header.height = info.height;
+	header.sampling = static_cast<int32_t>(info.sampling);
+	header.seed = info.seed;
+	header.samples_done = info.samples_done;
+
+	const bool ok = file.write(&header, sizeof(header)) && write_array(file, f.radiance)
+					&& write_array(file, f.luminance_sq) && write_array(file, f.albedo) && write_array(file, f.normal)
+					&& write_array(file, f.depth) && write_array(file, f.samples);
+	return ok && file.commit();
+}
+
+bool read_checkpoint(const std::string &path, film &f, checkpoint_info &info, std::string &error) {
+	std::FILE *file = std::fopen(path.c_str(), "rb");
+	if (!file) {
+		error = "cannot open file";
+		return false;
+	}
+
+	checkpoint_header header;
+	if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, checkpoint_magic, 4) != 0) {
+		error = "not a checkpoint";
+		std::fclose(file);
+		return false;
+	}
+	if (header.version != checkpoint_version) {
+		error = "unsupported version " + std::to_string(header.version);
+		std::fclose(file);
+		return false;
+	}
+	if (header.scene_hash != info.scene_hash || header.width != info.width || header.height != info.height) {
+		error = "written for a different scene or resolution";
+		std::fclose(file);
+		return false;
+	}
+
+	info.sampling = static_cast<sampler_type>(header.sampling);
+	info.seed = header.seed;
+	info.samples_done = header.samples_done;
+
+	// 已经按这个尺寸分配过时不再重新分配, 保留 NUMA 模式下各行所在的节点
+	if (f.width != header.width || f.height != header.height)
+		f.resize(header.width, header.height);
+	const bool ok = read_array(file, f.radiance) && read_array(file, f.luminance_sq) && read_array(file, f.albedo)
+					&& read_array(file, f.normal) && read_array(file, f.depth) && read_array(file, f.samples);
+	std::fclose(file);
+	if (!ok)
+		error = "truncated";
+	return ok;
+}
+
+bool render_with_checkpoints(const path_integrator &integrator, film &f, const render_settings &settings,
+							 checkpoint_info &info, int target_spp, const std::string &path, double interval) {
+	using clock = std::chrono::steady_clock;
+	auto last_save = clock::now();
+	int pass = 1;
+
+	while (info.samples_done < target_spp) {
+		const int count = std::min(pass, target_spp - info.samples_done);
+		const double seconds = render_pass(integrator, f, settings, info.samples_done, count);
+		info.samples_done += count;
+
+		// 下一遍的样本数: 最多翻倍, 至少1
+		const double per_sample = seconds / count;
+		const double wanted = interval / 4 / std::max(per_sample, 1e-6);
+		pass = std::max(1, std::min(2 * count, static_cast<int>(wanted)));
+
+		std::cerr << "\rsamples: " << info.samples_done << "/" << target_spp << ' ' << std::flush;
+
+		const double since_save = std::chrono::duration<double>(clock::now() - last_save).count();
+		if (since_save >= interval || info.samples_done == target_spp) {
+			const auto save_start = clock::now();
+			if (!write_checkpoint(path, f, info)) {
+				std::cerr << "\nERROR: Could not write checkpoint '" << path << "'.\n";
+				return false;
+			}
+			last_save = clock::now();
+			std::cerr << "\ncheckpoint: " << info.samples_done << " spp -> " << path << " ("
+					  << std::chrono::duration<double>(last_save - save_start).count() << "s)\n";
+		}
+	}
+	return true;
+}
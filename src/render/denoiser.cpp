@@ -0,0 +1,216 @@
+#include "render/denoiser.h"
+#include "render/trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+	// 带边缘填充的单通道图像, 填充宽度足够容纳最大步长的5x5核, 内层循环因此不需要钳位下标
+	struct plane {
+		void resize(int w, int h, int p) {
+			pad = p;
+			stride = w + 2 * p;
+			rows = h + 2 * p;
+			data.assign(static_cast<size_t>(stride) * rows, 0.0f);
+		}
+
+		float *row(int y) { return data.data() + static_cast<size_t>(y + pad) * stride + pad; }
+
+		const float *row(int y) const { return data.data() + static_cast<size_t>(y + pad) * stride + pad; }
+
+		// 复制最外圈的像素到填充区(等价于钳位到边缘)
+		void replicate_edges(int w, int h) {
+			for (int y = 0; y < h; ++y) {
+				float *r = row(y);
+				std::fill(r - pad, r, r[0]);
+				std::fill(r + w, r + w + pad, r[w - 1]);
+			}
+			for (int y = -pad; y < 0; ++y)
+				std::memcpy(row(y) - pad, row(0) - pad, sizeof(float) * stride);
+			for (int y = h; y < h + pad; ++y)
+				std::memcpy(row(y) - pad, row(h - 1) - pad, sizeof(float) * stride);
+		}
+
+		std::vector<float> data;
+		int pad = 0, stride = 0, rows = 0;
+	};
+
+	// 只用于 x <= 0 的权重, 多项式近似 2^f, 没有函数调用所以可以向量化
+	inline float fast_exp(float x) {
+		x = std::max(x, -80.0f);
+		float t = x * 1.442695041f;
+		auto ti = static_cast<int32_t>(t);
+		ti -= (t < static_cast<float>(ti)) ? 1 : 0;
+		float f = t - static_cast<float>(ti);
+		float p = 1.0f + f * (0.6931472f + f * (0.2402265f + f * (0.05550411f + f * (0.009618129f + f * 0.001333355f))));
+		int32_t bits = (ti + 127) << 23;
+		float scale;
+		std::memcpy(&scale, &bits, sizeof(float));
+		return p * scale;
+	}
+
+	const float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+}
+
+void atrous_denoiser::denoise(const film &f, std::vector<color> &output) const {
+	RT_TRACE_ZONE("denoise");
+	const int w = f.width, h = f.height;
+	const int iterations = std::max(settings.iterations, 1);
+	const int pad = 2 << (iterations - 1);
+	const int tile = std::max(settings.tile_size, 8);
+
+	plane r[2], g[2], b[2], var[2], nx, ny, nz, z, var_blur;
+	for (int k = 0; k < 2; ++k) {
+		r[k].resize(w, h, pad);
+		g[k].resize(w, h, pad);
+		b[k].resize(w, h, pad);
+		var[k].resize(w, h, pad);
+	}
+	nx.resize(w, h, pad);
+	ny.resize(w, h, pad);
+	nz.resize(w, h, pad);
+	z.resize(w, h, pad);
+	var_blur.resize(w, h, pad);
+	std::vector<color> modulation(static_cast<size_t>(w) * h, color(1.0));
+
+	// 解调: 光照 = 辐射度 / 反照率
+#pragma omp parallel for
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const auto idx = f.index(x, y);
+			const int n = f.samples[idx];
+			if (n == 0)
+				continue;
+
+			color mean = f.radiance[idx] / n;
+			for (int c = 0; c < 3; ++c)
+				if (!(mean[c] == mean[c])) mean[c] = 0.0;
+
+			color alb = f.albedo[idx] / n;
+			color demod;
+			for (int c = 0; c < 3; ++c) {
+				modulation[idx][c] = alb[c] > 1e-3 ? alb[c] : 1.0;
+				demod[c] = mean[c] / modulation[idx][c];
+			}
+
+			// 均值的方差 = (E[l^2] - E[l]^2) / n
+			const double lum = film::luminance(mean);
+			const double lum_mod = std::max(film::luminance(modulation[idx]), 1e-3);
+			const double variance = std::max(f.luminance_sq[idx] / n - lum * lum, 0.0) / n;
+
+			vec3 normal = f.normal[idx];
+			if (normal.length_squared() > 0)
+				normal = unit_vector(normal);
+
+			r[0].row(y)[x] = static_cast<float>(demod.x());
+			g[0].row(y)[x] = static_cast<float>(demod.y());
+			b[0].row(y)[x] = static_cast<float>(demod.z());
+			var[0].row(y)[x] = static_cast<float>(variance / (lum_mod * lum_mod));
+			nx.row(y)[x] = static_cast<float>(normal.x());
+			ny.row(y)[x] = static_cast<float>(normal.y());
+			nz.row(y)[x] = static_cast<float>(normal.z());
+			z.row(y)[x] = static_cast<float>(f.depth[idx] / n);
+		}
+	}
+	nx.replicate_edges(w, h);
+	ny.replicate_edges(w, h);
+	nz.replicate_edges(w, h);
+	z.replicate_edges(w, h);
+
+	const int tiles_x = (w + tile - 1) / tile;
+	const int tiles_y = (h + tile - 1) / tile;
+	const float sigma_l = settings.sigma_luminance;
+	const float sigma_n = settings.sigma_normal;
+	const float sigma_z = settings.sigma_depth;
+
+	int src = 0;
+	for (int it = 0; it < iterations; ++it) {
+		const int step = 1 << it;
+		const int dst = src ^ 1;
+		r[src].replicate_edges(w, h);
+		g[src].replicate_edges(w, h);
+		b[src].replicate_edges(w, h);
+		var[src].replicate_edges(w, h);
+
+		// 方差先做一次3x3模糊, 单像素的方差估计噪声太大
+#pragma omp parallel for
+		for (int y = 0; y < h; ++y) {
+			const float *v0 = var[src].row(y - 1);
+			const float *v1 = var[src].row(y);
+			const float *v2 = var[src].row(y + 1);
+			float *out = var_blur.row(y);
+#pragma omp simd
+			for (int x = 0; x < w; ++x) {
+				out[x] = (v0[x - 1] + 2 * v0[x] + v0[x + 1]
+						  + 2 * v1[x - 1] + 4 * v1[x] + 2 * v1[x + 1]
+						  + v2[x - 1] + 2 * v2[x] + v2[x + 1]) * (1.0f / 16);
+			}
+		}
+
+#pragma omp parallel for schedule(dynamic)
+		for (int t = 0; t < tiles_x * tiles_y; ++t) {
+			const int x0 = (t % tiles_x) * tile, x1 = std::min(x0 + tile, w);
+			const int y0 = (t / tiles_x) * tile, y1 = std::min(y0 + tile, h);
+
+			for (int y = y0; y < y1; ++y) {
+				const float *cr = r[src].row(y), *cg = g[src].row(y), *cb = b[src].row(y);
+				const float *cnx = nx.row(y), *cny = ny.row(y), *cnz = nz.row(y), *cz = z.row(y);
+				const float *cvar = var_blur.row(y);
+				float *out_r = r[dst].row(y), *out_g = g[dst].row(y), *out_b = b[dst].row(y);
+				float *out_var = var[dst].row(y);
+
+#pragma omp simd
+				for (int x = x0; x < x1; ++x) {
+					const float lp = 0.2126f * cr[x] + 0.7152f * cg[x] + 0.0722f * cb[x];
+					const float inv_sigma_l = 1.0f / (sigma_l * std::sqrt(std::max(cvar[x], 0.0f)) + 1e-4f);
+					const float inv_sigma_z = 1.0f / (sigma_z * step * cz[x] + 1e-4f);
+					const float len_p = cnx[x] * cnx[x] + cny[x] * cny[x] + cnz[x] * cnz[x];
+
+					float sum_w = 0, sum_r = 0, sum_g = 0, sum_b = 0, sum_var = 0;
+					for (int dy = -2; dy <= 2; ++dy) {
+						const int qy = y + dy * step;
+						const float *qr = r[src].row(qy), *qg = g[src].row(qy), *qb = b[src].row(qy);
+						const float *qnx = nx.row(qy), *qny = ny.row(qy), *qnz = nz.row(qy), *qz = z.row(qy);
+						const float *qvar = var[src].row(qy);
+						for (int dx = -2; dx <= 2; ++dx) {
+							const int qx = x + dx * step;
+							const float lq = 0.2126f * qr[qx] + 0.7152f * qg[qx] + 0.0722f * qb[qx];
+							const float len_q = qnx[qx] * qnx[qx] + qny[qx] * qny[qx] + qnz[qx] * qnz[qx];
+							// 两边都没有几何体(法线为0)时视为同一平面, 一边没有时视为垂直
+							const float cos_n = cnx[x] * qnx[qx] + cny[x] * qny[qx] + cnz[x] * qnz[qx]
+												+ (1.0f - len_p) * (1.0f - len_q);
+							const float e = std::fabs(lp - lq) * inv_sigma_l
+											+ std::fabs(cz[x] - qz[qx]) * inv_sigma_z
+											+ sigma_n * std::max(1.0f - cos_n, 0.0f);
+							const float weight = kernel[dy + 2] * kernel[dx + 2] * fast_exp(-e);
+
+							sum_w += weight;
+							sum_r += weight * qr[qx];
+							sum_g += weight * qg[qx];
+							sum_b += weight * qb[qx];
+							sum_var += weight * weight * qvar[qx];
+						}
+					}
+
+					const float inv_w = 1.0f / sum_w;
+					out_r[x] = sum_r * inv_w;
+					out_g[x] = sum_g * inv_w;
+					out_b[x] = sum_b * inv_w;
+					out_var[x] = sum_var * inv_w * inv_w;
+				}
+			}
+		}
+		src = dst;
+	}
+
+	// 重新调制
+	output.assign(static_cast<size_t>(w) * h, color(0.0));
+#pragma omp parallel for
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const auto idx = f.index(x, y);
+			output[idx] = modulation[idx] * color(r[src].row(y)[x], g[src].row(y)[x], b[src].row(y)[x]);
+		}
+	}
+}
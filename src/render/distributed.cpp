@@ -0,0 +1,361 @@
+#include "render/distributed.h"
+#include "render/integrator.h"
+#include "utility/socket.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <cerrno>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	const uint32_t protocol_magic = 0x31575452;	// "RTW1"
+
+	enum class message_type : uint32_t {
+		setup = 1,		// 协调者 -> worker: 场景和分辨率
+		job = 2,		// 协调者 -> worker: 一个任务
+		result = 3,		// worker -> 协调者: job id 和像素
+		shutdown = 4,	// 协调者 -> worker: 退出
+	};
+
+	struct message_header {
+		uint32_t magic;
+		uint32_t type;
+		uint32_t size;	// 消息体的字节数
+	};
+
+	struct setup_message {
+		char scene[64];
+		int32_t width, height;
+		int32_t sampling;
+		uint32_t seed;
+	};
+
+	struct job_message {
+		uint32_t id;
+		int32_t x0, y0, x1, y1;
+		int32_t first_sample, sample_count;
+	};
+
+	// 结果消息的 job id 之后是块内逐行排列的像素, 按本机字节序(协调者和 worker 应是同一种架构)
+	struct tile_pixel {
+		float radiance[3];
+		float luminance_sq;
+		float albedo[3];
+		float normal[3];
+		float depth;
+		int32_t samples;
+	};
+
+	bool send_message(socket_stream &s, message_type type, const void *body, size_t size) {
+		const message_header h{protocol_magic, static_cast<uint32_t>(type), static_cast<uint32_t>(size)};
+		return s.send_all(&h, sizeof(h)) && (size == 0 || s.send_all(body, size));
+	}
+
+	bool recv_header(socket_stream &s, message_header &h) {
+		return s.recv_all(&h, sizeof(h)) && h.magic == protocol_magic;
+	}
+
+	tile_pixel pack(const pixel_samples &p) {
+		tile_pixel t;
+		for (int c = 0; c < 3; ++c) {
+			t.radiance[c] = static_cast<float>(p.radiance[c]);
+			t.albedo[c] = static_cast<float>(p.aov.albedo[c]);
+			t.normal[c] = static_cast<float>(p.aov.normal[c]);
+		}
+		t.luminance_sq = static_cast<float>(p.luminance_sq);
+		t.depth = static_cast<float>(p.aov.depth);
+		t.samples = p.count;
+		return t;
+	}
+}
+
+int run_worker(const std::string &address, int threads) {
+	socket_stream conn;
+	// 协调者可能还没开始监听
+	for (int attempt = 0; attempt < 100 && !conn.is_open(); ++attempt) {
+		conn = socket_stream::connect(address);
+		if (!conn.is_open())
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	if (!conn.is_open()) {
+		std::cerr << "ERROR: Could not connect to coordinator '" << address << "'.\n";
+		return 1;
+	}
+
+	message_header h;
+	setup_message setup;
+	if (!recv_header(conn, h) || h.type != static_cast<uint32_t>(message_type::setup) || h.size != sizeof(setup)
+		|| !conn.recv_all(&setup, sizeof(setup))) {
+		std::cerr << "ERROR: Bad setup message from coordinator.\n";
+		return 1;
+	}
+	setup.scene[sizeof(setup.scene) - 1] = '\0';
+
+	scene world;
+	if (!make_scene(setup.scene, world)) {
+		std::cerr << "ERROR: Unknown scene '" << setup.scene << "'.\n";
+		return 1;
+	}
+	world.image_width = setup.width;
+	path_integrator integrator(world, setup.width, setup.height);
+	const auto sampling = static_cast<sampler_type>(setup.sampling);
+
+	if (threads > 0)
+		omp_set_num_threads(threads);
+
+	std::vector<char> body;
+	while (recv_header(conn, h)) {
+		if (h.type == static_cast<uint32_t>(message_type::shutdown))
+			return 0;
+
+		job_message job;
+		if (h.type != static_cast<uint32_t>(message_type::job) || h.size != sizeof(job) || !conn.recv_all(&job, sizeof(job)))
+			break;
+
+		const int w = job.x1 - job.x0, rows = job.y1 - job.y0;
+		body.resize(sizeof(uint32_t) + sizeof(tile_pixel) * w * rows);
+		std::memcpy(body.data(), &job.id, sizeof(uint32_t));
+		auto pixels = reinterpret_cast<tile_pixel *>(body.data() + sizeof(uint32_t));
+
+#pragma omp parallel
+		{
+			auto smp = make_sampler(sampling, setup.seed);
+#pragma omp for schedule(dynamic)
+			for (int row = 0; row < rows; ++row) {
+				for (int col = 0; col < w; ++col) {
+					const auto p = integrator.sample_pixel(job.x0 + col, job.y0 + row, job.first_sample,
+														   job.sample_count, *smp);
+					pixels[row * w + col] = pack(p);
+				}
+			}
+		}
+
+		if (!send_message(conn, message_type::result, body.data(), body.size()))
+			break;
+	}
+
+	std::cerr << "ERROR: Lost connection to coordinator.\n";
+	return 1;
+}
+
+#ifdef _WIN32
+
+bool run_coordinator(const scene &, const render_settings &, const distributed_settings &, film &) {
+	std::cerr << "ERROR: Distributed rendering needs POSIX sockets.\n";
+	return false;
+}
+
+#else
+
+bool run_coordinator(const scene &s, const render_settings &settings, const distributed_settings &ds, film &f) {
+	// 向已经断开的 worker 写数据时返回错误, 而不是让进程退出
+	std::signal(SIGPIPE, SIG_IGN);
+
+	socket_stream listener = socket_stream::listen(ds.address);
+	if (!listener.is_open()) {
+		std::cerr << "ERROR: Could not listen on '" << ds.address << "'.\n";
+		return false;
+	}
+
+	// 协调者到这里还没有用过 OpenMP, 子进程可以安全地创建自己的线程池
+	std::vector<pid_t> children;
+	for (int k = 0; k < ds.local_workers; ++k) {
+		const pid_t pid = fork();
+		if (pid == 0) {
+			// 不经过析构函数, 否则会删掉协调者的套接字文件
+			::close(listener.handle());
+			_exit(run_worker(ds.address, ds.threads));
+		}
+		if (pid > 0)
+			children.push_back(pid);
+	}
+
+	// 任务: 从图像顶部开始的像素块, 每块再按样本区间切开
+	const int tile = std::max(ds.job_tile_size, 1);
+	const int spp = s.samples_per_pixel;
+	const int chunk = ds.job_samples > 0 ? std::min(ds.job_samples, spp) : spp;
+	const int chunks = (spp + chunk - 1) / chunk;
+	const int tiles_x = (settings.width + tile - 1) / tile;
+	const int tiles_y = (settings.height + tile - 1) / tile;
+	const int job_count = tiles_x * tiles_y * chunks;
+
+	std::vector<job_message> jobs(job_count);
+	for (int t = 0; t < tiles_x * tiles_y; ++t) {
+		const int x0 = (t % tiles_x) * tile, x1 = std::min(x0 + tile, settings.width);
+		const int y1 = settings.height - (t / tiles_x) * tile, y0 = std::max(y1 - tile, 0);
+		for (int c = 0; c < chunks; ++c) {
+			const int first = c * chunk;
+			jobs[t * chunks + c] = job_message{static_cast<uint32_t>(t * chunks + c), x0, y0, x1, y1, first,
+											   std::min(chunk, spp - first)};
+		}
+	}
+
+	std::deque<int> pending;
+	for (int id = 0; id < job_count; ++id)
+		pending.push_back(id);
+	std::vector<char> received(job_count, 0);
+	// 同一块的样本段必须按顺序累加(浮点加法不满足结合律), 先到的段在这里等待
+	std::vector<std::vector<tile_pixel>> waiting(job_count);
+	std::vector<int> next_chunk(tiles_x * tiles_y, 0);
+	int remaining = job_count;
+
+	auto accumulate = [&](int id, const std::vector<tile_pixel> &pixels) {
+		const auto &job = jobs[id];
+		const int w = job.x1 - job.x0;
+		for (int j = job.y0; j < job.y1; ++j) {
+			for (int i = job.x0; i < job.x1; ++i) {
+				const auto &p = pixels[(j - job.y0) * w + (i - job.x0)];
+				const first_hit_aov aov{color(p.albedo[0], p.albedo[1], p.albedo[2]),
+										vec3(p.normal[0], p.normal[1], p.normal[2]), p.depth};
+				f.add_samples(i, j, color(p.radiance[0], p.radiance[1], p.radiance[2]), p.luminance_sq, aov,
+							  p.samples);
+			}
+		}
+	};
+
+	auto merge = [&](int id, std::vector<tile_pixel> &&pixels) {
+		const int t = id / chunks;
+		waiting[id] = std::move(pixels);
+		while (next_chunk[t] < chunks && !waiting[t * chunks + next_chunk[t]].empty()) {
+			auto &ready = waiting[t * chunks + next_chunk[t]];
+			accumulate(t * chunks + next_chunk[t], ready);
+			std::vector<tile_pixel>().swap(ready);
+			++next_chunk[t];
+		}
+	};
+
+	setup_message setup{};
+	std::strncpy(setup.scene, s.name.c_str(), sizeof(setup.scene) - 1);
+	setup.width = settings.width;
+	setup.height = settings.height;
+	setup.sampling = static_cast<int32_t>(settings.sampling);
+	setup.seed = settings.seed;
+
+	struct worker_connection {
+		socket_stream conn;
+		std::vector<int> jobs;
+	};
+	std::vector<worker_connection> workers;
+
+	auto dispatch = [&](worker_connection &w) {
+		while (static_cast<int>(w.jobs.size()) < std::max(ds.jobs_in_flight, 1) && !pending.empty()) {
+			const int id = pending.front();
+			pending.pop_front();
+			if (received[id])
+				continue;
+			if (!send_message(w.conn, message_type::job, &jobs[id], sizeof(job_message))) {
+				pending.push_front(id);
+				return false;
+			}
+			w.jobs.push_back(id);
+		}
+		return true;
+	};
+
+	// 断开的 worker 手上的任务放回队列前面, 尽快重新分配
+	auto drop = [&](size_t k) {
+		auto &w = workers[k];
+		int requeued = 0;
+		for (auto it = w.jobs.rbegin(); it != w.jobs.rend(); ++it) {
+			if (!received[*it]) {
+				pending.push_front(*it);
+				++requeued;
+			}
+		}
+		std::cerr << "\nworker lost, " << requeued << " jobs requeued\n";
+		workers.erase(workers.begin() + static_cast<std::ptrdiff_t>(k));
+	};
+
+	const auto print_progress = [&]() {
+		if (settings.progress)
+			std::cerr << "\rjobs remaining: " << remaining << " (" << workers.size() << " workers) " << std::flush;
+	};
+
+	std::cerr << job_count << " jobs, waiting for workers on " << ds.address << "\n";
+	std::vector<pollfd> fds;
+	while (remaining > 0) {
+		fds.clear();
+		fds.push_back(pollfd{listener.handle(), POLLIN, 0});
+		for (auto &w : workers)
+			fds.push_back(pollfd{w.conn.handle(), POLLIN, 0});
+
+		if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+			std::cerr << "ERROR: poll failed.\n";
+			return false;
+		}
+
+		// 从后往前处理, 删除断开的 worker 不影响前面的下标
+		for (size_t k = workers.size(); k-- > 0;) {
+			if (!(fds[k + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			auto &w = workers[k];
+
+			message_header h;
+			uint32_t id = 0;
+			if (!recv_header(w.conn, h) || h.type != static_cast<uint32_t>(message_type::result)
+				|| h.size < sizeof(uint32_t) || !w.conn.recv_all(&id, sizeof(id)) || id >= static_cast<uint32_t>(job_count)) {
+				drop(k);
+				continue;
+			}
+			const auto &job = jobs[id];
+			std::vector<tile_pixel> pixels(static_cast<size_t>(job.x1 - job.x0) * (job.y1 - job.y0));
+			if (h.size != sizeof(uint32_t) + pixels.size() * sizeof(tile_pixel)
+				|| !w.conn.recv_all(pixels.data(), pixels.size() * sizeof(tile_pixel))) {
+				drop(k);
+				continue;
+			}
+
+			w.jobs.erase(std::remove(w.jobs.begin(), w.jobs.end(), static_cast<int>(id)), w.jobs.end());
+			if (!received[id]) {
+				received[id] = 1;
+				--remaining;
+				merge(static_cast<int>(id), std::move(pixels));
+				print_progress();
+			}
+		}
+
+		if (fds[0].revents & POLLIN) {
+			worker_connection w{listener.accept(), {}};
+			if (w.conn.is_open() && send_message(w.conn, message_type::setup, &setup, sizeof(setup)))
+				workers.push_back(std::move(w));
+		}
+
+		// 空闲的 worker 接手新任务和重新排队的任务
+		for (size_t k = workers.size(); k-- > 0;)
+			if (!dispatch(workers[k]))
+				drop(k);
+
+		// 本机 worker 全部退出而且没有其它 worker 时, 不会再有进展
+		if (!children.empty() && workers.empty()) {
+			children.erase(std::remove_if(children.begin(), children.end(), [](pid_t pid) {
+				return waitpid(pid, nullptr, WNOHANG) == pid;
+			}), children.end());
+			if (children.empty()) {
+				std::cerr << "\nERROR: All local workers exited with " << remaining << " jobs left.\n";
+				return false;
+			}
+		}
+	}
+
+	for (auto &w : workers)
+		send_message(w.conn, message_type::shutdown, nullptr, 0);
+	workers.clear();
+	for (pid_t pid : children)
+		waitpid(pid, nullptr, 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "render/emitters.h"
+#include "asset/light.h"
+#include "geometry/bvh.h"
+#include "shape/aarect.h"
+#include "shape/sphere.h"
+
+#include <typeinfo>
+
+void emitter::sample(double r1, double r2, point3 &p, vec3 &n, double &u, double &v) const {
+	if (kind == 0) {
+		u = r1;
+		v = r2;
+		const double a = a0 + u * (a1 - a0), b = b0 + v * (b1 - b0);
+		if (axis == 0) {
+			p = point3(a, b, k);
+			n = vec3(0, 0, sign);
+		} else if (axis == 1) {
+			p = point3(a, k, b);
+			n = vec3(0, sign, 0);
+		} else {
+			p = point3(k, a, b);
+			n = vec3(sign, 0, 0);
+		}
+	} else {
+		const double z = 1 - 2 * r1;
+		const double phi = 2 * PI * r2;
+		const double r = std::sqrt(std::max(0.0, 1 - z * z));
+		n = vec3(r * std::cos(phi), r * std::sin(phi), z);
+		p = center + radius * n;
+		sphere::get_sphere_uv(n, u, v);
+	}
+}
+
+color emitter::radiance(const point3 &p, const vec3 &n, double u, double v) const {
+	hit_record rec;
+	rec.p = p;
+	rec.normal = n;
+	rec.front_face = true;
+	rec.u = u;
+	rec.v = v;
+	return mat->emitted(ray(p + n, -n), rec, u, v, p);
+}
+
+emitter_list::emitter_list(const hittable_list &world) {
+	for (const auto &object : world.objects)
+		add(object, false);
+
+	double total = 0;
+	for (auto &e : items) {
+		// 按光源中心的辐射度乘面积选择
+		const point3 p = e.kind == 1 ? e.center : point3(0);
+		const color le = e.radiance(p, vec3(0, 1, 0), 0.5, 0.5);
+		total += e.area * (le.x() + le.y() + le.z()) / 3.0;
+		e.cdf = total;
+	}
+	for (auto &e : items)
+		e.cdf = total > 0 ? e.cdf / total : 1.0;
+}
+
+void emitter_list::add(const shared_ptr<hittable> &object, bool flipped) {
+	if (!object)
+		return;
+
+	const auto &type = typeid(*object);
+	if (type == typeid(hittable_list)) {
+		for (const auto &child : static_cast<const hittable_list &>(*object).objects)
+			add(child, flipped);
+		return;
+	}
+	if (type == typeid(bvh_node)) {
+		const auto &n = static_cast<const bvh_node &>(*object);
+		add(n.left, flipped);
+		if (n.right != n.left)
+			add(n.right, flipped);
+		return;
+	}
+	if (type == typeid(flip_face)) {
+		add(static_cast<const flip_face &>(*object).ptr, !flipped);
+		return;
+	}
+
+	emitter e{};
+	if (type == typeid(xy_rect)) {
+		const auto &q = static_cast<const xy_rect &>(*object);
+		e = {0, q.x0, q.x1, q.y0, q.y1, q.k, 0, 0, point3(0), 0, q.mp.get(), 0, 0};
+	} else if (type == typeid(xz_rect)) {
+		const auto &q = static_cast<const xz_rect &>(*object);
+		e = {0, q.x0, q.x1, q.z0, q.z1, q.k, 1, 0, point3(0), 0, q.mp.get(), 0, 0};
+	} else if (type == typeid(yz_rect)) {
+		const auto &q = static_cast<const yz_rect &>(*object);
+		e = {0, q.y0, q.y1, q.z0, q.z1, q.k, 2, 0, point3(0), 0, q.mp.get(), 0, 0};
+	} else if (type == typeid(sphere) && !flipped) {
+		const auto &s = static_cast<const sphere &>(*object);
+		e.kind = 1;
+		e.center = s.center;
+		e.radius = s.radius;
+		e.mat = s.mat_ptr.get();
+		e.area = 4 * PI * s.radius * s.radius;
+	} else {
+		return;
+	}
+	if (!e.mat || typeid(*e.mat) != typeid(diffuse_light))
+		return;
+
+	if (e.kind == 0) {
+		e.area = (e.a1 - e.a0) * (e.b1 - e.b0);
+		// 矩形的正面朝向 +轴, 光从正面射出; flip_face 之后从背面射出
+		e.sign = flipped ? -1.0 : 1.0;
+	}
+	items.push_back(e);
+}
+
+size_t emitter_list::pick(double r, double &pdf) const {
+	size_t which = 0;
+	while (which + 1 < items.size() && r >= items[which].cdf)
+		++which;
+	pdf = pick_pdf(which);
+	return which;
+}
+
+int emitter_list::find(const material *m, const point3 &p) const {
+	for (size_t k = 0; k < items.size(); ++k) {
+		const emitter &e = items[k];
+		if (e.mat != m)
+			continue;
+		if (e.kind == 1) {
+			if (std::fabs((p - e.center).length() - e.radius) <= 1e-4 * e.radius + 1e-6)
+				return static_cast<int>(k);
+			continue;
+		}
+		const int ka = e.axis == 0 ? 2 : e.axis == 1 ? 1 : 0;
+		const int aa = e.axis == 2 ? 1 : 0;
+		const int ba = e.axis == 0 ? 1 : 2;
+		const double eps = 1e-6 * (std::fabs(e.k) + 1.0);
+		if (std::fabs(p[ka] - e.k) <= eps && p[aa] >= e.a0 - eps && p[aa] <= e.a1 + eps && p[ba] >= e.b0 - eps &&
+			p[ba] <= e.b1 + eps)
+			return static_cast<int>(k);
+	}
+	return -1;
+}
+
+bool emitter_list::covers(const material *m) const {
+	for (const auto &e : items)
+		if (e.mat == m)
+			return true;
+	return false;
+}
@@ -0,0 +1,93 @@
+#include "render/image_io.h"
+#include "color.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+std::vector<color> mean_image(const film &f) {
+	std::vector<color> pixels(static_cast<size_t>(f.width) * f.height);
+	for (int j = 0; j < f.height; ++j) {
+		for (int i = 0; i < f.width; ++i) {
+			color c = f.mean_radiance(i, j);
+			for (int k = 0; k < 3; ++k)
+				if (c[k] != c[k]) c[k] = 0.0;
+			pixels[f.index(i, j)] = c;
+		}
+	}
+	return pixels;
+}
+
+void write_ppm(std::ostream &out, int width, int height, const std::vector<color> &pixels) {
+	out << "P3\n" << width << ' ' << height << "\n255\n";
+	for (int j = height - 1; j >= 0; --j) {
+		for (int i = 0; i < width; ++i) {
+			write_color(out, pixels[static_cast<size_t>(j) * width + i], 1);
+		}
+	}
+	out.flush();
+}
+
+namespace {
+	bool host_is_little_endian() {
+		const uint16_t probe = 1;
+		uint8_t first;
+		std::memcpy(&first, &probe, 1);
+		return first == 1;
+	}
+}
+
+bool write_pfm(const std::string &path, int width, int height, const std::vector<color> &pixels) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	// 比例因子为负表示小端
+	file << "PF\n" << width << ' ' << height << '\n' << (host_is_little_endian() ? "-1.0" : "1.0") << '\n';
+	std::vector<float> row(static_cast<size_t>(width) * 3);
+	for (int j = 0; j < height; ++j) {
+		for (int i = 0; i < width; ++i) {
+			const color &c = pixels[static_cast<size_t>(j) * width + i];
+			for (int k = 0; k < 3; ++k)
+				row[static_cast<size_t>(i) * 3 + k] = static_cast<float>(c[k]);
+		}
+		file.write(reinterpret_cast<const char *>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(float)));
+	}
+	return static_cast<bool>(file);
+}
+
+bool read_pfm(const std::string &path, int &width, int &height, std::vector<color> &pixels) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	std::string magic;
+	double scale = 0;
+	file >> magic >> width >> height >> scale;
+	// 头部之后只有一个空白字符
+	file.get();
+	if (!file || magic != "PF" || width <= 0 || height <= 0)
+		return false;
+
+	const bool swap = (scale < 0) != host_is_little_endian();
+	std::vector<float> row(static_cast<size_t>(width) * 3);
+	pixels.assign(static_cast<size_t>(width) * height, color(0.0));
+	for (int j = 0; j < height; ++j) {
+		file.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(float)));
+		if (!file)
+			return false;
+		for (int i = 0; i < width; ++i) {
+			for (int k = 0; k < 3; ++k) {
+				float value = row[static_cast<size_t>(i) * 3 + k];
+				if (swap) {
+					uint32_t bits;
+					std::memcpy(&bits, &value, sizeof(bits));
+					bits = (bits >> 24) | ((bits >> 8) & 0xff00u) | ((bits << 8) & 0xff0000u) | (bits << 24);
+					std::memcpy(&value, &bits, sizeof(bits));
+				}
+				pixels[static_cast<size_t>(j) * width + i][k] = value;
+			}
+		}
+	}
+	return true;
+}
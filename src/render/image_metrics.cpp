@@ -0,0 +1,284 @@
+#include "render/image_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+double rmse(const std::vector<color> &test, const std::vector<color> &reference) {
+	double sum = 0;
+	for (size_t k = 0; k < test.size(); ++k) {
+		const vec3 d = test[k] - reference[k];
+		sum += d.length_squared();
+	}
+	return std::sqrt(sum / (3.0 * static_cast<double>(test.size())));
+}
+
+double rel_mse(const std::vector<color> &test, const std::vector<color> &reference) {
+	double sum = 0;
+	for (size_t k = 0; k < test.size(); ++k) {
+		for (int c = 0; c < 3; ++c) {
+			const double d = test[k][c] - reference[k][c];
+			sum += d * d / (reference[k][c] * reference[k][c] + 0.01);
+		}
+	}
+	return sum / (3.0 * static_cast<double>(test.size()));
+}
+
+double relative_noise(const film &f) {
+	double sum = 0;
+	size_t pixels = 0;
+	for (size_t k = 0; k < f.samples.size(); ++k) {
+		const int n = f.samples[k];
+		if (n < 2)
+			continue;
+		const double mean = film::luminance(f.radiance[k]) / n;
+		if (mean != mean)
+			continue;
+		const double variance = std::max(f.luminance_sq[k] / n - mean * mean, 0.0) / (n - 1);
+		sum += std::sqrt(variance) / (std::fabs(mean) + 0.01);
+		++pixels;
+	}
+	return pixels > 0 ? sum / static_cast<double>(pixels) : infinity;
+}
+
+namespace {
+	// 单通道浮点图像
+	struct channel {
+		int width = 0, height = 0;
+		std::vector<float> data;
+
+		channel() = default;
+
+		channel(int w, int h) : width(w), height(h), data(static_cast<size_t>(w) * h, 0.0f) {}
+
+		float &at(int x, int y) { return data[static_cast<size_t>(y) * width + x]; }
+
+		float at(int x, int y) const { return data[static_cast<size_t>(y) * width + x]; }
+	};
+
+	// 可分离卷积, 边界钳位到最外圈像素; kernel 的长度为 2 * radius + 1
+	channel convolve(const channel &in, const std::vector<float> &kx, const std::vector<float> &ky) {
+		const int w = in.width, h = in.height;
+		const int rx = static_cast<int>(kx.size() / 2), ry = static_cast<int>(ky.size() / 2);
+		channel tmp(w, h), out(w, h);
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				float sum = 0;
+				for (int k = -rx; k <= rx; ++k)
+					sum += kx[k + rx] * in.at(std::clamp(x + k, 0, w - 1), y);
+				tmp.at(x, y) = sum;
+			}
+		}
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				float sum = 0;
+				for (int k = -ry; k <= ry; ++k)
+					sum += ky[k + ry] * tmp.at(x, std::clamp(y + k, 0, h - 1));
+				out.at(x, y) = sum;
+			}
+		}
+		return out;
+	}
+
+	// D65 白点
+	const double white_x = 0.950428545, white_y = 1.0, white_z = 1.088900371;
+
+	vec3 linear_rgb_to_xyz(const vec3 &c) {
+		return vec3(0.4124564 * c[0] + 0.3575761 * c[1] + 0.1804375 * c[2],
+					0.2126729 * c[0] + 0.7151522 * c[1] + 0.0721750 * c[2],
+					0.0193339 * c[0] + 0.1191920 * c[1] + 0.9503041 * c[2]);
+	}
+
+	vec3 xyz_to_linear_rgb(const vec3 &c) {
+		return vec3(3.2404542 * c[0] - 1.5371385 * c[1] - 0.4985314 * c[2],
+					-0.9692660 * c[0] + 1.8760108 * c[1] + 0.0415560 * c[2],
+					0.0556434 * c[0] - 0.2040259 * c[1] + 1.0572252 * c[2]);
+	}
+
+	vec3 xyz_to_ycxcz(const vec3 &c) {
+		const double y = c[1] / white_y;
+		return vec3(116.0 * y - 16.0, 500.0 * (c[0] / white_x - y), 200.0 * (y - c[2] / white_z));
+	}
+
+	vec3 ycxcz_to_xyz(const vec3 &c) {
+		const double y = (c[0] + 16.0) / 116.0;
+		return vec3((c[1] / 500.0 + y) * white_x, y * white_y, (y - c[2] / 200.0) * white_z);
+	}
+
+	vec3 xyz_to_lab(const vec3 &c) {
+		auto f = [](double t) {
+			const double delta = 6.0 / 29.0;
+			return t > delta * delta * delta ? std::cbrt(t) : t / (3.0 * delta * delta) + 4.0 / 29.0;
+		};
+		const double fx = f(c[0] / white_x), fy = f(c[1] / white_y), fz = f(c[2] / white_z);
+		return vec3(116.0 * fy - 16.0, 500.0 * (fx - fy), 200.0 * (fy - fz));
+	}
+
+	// Hunt 效应: 暗处的色差不那么明显
+	vec3 hunt_adjust(const vec3 &lab) {
+		return vec3(lab[0], 0.01 * lab[0] * lab[1], 0.01 * lab[0] * lab[2]);
+	}
+
+	double hyab(const vec3 &a, const vec3 &b) {
+		const double da = a[1] - b[1], db = a[2] - b[2];
+		return std::fabs(a[0] - b[0]) + std::sqrt(da * da + db * db);
+	}
+
+	double srgb_to_linear(double c) {
+		return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+	}
+
+	// 与 write_color 相同的显示值, 再按 sRGB 解码
+	vec3 display_linear(const color &radiance) {
+		vec3 c;
+		for (int k = 0; k < 3; ++k) {
+			const double v = radiance[k] == radiance[k] ? radiance[k] : 0.0;
+			c[k] = srgb_to_linear(std::sqrt(std::clamp(v, 0.0, 1.0)));
+		}
+		return c;
+	}
+
+	// 对比敏感度函数的空间滤波, 每个通道是一个或两个高斯的和(以视角的度为单位)
+	struct csf_params {
+		double a1, b1, a2, b2;
+	};
+
+	const csf_params csf[3] = {
+			{1.0, 0.0047, 0.0, 1e-5},	// 亮度
+			{1.0, 0.0053, 0.0, 1e-5},	// 红-绿
+			{34.1, 0.04, 13.5, 0.025},	// 蓝-黄
+	};
+
+	channel csf_filter(const channel &in, const csf_params &p, double ppd) {
+		const double max_b = std::max(p.b1, p.b2);
+		const int radius = static_cast<int>(std::ceil(3.0 * std::sqrt(max_b / (2.0 * PI * PI)) * ppd));
+
+		auto gaussian = [&](double b) {
+			std::vector<float> g(2 * radius + 1);
+			for (int k = -radius; k <= radius; ++k) {
+				const double x = k / ppd;
+				g[k + radius] = static_cast<float>(std::exp(-PI * PI * x * x / b));
+			}
+			return g;
+		};
+		auto sum_of = [](const std::vector<float> &g) {
+			double s = 0;
+			for (float v : g) s += v;
+			return s;
+		};
+
+		// 二维核 = c1 * g1(x)g1(y) + c2 * g2(x)g2(y), 整体归一化
+		const auto g1 = gaussian(p.b1);
+		const double c1 = p.a1 * std::sqrt(PI / p.b1);
+		const double s1 = sum_of(g1);
+		channel out = convolve(in, g1, g1);
+		double total = c1 * s1 * s1;
+		if (p.a2 > 0) {
+			const auto g2 = gaussian(p.b2);
+			const double c2 = p.a2 * std::sqrt(PI / p.b2);
+			const double s2 = sum_of(g2);
+			const channel second = convolve(in, g2, g2);
+			for (size_t k = 0; k < out.data.size(); ++k)
+				out.data[k] = static_cast<float>(c1 * out.data[k] + c2 * second.data[k]);
+			total += c2 * s2 * s2;
+			for (auto &v : out.data)
+				v = static_cast<float>(v / total);
+		} else {
+			for (auto &v : out.data)
+				v = static_cast<float>(v / (s1 * s1));
+		}
+		return out;
+	}
+
+	// 正、负权重分别归一化到 1 和 -1
+	void normalize_signed(std::vector<float> &k) {
+		double pos = 0, neg = 0;
+		for (float v : k) (v > 0 ? pos : neg) += v;
+		for (auto &v : k) {
+			if (v > 0) v = static_cast<float>(v / pos);
+			else if (v < 0) v = static_cast<float>(v / -neg);
+		}
+	}
+
+	// 边缘(一阶导)和点(二阶导)特征的强度
+	void feature_strength(const channel &luma, double ppd, channel &edge, channel &point) {
+		const double sigma = 0.5 * 0.082 * ppd;
+		const int radius = static_cast<int>(std::ceil(3.0 * sigma));
+		std::vector<float> g(2 * radius + 1), dg(2 * radius + 1), ddg(2 * radius + 1);
+		double g_sum = 0;
+		for (int k = -radius; k <= radius; ++k) {
+			const double x = k, e = std::exp(-x * x / (2.0 * sigma * sigma));
+			g[k + radius] = static_cast<float>(e);
+			dg[k + radius] = static_cast<float>(-x * e);
+			ddg[k + radius] = static_cast<float>((x * x / (sigma * sigma) - 1.0) * e);
+			g_sum += e;
+		}
+		for (auto &v : g) v = static_cast<float>(v / g_sum);
+		normalize_signed(dg);
+		normalize_signed(ddg);
+
+		const channel ex = convolve(luma, dg, g), ey = convolve(luma, g, dg);
+		const channel px = convolve(luma, ddg, g), py = convolve(luma, g, ddg);
+		edge = channel(luma.width, luma.height);
+		point = channel(luma.width, luma.height);
+		for (size_t k = 0; k < luma.data.size(); ++k) {
+			edge.data[k] = std::sqrt(ex.data[k] * ex.data[k] + ey.data[k] * ey.data[k]);
+			point.data[k] = std::sqrt(px.data[k] * px.data[k] + py.data[k] * py.data[k]);
+		}
+	}
+}
+
+double flip_error(const std::vector<color> &test, const std::vector<color> &reference, int width, int height,
+				  double pixels_per_degree) {
+	const size_t n = static_cast<size_t>(width) * height;
+	const double qc = 0.7, qf = 0.5, pc = 0.4, pt = 0.95;
+
+	// 最大色差取绿色和蓝色之间的距离
+	const double cmax = std::pow(hyab(hunt_adjust(xyz_to_lab(linear_rgb_to_xyz(vec3(0, 1, 0)))),
+									  hunt_adjust(xyz_to_lab(linear_rgb_to_xyz(vec3(0, 0, 1))))), qc);
+
+	std::vector<vec3> lab[2];
+	channel luma[2];
+	const std::vector<color> *images[2] = {&test, &reference};
+	for (int m = 0; m < 2; ++m) {
+		channel opponent[3] = {channel(width, height), channel(width, height), channel(width, height)};
+		luma[m] = channel(width, height);
+		for (size_t k = 0; k < n; ++k) {
+			const vec3 xyz = linear_rgb_to_xyz(display_linear((*images[m])[k]));
+			const vec3 ycc = xyz_to_ycxcz(xyz);
+			for (int c = 0; c < 3; ++c)
+				opponent[c].data[k] = static_cast<float>(ycc[c]);
+			luma[m].data[k] = static_cast<float>(xyz[1] / white_y);
+		}
+
+		channel filtered[3];
+		for (int c = 0; c < 3; ++c)
+			filtered[c] = csf_filter(opponent[c], csf[c], pixels_per_degree);
+
+		lab[m].resize(n);
+		for (size_t k = 0; k < n; ++k) {
+			vec3 rgb = xyz_to_linear_rgb(ycxcz_to_xyz(vec3(filtered[0].data[k], filtered[1].data[k], filtered[2].data[k])));
+			for (int c = 0; c < 3; ++c)
+				rgb[c] = std::clamp(rgb[c], 0.0, 1.0);
+			lab[m][k] = hunt_adjust(xyz_to_lab(linear_rgb_to_xyz(rgb)));
+		}
+	}
+
+	channel edge[2], point[2];
+	for (int m = 0; m < 2; ++m)
+		feature_strength(luma[m], pixels_per_degree, edge[m], point[m]);
+
+	double sum = 0;
+	for (size_t k = 0; k < n; ++k) {
+		// 颜色误差压缩到 [0, 1]: 小色差线性放大, 大色差逐渐饱和
+		const double d = std::pow(hyab(lab[0][k], lab[1][k]), qc);
+		const double color_error = d < pc * cmax ? pt / (pc * cmax) * d
+												 : pt + (d - pc * cmax) / (cmax - pc * cmax) * (1.0 - pt);
+
+		const double feature_error = std::pow(
+				std::max(std::fabs(edge[0].data[k] - edge[1].data[k]), std::fabs(point[0].data[k] - point[1].data[k]))
+				/ std::sqrt(2.0), qf);
+
+		sum += std::pow(std::min(color_error, 1.0), 1.0 - feature_error);
+	}
+	return sum / static_cast<double>(n);
+}
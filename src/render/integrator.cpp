@@ -0,0 +1,170 @@
+#include "render/integrator.h"
+#include "render/stats.h"
+
+#include "geometry/bvh.h"
+#include "geometry/pdf.h"
+#include "asset/material.h"
+
+#include <thread>
+
+color path_integrator::ray_color(const ray &r, int depth, sampler &smp, first_hit_aov *aov,
+								 const ray_differential *diff, path_state state) const {
+	hit_record rec;
+	const int max_depth = world.max_depth;
+
+	// If we've exceeded the ray bounce limit, no more light is gathered.
+	if (depth <= 0) {
+		RT_STATS(render_stats::local().count_path(max_depth));
+		return color(0, 0, 0);
+	}
+
+	RT_STATS(render_stats::local().count_ray(depth == max_depth ? ray_kind::camera : ray_kind::secondary));
+	if (!geometry().hit(r, 0.001, infinity, rec)) {
+		RT_STATS(render_stats::local().count_path(max_depth - depth + 1));
+		return world.background;
+	}
+
+	if (diff)
+		rec.compute_uv_footprint(r, *diff);
+
+	scatter_record srec;
+	color emitted = materials.emitted(rec.mat_ptr, r, rec);
+	const bool use_caustics = caustics && caustics->active();
+	if (use_caustics && state.from == path_origin::specular_after_diffuse && caustics->covers(rec.mat_ptr))
+		emitted = color(0, 0, 0);
+	if (!materials.scatter(rec.mat_ptr, r, rec, srec)) {
+		if (aov) {
+			aov->normal = rec.normal;
+			aov->depth = rec.t * r.direction().length();
+		}
+		RT_STATS(render_stats::local().count_path(max_depth - depth + 1));
+		return emitted;
+	}
+
+	if (srec.is_specular) {
+		if (aov)
+			aov->albedo = aov->albedo * srec.attenuation;
+		path_state next = state;
+		if (state.from != path_origin::camera)
+			next.from = path_origin::specular_after_diffuse;
+		return srec.attenuation * ray_color(srec.specular_ray, depth - 1, smp, aov, nullptr, next);
+	}
+
+	if (aov) {
+		aov->albedo = aov->albedo * srec.attenuation;
+		aov->normal = rec.normal;
+		aov->depth = rec.t * r.direction().length();
+	}
+
+	// 焦散: 半径内光子的功率乘 BRDF, scattering_pdf / cos 就是 BRDF
+	if (use_caustics) {
+		const color flux = caustics->photons().gather(rec.p, rec.normal, caustics->radius(), [&](const vec3 &wi) {
+			const double cosine = dot(rec.normal, wi);
+			return cosine > 0 ? materials.scattering_pdf(rec.mat_ptr, r, rec, ray(rec.p, wi, r.time())) / cosine : 0.0;
+		});
+		emitted += srec.attenuation * flux * caustics->density_scale();
+	}
+
+	// 辐射度缓存: 格子可用时路径到此结束, 偶尔照常追踪以继续更新
+	const bool use_cache = radiance && state.diffuse_bounces >= radiance->config().bounce &&
+						   !radiance->too_close(rec.t * r.direction().length());
+	if (use_cache) {
+		color cached;
+		if (radiance->lookup(rec.p, rec.normal, cached) && random_double() >= radiance->config().update_rate) {
+			RT_STATS(render_stats::local().count_path(max_depth - depth + 1));
+			return emitted + srec.attenuation * cached;
+		}
+	}
+
+	auto light_ptr = make_shared<hittable_pdf>(world.lights, rec.p);
+	mixture_pdf p(light_ptr, shared_ptr<pdf>(shared_ptr<pdf>(), srec.scatter_pdf()));
+
+	smp.start_bounce(max_depth - depth);
+	ray scattered;
+	double pdf_val;
+	if (guide && guide->ready()) {
+		// 路径引导: 学到的方向分布与光源/BSDF 的混合各占一半
+		guide_pdf g(guide->distribution(rec.p));
+		mixture_pdf guided(shared_ptr<pdf>(shared_ptr<pdf>(), &g), shared_ptr<pdf>(shared_ptr<pdf>(), &p));
+		scattered = ray(rec.p, guided.generate(smp), r.time());
+		pdf_val = guided.value(scattered.direction());
+		// 方向树覆盖整个球面, 落到表面下面的方向没有贡献, 不再追踪
+		if (dot(scattered.direction(), rec.normal) <= 0) {
+			RT_STATS(render_stats::local().count_path(max_depth - depth + 1));
+			return emitted;
+		}
+	} else {
+		scattered = ray(rec.p, p.generate(smp), r.time());
+		pdf_val = p.value(scattered.direction());
+	}
+
+	// Monte-Carlo BRDF
+	const path_state next{path_origin::diffuse, state.diffuse_bounces + 1};
+	const bool learning = guide && guide->training();
+	if (use_cache || learning) {
+		// 缓存存的是乘反照率之前的入射部分; 引导记录沿这个方向带回的亮度除以 pdf
+		const color li = ray_color(scattered, depth - 1, smp, nullptr, nullptr, next);
+		const color incident = materials.scattering_pdf(rec.mat_ptr, r, rec, scattered) * li / pdf_val;
+		if (use_cache)
+			radiance->add(rec.p, rec.normal, incident);
+		if (learning)
+			guide->record(rec.p, unit_vector(scattered.direction()), film::luminance(li) / pdf_val);
+		return emitted + srec.attenuation * incident;
+	}
+	return emitted
+		+ srec.attenuation * materials.scattering_pdf(rec.mat_ptr, r, rec, scattered)
+			* ray_color(scattered, depth - 1, smp, nullptr, nullptr, next) / pdf_val;
+}
+
+pixel_samples path_integrator::sample_pixel(int i, int j, int first_sample, int count, sampler &smp) const {
+	pixel_samples result;
+	result.count = count;
+
+	const double du_pixel = 1.0 / (image_width - 1.0);
+	const double dv_pixel = 1.0 / (image_height - 1.0);
+
+	for (int s = first_sample; s < first_sample + count; ++s) {
+		smp.start_pixel_sample(i, j, s);
+		auto [du, dv] = smp.get_2d();
+		double u = (i + du) / (image_width - 1.0);
+		double v = (j + dv) / (image_height - 1.0);
+		ray_differential diff;
+		ray r = world.cam.get_ray(u, v, du_pixel, dv_pixel, smp, diff);
+
+		first_hit_aov aov;
+		color sample = method == integrator_kind::bdpt ? bdpt_color(r, &aov)
+													   : ray_color(r, world.max_depth, smp, &aov, &diff);
+		// NaN的样本直接丢弃, 否则会污染整个像素
+		if (sample.x() != sample.x() || sample.y() != sample.y() || sample.z() != sample.z())
+			sample = color(0, 0, 0);
+
+		result.radiance += sample;
+		result.luminance_sq += film::luminance(sample) * film::luminance(sample);
+		result.aov.albedo += aov.albedo;
+		result.aov.normal += aov.normal;
+		result.aov.depth += aov.depth;
+	}
+	return result;
+}
+
+void path_integrator::replicate_geometry(const numa_topology &topo, int threads) {
+	replicas.clear();
+	const int nodes = topo.active_nodes(threads);
+	if (nodes < 2)
+		return;
+
+	replicas.resize(nodes);
+	std::vector<std::thread> copiers;
+	for (int node = 0; node < nodes; ++node) {
+		copiers.emplace_back([this, &topo, node]() {
+			// 在目标节点上分配, 新节点的页面由本线程第一次写入
+			pin_thread(topo.node_cpus[node].front(), node);
+			for (const auto &object : world.world.objects) {
+				auto tree = std::dynamic_pointer_cast<bvh_node>(object);
+				replicas[node].add(tree ? tree->clone() : object);
+			}
+		});
+	}
+	for (auto &t : copiers)
+		t.join();
+}
@@ -0,0 +1,269 @@
+#include "render/path_guide.h"
+#include "utility/atomic_float.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// 等面积映射: u = (cos theta + 1) / 2, v = phi / 2pi, 正方形上的面积乘 4pi 就是立体角
+	void to_square(const vec3 &dir, double &u, double &v) {
+		u = std::clamp((dir.z() + 1) * 0.5, 0.0, 1.0);
+		double phi = std::atan2(dir.y(), dir.x());
+		if (phi < 0)
+			phi += 2 * PI;
+		v = std::clamp(phi / (2 * PI), 0.0, 1.0);
+	}
+
+	vec3 from_square(double u, double v) {
+		const double z = 2 * u - 1;
+		const double r = std::sqrt(std::max(0.0, 1 - z * z));
+		const double phi = 2 * PI * v;
+		return vec3(r * std::cos(phi), r * std::sin(phi), z);
+	}
+
+	// 点在当前节点的哪个象限: 低位是 u 方向, 高位是 v 方向; 同时把坐标缩放到子节点内
+	int quadrant(double &u, double &v) {
+		int q = 0;
+		if (u >= 0.5) {
+			q |= 1;
+			u -= 0.5;
+		}
+		if (v >= 0.5) {
+			q |= 2;
+			v -= 0.5;
+		}
+		u = std::min(2 * u, 1.0);
+		v = std::min(2 * v, 1.0);
+		return q;
+	}
+
+	const double one_minus_epsilon = 0x1.fffffffffffffp-1;
+}
+
+double direction_tree::pdf(const vec3 &dir) const {
+	double u, v;
+	to_square(dir, u, v);
+
+	double p = 1;
+	uint32_t n = 0;
+	for (;;) {
+		const node &nd = nodes[n];
+		const double total = nd.sum[0] + nd.sum[1] + nd.sum[2] + nd.sum[3];
+		// 没有能量的子树按均匀分布
+		if (total <= 0)
+			break;
+		const int q = quadrant(u, v);
+		p *= 4 * nd.sum[q] / total;
+		if (!nd.child[q])
+			break;
+		n = nd.child[q];
+	}
+	return p / (4 * PI);
+}
+
+vec3 direction_tree::sample(double r1, double r2) const {
+	double x0 = 0, y0 = 0, size = 1;
+	uint32_t n = 0;
+	for (;;) {
+		const node &nd = nodes[n];
+		const double total = nd.sum[0] + nd.sum[1] + nd.sum[2] + nd.sum[3];
+		if (total <= 0)
+			break;
+
+		// 先按两列的能量选列, 再在列中按能量选行; 样本缩放后留给下一层
+		int q = 0;
+		const double left = (nd.sum[0] + nd.sum[2]) / total;
+		if (r1 < left) {
+			r1 /= left;
+		} else {
+			r1 = (r1 - left) / (1 - left);
+			q |= 1;
+		}
+		const double column = nd.sum[q] + nd.sum[q + 2];
+		const double bottom = column > 0 ? nd.sum[q] / column : 0.5;
+		if (r2 < bottom) {
+			r2 /= bottom;
+		} else {
+			r2 = (r2 - bottom) / (1 - bottom);
+			q |= 2;
+		}
+		r1 = std::min(r1, one_minus_epsilon);
+		r2 = std::min(r2, one_minus_epsilon);
+
+		size *= 0.5;
+		x0 += (q & 1) ? size : 0;
+		y0 += (q & 2) ? size : 0;
+		if (!nd.child[q])
+			break;
+		n = nd.child[q];
+	}
+	return from_square(x0 + r1 * size, y0 + r2 * size);
+}
+
+void direction_tree_builder::refine_from(const direction_tree &tree, double rho, int max_depth) {
+	const auto &root = tree.nodes[0];
+	const double total = root.sum[0] + root.sum[1] + root.sum[2] + root.sum[3];
+
+	struct item {
+		// 旧树上对应的节点, -1 表示旧树在这里已经是叶子
+		int64_t src;
+		float sums[4];
+		uint32_t dst;
+		int depth;
+	};
+
+	child.assign(1, {0, 0, 0, 0});
+	std::vector<item> stack;
+	stack.push_back({0, {root.sum[0], root.sum[1], root.sum[2], root.sum[3]}, 0, 1});
+	while (!stack.empty()) {
+		const item it = stack.back();
+		stack.pop_back();
+		for (int q = 0; q < 4; ++q) {
+			if (total <= 0 || it.sums[q] / total <= rho || it.depth >= max_depth)
+				continue;
+			const auto index = static_cast<uint32_t>(child.size());
+			child.push_back({0, 0, 0, 0});
+			child[it.dst][q] = index;
+
+			item next{-1, {}, index, it.depth + 1};
+			if (it.src >= 0 && tree.nodes[it.src].child[q]) {
+				next.src = tree.nodes[it.src].child[q];
+				std::copy(tree.nodes[next.src].sum, tree.nodes[next.src].sum + 4, next.sums);
+			} else {
+				// 旧树上没有细分过, 假设能量在四个子象限中均匀
+				std::fill(next.sums, next.sums + 4, it.sums[q] * 0.25f);
+			}
+			stack.push_back(next);
+		}
+	}
+
+	sum.reset(new std::atomic<float>[4 * child.size()]);
+	for (size_t k = 0; k < 4 * child.size(); ++k)
+		sum[k].store(0.0f, std::memory_order_relaxed);
+}
+
+void direction_tree_builder::record(double u, double v, float value) {
+	uint32_t n = 0;
+	for (;;) {
+		const int q = quadrant(u, v);
+		atomic_add(sum[4 * n + q], value);
+		if (!child[n][q])
+			break;
+		n = child[n][q];
+	}
+}
+
+direction_tree direction_tree_builder::freeze() const {
+	direction_tree tree;
+	tree.nodes.resize(child.size());
+	for (size_t n = 0; n < child.size(); ++n) {
+		for (int q = 0; q < 4; ++q) {
+			tree.nodes[n].sum[q] = sum[4 * n + q].load(std::memory_order_relaxed);
+			tree.nodes[n].child[q] = child[n][q];
+		}
+	}
+	return tree;
+}
+
+path_guide::path_guide(const hittable_list &world, const settings &s) : options(s) {
+	aabb box;
+	if (world.bounding_box(0, 1, box)) {
+		// 稍微放大, 包围盒表面上的撞点也落在里面
+		const vec3 margin = 1e-3 * (box.max() - box.min()) + vec3(1e-4, 1e-4, 1e-4);
+		lo = box.min() - margin;
+		hi = box.max() + margin;
+	} else {
+		lo = point3(-1, -1, -1);
+		hi = point3(1, 1, 1);
+	}
+
+	nodes.push_back({-1, 0, {0, 0}, 0});
+	leaves.push_back(std::make_unique<leaf_data>());
+	leaves[0]->building.refine_from(leaves[0]->sampling, options.rho, options.max_direction_depth);
+}
+
+uint32_t path_guide::find_leaf(const point3 &p) const {
+	point3 a = lo, b = hi;
+	uint32_t n = 0;
+	while (nodes[n].axis >= 0) {
+		const int axis = nodes[n].axis;
+		const double mid = 0.5 * (a[axis] + b[axis]);
+		if (p[axis] < mid) {
+			b[axis] = mid;
+			n = nodes[n].child[0];
+		} else {
+			a[axis] = mid;
+			n = nodes[n].child[1];
+		}
+	}
+	return nodes[n].leaf;
+}
+
+void path_guide::record(const point3 &p, const vec3 &dir, double value) {
+	if (!learning)
+		return;
+	leaf_data &leaf = *leaves[find_leaf(p)];
+	leaf.samples.fetch_add(1, std::memory_order_relaxed);
+	if (!(value > 0) || !std::isfinite(value))
+		return;
+	double u, v;
+	to_square(dir, u, v);
+	leaf.building.record(u, v, static_cast<float>(value));
+}
+
+const direction_tree &path_guide::distribution(const point3 &p) const {
+	return leaves[find_leaf(p)]->sampling;
+}
+
+void path_guide::split(uint32_t n, double samples, double threshold) {
+	if (samples <= threshold || nodes[n].depth >= options.max_spatial_depth)
+		return;
+
+	// 两个子节点都从父节点的方向树开始, 下一轮再各自学习
+	const uint32_t parent = nodes[n].leaf;
+	const auto second = static_cast<uint32_t>(leaves.size());
+	leaves.push_back(std::make_unique<leaf_data>());
+	leaves[second]->sampling = leaves[parent]->sampling;
+
+	const int depth = nodes[n].depth + 1;
+	const auto c0 = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({-1, depth, {0, 0}, parent});
+	nodes.push_back({-1, depth, {0, 0}, second});
+	nodes[n].axis = nodes[n].depth % 3;
+	nodes[n].child[0] = c0;
+	nodes[n].child[1] = c0 + 1;
+
+	split(c0, samples * 0.5, threshold);
+	split(c0 + 1, samples * 0.5, threshold);
+}
+
+void path_guide::end_iteration() {
+	for (auto &leaf : leaves) {
+		// 这一轮没有记到能量的叶子保留原来的分布
+		direction_tree next = leaf->building.freeze();
+		const auto &root = next.nodes[0];
+		if (root.sum[0] + root.sum[1] + root.sum[2] + root.sum[3] > 0)
+			leaf->sampling = std::move(next);
+	}
+
+	const double threshold = options.spatial_threshold * std::sqrt(std::pow(2.0, iterations));
+	const size_t count = nodes.size();
+	for (size_t n = 0; n < count; ++n) {
+		if (nodes[n].axis >= 0)
+			continue;
+		split(static_cast<uint32_t>(n), leaves[nodes[n].leaf]->samples.load(std::memory_order_relaxed), threshold);
+	}
+
+	for (auto &leaf : leaves) {
+		leaf->building.refine_from(leaf->sampling, options.rho, options.max_direction_depth);
+		leaf->samples.store(0, std::memory_order_relaxed);
+	}
+	++iterations;
+}
+
+size_t path_guide::direction_nodes() const {
+	size_t n = 0;
+	for (const auto &leaf : leaves)
+		n += leaf->sampling.nodes.size();
+	return n;
+}
@@ -0,0 +1,156 @@
+#include "render/photon_map.h"
+#include "asset/material.h"
+#include "geometry/obn.h"
+#include "render/trace.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+	// 光子随机数的序列, 与渲染使用的序列分开
+	const uint64_t photon_seed = 0x70686f746f6eULL;
+
+	// 每个任务发射的光子数
+	const size_t photon_chunk = 4096;
+
+	const double alpha = 2.0 / 3.0;
+}
+
+void photon_map::build() {
+	RT_TRACE_ZONE("photon map build");
+	build(0, photons.size());
+}
+
+void photon_map::build(size_t begin, size_t end) {
+	if (end - begin < 2) {
+		if (begin < end)
+			photons[begin].axis = 0;
+		return;
+	}
+
+	float lo[3] = {photons[begin].position[0], photons[begin].position[1], photons[begin].position[2]};
+	float hi[3] = {lo[0], lo[1], lo[2]};
+	for (size_t k = begin + 1; k < end; ++k) {
+		for (int a = 0; a < 3; ++a) {
+			lo[a] = std::min(lo[a], photons[k].position[a]);
+			hi[a] = std::max(hi[a], photons[k].position[a]);
+		}
+	}
+	int axis = 0;
+	if (hi[1] - lo[1] > hi[axis] - lo[axis])
+		axis = 1;
+	if (hi[2] - lo[2] > hi[axis] - lo[axis])
+		axis = 2;
+
+	const size_t mid = begin + (end - begin) / 2;
+	std::nth_element(photons.begin() + begin, photons.begin() + mid, photons.begin() + end,
+					 [axis](const photon &a, const photon &b) { return a.position[axis] < b.position[axis]; });
+	photons[mid].axis = static_cast<uint8_t>(axis);
+	build(begin, mid);
+	build(mid + 1, end);
+}
+
+caustic_cache::caustic_cache(const scene &s, size_t photons_per_pass, double radius)
+		: world(s), emitters(s.world), photons_per_pass(photons_per_pass), initial_radius(radius) {
+	if (initial_radius <= 0) {
+		aabb box;
+		initial_radius = s.world.bounding_box(0, 1, box) ? 0.002 * (box.max() - box.min()).length() : 0.01;
+	}
+	current_radius = initial_radius;
+}
+
+void caustic_cache::trace_photon(uint64_t index, std::vector<photon> &out) const {
+	// 每个光子用自己的序列, 结果与线程数无关
+	random_generator() = pcg32(photon_seed, index);
+
+	double select_pdf;
+	const emitter &e = emitters[emitters.pick(random_double(), select_pdf)];
+	if (select_pdf <= 0)
+		return;
+
+	// 在光源上均匀地取一点
+	point3 p;
+	vec3 n;
+	double u, v;
+	const double r1 = random_double();
+	const double r2 = random_double();
+	e.sample(r1, r2, p, n, u, v);
+	const color le = e.radiance(p, n, u, v);
+
+	// 余弦分布的方向: 功率 = Le * cos / (pdf_A * pdf_w) = Le * area * PI
+	onb uvw;
+	uvw.build_from_w(n);
+	color power = le * (e.area * PI / select_pdf);
+	ray r(p, uvw.local(random_cosine_direction()), random_double());
+
+	int specular_bounces = 0;
+	for (int depth = 0; depth < world.max_depth; ++depth) {
+		hit_record rec;
+		if (!world.world.hit(r, 0.001, infinity, rec) || !rec.mat_ptr)
+			return;
+
+		scatter_record srec;
+		if (!rec.mat_ptr->scatter(r, rec, srec))
+			return;
+		if (srec.is_specular) {
+			power = power * srec.attenuation;
+			r = srec.specular_ray;
+			++specular_bounces;
+			continue;
+		}
+
+		// 第一个漫反射表面: 只有经过镜面的光子是焦散
+		if (specular_bounces > 0) {
+			const vec3 d = unit_vector(r.direction());
+			photon ph;
+			for (int a = 0; a < 3; ++a) {
+				ph.position[a] = static_cast<float>(rec.p[a]);
+				ph.direction[a] = static_cast<float>(d[a]);
+				ph.normal[a] = static_cast<float>(rec.normal[a]);
+				ph.power[a] = static_cast<float>(power[a]);
+			}
+			ph.axis = 0;
+			out.push_back(ph);
+		}
+		return;
+	}
+}
+
+void caustic_cache::next_pass(bool restart) {
+	if (emitters.empty() || photons_per_pass == 0)
+		return;
+	RT_TRACE_ZONE("caustic photons", passes);
+	const auto start = std::chrono::steady_clock::now();
+
+	if (restart) {
+		map.clear();
+		passes = 0;
+		emitted = 0;
+		current_radius = initial_radius;
+	} else if (passes > 0) {
+		current_radius *= std::sqrt((passes + alpha) / (passes + 1.0));
+	}
+
+	// 按块并行发射, 每块的结果按块的顺序合并
+	const size_t chunks = (photons_per_pass + photon_chunk - 1) / photon_chunk;
+	std::vector<std::vector<photon>> found(chunks);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (long long c = 0; c < static_cast<long long>(chunks); ++c) {
+		const size_t first = static_cast<size_t>(c) * photon_chunk;
+		const size_t last = std::min(first + photon_chunk, photons_per_pass);
+		for (size_t k = first; k < last; ++k)
+			trace_photon(emitted + k, found[c]);
+	}
+	for (const auto &chunk : found)
+		map.add(chunk);
+	map.build();
+
+	emitted += photons_per_pass;
+	++passes;
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cerr << "caustics: pass " << passes << ", " << map.size() << " photons from " << emitted
+			  << " emitted, radius " << current_radius << ", " << ms << " ms\n";
+}
@@ -0,0 +1,102 @@
+#include "render/progressive.h"
+#include "render/image_io.h"
+#include "render/image_metrics.h"
+#include "render/trace.h"
+#include "utility/atomic_file.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace {
+	bool write_preview(const std::string &path, const film &f) {
+		RT_TRACE_ZONE("preview");
+		std::ostringstream image;
+		write_ppm(image, f.width, f.height, mean_image(f));
+		const std::string bytes = image.str();
+
+		atomic_file file(path);
+		return file.write(bytes.data(), bytes.size()) && file.commit();
+	}
+}
+
+progressive_result render_progressive(const path_integrator &integrator, film &f, const render_settings &settings,
+									  checkpoint_info &info, const progressive_settings &ps,
+									  std::chrono::steady_clock::time_point start) {
+	using clock = std::chrono::steady_clock;
+	auto seconds_since = [](clock::time_point t) { return std::chrono::duration<double>(clock::now() - t).count(); };
+
+	progressive_result result;
+	auto last_preview = clock::now();
+	auto last_checkpoint = clock::now();
+	int passes_since_preview = 0;
+	double seconds_per_sample = 0;
+
+	while (true) {
+		if (info.samples_done >= ps.target_spp) {
+			result.stop_reason = "target spp";
+			break;
+		}
+
+		int count = std::min(std::max(info.samples_done, 1), ps.target_spp - info.samples_done);
+		if (ps.time_limit > 0 && result.passes > 0) {
+			// 按上一遍的速度缩小这一遍, 不超出时间预算; 一个样本也放不下时停止
+			const double left = ps.time_limit - seconds_since(start);
+			const int affordable = static_cast<int>(left / std::max(seconds_per_sample, 1e-9));
+			if (affordable < 1) {
+				result.stop_reason = "time limit";
+				break;
+			}
+			count = std::min(count, affordable);
+		}
+
+		const double seconds = render_pass(integrator, f, settings, info.samples_done, count);
+		seconds_per_sample = seconds / count;
+		info.samples_done += count;
+		++result.passes;
+		++passes_since_preview;
+
+		result.noise = relative_noise(f);
+		std::cerr << "\rpass " << result.passes << ": " << info.samples_done << " spp, noise " << result.noise << "   "
+				  << std::flush;
+
+		if (result.passes == 1 && ps.preview_path.empty())
+			result.first_image_seconds = seconds_since(start);
+
+		const bool done = info.samples_done >= ps.target_spp
+						  || (ps.noise_threshold > 0 && result.noise <= ps.noise_threshold)
+						  || (ps.time_limit > 0 && seconds_since(start) >= ps.time_limit);
+
+		if (!ps.preview_path.empty()
+			&& (result.passes == 1 || done || seconds_since(last_preview) >= ps.preview_interval
+				|| (ps.preview_passes > 0 && passes_since_preview >= ps.preview_passes))) {
+			if (!write_preview(ps.preview_path, f))
+				std::cerr << "\nERROR: Could not write preview '" << ps.preview_path << "'.\n";
+			if (result.passes == 1) {
+				result.first_image_seconds = seconds_since(start);
+				std::cerr << "\nfirst image after " << result.first_image_seconds << "s -> " << ps.preview_path << "\n";
+			}
+			last_preview = clock::now();
+			passes_since_preview = 0;
+		}
+
+		if (!ps.checkpoint_path.empty() && (done || seconds_since(last_checkpoint) >= ps.checkpoint_interval)) {
+			if (!write_checkpoint(ps.checkpoint_path, f, info))
+				std::cerr << "\nERROR: Could not write checkpoint '" << ps.checkpoint_path << "'.\n";
+			last_checkpoint = clock::now();
+		}
+
+		if (ps.noise_threshold > 0 && result.noise <= ps.noise_threshold) {
+			result.stop_reason = "noise threshold";
+			break;
+		}
+		if (ps.time_limit > 0 && seconds_since(start) >= ps.time_limit) {
+			result.stop_reason = "time limit";
+			break;
+		}
+	}
+
+	result.samples = info.samples_done;
+	std::cerr << "\n";
+	return result;
+}
@@ -0,0 +1,120 @@
+#include "render/radiance_cache.h"
+#include "utility/atomic_float.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// 线性探测的最大步数, 超过就当作表满了
+	const int max_probes = 32;
+
+	// 法线在八面体映射上每个方向的格数, 取奇数让坐标轴方向落在格子中间
+	const int normal_bins = 5;
+
+	uint64_t mix64(uint64_t x) {
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		return x;
+	}
+}
+
+radiance_cache::radiance_cache(const hittable_list &world, const settings &s) : options(s) {
+	if (options.cell_size <= 0) {
+		aabb box;
+		options.cell_size = world.bounding_box(0, 1, box) ? 0.01 * (box.max() - box.min()).length() : 1.0;
+	}
+	inv_cell_size = 1.0 / options.cell_size;
+
+	size_t n = 1;
+	while (n < std::max<size_t>(options.cells, 1024))
+		n <<= 1;
+	options.cells = n;
+	mask = n - 1;
+	cells.reset(new cell[n]);
+	clear();
+}
+
+void radiance_cache::clear() {
+	for (size_t k = 0; k <= mask; ++k) {
+		cells[k].key.store(0, std::memory_order_relaxed);
+		for (auto &s : cells[k].sum)
+			s.store(0.0f, std::memory_order_relaxed);
+		cells[k].count.store(0, std::memory_order_relaxed);
+	}
+}
+
+uint64_t radiance_cache::key(const point3 &p, const vec3 &n) const {
+	// 八面体映射: 法线投影到 |x| + |y| + |z| = 1 上, 下半球折到外面的三角形
+	const double l1 = std::fabs(n.x()) + std::fabs(n.y()) + std::fabs(n.z());
+	double ox = n.x() / l1, oy = n.y() / l1;
+	if (n.z() < 0) {
+		const double fx = (1 - std::fabs(oy)) * (ox >= 0 ? 1 : -1);
+		const double fy = (1 - std::fabs(ox)) * (oy >= 0 ? 1 : -1);
+		ox = fx;
+		oy = fy;
+	}
+	const int bx = std::min(normal_bins - 1, static_cast<int>((ox * 0.5 + 0.5) * normal_bins));
+	const int by = std::min(normal_bins - 1, static_cast<int>((oy * 0.5 + 0.5) * normal_bins));
+
+	const auto ix = static_cast<int64_t>(std::floor(p.x() * inv_cell_size));
+	const auto iy = static_cast<int64_t>(std::floor(p.y() * inv_cell_size));
+	const auto iz = static_cast<int64_t>(std::floor(p.z() * inv_cell_size));
+	uint64_t h = mix64(static_cast<uint64_t>(ix) * 0x9e3779b97f4a7c15ULL);
+	h = mix64(h ^ static_cast<uint64_t>(iy) * 0xbf58476d1ce4e5b9ULL);
+	h = mix64(h ^ static_cast<uint64_t>(iz) * 0x94d049bb133111ebULL);
+	h = mix64(h ^ static_cast<uint64_t>(bx * normal_bins + by + 1));
+	return h ? h : 1;
+}
+
+radiance_cache::cell *radiance_cache::find(uint64_t k, bool insert) const {
+	size_t slot = static_cast<size_t>(k) & mask;
+	for (int probe = 0; probe < max_probes; ++probe, slot = (slot + 1) & mask) {
+		cell &c = cells[slot];
+		uint64_t current = c.key.load(std::memory_order_acquire);
+		if (current == k)
+			return &c;
+		if (current == 0) {
+			if (!insert)
+				return nullptr;
+			// 别的线程可能同时占用这一格, 失败时 current 是它写入的键
+			if (c.key.compare_exchange_strong(current, k, std::memory_order_acq_rel) || current == k)
+				return &c;
+		}
+	}
+	return nullptr;
+}
+
+bool radiance_cache::lookup(const point3 &p, const vec3 &n, color &value) const {
+	const cell *c = find(key(p, n), false);
+	if (!c)
+		return false;
+	const uint32_t count = c->count.load(std::memory_order_relaxed);
+	if (count < static_cast<uint32_t>(options.min_samples))
+		return false;
+	value = color(c->sum[0].load(std::memory_order_relaxed), c->sum[1].load(std::memory_order_relaxed),
+				  c->sum[2].load(std::memory_order_relaxed)) /
+			count;
+	return true;
+}
+
+void radiance_cache::add(const point3 &p, const vec3 &n, const color &value) {
+	// NaN 和无穷大的样本会毁掉整格
+	if (!std::isfinite(value.x()) || !std::isfinite(value.y()) || !std::isfinite(value.z()))
+		return;
+	cell *c = find(key(p, n), true);
+	if (!c)
+		return;
+	for (int k = 0; k < 3; ++k)
+		atomic_add(c->sum[k], static_cast<float>(value[k]));
+	c->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t radiance_cache::used() const {
+	size_t n = 0;
+	for (size_t k = 0; k <= mask; ++k)
+		n += cells[k].key.load(std::memory_order_relaxed) != 0;
+	return n;
+}
@@ -0,0 +1,160 @@
+#include "render/renderer.h"
+#include "render/stats.h"
+#include "render/trace.h"
+#include "thread/numa.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace {
+	// 绑定当前的 OpenMP 线程, 返回它所在的节点
+	int pin_omp_thread(const numa_topology &topo) {
+		const int thread = omp_get_thread_num(), threads = omp_get_num_threads();
+		const int node = topo.node_of_thread(thread, threads);
+		pin_thread(topo.cpu_of_thread(thread, threads), node);
+		return node;
+	}
+
+	// 节点 band 的条带从第 first_tile_row(band) 行 tile 开始
+	int first_tile_row(int band, int bands, int tiles_y) {
+		return band * tiles_y / bands;
+	}
+}
+
+int render_threads(const render_settings &settings) {
+	return settings.threads > 0 ? settings.threads : omp_get_max_threads();
+}
+
+void allocate_film(film &f, const render_settings &settings) {
+	if (!settings.numa) {
+		f.resize(settings.width, settings.height);
+		return;
+	}
+
+	f.allocate(settings.width, settings.height);
+	const auto &topo = numa_topology::system();
+	const int tiles_y = settings.tiles_y();
+
+#pragma omp parallel num_threads(render_threads(settings))
+	{
+		const int node = pin_omp_thread(topo);
+		// OpenMP 给的线程可能比请求的少(OMP_THREAD_LIMIT、动态调整),
+		// 条带和行都按实际的线程数划分, 否则没有线程的那部分行不会被清零
+		const int threads = omp_get_num_threads();
+		const int bands = topo.active_nodes(threads);
+		// 图像的第 0 行在最下面, tile 行从顶部开始
+		const int y1 = settings.height - first_tile_row(node, bands, tiles_y) * settings.tile_size;
+		const int y0 = std::max(settings.height - first_tile_row(node + 1, bands, tiles_y) * settings.tile_size, 0);
+
+		// 条带内的行再平分给本节点的线程
+		const int first = topo.first_thread(node, threads);
+		const int count = topo.first_thread(node + 1, threads) - first;
+		const int k = omp_get_thread_num() - first;
+		const int rows = y1 - y0;
+		f.clear_rows(y0 + rows * k / count, y0 + rows * (k + 1) / count);
+	}
+}
+
+double render_pass(const path_integrator &integrator, film &f, const render_settings &settings, int first_sample,
+				   int sample_count) {
+	const int width = settings.width, height = settings.height;
+	const int tile_size = settings.tile_size;
+	const int tiles_x = settings.tiles_x();
+	const int tile_count = tiles_x * settings.tiles_y();
+	int remaining = tile_count;
+
+	if (settings.threads > 0)
+		omp_set_num_threads(settings.threads);
+
+	// NUMA 模式下每个条带一个计数器, 存放下一个未分配的 tile
+	const auto &topo = numa_topology::system();
+	const int bands = settings.numa ? topo.active_nodes(render_threads(settings)) : 1;
+	std::unique_ptr<std::atomic<int>[]> next_tile(new std::atomic<int>[bands]);
+	for (int b = 0; b < bands; ++b)
+		next_tile[b] = first_tile_row(b, bands, settings.tiles_y()) * tiles_x;
+
+	const auto start = std::chrono::steady_clock::now();
+	integrator.prepare_pass(first_sample);
+
+#pragma omp parallel
+	{
+		const int node = settings.numa ? pin_omp_thread(topo) : 0;
+		// 每个线程一个采样器副本
+		auto smp = make_sampler(settings.sampling, settings.seed);
+		// 0 号线程就是主线程
+		if (omp_get_thread_num() != 0)
+			RT_TRACE_THREAD_NAME("worker " + std::to_string(omp_get_thread_num()));
+		RT_TRACE_ZONE("render");
+
+		auto render_tile = [&](int t) {
+			// 从图像顶部开始
+			const int x0 = (t % tiles_x) * tile_size, x1 = std::min(x0 + tile_size, width);
+			const int y1 = height - (t / tiles_x) * tile_size, y0 = std::max(y1 - tile_size, 0);
+			RT_TRACE_ZONE("tile", t);
+			RT_STATS(const auto tile_start = std::chrono::steady_clock::now());
+
+			for (int j = y1 - 1; j >= y0; --j) {
+				for (int i = x0; i < x1; ++i) {
+					RT_STATS(const uint64_t work_before = render_stats::local().work());
+					integrator.render_pixel(i, j, first_sample, sample_count, *smp, f);
+					RT_STATS(render_stats::instance().add_pixel_cost(
+							i, j, static_cast<float>(render_stats::local().work() - work_before)));
+				}
+			}
+
+			RT_STATS(render_stats::instance().add_tile_time(t, x0, y0, std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - tile_start).count()));
+
+			if (settings.progress) {
+#pragma omp critical(render_progress)
+				std::cerr << "\rtiles remaining: " << --remaining << ' ' << std::flush;
+			}
+		};
+
+		if (settings.numa) {
+			// 先渲染本节点的条带, 做完之后依次从后面的节点取
+			for (int k = 0; k < bands; ++k) {
+				const int band = (node + k) % bands;
+				const int end = first_tile_row(band + 1, bands, settings.tiles_y()) * tiles_x;
+				for (int t = next_tile[band]++; t < end; t = next_tile[band]++)
+					render_tile(t);
+			}
+		} else {
+#pragma omp for schedule(dynamic)
+			for (int t = 0; t < tile_count; ++t)
+				render_tile(t);
+		}
+	}
+	integrator.finish_pass(f);
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double train_path_guide(const path_integrator &integrator, path_guide &guide, const render_settings &settings,
+						int budget) {
+	RT_TRACE_ZONE("train guide");
+	render_settings quiet = settings;
+	quiet.progress = false;
+	film scratch;
+	allocate_film(scratch, quiet);
+
+	// 训练用的样本序号放在渲染用不到的地方, 不与正式的样本重复
+	const int first = 1 << 24;
+	int used = 0;
+	double seconds = 0;
+	guide.set_training(true);
+	for (int spp = 1; used + spp <= budget; spp *= 2) {
+		seconds += render_pass(integrator, scratch, quiet, first + used, spp);
+		used += spp;
+		guide.end_iteration();
+		std::cerr << "path guide: iteration " << guide.iteration() << ", " << spp << " spp, "
+				  << guide.spatial_leaves() << " spatial leaves, " << guide.direction_nodes() << " direction nodes\n";
+	}
+	guide.set_training(false);
+	return seconds;
+}
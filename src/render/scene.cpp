@@ -0,0 +1,345 @@
+#include "render/scene.h"
+
+#include "asset/image_texture.h"
+#include "asset/light.h"
+#include "asset/material.h"
+#include "asset/noise_texture.h"
+#include "geometry/bvh.h"
+#include "geometry/rotate.h"
+#include "geometry/translate.h"
+#include "render/trace.h"
+#include "sample/sampler.h"
+#include "shape/aarect.h"
+#include "shape/box.h"
+#include "shape/moving_sphere.h"
+#include "shape/sphere.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifndef RT_ASSET_DIR
+#define RT_ASSET_DIR "assets"
+#endif
+
+namespace {
+	// turntable 不为空时返回铝盒子的旋转, 用于动画
+	hittable_list cornell_box_objects(shared_ptr<rotate_y> *turntable = nullptr) {
+		RT_TRACE_ZONE("scene build");
+		hittable_list objects;
+
+		auto red = make_shared<lambertian>(color(.65, .05, .05));
+		auto white = make_shared<lambertian>(color(.73, .73, .73));
+		auto green = make_shared<lambertian>(color(.12, .45, .15));
+
+	//    auto baseColor = vec3(.34299999, .54779997, .22700010);
+		auto baseColor = vec3(1.0);
+		auto light = make_shared<diffuse_light>(baseColor * color(15, 15, 15));
+
+		// box
+		shared_ptr<material> aluminum = make_shared<metal>(color(0.8, 0.85, 0.88), 0.0);
+		shared_ptr<hittable> box1 = make_shared<box>(point3(0, 0, 0), point3(165, 330, 165), aluminum);
+		auto rotation = make_shared<rotate_y>(box1, 15);
+		if (turntable)
+			*turntable = rotation;
+		box1 = make_shared<translate>(rotation, vec3(265, 0, 295));
+		objects.add(box1);
+
+		auto glass = make_shared<dielectric>(1.5);
+		objects.add(make_shared<sphere>(point3(190,90,190), 90 , glass));
+
+		// wall
+		objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+		objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+		objects.add(make_shared<flip_face>(make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
+	//    objects.add(make_shared<xz_rect>(213, 343, 227, 332, 554, light));
+		objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+		objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+		objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+
+		return objects;
+	}
+
+
+	void cornell_box(scene &s) {
+		shared_ptr<rotate_y> turntable;
+		s.world = cornell_box_objects(&turntable);
+
+		auto lights = make_shared<hittable_list>();
+		lights->add(make_shared<xz_rect>(213, 343, 227, 332, 554, shared_ptr<material>()));
+		lights->add(make_shared<sphere>(point3(190, 90, 190), 90, shared_ptr<material>()));
+		s.lights = lights;
+
+		s.aspect_ratio = 1.0;
+		s.image_width = 1024;
+		s.samples_per_pixel = 600;
+		s.background = color(0, 0, 0);
+		s.cam.reset(point3(278, 278, -800), point3(278, 278, 0), vec3(0, 1, 0), 40.0, s.aspect_ratio, 0.0, 10.0, 0.0, 1.0);
+
+		// 序列渲染时盒子每秒转 45 度; 玻璃球同时在光源列表里, 所以不动它
+		s.animate = [turntable](scene &, double time0, double) { turntable->set_angle(15 + 45 * time0); };
+	}
+
+	// 大理石纹理的地面和地球, 上方一块面光源
+	void textured_spheres(scene &s) {
+		RT_TRACE_ZONE("scene build");
+		auto marble = make_shared<lambertian>(make_shared<noise_texture>(4));
+		auto earth = make_shared<lambertian>(make_shared<image_texture>(RT_ASSET_DIR "/earthmap.jpg"));
+		auto light = make_shared<diffuse_light>(color(7, 7, 7));
+
+		s.world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, marble));
+		s.world.add(make_shared<sphere>(point3(0, 2, 0), 2, earth));
+		s.world.add(make_shared<flip_face>(make_shared<xz_rect>(-2, 2, -2, 2, 7, light)));
+
+		s.lights = make_shared<xz_rect>(-2, 2, -2, 2, 7, shared_ptr<material>());
+
+		s.aspect_ratio = 16.0 / 9.0;
+		s.image_width = 400;
+		s.samples_per_pixel = 200;
+		s.background = color(0.02, 0.02, 0.03);
+		s.cam.reset(point3(13, 4, 6), point3(0, 1.5, 0), vec3(0, 1, 0), 28.0, s.aspect_ratio, 0.0, 10.0, 0.0, 1.0);
+	}
+
+	// 几百个随机小球放进 BVH, 天空背景加一个球形光源
+	void random_spheres(scene &s) {
+		RT_TRACE_ZONE("scene build");
+		pcg32 rng(2022);
+		hittable_list objects;
+
+		auto checker = make_shared<checker_texture>(color(0.2, 0.3, 0.1), color(0.9, 0.9, 0.9));
+		objects.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(checker)));
+
+		for (int a = -11; a < 11; a++) {
+			for (int b = -11; b < 11; b++) {
+				const double choose_mat = rng.next_double();
+				point3 center(a + 0.9 * rng.next_double(), 0.2, b + 0.9 * rng.next_double());
+				if ((center - point3(4, 0.2, 0)).length() <= 0.9)
+					continue;
+
+				shared_ptr<material> mat;
+				if (choose_mat < 0.8) {
+					color albedo(rng.next_double() * rng.next_double(), rng.next_double() * rng.next_double(),
+								 rng.next_double() * rng.next_double());
+					mat = make_shared<lambertian>(albedo);
+				} else if (choose_mat < 0.95) {
+					color albedo(0.5 + 0.5 * rng.next_double(), 0.5 + 0.5 * rng.next_double(), 0.5 + 0.5 * rng.next_double());
+					mat = make_shared<metal>(albedo, 0.5 * rng.next_double());
+				} else {
+					mat = make_shared<dielectric>(1.5);
+				}
+				objects.add(make_shared<sphere>(center, 0.2, mat));
+			}
+		}
+
+		objects.add(make_shared<sphere>(point3(0, 1, 0), 1.0, make_shared<dielectric>(1.5)));
+		objects.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, make_shared<lambertian>(color(0.4, 0.2, 0.1))));
+		objects.add(make_shared<sphere>(point3(4, 1, 0), 1.0, make_shared<metal>(color(0.7, 0.6, 0.5), 0.0)));
+
+		s.world.add(make_shared<bvh_node>(objects, 0.0, 1.0));
+
+		auto light = make_shared<diffuse_light>(color(6, 6, 6));
+		s.world.add(make_shared<sphere>(point3(0, 12, 4), 3, light));
+		s.lights = make_shared<sphere>(point3(0, 12, 4), 3, shared_ptr<material>());
+
+		s.aspect_ratio = 3.0 / 2.0;
+		s.image_width = 600;
+		s.samples_per_pixel = 100;
+		s.background = color(0.35, 0.4, 0.5);
+		s.cam.reset(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20.0, s.aspect_ratio, 0.0, 10.0, 0.0, 1.0);
+	}
+
+	// 一群绕场景中心公转、在地面上弹跳的小球, 每个球的角速度不同, 用于序列渲染和 BVH 的重新拟合
+	void bouncing_spheres(scene &s) {
+		RT_TRACE_ZONE("scene build");
+		pcg32 rng(2024);
+
+		struct ball {
+			shared_ptr<moving_sphere> sphere;
+			double orbit_radius, orbit_phase, angular_speed;
+			double bounce_height, bounce_phase, bounce_rate;
+
+			point3 position(double t) const {
+				const double angle = orbit_phase + angular_speed * t;
+				const double y = sphere->radius + bounce_height * std::fabs(std::sin(bounce_phase + bounce_rate * t));
+				return point3(orbit_radius * std::cos(angle), y, orbit_radius * std::sin(angle));
+			}
+		};
+		auto balls = make_shared<std::vector<ball>>();
+
+		hittable_list objects;
+		for (int k = 0; k < 800; ++k) {
+			ball b;
+			b.orbit_radius = 1.5 + 8.0 * std::sqrt(rng.next_double());
+			b.orbit_phase = 2 * PI * rng.next_double();
+			b.angular_speed = (rng.next_double() < 0.5 ? -1 : 1) * (0.2 + 0.8 * rng.next_double());
+			b.bounce_height = 0.3 + 1.5 * rng.next_double();
+			b.bounce_phase = PI * rng.next_double();
+			b.bounce_rate = 2.0 + 4.0 * rng.next_double();
+
+			shared_ptr<material> mat;
+			const double choose_mat = rng.next_double();
+			if (choose_mat < 0.75) {
+				color albedo(rng.next_double() * rng.next_double(), rng.next_double() * rng.next_double(),
+							 rng.next_double() * rng.next_double());
+				mat = make_shared<lambertian>(albedo);
+			} else if (choose_mat < 0.95) {
+				color albedo(0.5 + 0.5 * rng.next_double(), 0.5 + 0.5 * rng.next_double(), 0.5 + 0.5 * rng.next_double());
+				mat = make_shared<metal>(albedo, 0.3 * rng.next_double());
+			} else {
+				mat = make_shared<dielectric>(1.5);
+			}
+
+			const double radius = 0.12 + 0.12 * rng.next_double();
+			b.sphere = make_shared<moving_sphere>(point3(0), point3(0), 0.0, 1.0, radius, mat);
+			balls->push_back(b);
+			objects.add(b.sphere);
+		}
+
+		auto checker = make_shared<checker_texture>(color(0.2, 0.3, 0.1), color(0.9, 0.9, 0.9));
+		s.world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(checker)));
+
+		auto light = make_shared<diffuse_light>(color(8, 8, 8));
+		s.world.add(make_shared<sphere>(point3(0, 12, 0), 3, light));
+		s.lights = make_shared<sphere>(point3(0, 12, 0), 3, shared_ptr<material>());
+
+		s.aspect_ratio = 16.0 / 9.0;
+		s.image_width = 480;
+		s.samples_per_pixel = 64;
+		s.background = color(0.35, 0.4, 0.5);
+
+		// 每个球的位置是时间的函数, 快门开启期间的移动用 moving_sphere 的运动模糊表示; 相机缓慢环绕
+		s.animate = [balls](scene &sc, double time0, double time1) {
+			for (auto &b : *balls) {
+				b.sphere->center0 = b.position(time0);
+				b.sphere->center1 = b.position(time1);
+				b.sphere->time0 = time0;
+				b.sphere->time1 = time1;
+			}
+			const double angle = 0.6 + 0.1 * time0;
+			sc.cam.reset(point3(18 * std::cos(angle), 5, 18 * std::sin(angle)), point3(0, 0.5, 0), vec3(0, 1, 0), 35.0,
+						 sc.aspect_ratio, 0.0, 10.0, time0, time1);
+		};
+
+		// 先摆到第 0 帧再建树
+		s.animate(s, 0.0, s.shutter / s.frame_rate);
+		auto bvh = make_shared<dynamic_bvh>(objects, 0.0, s.shutter / s.frame_rate);
+		s.world.add(bvh);
+		s.dynamic_bvhs.push_back(bvh);
+	}
+
+	/*
+	 * 《The Next Week》最后的场景: 400 个盒子组成的地面、几种材质的球和 1000 个小球组成的立方体,
+	 * 图元数量和种类都比较多, 用来比较加速结构。书中的两团体积雾没有加入(各向同性材质的散射还没有实现)。
+	 */
+	void final_scene(scene &s) {
+		RT_TRACE_ZONE("scene build");
+		pcg32 rng(2021);
+
+		hittable_list boxes1;
+		auto ground = make_shared<lambertian>(color(0.48, 0.83, 0.53));
+		const int boxes_per_side = 20;
+		for (int i = 0; i < boxes_per_side; i++) {
+			for (int j = 0; j < boxes_per_side; j++) {
+				auto w = 100.0;
+				auto x0 = -1000.0 + i * w;
+				auto z0 = -1000.0 + j * w;
+				auto y0 = 0.0;
+				auto x1 = x0 + w;
+				auto y1 = 1 + 100 * rng.next_double();
+				auto z1 = z0 + w;
+				boxes1.add(make_shared<box>(point3(x0, y0, z0), point3(x1, y1, z1), ground));
+			}
+		}
+		s.world.add(make_shared<bvh_node>(boxes1, 0, 1));
+
+		auto light = make_shared<diffuse_light>(color(7, 7, 7));
+		s.world.add(make_shared<flip_face>(make_shared<xz_rect>(123, 423, 147, 412, 554, light)));
+		s.lights = make_shared<xz_rect>(123, 423, 147, 412, 554, shared_ptr<material>());
+
+		auto center1 = point3(400, 400, 200);
+		auto center2 = center1 + vec3(30, 0, 0);
+		auto moving_sphere_material = make_shared<lambertian>(color(0.7, 0.3, 0.1));
+		s.world.add(make_shared<moving_sphere>(center1, center2, 0, 1, 50, moving_sphere_material));
+
+		s.world.add(make_shared<sphere>(point3(260, 150, 45), 50, make_shared<dielectric>(1.5)));
+		s.world.add(make_shared<sphere>(point3(0, 150, 145), 50, make_shared<metal>(color(0.8, 0.8, 0.9), 1.0)));
+		s.world.add(make_shared<sphere>(point3(360, 150, 145), 70, make_shared<dielectric>(1.5)));
+
+		auto emat = make_shared<lambertian>(make_shared<image_texture>(RT_ASSET_DIR "/earthmap.jpg"));
+		s.world.add(make_shared<sphere>(point3(400, 200, 400), 100, emat));
+		auto pertext = make_shared<noise_texture>(0.1);
+		s.world.add(make_shared<sphere>(point3(220, 280, 300), 80, make_shared<lambertian>(pertext)));
+
+		hittable_list boxes2;
+		auto white = make_shared<lambertian>(color(.73, .73, .73));
+		for (int j = 0; j < 1000; j++) {
+			point3 p(165 * rng.next_double(), 165 * rng.next_double(), 165 * rng.next_double());
+			boxes2.add(make_shared<sphere>(p, 10, white));
+		}
+		s.world.add(make_shared<translate>(make_shared<rotate_y>(make_shared<bvh_node>(boxes2, 0.0, 1.0), 15),
+											vec3(-100, 270, 395)));
+
+		s.aspect_ratio = 1.0;
+		s.image_width = 800;
+		s.samples_per_pixel = 1000;
+		s.background = color(0, 0, 0);
+		s.cam.reset(point3(478, 278, -600), point3(278, 278, 0), vec3(0, 1, 0), 40.0, s.aspect_ratio, 0.0, 10.0, 0.0, 1.0);
+	}
+
+	struct scene_entry {
+		const char *name;
+		void (*build)(scene &);
+	};
+
+	const scene_entry scene_table[] = {
+			{"cornell_box", cornell_box},
+			{"textured_spheres", textured_spheres},
+			{"random_spheres", random_spheres},
+			{"bouncing_spheres", bouncing_spheres},
+			{"final_scene", final_scene},
+	};
+}
+
+bool make_scene(const std::string &name, scene &out) {
+	for (const auto &entry : scene_table) {
+		if (name == entry.name) {
+			// BVH 的划分轴和 Perlin 噪声的排列来自 random_double(), 每次从同一个状态开始,
+			// 这样每个进程构建出的场景完全相同
+			random_generator() = pcg32();
+			out = scene();
+			out.name = name;
+			entry.build(out);
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<std::string> scene_names() {
+	std::vector<std::string> names;
+	for (const auto &entry : scene_table)
+		names.emplace_back(entry.name);
+	return names;
+}
+
+scene_update update_scene(scene &s, int frame) {
+	scene_update result;
+	if (!s.animate)
+		return result;
+
+	RT_TRACE_ZONE("scene update", frame);
+	const auto start = std::chrono::steady_clock::now();
+	// 快门为 0 时 moving_sphere 的两个时刻重合, 留一点间隔
+	const double time0 = frame / s.frame_rate;
+	const double time1 = time0 + std::max(s.shutter, 1e-3) / s.frame_rate;
+
+	s.animate(s, time0, time1);
+	for (auto &bvh : s.dynamic_bvhs) {
+		if (bvh->update(time0, time1))
+			++result.rebuilds;
+		else
+			++result.refits;
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
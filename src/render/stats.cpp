@@ -0,0 +1,196 @@
+#include "render/stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace {
+	std::mutex registry_mutex;
+	std::vector<std::unique_ptr<thread_stats>> registry;
+
+	// 黑 -> 蓝 -> 红 -> 黄 -> 白
+	void heat_color(float t, int rgb[3]) {
+		const float stops[5][3] = {{0, 0, 0}, {0, 0, 1}, {1, 0, 0}, {1, 1, 0}, {1, 1, 1}};
+		t = std::min(std::max(t, 0.0f), 1.0f) * 4.0f;
+		const int k = std::min(static_cast<int>(t), 3);
+		const float f = t - k;
+		for (int c = 0; c < 3; ++c)
+			rgb[c] = static_cast<int>(255.999f * (stops[k][c] + f * (stops[k + 1][c] - stops[k][c])));
+	}
+}
+
+const char *ray_kind_name(ray_kind kind) {
+	switch (kind) {
+		case ray_kind::camera: return "camera";
+		case ray_kind::secondary: return "secondary";
+		case ray_kind::light_probe: return "light probe";
+		default: return "?";
+	}
+}
+
+const char *shape_kind_name(shape_kind kind) {
+	switch (kind) {
+		case shape_kind::sphere: return "sphere";
+		case shape_kind::moving_sphere: return "moving_sphere";
+		case shape_kind::xy_rect: return "xy_rect";
+		case shape_kind::xz_rect: return "xz_rect";
+		case shape_kind::yz_rect: return "yz_rect";
+		case shape_kind::box: return "box";
+		case shape_kind::constant_medium: return "constant_medium";
+		default: return "?";
+	}
+}
+
+uint64_t thread_stats::work() const {
+	uint64_t sum = bvh_nodes_visited;
+	for (auto tests : primitive_tests)
+		sum += tests;
+	return sum;
+}
+
+void thread_stats::merge(const thread_stats &other) {
+	for (int k = 0; k < static_cast<int>(ray_kind::count); ++k)
+		rays[k] += other.rays[k];
+	bvh_nodes_visited += other.bvh_nodes_visited;
+	for (int k = 0; k < static_cast<int>(shape_kind::count); ++k) {
+		primitive_tests[k] += other.primitive_tests[k];
+		primitive_hits[k] += other.primitive_hits[k];
+	}
+	for (int k = 0; k <= max_path_length; ++k)
+		path_length[k] += other.path_length[k];
+}
+
+render_stats &render_stats::instance() {
+	static render_stats stats;
+	return stats;
+}
+
+thread_stats &render_stats::local() {
+	thread_local thread_stats *current = nullptr;
+	if (!current) {
+		std::lock_guard<std::mutex> guard(registry_mutex);
+		registry.push_back(std::make_unique<thread_stats>());
+		current = registry.back().get();
+	}
+	return *current;
+}
+
+void render_stats::reset(int w, int h, int tile_count) {
+	width = w;
+	height = h;
+	pixel_cost.assign(static_cast<size_t>(w) * h, 0.0f);
+	tile_times.assign(tile_count, tile_time());
+
+	std::lock_guard<std::mutex> guard(registry_mutex);
+	for (auto &s : registry)
+		*s = thread_stats();
+}
+
+void render_stats::add_tile_time(int tile, int x0, int y0, double seconds) {
+	tile_times[tile].x0 = x0;
+	tile_times[tile].y0 = y0;
+	tile_times[tile].seconds += seconds;
+}
+
+thread_stats render_stats::merged() const {
+	thread_stats total;
+	std::lock_guard<std::mutex> guard(registry_mutex);
+	for (const auto &s : registry)
+		total.merge(*s);
+	return total;
+}
+
+void render_stats::print(std::ostream &out, double render_seconds) const {
+	const thread_stats total = merged();
+	char line[256];
+
+	uint64_t ray_total = 0;
+	for (auto n : total.rays)
+		ray_total += n;
+
+	out << "stats:\n";
+	out << "  rays      ";
+	for (int k = 0; k < static_cast<int>(ray_kind::count); ++k)
+		out << "  " << ray_kind_name(static_cast<ray_kind>(k)) << " " << total.rays[k];
+	std::snprintf(line, sizeof(line), "  (%.3f Mrays/s)\n", render_seconds > 0 ? ray_total * 1e-6 / render_seconds : 0.0);
+	out << line;
+
+	std::snprintf(line, sizeof(line), "  bvh nodes %llu (%.1f per ray)\n",
+				  static_cast<unsigned long long>(total.bvh_nodes_visited),
+				  ray_total ? static_cast<double>(total.bvh_nodes_visited) / ray_total : 0.0);
+	out << line;
+
+	std::snprintf(line, sizeof(line), "  %-16s %14s %14s %8s\n", "shape", "tests", "hits", "hit %");
+	out << line;
+	for (int k = 0; k < static_cast<int>(shape_kind::count); ++k) {
+		if (total.primitive_tests[k] == 0)
+			continue;
+		std::snprintf(line, sizeof(line), "  %-16s %14llu %14llu %7.1f%%\n", shape_kind_name(static_cast<shape_kind>(k)),
+					  static_cast<unsigned long long>(total.primitive_tests[k]),
+					  static_cast<unsigned long long>(total.primitive_hits[k]),
+					  100.0 * total.primitive_hits[k] / total.primitive_tests[k]);
+		out << line;
+	}
+
+	uint64_t paths = 0, segments = 0;
+	for (int k = 0; k <= thread_stats::max_path_length; ++k) {
+		paths += total.path_length[k];
+		segments += k * total.path_length[k];
+	}
+	std::snprintf(line, sizeof(line), "  path length (segments) mean %.2f:", paths ? static_cast<double>(segments) / paths : 0.0);
+	out << line;
+	// 累计到 99% 之后的长尾合成一格
+	uint64_t cumulative = 0;
+	for (int k = 0; k <= thread_stats::max_path_length && paths; ++k) {
+		if (total.path_length[k] == 0)
+			continue;
+		if (cumulative >= paths * 99 / 100) {
+			std::snprintf(line, sizeof(line), " %d+:%.1f%%", k, 100.0 * (paths - cumulative) / paths);
+			out << line;
+			break;
+		}
+		cumulative += total.path_length[k];
+		std::snprintf(line, sizeof(line), " %d%s:%.1f%%", k, k == thread_stats::max_path_length ? "+" : "",
+					  100.0 * total.path_length[k] / paths);
+		out << line;
+	}
+	out << "\n";
+
+	if (!tile_times.empty()) {
+		auto sorted = tile_times;
+		std::sort(sorted.begin(), sorted.end(), [](const tile_time &a, const tile_time &b) {
+			return a.seconds < b.seconds;
+		});
+		const auto &slowest = sorted.back();
+		std::snprintf(line, sizeof(line), "  tiles     %zu, min %.2f ms, median %.2f ms, max %.2f ms at (%d, %d)\n",
+					  sorted.size(), 1e3 * sorted.front().seconds, 1e3 * sorted[sorted.size() / 2].seconds,
+					  1e3 * slowest.seconds, slowest.x0, slowest.y0);
+		out << line;
+	}
+}
+
+bool render_stats::write_heatmap(const std::string &path) const {
+	if (pixel_cost.empty())
+		return false;
+
+	auto sorted = pixel_cost;
+	const size_t p99 = sorted.size() * 99 / 100;
+	std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+	const float scale = sorted[p99] > 0 ? 1.0f / sorted[p99] : 0.0f;
+
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << "P3\n" << width << ' ' << height << "\n255\n";
+	// 与渲染输出一样从最上面一行开始
+	for (int j = height - 1; j >= 0; --j) {
+		for (int i = 0; i < width; ++i) {
+			int rgb[3];
+			heat_color(pixel_cost[static_cast<size_t>(j) * width + i] * scale, rgb);
+			file << rgb[0] << ' ' << rgb[1] << ' ' << rgb[2] << '\n';
+		}
+	}
+	return static_cast<bool>(file);
+}
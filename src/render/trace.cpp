@@ -0,0 +1,106 @@
+#include "render/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+	struct trace_event {
+		const char *name;
+		int64_t id;
+		trace_recorder::clock::time_point begin, end;
+	};
+
+	// 只由所属线程写入, 写出时其它线程已经结束渲染
+	struct thread_buffer {
+		int tid = 0;
+		std::string name;
+		std::vector<trace_event> events;
+		size_t written = 0;
+	};
+
+	std::mutex registry_mutex;
+	std::vector<std::unique_ptr<thread_buffer>> registry;
+
+	thread_buffer &local_buffer() {
+		thread_local thread_buffer *current = nullptr;
+		if (!current) {
+			std::lock_guard<std::mutex> guard(registry_mutex);
+			registry.push_back(std::make_unique<thread_buffer>());
+			current = registry.back().get();
+			current->tid = static_cast<int>(registry.size());
+			current->events.resize(trace_recorder::events_per_thread);
+		}
+		return *current;
+	}
+
+	// 事件名都是代码里的字面量, 只需要处理引号和反斜杠
+	void write_escaped(FILE *out, const char *s) {
+		for (; *s; ++s) {
+			if (*s == '"' || *s == '\\')
+				std::fputc('\\', out);
+			std::fputc(*s, out);
+		}
+	}
+}
+
+trace_recorder &trace_recorder::instance() {
+	static trace_recorder recorder;
+	return recorder;
+}
+
+void trace_recorder::start() {
+	epoch = clock::now();
+	recording = true;
+}
+
+void trace_recorder::set_thread_name(const std::string &name) {
+	if (instance().enabled())
+		local_buffer().name = name;
+}
+
+void trace_recorder::record(const char *name, int64_t id, clock::time_point begin, clock::time_point end) {
+	auto &buffer = local_buffer();
+	buffer.events[buffer.written % events_per_thread] = trace_event{name, id, begin, end};
+	++buffer.written;
+}
+
+bool trace_recorder::write(const std::string &path) const {
+	FILE *out = std::fopen(path.c_str(), "w");
+	if (!out)
+		return false;
+
+	auto micros = [this](clock::time_point t) {
+		return std::chrono::duration<double, std::micro>(t - epoch).count();
+	};
+
+	std::lock_guard<std::mutex> guard(registry_mutex);
+	std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const auto &buffer : registry) {
+		if (!buffer->name.empty()) {
+			std::fprintf(out, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"",
+						 first ? "" : ",\n", buffer->tid);
+			write_escaped(out, buffer->name.c_str());
+			std::fprintf(out, "\"}}");
+			first = false;
+		}
+
+		// 缓冲写满之后只保留最新的 events_per_thread 个事件
+		const size_t count = std::min(buffer->written, events_per_thread);
+		for (size_t k = buffer->written - count; k < buffer->written; ++k) {
+			const auto &e = buffer->events[k % events_per_thread];
+			std::fprintf(out, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"", first ? "" : ",\n", buffer->tid);
+			write_escaped(out, e.name);
+			std::fprintf(out, "\",\"ts\":%.3f,\"dur\":%.3f", micros(e.begin), micros(e.end) - micros(e.begin));
+			if (e.id >= 0)
+				std::fprintf(out, ",\"args\":{\"id\":%lld}", static_cast<long long>(e.id));
+			std::fprintf(out, "}");
+			first = false;
+		}
+	}
+	std::fprintf(out, "\n]}\n");
+	return std::fclose(out) == 0;
+}
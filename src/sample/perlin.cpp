@@ -1,118 +1,221 @@
-#include "sample/perlin.h"
-
-perlin::perlin() {
-    ranvec = new vec3[point_count];
-    for (int i = 0; i < point_count; ++i)
-        ranvec[i] = unit_vector(vec3::random(-1, 1));
-
-    perm_x = perlin_generate_perm();
-    perm_y = perlin_generate_perm();
-    perm_z = perlin_generate_perm();
-}
-
-double perlin::noise(const point3 &p) const {
-
-    auto u = p.x() - std::floor(p.x());
-    auto v = p.y() - std::floor(p.y());
-    auto w = p.z() - std::floor(p.z());
-
-    // SovMach bands
-    // Hermite cubic to round off the interpolation
-    u = u * u * (3 - 2 * u);
-    v = v * v * (3 - 2 * v);
-    w = w * w * (3 - 2 * w);
-
-    auto i = static_cast<int>(std::floor(p.x()));
-    auto j = static_cast<int>(std::floor(p.y()));
-    auto k = static_cast<int>(std::floor(p.z()));
-
-    vec3 c[2][2][2];
-
-    for (int di = 0; di < 2; ++di) {
-        for (int dj = 0; dj < 2; ++dj) {
-            for (int dk = 0; dk < 2; ++dk) {
-                c[di][dj][dk] = ranvec[
-                        perm_x[(i + di) & 255] ^
-                        perm_y[(j + dj) & 255] ^
-                        perm_z[(k + dk) & 255]];
-            }
-        }
-    }
-
-//    return trilinear_interp(c, u, v, w);
-    return perlin_interp(c, u, v, w);
-}
-
-double perlin::turb(const point3& p, int depth/* = 7*/) const {
-    auto accum = 0.0;
-    auto temp_p = p;
-    auto weight = 1.0;
-
-    for (int i = 0; i < depth; i++) {
-        accum += weight*noise(temp_p);
-        weight *= 0.5;
-        temp_p *= 2;
-    }
-
-    return std::fabs(accum);
-}
-
-perlin::~perlin() {
-    delete ranvec;
-    delete[] perm_x;
-    delete[] perm_y;
-    delete[] perm_z;
-}
-
-
-int *perlin::perlin_generate_perm() {
-    auto p = new int[point_count];
-
-    for (int i = 0; i < perlin::point_count; ++i)
-        p[i] = i;
-
-    permute(p, point_count);
-
-    return p;
-}
-
-// Perlin with trilienear interpolation
-double perlin::trilinear_interp(double c[2][2][2], double u, double v, double w) {
-    auto accum = 0.0;
-    for (int i = 0; i < 2; ++i)
-        for (int j = 0; j < 2; ++j)
-            for (int k = 0; k < 2; ++k)
-                accum += (i * u + (1 - i) * (1 - u)) *
-                         (j * v + (1 - j) * (1 - v)) *
-                         (k * w + (1 - k) * (1 - w)) *
-                         c[i][j][k];
-    return accum;
-}
-
-// 洗牌算法
-void perlin::permute(int *p, int n) {
-    for (int i = n - 1; i > 0; --i) {
-        int target = random_int(0, i);
-        std::swap(p[i], p[target]);
-    }
-}
-
-double perlin::perlin_interp(vec3 (*c)[2][2], double u, double v, double w) {
-    auto uu = u * u * (3 - 2 * u);
-    auto vv = v * v * (3 - 2 * v);
-    auto ww = w * w * (3 - 2 * w);
-    auto accum = 0.0;
-
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 2; j++) {
-            for (int k = 0; k < 2; k++) {
-                vec3 weight_v(u - i, v - j, w - k);
-                accum += (i * uu + (1 - i) * (1 - uu))
-                         * (j * vv + (1 - j) * (1 - vv))
-                         * (k * ww + (1 - k) * (1 - ww))
-                         * dot(c[i][j][k], weight_v);
-            }
-        }
-    }
-    return accum;
-}
+#include "sample/perlin.h"
+
+#include <cmath>
+
+// x64 上总是有 SSE2; 其他平台走标量实现
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RT_PERLIN_SSE2 1
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+namespace {
+    // Hermite cubic to round off the interpolation
+    inline float hermite(float t) {
+        return t * t * (3 - 2 * t);
+    }
+
+    inline float lerp_weight(int i, float t) {
+        return i ? t : 1 - t;
+    }
+
+    inline int floor_int(double x) {
+        const auto i = static_cast<int>(x);
+        return i - (x < i ? 1 : 0);
+    }
+
+    /*
+     * 晶格上8个梯度的插值。
+     * 坐标用double取整, 高倍频时float的小数部分精度不够。
+     * 与原实现一致: 小数部分先平滑一次作为点积的偏移, 再平滑一次作为插值权重。
+     */
+    template <typename Lattice>
+    inline double lattice_noise(const Lattice &t, double x, double y, double z) {
+        const int i = floor_int(x), j = floor_int(y), k = floor_int(z);
+
+        const float u = hermite(static_cast<float>(x - i));
+        const float v = hermite(static_cast<float>(y - j));
+        const float w = hermite(static_cast<float>(z - k));
+        const float uu = hermite(u), vv = hermite(v), ww = hermite(w);
+
+        const int px[2] = {t.perm[0][i & 255], t.perm[0][(i + 1) & 255]};
+        const int py[2] = {t.perm[1][j & 255], t.perm[1][(j + 1) & 255]};
+        const int pz[2] = {t.perm[2][k & 255], t.perm[2][(k + 1) & 255]};
+
+        float accum = 0.0f;
+        for (int di = 0; di < 2; ++di) {
+            for (int dj = 0; dj < 2; ++dj) {
+                for (int dk = 0; dk < 2; ++dk) {
+                    const float *g = t.gradient[px[di] ^ py[dj] ^ pz[dk]];
+                    const float d = g[0] * (u - di) + g[1] * (v - dj) + g[2] * (w - dk);
+                    accum += lerp_weight(di, uu) * lerp_weight(dj, vv) * lerp_weight(dk, ww) * d;
+                }
+            }
+        }
+        return accum;
+    }
+
+#ifdef RT_PERLIN_SSE2
+    inline __m128 hermite4(__m128 t) {
+        return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(t, t)));
+    }
+
+    /*
+     * 4个点一起算: 每个角上的4个梯度各用一次16字节对齐读取, 转置后得到 x/y/z 三个向量,
+     * 点积和三线性插值全部在 SSE 寄存器里完成。
+     */
+    template <typename Lattice>
+    inline void lattice_noise4(const Lattice &t, const double *x, const double *y, const double *z, double *out) {
+        int i[4], j[4], k[4];
+        float fu[4], fv[4], fw[4];
+        for (int l = 0; l < 4; ++l) {
+            i[l] = floor_int(x[l]);
+            j[l] = floor_int(y[l]);
+            k[l] = floor_int(z[l]);
+            fu[l] = static_cast<float>(x[l] - i[l]);
+            fv[l] = static_cast<float>(y[l] - j[l]);
+            fw[l] = static_cast<float>(z[l] - k[l]);
+        }
+
+        // 直接拼成寄存器, 避免先写内存再整块读回时的存储转发停顿
+        auto perm4 = [&t](int axis, const int *c, int offset) {
+            return _mm_setr_epi32(t.perm[axis][(c[0] + offset) & 255], t.perm[axis][(c[1] + offset) & 255],
+                                  t.perm[axis][(c[2] + offset) & 255], t.perm[axis][(c[3] + offset) & 255]);
+        };
+        const __m128i px[2] = {perm4(0, i, 0), perm4(0, i, 1)};
+        const __m128i py[2] = {perm4(1, j, 0), perm4(1, j, 1)};
+        const __m128i pz[2] = {perm4(2, k, 0), perm4(2, k, 1)};
+
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 u = hermite4(_mm_setr_ps(fu[0], fu[1], fu[2], fu[3]));
+        const __m128 v = hermite4(_mm_setr_ps(fv[0], fv[1], fv[2], fv[3]));
+        const __m128 w = hermite4(_mm_setr_ps(fw[0], fw[1], fw[2], fw[3]));
+        const __m128 wu[2] = {_mm_sub_ps(one, hermite4(u)), hermite4(u)};
+        const __m128 wv[2] = {_mm_sub_ps(one, hermite4(v)), hermite4(v)};
+        const __m128 ww[2] = {_mm_sub_ps(one, hermite4(w)), hermite4(w)};
+        const __m128 du[2] = {u, _mm_sub_ps(u, one)};
+        const __m128 dv[2] = {v, _mm_sub_ps(v, one)};
+        const __m128 dw[2] = {w, _mm_sub_ps(w, one)};
+
+        __m128 accum = _mm_setzero_ps();
+        for (int di = 0; di < 2; ++di) {
+            const __m128i hx = px[di];
+            for (int dj = 0; dj < 2; ++dj) {
+                const __m128i hxy = _mm_xor_si128(hx, py[dj]);
+                const __m128 wuv = _mm_mul_ps(wu[di], wv[dj]);
+                for (int dk = 0; dk < 2; ++dk) {
+                    alignas(16) int h[4];
+                    _mm_store_si128(reinterpret_cast<__m128i *>(h),
+                                    _mm_xor_si128(hxy, pz[dk]));
+
+                    __m128 gx = _mm_load_ps(t.gradient[h[0]]);
+                    __m128 gy = _mm_load_ps(t.gradient[h[1]]);
+                    __m128 gz = _mm_load_ps(t.gradient[h[2]]);
+                    __m128 gw = _mm_load_ps(t.gradient[h[3]]);
+                    _MM_TRANSPOSE4_PS(gx, gy, gz, gw);
+
+                    const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, du[di]), _mm_mul_ps(gy, dv[dj])),
+                                                _mm_mul_ps(gz, dw[dk]));
+                    accum = _mm_add_ps(accum, _mm_mul_ps(_mm_mul_ps(wuv, ww[dk]), d));
+                }
+            }
+        }
+
+        alignas(16) float result[4];
+        _mm_store_ps(result, accum);
+        for (int l = 0; l < 4; ++l)
+            out[l] = result[l];
+    }
+#else
+    template <typename Lattice>
+    inline void lattice_noise4(const Lattice &t, const double *x, const double *y, const double *z, double *out) {
+        for (int l = 0; l < 4; ++l)
+            out[l] = lattice_noise(t, x[l], y[l], z[l]);
+    }
+#endif
+}
+
+perlin::perlin() {
+    for (int i = 0; i < point_count; ++i) {
+        auto g = unit_vector(vec3::random(-1, 1));
+        table.gradient[i][0] = static_cast<float>(g.x());
+        table.gradient[i][1] = static_cast<float>(g.y());
+        table.gradient[i][2] = static_cast<float>(g.z());
+        table.gradient[i][3] = 0.0f;
+    }
+
+    for (auto &perm : table.perm) {
+        for (int i = 0; i < point_count; ++i)
+            perm[i] = static_cast<uint8_t>(i);
+        permute(perm, point_count);
+    }
+}
+
+double perlin::noise(const point3 &p) const {
+    return lattice_noise(table, p.x(), p.y(), p.z());
+}
+
+// 各倍频相互独立, 每4个倍频作为一组一起计算
+double perlin::turb(const point3 &p, int depth/* = 7*/) const {
+    auto accum = 0.0;
+
+    for (int first = 0; first < depth; first += 4) {
+        double x[4], y[4], z[4], n[4];
+        for (int l = 0; l < 4; ++l) {
+            const double frequency = static_cast<double>(1 << (first + l));
+            x[l] = p.x() * frequency;
+            y[l] = p.y() * frequency;
+            z[l] = p.z() * frequency;
+        }
+        lattice_noise4(table, x, y, z, n);
+
+        for (int l = 0; l < 4 && first + l < depth; ++l)
+            accum += n[l] / static_cast<double>(1 << (first + l));
+    }
+
+    return std::fabs(accum);
+}
+
+void perlin::noise(const point3 *p, double *out, size_t n) const {
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        const double x[4] = {p[k].x(), p[k + 1].x(), p[k + 2].x(), p[k + 3].x()};
+        const double y[4] = {p[k].y(), p[k + 1].y(), p[k + 2].y(), p[k + 3].y()};
+        const double z[4] = {p[k].z(), p[k + 1].z(), p[k + 2].z(), p[k + 3].z()};
+        lattice_noise4(table, x, y, z, out + k);
+    }
+    for (; k < n; ++k)
+        out[k] = noise(p[k]);
+}
+
+void perlin::turb(const point3 *p, double *out, size_t n, int depth) const {
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        double accum[4] = {0, 0, 0, 0};
+        double frequency = 1.0;
+        for (int i = 0; i < depth; i++) {
+            double x[4], y[4], z[4], value[4];
+            for (int l = 0; l < 4; ++l) {
+                x[l] = p[k + l].x() * frequency;
+                y[l] = p[k + l].y() * frequency;
+                z[l] = p[k + l].z() * frequency;
+            }
+            lattice_noise4(table, x, y, z, value);
+            for (int l = 0; l < 4; ++l)
+                accum[l] += value[l] / frequency;
+            frequency *= 2;
+        }
+        for (int l = 0; l < 4; ++l)
+            out[k + l] = std::fabs(accum[l]);
+    }
+    for (; k < n; ++k)
+        out[k] = turb(p[k], depth);
+}
+
+// 洗牌算法
+void perlin::permute(uint8_t *p, int n) {
+    for (int i = n - 1; i > 0; --i) {
+        int target = random_int(0, i);
+        std::swap(p[i], p[target]);
+    }
+}
@@ -0,0 +1,144 @@
+#include "sample/sampler.h"
+
+#include <algorithm>
+
+namespace {
+	const double one_minus_epsilon = 0x1.fffffffffffffp-1;
+
+	uint32_t reverse_bits(uint32_t x) {
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+		x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+		x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+		x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+		return x;
+	}
+
+	// 每一位只依赖于更低的位
+	uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return x;
+	}
+
+	// 翻转后每一位只依赖于更高的位, 即Owen扰乱
+	uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+		x = reverse_bits(x);
+		x = laine_karras_permutation(x, seed);
+		return reverse_bits(x);
+	}
+
+	// Sobol第二维的方向数(本原多项式 x + 1)
+	struct sobol_directions {
+		uint32_t v[32];
+
+		sobol_directions() {
+			v[0] = 1u << 31;
+			for (int i = 1; i < 32; ++i)
+				v[i] = v[i - 1] ^ (v[i - 1] >> 1);
+		}
+	};
+
+	const sobol_directions sobol_dim1;
+
+	uint32_t sobol_second(uint32_t index) {
+		uint32_t x = 0;
+		for (int bit = 0; index != 0; ++bit, index >>= 1)
+			if (index & 1u)
+				x ^= sobol_dim1.v[bit];
+		return x;
+	}
+
+	double to_unit(uint32_t x) {
+		return std::min(x * 0x1p-32, one_minus_epsilon);
+	}
+}
+
+double halton_sampler::owen_scrambled_radical_inverse(uint32_t base, uint32_t a, uint32_t hash) {
+	const double inv_base = 1.0 / base;
+	double inv_base_m = 1.0;
+	uint64_t reversed_digits = 0;
+
+	// 每一位数字都按其前缀做一次随机平移, 前缀为0时也要继续, 否则低位不会被扰乱;
+	// 前缀的值不区分长度("0" 和 "00"), 所以位数也要参与哈希, 否则前导0的各位会得到相同的平移
+	for (uint32_t depth = 0; inv_base_m > 1e-10; ++depth) {
+		uint32_t next = a / base;
+		uint32_t digit = a - next * base;
+		uint32_t prefix = static_cast<uint32_t>(reversed_digits ^ (reversed_digits >> 32));
+		uint32_t digit_hash = hash_combine(hash ^ prefix, depth);
+		digit = (digit + digit_hash) % base;
+		reversed_digits = reversed_digits * base + digit;
+		inv_base_m *= inv_base;
+		a = next;
+	}
+	return std::min(inv_base_m * static_cast<double>(reversed_digits), one_minus_epsilon);
+}
+
+/*
+ * 同一个下标在不同维度对之间会完全相关, 所以每个维度对先把下标打乱。
+ * 打乱本身是基数2的嵌套置换, 基数2的那一维如果只把打乱后的下标做根式反演, 各维度对的基数2坐标
+ * 与像素样本下标的分层一一对应; 所以基数2这一维在反演之后再用自己的种子做一次Owen扰乱,
+ * 基数3的一维也用自己的种子。
+ */
+double halton_sampler::radical_inverse_2(uint32_t i, uint32_t hash) {
+	return to_unit(nested_uniform_scramble(reverse_bits(i), hash));
+}
+
+double halton_sampler::get_1d() {
+	uint32_t dim_seed = hash_combine(pixel_seed, dimension++);
+	uint32_t i = nested_uniform_scramble(index, dim_seed);
+	return radical_inverse_2(i, hash_combine(dim_seed, 0));
+}
+
+std::pair<double, double> halton_sampler::get_2d() {
+	uint32_t dim_seed = hash_combine(pixel_seed, dimension);
+	dimension += 2;
+	uint32_t i = nested_uniform_scramble(index, dim_seed);
+	return std::make_pair(radical_inverse_2(i, hash_combine(dim_seed, 0)),
+						  owen_scrambled_radical_inverse(3, i, hash_combine(dim_seed, 1)));
+}
+
+uint32_t sobol_sampler::shuffled_index(uint32_t dim_seed) const {
+	return nested_uniform_scramble(index, dim_seed);
+}
+
+double sobol_sampler::get_1d() {
+	uint32_t dim_seed = hash_combine(pixel_seed, dimension++);
+	uint32_t i = shuffled_index(dim_seed);
+	return to_unit(nested_uniform_scramble(reverse_bits(i), hash_combine(dim_seed, 0)));
+}
+
+std::pair<double, double> sobol_sampler::get_2d() {
+	uint32_t dim_seed = hash_combine(pixel_seed, dimension);
+	dimension += 2;
+	uint32_t i = shuffled_index(dim_seed);
+	return std::make_pair(to_unit(nested_uniform_scramble(reverse_bits(i), hash_combine(dim_seed, 0))),
+						  to_unit(nested_uniform_scramble(sobol_second(i), hash_combine(dim_seed, 1))));
+}
+
+shared_ptr<sampler> make_sampler(sampler_type type, uint32_t seed) {
+	switch (type) {
+		case sampler_type::halton:
+			return make_shared<halton_sampler>(seed);
+		case sampler_type::sobol:
+			return make_shared<sobol_sampler>(seed);
+		case sampler_type::independent:
+		default:
+			return make_shared<independent_sampler>(seed);
+	}
+}
+
+const char *sampler_name(sampler_type type) {
+	switch (type) {
+		case sampler_type::halton:
+			return "halton";
+		case sampler_type::sobol:
+			return "sobol";
+		case sampler_type::independent:
+		default:
+			return "independent";
+	}
+}
@@ -0,0 +1,558 @@
+#include "shape/chunked_mesh.h"
+#include "geometry/geometry_cache.h"
+#include "render/stats.h"
+#include "render/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace {
+	const char rtm_magic[4] = {'R', 'T', 'M', 'C'};
+	const size_t triangle_floats = 9;
+	const int stack_size = 64;
+	// 块内 BVH 每个叶节点最多的三角形数
+	const size_t chunk_leaf_size = 4;
+	const float float_infinity = std::numeric_limits<float>::infinity();
+
+	uint64_t align_up(uint64_t x, uint64_t a) {
+		return (x + a - 1) / a * a;
+	}
+
+	// 21 位整数的每一位之间插入两个0
+	uint64_t spread_bits(uint64_t x) {
+		x &= 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffffULL;
+		x = (x | x << 16) & 0x1f0000ff0000ffULL;
+		x = (x | x << 8) & 0x100f00f00f00f00fULL;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+		x = (x | x << 2) & 0x1249249249249249ULL;
+		return x;
+	}
+
+	// 光线进入包围盒的距离, 没有交点时返回 false
+	bool box_entry(const double lo[3], const double hi[3], const ray &r, const vec3 &inv, double t_min, double t_max,
+				   double &entry) {
+		for (int a = 0; a < 3; ++a) {
+			double t0 = (lo[a] - r.origin()[a]) * inv[a];
+			double t1 = (hi[a] - r.origin()[a]) * inv[a];
+			if (inv[a] < 0.0)
+				std::swap(t0, t1);
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+			if (t_max < t_min)
+				return false;
+		}
+		entry = t_min;
+		return true;
+	}
+
+	bool box_entry(const aabb &box, const ray &r, const vec3 &inv, double t_min, double t_max, double &entry) {
+		const double lo[3] = {box.min().x(), box.min().y(), box.min().z()};
+		const double hi[3] = {box.max().x(), box.max().y(), box.max().z()};
+		return box_entry(lo, hi, r, inv, t_min, t_max, entry);
+	}
+
+	bool node_entry(const mesh_chunk::node &n, const ray &r, const vec3 &inv, double t_min, double t_max) {
+		const double lo[3] = {n.lo[0], n.lo[1], n.lo[2]};
+		const double hi[3] = {n.hi[0], n.hi[1], n.hi[2]};
+		double entry;
+		return box_entry(lo, hi, r, inv, t_min, t_max, entry);
+	}
+
+	vec3 to_vec3(const float v[3]) {
+		return vec3(v[0], v[1], v[2]);
+	}
+
+	vec3 inverse_direction(const ray &r) {
+		return vec3(1.0 / r.direction().x(), 1.0 / r.direction().y(), 1.0 / r.direction().z());
+	}
+
+	// Möller-Trumbore 求交, 坐标参数化为 p = v0 + u e1 + v e2
+	bool hit_triangle(const mesh_chunk::triangle &tri, const ray &r, double t_min, double t_max, double &t,
+					  double &u, double &v) {
+		const vec3 e1 = to_vec3(tri.e1), e2 = to_vec3(tri.e2);
+		const vec3 pvec = cross(r.direction(), e2);
+		const double det = dot(e1, pvec);
+		if (std::fabs(det) < 1e-12)
+			return false;
+		const double inv_det = 1.0 / det;
+		const vec3 tvec = r.origin() - to_vec3(tri.v0);
+		u = dot(tvec, pvec) * inv_det;
+		if (u < 0.0 || u > 1.0)
+			return false;
+		const vec3 qvec = cross(tvec, e1);
+		v = dot(r.direction(), qvec) * inv_det;
+		if (v < 0.0 || u + v > 1.0)
+			return false;
+		t = dot(e2, qvec) * inv_det;
+		return t > t_min && t < t_max;
+	}
+
+	// 按质心的最长轴在中位数处划分, 左子节点紧跟父节点
+	void build_chunk_node(mesh_chunk &c, std::vector<uint32_t> &order, const std::vector<vec3> &centroids,
+						  size_t begin, size_t end) {
+		const auto index = static_cast<uint32_t>(c.nodes.size());
+		c.nodes.emplace_back();
+
+		float lo[3] = {float_infinity, float_infinity, float_infinity};
+		float hi[3] = {-float_infinity, -float_infinity, -float_infinity};
+		vec3 cmin(infinity), cmax(-infinity);
+		for (size_t k = begin; k < end; ++k) {
+			const auto &tri = c.triangles[order[k]];
+			for (int a = 0; a < 3; ++a) {
+				const float p[3] = {tri.v0[a], tri.v0[a] + tri.e1[a], tri.v0[a] + tri.e2[a]};
+				lo[a] = std::min({lo[a], p[0], p[1], p[2]});
+				hi[a] = std::max({hi[a], p[0], p[1], p[2]});
+				cmin[a] = std::min(cmin[a], centroids[order[k]][a]);
+				cmax[a] = std::max(cmax[a], centroids[order[k]][a]);
+			}
+		}
+		std::copy(lo, lo + 3, c.nodes[index].lo);
+		std::copy(hi, hi + 3, c.nodes[index].hi);
+
+		if (end - begin <= chunk_leaf_size) {
+			c.nodes[index].index = static_cast<uint32_t>(begin);
+			c.nodes[index].count = static_cast<uint16_t>(end - begin);
+			return;
+		}
+
+		const vec3 extent = cmax - cmin;
+		int axis = 0;
+		if (extent.y() > extent[axis])
+			axis = 1;
+		if (extent.z() > extent[axis])
+			axis = 2;
+		const size_t mid = begin + (end - begin) / 2;
+		std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+						 [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+		build_chunk_node(c, order, centroids, begin, mid);
+		c.nodes[index].index = static_cast<uint32_t>(c.nodes.size());
+		c.nodes[index].count = 0;
+		c.nodes[index].axis = static_cast<uint16_t>(axis);
+		build_chunk_node(c, order, centroids, mid, end);
+	}
+}
+
+void mesh_chunk::build() {
+	nodes.clear();
+	if (triangles.empty())
+		return;
+
+	std::vector<uint32_t> order(triangles.size());
+	std::vector<vec3> centroids(triangles.size());
+	for (size_t k = 0; k < triangles.size(); ++k) {
+		order[k] = static_cast<uint32_t>(k);
+		const auto &tri = triangles[k];
+		centroids[k] = to_vec3(tri.v0) + (to_vec3(tri.e1) + to_vec3(tri.e2)) / 3.0;
+	}
+	nodes.reserve(2 * triangles.size() / chunk_leaf_size + 1);
+	build_chunk_node(*this, order, centroids, 0, triangles.size());
+
+	std::vector<triangle> sorted(triangles.size());
+	for (size_t k = 0; k < order.size(); ++k)
+		sorted[k] = triangles[order[k]];
+	triangles.swap(sorted);
+}
+
+bool mesh_chunk::hit(const ray &r, double t_min, double &closest, uint32_t &prim, double &u, double &v) const {
+	if (nodes.empty())
+		return false;
+
+	const vec3 inv = inverse_direction(r);
+	uint32_t stack[stack_size];
+	int top = 0;
+	uint32_t current = 0;
+	bool hit_anything = false;
+	while (true) {
+		const node &n = nodes[current];
+		RT_STATS(++render_stats::local().bvh_nodes_visited);
+		if (node_entry(n, r, inv, t_min, closest)) {
+			if (n.count > 0) {
+				for (uint32_t k = n.index; k < n.index + n.count; ++k) {
+					double t, tu, tv;
+					if (hit_triangle(triangles[k], r, t_min, closest, t, tu, tv)) {
+						closest = t;
+						prim = k;
+						u = tu;
+						v = tv;
+						hit_anything = true;
+					}
+				}
+			} else {
+				uint32_t near_child = current + 1, far_child = n.index;
+				if (r.direction()[n.axis] < 0.0)
+					std::swap(near_child, far_child);
+				stack[top++] = far_child;
+				current = near_child;
+				continue;
+			}
+		}
+		if (top == 0)
+			break;
+		current = stack[--top];
+	}
+	return hit_anything;
+}
+
+chunked_mesh::chunked_mesh(const std::string &path, shared_ptr<material> m) : file(path), mat_ptr(std::move(m)) {
+	if (const char *reason = check_header()) {
+		std::cerr << "ERROR: Could not load mesh file '" << path << "': " << reason << ".\n";
+		chunks.clear();
+		return;
+	}
+
+	cache_id = geometry_cache::instance().register_mesh();
+	chunk_boxes.reserve(chunks.size());
+	for (const auto &c : chunks)
+		chunk_boxes.emplace_back(point3(c.bounds[0], c.bounds[1], c.bounds[2]),
+								 point3(c.bounds[3], c.bounds[4], c.bounds[5]));
+
+	std::vector<uint32_t> order(chunks.size());
+	for (size_t k = 0; k < order.size(); ++k)
+		order[k] = static_cast<uint32_t>(k);
+	top.reserve(2 * chunks.size());
+	build_top(order, 0, order.size());
+}
+
+const char *chunked_mesh::check_header() {
+	if (!file.is_open())
+		return "cannot map file";
+	if (file.size() < rtm_header::data_alignment)
+		return "file too small";
+
+	rtm_header header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, rtm_magic, sizeof(rtm_magic)) != 0)
+		return "not an .rtm file";
+	if (header.version != rtm_header::current_version)
+		return "unsupported version";
+	if (header.chunk_count == 0)
+		return "empty mesh";
+	if (header.table_offset < sizeof(rtm_header) || header.table_offset > file.size() ||
+		uint64_t(header.chunk_count) * sizeof(rtm_chunk) > file.size() - header.table_offset)
+		return "truncated chunk table";
+
+	chunks.resize(header.chunk_count);
+	std::memcpy(chunks.data(), file.data() + header.table_offset, chunks.size() * sizeof(rtm_chunk));
+
+	// 检查每一块都在文件范围内, 之后 load_chunk 不再做边界检查
+	uint64_t total = 0;
+	for (const auto &c : chunks) {
+		if (c.triangle_count == 0 || c.offset < rtm_header::data_alignment || c.offset > file.size() ||
+			uint64_t(c.triangle_count) * triangle_floats * sizeof(float) > file.size() - c.offset)
+			return "truncated file";
+		total += c.triangle_count;
+	}
+	if (total != header.triangle_count)
+		return "bad triangle count";
+	triangles = total;
+	return nullptr;
+}
+
+uint32_t chunked_mesh::build_top(std::vector<uint32_t> &order, size_t begin, size_t end) {
+	const auto index = static_cast<uint32_t>(top.size());
+	top.push_back({chunk_boxes[order[begin]], 0, 0, false});
+	for (size_t k = begin + 1; k < end; ++k)
+		top[index].box = surrounding_box(top[index].box, chunk_boxes[order[k]]);
+
+	if (end - begin == 1) {
+		top[index].index = order[begin];
+		top[index].leaf = true;
+		return index;
+	}
+
+	// 块数不多, 按包围盒中心在最长轴上的中位数划分即可
+	const vec3 extent = top[index].box.max() - top[index].box.min();
+	int axis = 0;
+	if (extent.y() > extent[axis])
+		axis = 1;
+	if (extent.z() > extent[axis])
+		axis = 2;
+	auto center = [&](uint32_t c) { return chunk_boxes[c].min()[axis] + chunk_boxes[c].max()[axis]; };
+	const size_t mid = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+					 [&](uint32_t a, uint32_t b) { return center(a) < center(b); });
+
+	top[index].axis = static_cast<uint8_t>(axis);
+	build_top(order, begin, mid);
+	top[index].index = build_top(order, mid, end);
+	return index;
+}
+
+shared_ptr<const mesh_chunk> chunked_mesh::load_chunk(uint32_t index) const {
+	RT_TRACE_ZONE("mesh chunk load");
+	const rtm_chunk &info = chunks[index];
+	const size_t bytes = size_t(info.triangle_count) * triangle_floats * sizeof(float);
+	const unsigned char *src = file.data() + info.offset;
+
+	auto c = std::make_shared<mesh_chunk>();
+	c->triangles.resize(info.triangle_count);
+	float p[triangle_floats];
+	for (uint32_t k = 0; k < info.triangle_count; ++k) {
+		std::memcpy(p, src + k * sizeof(p), sizeof(p));
+		auto &tri = c->triangles[k];
+		for (int a = 0; a < 3; ++a) {
+			tri.v0[a] = p[a];
+			tri.e1[a] = p[3 + a] - p[a];
+			tri.e2[a] = p[6 + a] - p[a];
+		}
+	}
+	// 数据已经复制出来, 映射的页面不必再占用常驻内存
+	file.release(info.offset, bytes);
+
+	c->build();
+	return c;
+}
+
+bool chunked_mesh::hit_chunk(const mesh_chunk &c, const ray &r, double t_min, double &closest,
+							 hit_record &rec) const {
+	uint32_t prim;
+	double u, v;
+	if (!c.hit(r, t_min, closest, prim, u, v))
+		return false;
+
+	const auto &tri = c.triangles[prim];
+	rec.t = closest;
+	rec.p = r.at(closest);
+	rec.u = u;
+	rec.v = v;
+	rec.dpdu = to_vec3(tri.e1);
+	rec.dpdv = to_vec3(tri.e2);
+	rec.set_face_normal(r, unit_vector(cross(rec.dpdu, rec.dpdv)));
+	rec.mat_ptr = mat_ptr.get();
+	return true;
+}
+
+bool chunked_mesh::hit(const ray &r, double t_min, double t_max, hit_record &rec) const {
+	if (top.empty())
+		return false;
+
+	auto &cache = geometry_cache::instance();
+	const vec3 inv = inverse_direction(r);
+	uint32_t stack[stack_size];
+	int depth = 0;
+	uint32_t current = 0;
+	double closest = t_max;
+	bool hit_anything = false;
+	while (true) {
+		const top_node &n = top[current];
+		double entry;
+		if (box_entry(n.box, r, inv, t_min, closest, entry)) {
+			if (n.leaf) {
+				hit_anything |= hit_chunk(*cache.chunk(cache_id, *this, n.index), r, t_min, closest, rec);
+			} else {
+				uint32_t near_child = current + 1, far_child = n.index;
+				if (r.direction()[n.axis] < 0.0)
+					std::swap(near_child, far_child);
+				stack[depth++] = far_child;
+				current = near_child;
+				continue;
+			}
+		}
+		if (depth == 0)
+			break;
+		current = stack[--depth];
+	}
+	return hit_anything;
+}
+
+bool chunked_mesh::bounding_box(double time0, double time1, aabb &output_box) const {
+	if (top.empty())
+		return false;
+	output_box = top[0].box;
+	return true;
+}
+
+chunked_mesh::batch_statistics chunked_mesh::trace_batch(const std::vector<ray> &rays, double t_min, double t_max,
+														 std::vector<hit_record> &hits,
+														 std::vector<char> &found) const {
+	RT_TRACE_ZONE("mesh trace batch");
+	const size_t n = rays.size();
+	hits.resize(n);
+	found.assign(n, 0);
+	std::vector<double> closest(n, t_max);
+	if (top.empty())
+		return {0, 0};
+
+	auto &cache = geometry_cache::instance();
+
+	// 第一遍: 驻留的块马上求交, 不驻留的块记下 (块, 光线, 进入距离), 不在这里加载
+	struct deferred_ray {
+		uint32_t chunk;
+		uint32_t ray;
+		// 向下取整到 float, 重新检查时不会错误地排除
+		float entry;
+	};
+	std::vector<deferred_ray> deferred;
+#pragma omp parallel
+	{
+		std::vector<deferred_ray> local;
+#pragma omp for schedule(dynamic, 256)
+		for (long long i = 0; i < static_cast<long long>(n); ++i) {
+			const ray &r = rays[i];
+			const vec3 inv = inverse_direction(r);
+			uint32_t stack[stack_size];
+			int depth = 0;
+			uint32_t current = 0;
+			while (true) {
+				const top_node &nd = top[current];
+				double entry;
+				if (box_entry(nd.box, r, inv, t_min, closest[i], entry)) {
+					if (nd.leaf) {
+						if (cache.resident(cache_id, nd.index)) {
+							found[i] |= hit_chunk(*cache.chunk(cache_id, *this, nd.index), r, t_min, closest[i], hits[i]);
+						} else {
+							float e = static_cast<float>(entry);
+							if (e > entry)
+								e = std::nextafter(e, -float_infinity);
+							local.push_back({nd.index, static_cast<uint32_t>(i), e});
+						}
+					} else {
+						uint32_t near_child = current + 1, far_child = nd.index;
+						if (r.direction()[nd.axis] < 0.0)
+							std::swap(near_child, far_child);
+						stack[depth++] = far_child;
+						current = near_child;
+						continue;
+					}
+				}
+				if (depth == 0)
+					break;
+				current = stack[--depth];
+			}
+		}
+#pragma omp critical
+		deferred.insert(deferred.end(), local.begin(), local.end());
+	}
+
+	// 第二遍: 按块分组, 每块只加载一次。推迟的块失去了由近到远的顺序, 所以按组里最近的进入距离排序,
+	// 近处的块先求交, 命中后远处的块大多可以用进入距离直接排除
+	std::sort(deferred.begin(), deferred.end(), [](const deferred_ray &a, const deferred_ray &b) {
+		return a.chunk != b.chunk ? a.chunk < b.chunk : a.ray < b.ray;
+	});
+	struct group {
+		size_t begin, end;
+		float entry;
+	};
+	std::vector<group> groups;
+	for (size_t begin = 0; begin < deferred.size();) {
+		group g{begin, begin, float_infinity};
+		while (g.end < deferred.size() && deferred[g.end].chunk == deferred[begin].chunk)
+			g.entry = std::min(g.entry, deferred[g.end++].entry);
+		groups.push_back(g);
+		begin = g.end;
+	}
+	std::sort(groups.begin(), groups.end(), [](const group &a, const group &b) { return a.entry < b.entry; });
+
+	batch_statistics result{deferred.size(), groups.size()};
+	for (const group &g : groups) {
+		// 先排除已经在更近处命中的光线, 全部被排除时不必加载
+		size_t live = g.begin;
+		for (size_t k = g.begin; k < g.end; ++k) {
+			if (deferred[k].entry < closest[deferred[k].ray])
+				deferred[live++] = deferred[k];
+		}
+		if (live == g.begin)
+			continue;
+
+		// 同一组里的光线各不相同, 可以并行求交
+		const mesh_chunk *c = cache.chunk(cache_id, *this, deferred[g.begin].chunk);
+#pragma omp parallel for schedule(static) if (live - g.begin > 256)
+		for (long long k = static_cast<long long>(g.begin); k < static_cast<long long>(live); ++k) {
+			const uint32_t i = deferred[k].ray;
+			found[i] |= hit_chunk(*c, rays[i], t_min, closest[i], hits[i]);
+		}
+	}
+	return result;
+}
+
+bool write_chunked_mesh(const std::string &path, const std::vector<float> &positions, size_t chunk_triangles) {
+	const size_t count = positions.size() / triangle_floats;
+	if (count == 0 || chunk_triangles == 0)
+		return false;
+
+	// 按质心的 Morton 码排序
+	float bounds[6] = {float_infinity, float_infinity, float_infinity, -float_infinity, -float_infinity, -float_infinity};
+	for (size_t k = 0; k < count * 3; ++k) {
+		for (int a = 0; a < 3; ++a) {
+			bounds[a] = std::min(bounds[a], positions[3 * k + a]);
+			bounds[3 + a] = std::max(bounds[3 + a], positions[3 * k + a]);
+		}
+	}
+	std::vector<std::pair<uint64_t, uint32_t>> keys(count);
+	for (size_t k = 0; k < count; ++k) {
+		const float *p = &positions[k * triangle_floats];
+		uint64_t code = 0;
+		for (int a = 0; a < 3; ++a) {
+			const float extent = bounds[3 + a] - bounds[a];
+			const float c = (p[a] + p[3 + a] + p[6 + a]) / 3.0f;
+			const float x = extent > 0 ? (c - bounds[a]) / extent : 0.0f;
+			code |= spread_bits(static_cast<uint64_t>(std::clamp(x, 0.0f, 1.0f) * 2097151.0f)) << a;
+		}
+		keys[k] = {code, static_cast<uint32_t>(k)};
+	}
+	std::sort(keys.begin(), keys.end());
+
+	const size_t chunk_count = (count + chunk_triangles - 1) / chunk_triangles;
+	rtm_header header{};
+	std::memcpy(header.magic, rtm_magic, sizeof(rtm_magic));
+	header.version = rtm_header::current_version;
+	header.chunk_count = static_cast<uint32_t>(chunk_count);
+	header.triangle_count = count;
+	header.table_offset = rtm_header::data_alignment;
+	std::copy(bounds, bounds + 6, header.bounds);
+
+	std::vector<rtm_chunk> table(chunk_count);
+	uint64_t offset = align_up(header.table_offset + chunk_count * sizeof(rtm_chunk), rtm_header::data_alignment);
+	for (size_t c = 0; c < chunk_count; ++c) {
+		const size_t begin = c * chunk_triangles, end = std::min(count, begin + chunk_triangles);
+		auto &info = table[c];
+		std::fill(info.bounds, info.bounds + 3, float_infinity);
+		std::fill(info.bounds + 3, info.bounds + 6, -float_infinity);
+		for (size_t k = begin; k < end; ++k) {
+			const float *p = &positions[keys[k].second * triangle_floats];
+			for (int v = 0; v < 3; ++v) {
+				for (int a = 0; a < 3; ++a) {
+					info.bounds[a] = std::min(info.bounds[a], p[3 * v + a]);
+					info.bounds[3 + a] = std::max(info.bounds[3 + a], p[3 * v + a]);
+				}
+			}
+		}
+		info.triangle_count = static_cast<uint32_t>(end - begin);
+		info.offset = offset;
+		offset = align_up(offset + info.triangle_count * triangle_floats * sizeof(float), rtm_header::data_alignment);
+	}
+
+	FILE *out = std::fopen(path.c_str(), "wb");
+	if (!out)
+		return false;
+
+	std::vector<unsigned char> page(rtm_header::data_alignment, 0);
+	std::memcpy(page.data(), &header, sizeof(header));
+	bool ok = std::fwrite(page.data(), 1, page.size(), out) == page.size();
+	ok = ok && std::fwrite(table.data(), sizeof(rtm_chunk), table.size(), out) == table.size();
+
+	const std::vector<unsigned char> zeros(rtm_header::data_alignment, 0);
+	uint64_t written = header.table_offset + chunk_count * sizeof(rtm_chunk);
+	for (size_t c = 0; ok && c < chunk_count; ++c) {
+		const auto &info = table[c];
+		const size_t pad = static_cast<size_t>(info.offset - written);
+		ok = std::fwrite(zeros.data(), 1, pad, out) == pad;
+		const size_t begin = c * chunk_triangles;
+		for (size_t k = begin; ok && k < begin + info.triangle_count; ++k)
+			ok = std::fwrite(&positions[keys[k].second * triangle_floats], sizeof(float), triangle_floats, out) ==
+				 triangle_floats;
+		written = info.offset + info.triangle_count * triangle_floats * sizeof(float);
+	}
+
+	ok = (std::fclose(out) == 0) && ok;
+	if (!ok)
+		std::remove(path.c_str());
+	return ok;
+}
@@ -1,30 +1,33 @@
-#include "shape/moving_sphere.h"
-
-point3 moving_sphere::center(double time) const {
-	return center0 + ((time - time0) / (time1 - time0)) * (center1 - center0);
-}
-
-bool moving_sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-	vec3 oc = r.origin() - center(r.time());
-	auto a = r.direction().length_squared();
-	auto half_b = dot(oc, r.direction());
-	auto c = oc.length_squared() - radius * radius;
-
-	auto discriminant = half_b * half_b - a * c;
-	if (discriminant < 0) return false;
-	auto sqrtd = sqrt(discriminant);
-
-	auto root = (-half_b - sqrtd) / a;
-	if (root < t_min || t_max < root) {
-		root = (-half_b + sqrtd) / a;
-		if (root < t_min || t_max < root)
-			return false;
-	}
-
-	rec.t = root;
-	rec.p = r.at(rec.t);
-	auto outward_normal = (rec.p - center(r.time())) / radius;
-	rec.set_face_normal(r, outward_normal);
-	rec.mat_ptr = mat_ptr;
-	return true;
+#include "shape/moving_sphere.h"
+#include "render/stats.h"
+
+point3 moving_sphere::center(double time) const {
+	return center0 + ((time - time0) / (time1 - time0)) * (center1 - center0);
+}
+
+bool moving_sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+	RT_STATS(render_stats::local().count_test(shape_kind::moving_sphere));
+	vec3 oc = r.origin() - center(r.time());
+	auto a = r.direction().length_squared();
+	auto half_b = dot(oc, r.direction());
+	auto c = oc.length_squared() - radius * radius;
+
+	auto discriminant = half_b * half_b - a * c;
+	if (discriminant < 0) return false;
+	auto sqrtd = sqrt(discriminant);
+
+	auto root = (-half_b - sqrtd) / a;
+	if (root < t_min || t_max < root) {
+		root = (-half_b + sqrtd) / a;
+		if (root < t_min || t_max < root)
+			return false;
+	}
+
+	rec.t = root;
+	rec.p = r.at(rec.t);
+	auto outward_normal = (rec.p - center(r.time())) / radius;
+	rec.set_face_normal(r, outward_normal);
+	rec.mat_ptr = mat_ptr.get();
+	RT_STATS(render_stats::local().count_hit(shape_kind::moving_sphere));
+	return true;
 }
\ No newline at end of file
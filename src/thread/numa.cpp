@@ -0,0 +1,127 @@
+#include "thread/numa.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace {
+	thread_local int pinned_cpu = -1;
+	thread_local int pinned_node = -1;
+
+	bool read_line(const std::string &path, std::string &line) {
+		std::ifstream file(path);
+		return file && std::getline(file, line);
+	}
+
+	// 进程允许使用的CPU
+	std::vector<int> allowed_cpus() {
+		std::vector<int> cpus;
+#if defined(__linux__)
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+		if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+				if (CPU_ISSET(cpu, &mask))
+					cpus.push_back(cpu);
+		}
+#endif
+		if (cpus.empty()) {
+			const int n = std::max(1u, std::thread::hardware_concurrency());
+			for (int cpu = 0; cpu < n; ++cpu)
+				cpus.push_back(cpu);
+		}
+		return cpus;
+	}
+}
+
+std::vector<int> parse_cpu_list(const std::string &list) {
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ',')) {
+		if (range.empty() || range[0] < '0' || range[0] > '9')
+			continue;
+		const auto dash = range.find('-');
+		const int first = std::atoi(range.c_str());
+		const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+		for (int cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+numa_topology numa_topology::read(const std::string &root) {
+	numa_topology topo;
+	const auto allowed = allowed_cpus();
+
+	std::string online;
+	if (read_line(root + "/online", online)) {
+		for (int node : parse_cpu_list(online)) {
+			std::string list;
+			if (!read_line(root + "/node" + std::to_string(node) + "/cpulist", list))
+				continue;
+			std::vector<int> cpus;
+			for (int cpu : parse_cpu_list(list))
+				if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+					cpus.push_back(cpu);
+			if (!cpus.empty())
+				topo.node_cpus.push_back(cpus);
+		}
+	}
+
+	if (topo.node_cpus.empty())
+		topo.node_cpus.push_back(allowed);
+	return topo;
+}
+
+const numa_topology &numa_topology::system() {
+	static const numa_topology topo = read();
+	return topo;
+}
+
+int numa_topology::active_nodes(int threads) const {
+	return std::max(1, std::min(nodes(), threads));
+}
+
+int numa_topology::node_of_thread(int thread, int threads) const {
+	return thread * active_nodes(threads) / std::max(threads, 1);
+}
+
+int numa_topology::first_thread(int node, int threads) const {
+	const int n = active_nodes(threads);
+	return (node * threads + n - 1) / n;
+}
+
+int numa_topology::cpu_of_thread(int thread, int threads) const {
+	const int node = node_of_thread(thread, threads);
+	const auto &cpus = node_cpus[node];
+	return cpus[(thread - first_thread(node, threads)) % cpus.size()];
+}
+
+bool pin_thread(int cpu, int node) {
+	pinned_node = node;
+	if (pinned_cpu == cpu)
+		return true;
+#if defined(__linux__)
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask) != 0)
+		return false;
+	pinned_cpu = cpu;
+	return true;
+#else
+	// 其它平台只记录节点, 由操作系统调度
+	return false;
+#endif
+}
+
+int current_numa_node() {
+	return pinned_node;
+}
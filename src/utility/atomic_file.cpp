@@ -0,0 +1,53 @@
+#include "utility/atomic_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+atomic_file::atomic_file(const std::string &path) : target(path), temp(path + ".tmp") {
+	file = std::fopen(temp.c_str(), "wb");
+}
+
+atomic_file::~atomic_file() {
+	if (file) {
+		std::fclose(file);
+		std::remove(temp.c_str());
+	}
+}
+
+bool atomic_file::write(const void *data, size_t size) {
+	if (!file || failed)
+		return false;
+	if (size > 0 && std::fwrite(data, 1, size, file) != size)
+		failed = true;
+	return !failed;
+}
+
+bool atomic_file::commit() {
+	if (!file)
+		return false;
+
+	bool ok = !failed && std::fflush(file) == 0;
+	// 改名之前数据必须已经落盘, 否则断电后可能留下一个空文件
+#ifdef _WIN32
+	ok = ok && _commit(_fileno(file)) == 0;
+#else
+	ok = ok && fsync(fileno(file)) == 0;
+#endif
+	ok = std::fclose(file) == 0 && ok;
+	file = nullptr;
+
+#ifdef _WIN32
+	ok = ok && MoveFileExA(temp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+	ok = ok && std::rename(temp.c_str(), target.c_str()) == 0;
+#endif
+	if (!ok)
+		std::remove(temp.c_str());
+	return ok;
+}
@@ -0,0 +1,110 @@
+#include "utility/mapped_file.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::string &path) {
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		close();
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		close();
+		return;
+	}
+	mapping_handle = mapping;
+
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		close();
+		return;
+	}
+	ptr = static_cast<const unsigned char *>(view);
+	length = static_cast<size_t>(file_size.QuadPart);
+}
+
+void mapped_file::close() {
+	if (ptr)
+		UnmapViewOfFile(ptr);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle)
+		CloseHandle(file_handle);
+	ptr = nullptr;
+	length = 0;
+	mapping_handle = file_handle = nullptr;
+}
+
+void mapped_file::release(size_t, size_t) const {
+	// 只读视图的页面由系统按需换出, 这里不做处理
+}
+
+#else
+
+mapped_file::mapped_file(const std::string &path) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st{};
+	if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return;
+	}
+
+	void *view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// 映射建立后文件描述符就不再需要了
+	::close(fd);
+	if (view == MAP_FAILED)
+		return;
+
+	// 纹理块和网格块的访问基本是随机的, 关掉预读
+	::madvise(view, static_cast<size_t>(st.st_size), MADV_RANDOM);
+
+	ptr = static_cast<const unsigned char *>(view);
+	length = static_cast<size_t>(st.st_size);
+}
+
+void mapped_file::close() {
+	if (ptr)
+		::munmap(const_cast<unsigned char *>(ptr), length);
+	ptr = nullptr;
+	length = 0;
+}
+
+void mapped_file::release(size_t offset, size_t bytes) const {
+	if (!ptr || offset >= length)
+		return;
+	// madvise 要求起点按页对齐
+	const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+	const size_t begin = offset / page * page;
+	const size_t end = std::min(length, offset + bytes);
+	::madvise(const_cast<unsigned char *>(ptr) + begin, end - begin, MADV_DONTNEED);
+}
+
+#endif
+
+mapped_file::~mapped_file() {
+	close();
+}
@@ -0,0 +1,286 @@
+#include "utility/options.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	bool parse_sampler(const char *name, sampler_type &type) {
+		for (auto t : {sampler_type::independent, sampler_type::halton, sampler_type::sobol}) {
+			if (std::strcmp(name, sampler_name(t)) == 0) {
+				type = t;
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+bool parse_options(int argc, char **argv, render_options &opt) {
+	for (int k = 1; k < argc; ++k) {
+		const char *arg = argv[k];
+		// 需要一个值的参数
+		auto value = [&]() -> const char * {
+			if (k + 1 >= argc) {
+				std::cerr << "missing value for " << arg << "\n";
+				return nullptr;
+			}
+			return argv[++k];
+		};
+
+		if (!std::strcmp(arg, "-h") || !std::strcmp(arg, "--help")) {
+			return false;
+		} else if (!std::strcmp(arg, "-o") || !std::strcmp(arg, "--output")) {
+			auto v = value();
+			if (!v) return false;
+			opt.output = v;
+		} else if (!std::strcmp(arg, "--scene")) {
+			auto v = value();
+			if (!v) return false;
+			opt.scene = v;
+		} else if (!std::strcmp(arg, "--spp")) {
+			auto v = value();
+			if (!v) return false;
+			opt.samples_per_pixel = std::atoi(v);
+		} else if (!std::strcmp(arg, "--width")) {
+			auto v = value();
+			if (!v) return false;
+			opt.image_width = std::atoi(v);
+		} else if (!std::strcmp(arg, "--threads")) {
+			auto v = value();
+			if (!v) return false;
+			opt.threads = std::atoi(v);
+		} else if (!std::strcmp(arg, "--sampler")) {
+			auto v = value();
+			if (!v || !parse_sampler(v, opt.sampling)) {
+				std::cerr << "unknown sampler\n";
+				return false;
+			}
+		} else if (!std::strcmp(arg, "--seed")) {
+			auto v = value();
+			if (!v) return false;
+			opt.seed = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+		} else if (!std::strcmp(arg, "--denoise")) {
+			opt.denoise = true;
+		} else if (!std::strcmp(arg, "--no-denoise")) {
+			opt.denoise = false;
+		} else if (!std::strcmp(arg, "--arena")) {
+			opt.arena = true;
+		} else if (!std::strcmp(arg, "--accel")) {
+			auto v = value();
+			if (!v || (std::strcmp(v, "bvh") && std::strcmp(v, "packed") && std::strcmp(v, "lbvh") && std::strcmp(v, "qbvh") &&
+					   std::strcmp(v, "lazy"))) {
+				std::cerr << "unknown acceleration structure\n";
+				return false;
+			}
+			opt.accel = v;
+		} else if (!std::strcmp(arg, "--integrator")) {
+			auto v = value();
+			if (!v || (std::strcmp(v, "path") && std::strcmp(v, "bdpt"))) {
+				std::cerr << "unknown integrator\n";
+				return false;
+			}
+			opt.integrator = v;
+		} else if (!std::strcmp(arg, "--radiance-cache")) {
+			opt.radiance_cache = true;
+		} else if (!std::strcmp(arg, "--radiance-cache-bounce")) {
+			auto v = value();
+			if (!v) return false;
+			opt.radiance_cache = true;
+			opt.radiance_cache_bounce = std::atoi(v);
+		} else if (!std::strcmp(arg, "--radiance-cache-cell")) {
+			auto v = value();
+			if (!v) return false;
+			opt.radiance_cache = true;
+			opt.radiance_cache_cell = std::atof(v);
+		} else if (!std::strcmp(arg, "--radiance-cache-samples")) {
+			auto v = value();
+			if (!v) return false;
+			opt.radiance_cache = true;
+			opt.radiance_cache_samples = std::atoi(v);
+		} else if (!std::strcmp(arg, "--radiance-cache-update")) {
+			auto v = value();
+			if (!v) return false;
+			opt.radiance_cache = true;
+			opt.radiance_cache_update = std::atof(v);
+		} else if (!std::strcmp(arg, "--guide")) {
+			opt.guide = true;
+		} else if (!std::strcmp(arg, "--guide-spp")) {
+			auto v = value();
+			if (!v) return false;
+			opt.guide = true;
+			opt.guide_spp = std::atoi(v);
+		} else if (!std::strcmp(arg, "--caustics")) {
+			auto v = value();
+			if (!v) return false;
+			opt.caustic_photons = std::atoi(v);
+		} else if (!std::strcmp(arg, "--caustic-radius")) {
+			auto v = value();
+			if (!v) return false;
+			opt.caustic_radius = std::atof(v);
+		} else if (!std::strcmp(arg, "--numa")) {
+			opt.numa = true;
+		} else if (!std::strcmp(arg, "--texture-cache-mb")) {
+			auto v = value();
+			if (!v) return false;
+			opt.texture_cache_mb = std::max(std::atoi(v), 1);
+		} else if (!std::strcmp(arg, "--heatmap")) {
+			auto v = value();
+			if (!v) return false;
+			opt.heatmap = v;
+		} else if (!std::strcmp(arg, "--trace")) {
+			auto v = value();
+			if (!v) return false;
+			opt.trace = v;
+		} else if (!std::strcmp(arg, "--checkpoint")) {
+			auto v = value();
+			if (!v) return false;
+			opt.checkpoint = v;
+		} else if (!std::strcmp(arg, "--checkpoint-interval")) {
+			auto v = value();
+			if (!v) return false;
+			opt.checkpoint_interval = std::max(std::atof(v), 0.1);
+		} else if (!std::strcmp(arg, "--resume")) {
+			opt.resume = true;
+		} else if (!std::strcmp(arg, "--progressive")) {
+			opt.progressive = true;
+		} else if (!std::strcmp(arg, "--preview")) {
+			auto v = value();
+			if (!v) return false;
+			opt.preview = v;
+		} else if (!std::strcmp(arg, "--preview-interval")) {
+			auto v = value();
+			if (!v) return false;
+			opt.preview_interval = std::max(std::atof(v), 0.0);
+		} else if (!std::strcmp(arg, "--preview-passes")) {
+			auto v = value();
+			if (!v) return false;
+			opt.preview_passes = std::max(std::atoi(v), 0);
+		} else if (!std::strcmp(arg, "--time-limit")) {
+			auto v = value();
+			if (!v) return false;
+			opt.time_limit = std::max(std::atof(v), 0.0);
+		} else if (!std::strcmp(arg, "--noise-threshold")) {
+			auto v = value();
+			if (!v) return false;
+			opt.noise_threshold = std::max(std::atof(v), 0.0);
+		} else if (!std::strcmp(arg, "--coordinator")) {
+			auto v = value();
+			if (!v) return false;
+			opt.coordinator = v;
+		} else if (!std::strcmp(arg, "--worker")) {
+			auto v = value();
+			if (!v) return false;
+			opt.worker = v;
+		} else if (!std::strcmp(arg, "--local-workers")) {
+			auto v = value();
+			if (!v) return false;
+			opt.local_workers = std::max(std::atoi(v), 0);
+		} else if (!std::strcmp(arg, "--job-tile")) {
+			auto v = value();
+			if (!v) return false;
+			opt.job_tile = std::max(std::atoi(v), 1);
+		} else if (!std::strcmp(arg, "--job-spp")) {
+			auto v = value();
+			if (!v) return false;
+			opt.job_spp = std::max(std::atoi(v), 0);
+		} else if (!std::strcmp(arg, "--frames")) {
+			auto v = value();
+			if (!v) return false;
+			opt.frames = std::max(std::atoi(v), 0);
+		} else if (!std::strcmp(arg, "--fps")) {
+			auto v = value();
+			if (!v) return false;
+			opt.fps = std::max(std::atof(v), 0.0);
+		} else if (!std::strcmp(arg, "--bvh-rebuild-ratio")) {
+			auto v = value();
+			if (!v) return false;
+			opt.bvh_rebuild_ratio = std::max(std::atof(v), 0.0);
+		} else {
+			std::cerr << "unknown option " << arg << "\n";
+			return false;
+		}
+	}
+	if (opt.resume && opt.checkpoint.empty()) {
+		std::cerr << "--resume needs --checkpoint <file>\n";
+		return false;
+	}
+	// worker 只按场景、分辨率和采样器渲染路径追踪的样本, 这些选项到不了 worker
+	if (!opt.coordinator.empty()) {
+		const char *local_only = opt.integrator != "path" ? "--integrator bdpt"
+								 : opt.caustic_photons > 0 ? "--caustics"
+								 : opt.radiance_cache	   ? "--radiance-cache"
+								 : opt.guide			   ? "--guide"
+								 : opt.progressive		   ? "--progressive"
+														   : nullptr;
+		if (local_only) {
+			std::cerr << local_only << " cannot be combined with --coordinator\n";
+			return false;
+		}
+	}
+	if (opt.denoise && opt.output.empty()) {
+		std::cerr << "--denoise needs -o <file>\n";
+		return false;
+	}
+	return true;
+}
+
+void print_usage(const char *program) {
+	std::cerr << "usage: " << program << " [options]\n"
+			  << "  -o, --output <file>      write the image to <file> instead of stdout\n"
+			  << "  --scene <name>           cornell_box | textured_spheres | random_spheres | bouncing_spheres |\n"
+			  << "                           final_scene (default cornell_box)\n"
+			  << "  --spp <n>                samples per pixel\n"
+			  << "  --width <n>              image width\n"
+			  << "  --threads <n>            render threads (default 32)\n"
+			  << "  --sampler <name>         independent | halton | sobol (default sobol)\n"
+			  << "  --seed <n>               sampler seed\n"
+			  << "  --denoise, --no-denoise  write <output>_denoised.ppm next to -o (default off)\n"
+			  << "  --arena                  store primitives, transforms and BVH nodes in typed pools in BVH leaf order\n"
+			  << "  --accel <name>           bvh | packed | lbvh | qbvh | lazy: the scene's BVH, flattened SoA leaves with\n"
+			  << "                           SIMD tests built by binned SAH, the same leaves built in parallel from\n"
+			  << "                           Morton codes, the SAH tree collapsed into 64-byte 4-wide nodes with 8-bit\n"
+			  << "                           quantized child boxes, or a BVH whose nodes are split when a ray first\n"
+			  << "                           enters them (default bvh)\n"
+			  << "  --integrator <name>      path | bdpt: path tracing or bidirectional path tracing (default path)\n"
+			  << "  --radiance-cache         end paths in a world-space radiance cache after the first diffuse bounce\n"
+			  << "  --radiance-cache-bounce <n> diffuse bounces before the cache is used (default 1)\n"
+			  << "  --radiance-cache-cell <s> cell size (default 1% of the scene diagonal)\n"
+			  << "  --radiance-cache-samples <n> samples a cell needs before it is used (default 16)\n"
+			  << "  --radiance-cache-update <p> probability of tracing on and updating a usable cell (default 0.1)\n"
+			  << "  --guide                  learn an SD-tree of incident light before rendering and guide diffuse bounces\n"
+			  << "  --guide-spp <n>          training budget in samples per pixel (default a quarter of the spp)\n"
+			  << "  --caustics <n>           emit n photons per pass into a progressive caustic cache (default 0, off)\n"
+			  << "  --caustic-radius <r>     initial gather radius (default 0.2% of the scene diagonal)\n"
+			  << "  --numa                   pin threads per NUMA node, replicate the BVH and place tile rows on their node\n"
+			  << "  --texture-cache-mb <n>   memory limit of the texture tile cache (default 256)\n"
+			  << "  --heatmap <file>         write a per-pixel cost heatmap (RT_ENABLE_STATS builds)\n"
+			  << "  --trace <file>           write a Chrome trace of scene build, tiles and output passes\n"
+			  << "  --checkpoint <file>      save the accumulated samples to <file> while rendering\n"
+			  << "  --checkpoint-interval <s> seconds between checkpoints (default 60)\n"
+			  << "  --resume                 continue from --checkpoint up to --spp samples\n"
+			  << "  --progressive            render in passes of doubling spp, writing a preview image\n"
+			  << "  --preview <file>         preview image (default <output>_preview.ppm)\n"
+			  << "  --preview-interval <s>   seconds between previews (default 2)\n"
+			  << "  --preview-passes <n>     also write a preview every n passes\n"
+			  << "  --time-limit <s>         stop progressive rendering after s seconds\n"
+			  << "  --noise-threshold <x>    stop progressive rendering when the estimated relative noise is below x\n"
+			  << "  --coordinator <addr>     hand out jobs to workers on unix:<path> or tcp:<host>:<port>\n"
+			  << "  --worker <addr>          render jobs for the coordinator at <addr>\n"
+			  << "  --local-workers <n>      fork n workers next to the coordinator\n"
+			  << "  --job-tile <n>           job tile size in pixels (default 32)\n"
+			  << "  --job-spp <n>            samples per job, 0 = all (default 0)\n"
+			  << "  --frames <n>             render an animated sequence to <output>_0000.ppm, ... (frame_0000.ppm on stdout)\n"
+			  << "  --fps <x>                frames per second of the sequence (default: scene, 24)\n"
+			  << "  --bvh-rebuild-ratio <x>  rebuild a refit BVH once its SAH cost exceeds x times the built cost\n"
+			  << "                           (default 1.3, 0 = rebuild every frame)\n";
+}
+
+std::string path_with_suffix(const std::string &path, const std::string &suffix) {
+	auto slash = path.find_last_of("/\\");
+	auto dot = path.find_last_of('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return path + suffix;
+	return path.substr(0, dot) + suffix + path.substr(dot);
+}
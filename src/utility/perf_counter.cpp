@@ -0,0 +1,63 @@
+#include "utility/perf_counter.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+perf_counter::perf_counter(event e) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	if (e == event::cache_misses) {
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	} else {
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+					  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+	fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+perf_counter::~perf_counter() {
+	if (fd >= 0)
+		::close(fd);
+}
+
+void perf_counter::start() {
+	if (fd < 0)
+		return;
+	ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t perf_counter::stop() {
+	if (fd < 0)
+		return 0;
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	uint64_t count = 0;
+	if (read(fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	return count;
+}
+
+#else
+
+perf_counter::perf_counter(event) {}
+
+perf_counter::~perf_counter() {}
+
+void perf_counter::start() {}
+
+uint64_t perf_counter::stop() {
+	return 0;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include "utility/socket.h"
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+socket_stream &socket_stream::operator=(socket_stream &&other) noexcept {
+	if (this != &other) {
+		close();
+		fd = other.fd;
+		unix_path = std::move(other.unix_path);
+		other.fd = -1;
+		other.unix_path.clear();
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+// 分布式渲染目前只支持 POSIX 套接字
+bool socket_stream::send_all(const void *, size_t) { return false; }
+
+bool socket_stream::recv_all(void *, size_t) { return false; }
+
+void socket_stream::close() { fd = -1; }
+
+socket_stream socket_stream::listen(const std::string &) { return socket_stream(); }
+
+socket_stream socket_stream::accept() { return socket_stream(); }
+
+socket_stream socket_stream::connect(const std::string &) { return socket_stream(); }
+
+#else
+
+namespace {
+	struct parsed_address {
+		bool tcp = false;
+		std::string path;
+		std::string host;
+		std::string port;
+	};
+
+	parsed_address parse_address(const std::string &address) {
+		parsed_address a;
+		if (address.compare(0, 4, "tcp:") == 0) {
+			a.tcp = true;
+			const auto rest = address.substr(4);
+			const auto colon = rest.rfind(':');
+			if (colon == std::string::npos) {
+				a.port = rest;
+			} else {
+				a.host = rest.substr(0, colon);
+				a.port = rest.substr(colon + 1);
+			}
+		} else if (address.compare(0, 5, "unix:") == 0) {
+			a.path = address.substr(5);
+		} else {
+			a.path = address;
+		}
+		return a;
+	}
+
+	bool make_unix_address(const std::string &path, sockaddr_un &addr) {
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.empty() || path.size() >= sizeof(addr.sun_path))
+			return false;
+		std::memcpy(addr.sun_path, path.c_str(), path.size());
+		return true;
+	}
+
+	// 结果是一个个小包, 关掉 Nagle 避免等待
+	void set_no_delay(int fd) {
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+}
+
+bool socket_stream::send_all(const void *data, size_t size) {
+	auto bytes = static_cast<const char *>(data);
+	while (size > 0) {
+#ifdef MSG_NOSIGNAL
+		const ssize_t n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+#else
+		const ssize_t n = ::send(fd, bytes, size, 0);
+#endif
+		if (n <= 0)
+			return false;
+		bytes += n;
+		size -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+bool socket_stream::recv_all(void *data, size_t size) {
+	auto bytes = static_cast<char *>(data);
+	while (size > 0) {
+		const ssize_t n = ::recv(fd, bytes, size, 0);
+		if (n <= 0)
+			return false;
+		bytes += n;
+		size -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+void socket_stream::close() {
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+	if (!unix_path.empty())
+		::unlink(unix_path.c_str());
+	unix_path.clear();
+}
+
+socket_stream socket_stream::listen(const std::string &address) {
+	const auto a = parse_address(address);
+	if (!a.tcp) {
+		sockaddr_un addr;
+		if (!make_unix_address(a.path, addr))
+			return socket_stream();
+		socket_stream s(::socket(AF_UNIX, SOCK_STREAM, 0));
+		if (!s.is_open())
+			return s;
+		// 上一次运行留下的套接字文件
+		::unlink(a.path.c_str());
+		if (::bind(s.fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(s.fd, 64) != 0)
+			s.close();
+		else
+			s.unix_path = a.path;
+		return s;
+	}
+
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo *list = nullptr;
+	if (getaddrinfo(a.host.empty() ? nullptr : a.host.c_str(), a.port.c_str(), &hints, &list) != 0)
+		return socket_stream();
+
+	socket_stream s;
+	for (auto p = list; p && !s.is_open(); p = p->ai_next) {
+		s = socket_stream(::socket(p->ai_family, p->ai_socktype, p->ai_protocol));
+		if (!s.is_open())
+			continue;
+		int one = 1;
+		setsockopt(s.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (::bind(s.fd, p->ai_addr, p->ai_addrlen) != 0 || ::listen(s.fd, 64) != 0)
+			s.close();
+	}
+	freeaddrinfo(list);
+	return s;
+}
+
+socket_stream socket_stream::accept() {
+	socket_stream s(::accept(fd, nullptr, nullptr));
+	if (s.is_open())
+		set_no_delay(s.fd);
+	return s;
+}
+
+socket_stream socket_stream::connect(const std::string &address) {
+	const auto a = parse_address(address);
+	if (!a.tcp) {
+		sockaddr_un addr;
+		if (!make_unix_address(a.path, addr))
+			return socket_stream();
+		socket_stream s(::socket(AF_UNIX, SOCK_STREAM, 0));
+		if (s.is_open() && ::connect(s.fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+			s.close();
+		return s;
+	}
+
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo *list = nullptr;
+	if (getaddrinfo(a.host.empty() ? "localhost" : a.host.c_str(), a.port.c_str(), &hints, &list) != 0)
+		return socket_stream();
+
+	socket_stream s;
+	for (auto p = list; p && !s.is_open(); p = p->ai_next) {
+		s = socket_stream(::socket(p->ai_family, p->ai_socktype, p->ai_protocol));
+		if (s.is_open() && ::connect(s.fd, p->ai_addr, p->ai_addrlen) != 0)
+			s.close();
+	}
+	freeaddrinfo(list);
+	if (s.is_open())
+		set_no_delay(s.fd);
+	return s;
+}
+
+#endif
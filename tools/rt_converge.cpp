@@ -0,0 +1,265 @@
+// 收敛测试: 在不同的时间预算下渲染内置场景, 与高spp的参考图像比较误差, 输出效率表
+#include "render/scene.h"
+#include "render/integrator.h"
+#include "render/renderer.h"
+#include "render/image_io.h"
+#include "render/image_metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+	struct converge_options {
+		std::vector<std::string> scenes;
+		std::vector<sampler_type> samplers{sampler_type::independent, sampler_type::sobol};
+		// 秒
+		std::vector<double> budgets{0.25, 0.5, 1, 2, 4};
+		int width = 128;
+		int reference_spp = 4096;
+		std::string reference_dir = ".";
+		int threads = 0;
+		bool json = false;
+	};
+
+	// 参考图像与被测图像使用不同的种子, 两者的噪声不相关
+	const uint32_t reference_seed = 0x5eed;
+	const uint32_t test_seed = 1;
+
+	struct measurement {
+		int spp = 0;
+		double seconds = 0;
+		double rmse = 0;
+		double rel_mse = 0;
+		double flip = 0;
+	};
+
+	struct table_row {
+		std::string scene;
+		sampler_type sampling;
+		double budget;
+		measurement m;
+		bool valid;
+	};
+
+	std::vector<std::string> split(const char *list) {
+		std::vector<std::string> items;
+		std::stringstream ss(list);
+		std::string item;
+		while (std::getline(ss, item, ','))
+			if (!item.empty())
+				items.push_back(item);
+		return items;
+	}
+
+	bool parse_sampler(const std::string &name, sampler_type &type) {
+		for (auto t : {sampler_type::independent, sampler_type::halton, sampler_type::sobol}) {
+			if (name == sampler_name(t)) {
+				type = t;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void print_usage(const char *program) {
+		std::cerr << "usage: " << program << " [options]\n"
+				  << "  --scene <name|all>       scenes to measure, comma separated (default all)\n"
+				  << "  --width <n>              image width (default 128)\n"
+				  << "  --budgets <s,s,...>      time budgets in seconds (default 0.25,0.5,1,2,4)\n"
+				  << "  --sampler <name,...>     samplers to compare (default independent,sobol)\n"
+				  << "  --reference-spp <n>      samples per pixel of the reference image (default 4096)\n"
+				  << "  --reference-dir <dir>    where reference images are cached as PFM (default .)\n"
+				  << "  --threads <n>            render threads (default: all cores)\n"
+				  << "  --json                   print the table as JSON\n";
+	}
+
+	bool parse(int argc, char **argv, converge_options &opt) {
+		for (int k = 1; k < argc; ++k) {
+			const char *arg = argv[k];
+			const char *v = k + 1 < argc ? argv[k + 1] : nullptr;
+			if (!std::strcmp(arg, "--json")) {
+				opt.json = true;
+				continue;
+			}
+			if (!v)
+				return false;
+			++k;
+			if (!std::strcmp(arg, "--scene")) {
+				opt.scenes = std::strcmp(v, "all") ? split(v) : scene_names();
+			} else if (!std::strcmp(arg, "--width")) {
+				opt.width = std::max(std::atoi(v), 8);
+			} else if (!std::strcmp(arg, "--budgets")) {
+				opt.budgets.clear();
+				for (const auto &b : split(v))
+					opt.budgets.push_back(std::atof(b.c_str()));
+				std::sort(opt.budgets.begin(), opt.budgets.end());
+				if (opt.budgets.empty())
+					return false;
+			} else if (!std::strcmp(arg, "--sampler")) {
+				opt.samplers.clear();
+				for (const auto &name : split(v)) {
+					sampler_type t;
+					if (!parse_sampler(name, t))
+						return false;
+					opt.samplers.push_back(t);
+				}
+			} else if (!std::strcmp(arg, "--reference-spp")) {
+				opt.reference_spp = std::max(std::atoi(v), 1);
+			} else if (!std::strcmp(arg, "--reference-dir")) {
+				opt.reference_dir = v;
+			} else if (!std::strcmp(arg, "--threads")) {
+				opt.threads = std::atoi(v);
+			} else {
+				return false;
+			}
+		}
+		if (opt.scenes.empty())
+			opt.scenes = scene_names();
+		return true;
+	}
+
+	// 读取缓存的参考图像, 没有或尺寸不符时重新渲染
+	void load_reference(const scene &s, const converge_options &opt, int width, int height,
+						std::vector<color> &reference) {
+		const std::string path = opt.reference_dir + "/" + s.name + "_" + std::to_string(width) + "_"
+								 + std::to_string(opt.reference_spp) + ".pfm";
+		int w = 0, h = 0;
+		if (read_pfm(path, w, h, reference) && w == width && h == height)
+			return;
+
+		std::cerr << "rendering reference " << path << " (" << opt.reference_spp << " spp)\n";
+		render_settings settings;
+		settings.width = width;
+		settings.height = height;
+		settings.threads = opt.threads;
+		settings.sampling = sampler_type::independent;
+		settings.seed = reference_seed;
+		settings.progress = false;
+
+		film f(width, height);
+		path_integrator integrator(s, width, height);
+		const double seconds = render_pass(integrator, f, settings, 0, opt.reference_spp);
+		std::cerr << "  " << seconds << "s\n";
+
+		reference = mean_image(f);
+		if (!write_pfm(path, width, height, reference))
+			std::cerr << "WARNING: Could not write reference '" << path << "'.\n";
+	}
+
+	/*
+	 * 渐进渲染: 每一遍把总样本数翻倍, 直到超出最大预算。
+	 * 样本序号连续, 所以 n spp 时的图像与一次渲染 n spp 相同; 计算误差的时间不计入渲染时间。
+	 */
+	std::vector<measurement> converge(const scene &s, const converge_options &opt, sampler_type sampling, int width,
+									  int height, const std::vector<color> &reference) {
+		render_settings settings;
+		settings.width = width;
+		settings.height = height;
+		settings.threads = opt.threads;
+		settings.sampling = sampling;
+		settings.seed = test_seed;
+		settings.progress = false;
+
+		film f(width, height);
+		path_integrator integrator(s, width, height);
+		std::vector<measurement> curve;
+
+		int spp = 0;
+		double seconds = 0;
+		const double max_budget = opt.budgets.back();
+		while (seconds <= max_budget && spp < opt.reference_spp) {
+			const int pass = std::max(spp, 1);
+			seconds += render_pass(integrator, f, settings, spp, pass);
+			spp += pass;
+
+			const auto image = mean_image(f);
+			measurement m;
+			m.spp = spp;
+			m.seconds = seconds;
+			m.rmse = rmse(image, reference);
+			m.rel_mse = rel_mse(image, reference);
+			m.flip = flip_error(image, reference, width, height);
+			curve.push_back(m);
+		}
+		return curve;
+	}
+
+	void print_table(const std::vector<table_row> &rows) {
+		std::printf("%-18s %-12s %8s %7s %9s %10s %10s %8s %12s\n", "scene", "sampler", "budget", "spp", "time",
+					"rmse", "relmse", "flip", "efficiency");
+		for (const auto &r : rows) {
+			std::printf("%-18s %-12s %7.2fs", r.scene.c_str(), sampler_name(r.sampling), r.budget);
+			if (!r.valid) {
+				std::printf(" %7s\n", "-");
+				continue;
+			}
+			// 效率 = 1 / (误差 x 时间), 越大越好, 不同预算之间应该大致不变
+			std::printf(" %7d %8.3fs %10.5f %10.5f %8.4f %12.2f\n", r.m.spp, r.m.seconds, r.m.rmse, r.m.rel_mse,
+						r.m.flip, 1.0 / (r.m.rel_mse * r.m.seconds));
+		}
+	}
+
+	void print_json(const std::vector<table_row> &rows, const converge_options &opt) {
+		std::printf("{\n  \"width\": %d,\n  \"reference_spp\": %d,\n  \"results\": [", opt.width, opt.reference_spp);
+		bool first = true;
+		for (const auto &r : rows) {
+			if (!r.valid)
+				continue;
+			std::printf("%s\n    {\"scene\": \"%s\", \"sampler\": \"%s\", \"budget\": %g, \"spp\": %d, "
+						"\"seconds\": %.4f, \"rmse\": %.6g, \"relmse\": %.6g, \"flip\": %.6g, \"efficiency\": %.6g}",
+						first ? "" : ",", r.scene.c_str(), sampler_name(r.sampling), r.budget, r.m.spp, r.m.seconds,
+						r.m.rmse, r.m.rel_mse, r.m.flip, 1.0 / (r.m.rel_mse * r.m.seconds));
+			first = false;
+		}
+		std::printf("\n  ]\n}\n");
+	}
+}
+
+int main(int argc, char **argv) {
+	converge_options opt;
+	if (!parse(argc, argv, opt)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<table_row> rows;
+	for (const auto &name : opt.scenes) {
+		scene s;
+		if (!make_scene(name, s)) {
+			std::cerr << "ERROR: Unknown scene '" << name << "'.\n";
+			return 1;
+		}
+		const int width = opt.width;
+		const int height = std::max(static_cast<int>(width / s.aspect_ratio), 1);
+
+		std::vector<color> reference;
+		load_reference(s, opt, width, height, reference);
+
+		for (auto sampling : opt.samplers) {
+			const auto curve = converge(s, opt, sampling, width, height, reference);
+			// 每个预算取预算之内的最后一遍
+			for (double budget : opt.budgets) {
+				table_row row{name, sampling, budget, measurement(), false};
+				for (const auto &m : curve) {
+					if (m.seconds <= budget) {
+						row.m = m;
+						row.valid = true;
+					}
+				}
+				rows.push_back(row);
+			}
+		}
+	}
+
+	if (opt.json)
+		print_json(rows, opt);
+	else
+		print_table(rows);
+	return 0;
+}
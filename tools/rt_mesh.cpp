@@ -0,0 +1,236 @@
+// 外存网格测试: 生成一块分块存储的地形(.rtm), 在限定的几何缓存下追踪光线, 报告吞吐量、缓存统计和峰值常驻内存
+#include "geometry/geometry_cache.h"
+#include "shape/chunked_mesh.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+	using clock_type = std::chrono::high_resolution_clock;
+
+	double elapsed_seconds(clock_type::time_point start) {
+		return std::chrono::duration<double>(clock_type::now() - start).count();
+	}
+
+	// 进程到目前为止的峰值常驻内存(MB), 不支持的平台返回0
+	double peak_rss_mb() {
+#ifdef _WIN32
+		return 0.0;
+#else
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0.0;
+		// Linux 上 ru_maxrss 的单位是 KB
+		return usage.ru_maxrss / 1024.0;
+#endif
+	}
+
+	double terrain_height(double x, double z) {
+		return 20.0 * std::sin(x * 0.013) * std::cos(z * 0.011) + 6.0 * std::sin(x * 0.05 + z * 0.03) +
+			   1.5 * std::sin(x * 0.21) * std::sin(z * 0.17);
+	}
+
+	// size x size 个格子的高度场, 每格两个三角形, 中心在原点
+	std::vector<float> make_terrain(int size) {
+		std::vector<float> positions;
+		positions.reserve(size_t(size) * size * 18);
+		const double half = 0.5 * size;
+		auto vertex = [&](int i, int j) {
+			const double x = i - half, z = j - half;
+			positions.push_back(static_cast<float>(x));
+			positions.push_back(static_cast<float>(terrain_height(x, z)));
+			positions.push_back(static_cast<float>(z));
+		};
+		for (int j = 0; j < size; ++j) {
+			for (int i = 0; i < size; ++i) {
+				vertex(i, j);
+				vertex(i + 1, j);
+				vertex(i + 1, j + 1);
+				vertex(i, j);
+				vertex(i + 1, j + 1);
+				vertex(i, j + 1);
+			}
+		}
+		return positions;
+	}
+
+	struct camera_setup {
+		point3 origin;
+		vec3 u, v, w;
+		size_t width, height;
+		double scale;
+	};
+
+	// 从地形一角斜看过去
+	camera_setup make_camera(const aabb &bounds, size_t count) {
+		const vec3 extent = bounds.max() - bounds.min();
+		camera_setup cam;
+		cam.origin = bounds.min() + vec3(0.05 * extent.x(), extent.y() + 30.0, 0.05 * extent.z());
+		const point3 target = bounds.min() + vec3(0.6 * extent.x(), 0.0, 0.6 * extent.z());
+		cam.w = unit_vector(cam.origin - target);
+		cam.u = unit_vector(cross(vec3(0, 1, 0), cam.w));
+		cam.v = cross(cam.w, cam.u);
+		cam.width = std::max<size_t>(1, static_cast<size_t>(std::sqrt(double(count))));
+		cam.height = (count + cam.width - 1) / cam.width;
+		cam.scale = std::tan(degrees_to_radians(35.0));
+		return cam;
+	}
+
+	// 第 [begin, end) 条相机光线, 按扫描线顺序
+	void camera_rays(const camera_setup &cam, size_t begin, size_t end, std::vector<ray> &rays) {
+		rays.clear();
+		for (size_t k = begin; k < end; ++k) {
+			const double sx = (2.0 * ((k % cam.width) + random_double()) / cam.width - 1.0) * cam.scale;
+			const double sy = (1.0 - 2.0 * ((k / cam.width) + random_double()) / cam.height) * cam.scale;
+			rays.emplace_back(cam.origin, unit_vector(sx * cam.u + sy * cam.v - cam.w));
+		}
+	}
+
+	// 命中点上的余弦分布反弹光线, 方向上不相干
+	void bounce_rays(const std::vector<hit_record> &hits, const std::vector<char> &found, std::vector<ray> &rays) {
+		rays.clear();
+		for (size_t k = 0; k < hits.size(); ++k) {
+			if (!found[k])
+				continue;
+			vec3 dir = hits[k].normal + random_unit_vector();
+			if (dir.near_zero())
+				dir = hits[k].normal;
+			rays.emplace_back(hits[k].p, unit_vector(dir));
+		}
+	}
+
+	struct wave_result {
+		double seconds = 0;
+		size_t rays = 0;
+		size_t hits = 0;
+		size_t deferred = 0;
+		uint64_t loads = 0;
+		uint64_t evictions = 0;
+	};
+
+	void trace_wave(const chunked_mesh &mesh, const std::vector<ray> &rays, bool sync, std::vector<hit_record> &hits,
+					std::vector<char> &found, wave_result &result) {
+		const auto before = geometry_cache::instance().stats();
+		const auto start = clock_type::now();
+		if (sync) {
+			hits.resize(rays.size());
+			found.assign(rays.size(), 0);
+#pragma omp parallel for schedule(dynamic, 256)
+			for (long long k = 0; k < static_cast<long long>(rays.size()); ++k)
+				found[k] = mesh.hit(rays[k], 1e-4, infinity, hits[k]);
+		} else {
+			result.deferred += mesh.trace_batch(rays, 1e-4, infinity, hits, found).deferred;
+		}
+		result.seconds += elapsed_seconds(start);
+		const auto after = geometry_cache::instance().stats();
+		result.rays += rays.size();
+		for (char f : found)
+			result.hits += f != 0;
+		result.loads += after.misses - before.misses;
+		result.evictions += after.evictions - before.evictions;
+	}
+
+	void print_usage(const char *program) {
+		std::cerr << "usage: " << program << " --write [--size n] <mesh.rtm>\n"
+				  << "       " << program << " [--cache-mb m] [--rays n] [--batch n] [--sync] <mesh.rtm>\n"
+				  << "  --write      generate an n x n heightfield (2 n^2 triangles, default n = 1024)\n"
+				  << "  --cache-mb   geometry cache limit in MB (default 32)\n"
+				  << "  --rays       camera rays; every hit spawns one diffuse bounce ray (default 1000000)\n"
+				  << "  --batch      rays per batch (default 65536); hits on non-resident chunks are deferred to the end of a batch\n"
+				  << "  --sync       load chunks synchronously inside hit() instead of deferring\n";
+	}
+}
+
+int main(int argc, char **argv) {
+	bool write = false, sync = false;
+	int size = 1024;
+	size_t cache_mb = 32, ray_count = 1000000, batch = 65536;
+	std::string path;
+	for (int i = 1; i < argc; ++i) {
+		const bool has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--write")) {
+			write = true;
+		} else if (!std::strcmp(argv[i], "--sync")) {
+			sync = true;
+		} else if (!std::strcmp(argv[i], "--size") && has_value) {
+			size = std::atoi(argv[++i]);
+		} else if (!std::strcmp(argv[i], "--cache-mb") && has_value) {
+			cache_mb = std::strtoull(argv[++i], nullptr, 10);
+		} else if (!std::strcmp(argv[i], "--rays") && has_value) {
+			ray_count = std::strtoull(argv[++i], nullptr, 10);
+		} else if (!std::strcmp(argv[i], "--batch") && has_value) {
+			batch = std::strtoull(argv[++i], nullptr, 10);
+		} else if (argv[i][0] == '-' || !path.empty()) {
+			print_usage(argv[0]);
+			return 1;
+		} else {
+			path = argv[i];
+		}
+	}
+	if (path.empty() || size <= 0 || ray_count == 0 || batch == 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (write) {
+		// 生成时整个网格都在内存里, 和追踪分成两次运行, 峰值内存才只反映追踪
+		const auto start = clock_type::now();
+		const std::vector<float> positions = make_terrain(size);
+		if (!write_chunked_mesh(path, positions)) {
+			std::cerr << "ERROR: Could not write '" << path << "'.\n";
+			return 1;
+		}
+		std::cout << path << ": " << positions.size() / 9 << " triangles, "
+				  << positions.size() * sizeof(float) / (1024.0 * 1024.0) << " MB of vertices, written in "
+				  << elapsed_seconds(start) << " s\n";
+		return 0;
+	}
+
+	auto &cache = geometry_cache::instance();
+	cache.set_memory_limit(cache_mb << 20);
+	const double rss_before = peak_rss_mb();
+
+	chunked_mesh mesh(path, nullptr);
+	if (!mesh.valid())
+		return 1;
+	aabb bounds;
+	mesh.bounding_box(0, 1, bounds);
+	std::cout << path << ": " << mesh.triangle_count() << " triangles in " << mesh.chunk_count() << " chunks, cache "
+			  << cache_mb << " MB, " << (sync ? "synchronous" : "batched (" + std::to_string(batch) + " rays)") << "\n";
+
+	// 光线按批生成: 每批先追踪相机光线, 再追踪它们的反弹光线, 同时只保留一批光线和命中记录
+	const camera_setup cam = make_camera(bounds, ray_count);
+	std::vector<ray> rays;
+	std::vector<hit_record> hits;
+	std::vector<char> found;
+	wave_result waves[2];
+	for (size_t begin = 0; begin < ray_count; begin += batch) {
+		camera_rays(cam, begin, std::min(ray_count, begin + batch), rays);
+		trace_wave(mesh, rays, sync, hits, found, waves[0]);
+		bounce_rays(hits, found, rays);
+		trace_wave(mesh, rays, sync, hits, found, waves[1]);
+	}
+
+	const char *names[2] = {"camera", "bounce"};
+	for (int wave = 0; wave < 2; ++wave) {
+		const wave_result &r = waves[wave];
+		std::cout << "  " << names[wave] << ": " << r.rays << " rays, " << r.rays / r.seconds * 1e-6 << " Mrays/s, "
+				  << 100.0 * r.hits / r.rays << "% hit, " << r.loads << " chunk loads, " << r.evictions << " evictions";
+		if (!sync)
+			std::cout << ", " << r.deferred << " deferred";
+		std::cout << "\n";
+	}
+
+	const auto s = cache.stats();
+	std::cout << "  cache peak " << s.peak_bytes / (1024.0 * 1024.0) << " MB, peak RSS " << peak_rss_mb()
+			  << " MB (" << rss_before << " MB before opening the mesh)\n";
+	return 0;
+}
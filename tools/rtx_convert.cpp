@@ -0,0 +1,101 @@
+// 把 JPEG/PNG 等图像离线转换成分块MIP纹理(.rtx), 并比较两种格式的启动时间
+#include "asset/image_texture.h"
+#include "asset/rtx_texture.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+	using clock_type = std::chrono::high_resolution_clock;
+
+	double elapsed_ms(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	// 默认的输出文件: 换掉输入的扩展名, 与 path_with_suffix 一样, 目录名里的点不算扩展名
+	std::string rtx_path(const std::string &input) {
+		const auto slash = input.find_last_of("/\\");
+		const auto dot = input.find_last_of('.');
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			return input + ".rtx";
+		return input.substr(0, dot) + ".rtx";
+	}
+
+	// 读出所有层的所有块, 返回耗时(毫秒)
+	double read_all_tiles(const tile_source &src) {
+		texture_tile tile;
+		const auto start = clock_type::now();
+		for (int level = 0; level < src.levels(); ++level) {
+			const int tiles_x = (src.level_width(level) + texture_tile::size - 1) / texture_tile::size;
+			const int tiles_y = (src.level_height(level) + texture_tile::size - 1) / texture_tile::size;
+			for (int ty = 0; ty < tiles_y; ++ty)
+				for (int tx = 0; tx < tiles_x; ++tx)
+					src.read_tile(level, tx, ty, tile);
+		}
+		return elapsed_ms(start);
+	}
+
+	void print_usage(const char *program) {
+		std::cerr << "usage: " << program << " [--half] <input image> [output.rtx]\n"
+				  << "  --half   store texels as 16-bit floats (half the size)\n";
+	}
+}
+
+int main(int argc, char **argv) {
+	bool half = false;
+	std::string input, output;
+	for (int i = 1; i < argc; ++i) {
+		if (!std::strcmp(argv[i], "--half")) {
+			half = true;
+		} else if (argv[i][0] == '-') {
+			print_usage(argv[0]);
+			return 1;
+		} else if (input.empty()) {
+			input = argv[i];
+		} else if (output.empty()) {
+			output = argv[i];
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (input.empty()) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	if (output.empty())
+		output = rtx_path(input);
+
+	// stb: 第一块需要解码整张图并生成金字塔
+	const auto decode_start = clock_type::now();
+	stb_tile_source source(input.c_str());
+	if (!source.valid())
+		return 1;
+	texture_tile first;
+	source.read_tile(0, 0, 0, first);
+	const double decode_ms = elapsed_ms(decode_start);
+	const double decode_all_ms = read_all_tiles(source);
+
+	const auto format = half ? rtx_texel_format::float16 : rtx_texel_format::float32;
+	if (!write_rtx_texture(output, source, format)) {
+		std::cerr << "ERROR: Could not write '" << output << "'.\n";
+		return 1;
+	}
+
+	// rtx: 只映射文件, 第一块只会触发一次缺页
+	const auto map_start = clock_type::now();
+	rtx_tile_source mapped(output.c_str());
+	if (!mapped.valid())
+		return 1;
+	mapped.read_tile(0, 0, 0, first);
+	const double map_ms = elapsed_ms(map_start);
+	const double map_all_ms = read_all_tiles(mapped);
+
+	std::cout << input << " -> " << output << " (" << source.width() << "x" << source.height() << ", "
+			  << source.levels() << " levels, " << (half ? "half" : "float") << ")\n"
+			  << "  first tile : decode " << decode_ms << " ms, mmap " << map_ms << " ms\n"
+			  << "  all tiles  : decode " << decode_all_ms << " ms, mmap " << map_all_ms << " ms\n";
+	return 0;
+}